@@ -0,0 +1,196 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// Times gumbo parses the way GumboInterface runs them, with and without
+// the GumboArena, and reports the parse throughput and how much memory
+// a parsed tree keeps.
+//
+// gumbo_parse_bench [--no-arena] [-n iterations] [file.xhtml ...]
+//
+// Without files a fixed set of generated chapters is parsed, so runs on
+// different builds parse exactly the same input.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gumbo.h"
+#include "Parsers/GumboArena.h"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double Msecs(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // A chapter of paragraphs with inline markup, entities and attributes
+    std::string GenerateChapter(int paragraphs, unsigned int seed)
+    {
+        static const char *words[] = {
+            "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+            "chapter", "reading", "&amp;", "caf&#233;", "&#8220;quoted&#8221;", "sigil"
+        };
+        const int word_count = sizeof(words) / sizeof(words[0]);
+        std::string html =
+            "<!DOCTYPE html>\n"
+            "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\">\n"
+            "<head>\n  <title>Chapter</title>\n"
+            "  <link href=\"../Styles/style.css\" type=\"text/css\" rel=\"stylesheet\"/>\n</head>\n"
+            "<body>\n  <h1 id=\"c1\">Chapter One</h1>\n";
+        for (int p = 0; p < paragraphs; p++) {
+            seed = seed * 1103515245 + 12345;
+            html += (seed >> 16) % 7 == 0 ? "  <p class=\"noindent\">" : "  <p>";
+            int length = 20 + (seed >> 8) % 80;
+            for (int w = 0; w < length; w++) {
+                seed = seed * 1103515245 + 12345;
+                const char *word = words[(seed >> 16) % word_count];
+                switch ((seed >> 8) % 23) {
+                    case 0:
+                        html += std::string("<i>") + word + "</i>";
+                        break;
+                    case 1:
+                        html += std::string("<span class=\"smallcaps\">") + word + "</span>";
+                        break;
+                    case 2:
+                        html += std::string("<a href=\"../Text/notes.xhtml#n") + std::to_string(p) + "\">" + word + "</a>";
+                        break;
+                    default:
+                        html += word;
+                }
+                html += w + 1 < length ? " " : ".";
+            }
+            html += "</p>\n";
+        }
+        html += "</body>\n</html>\n";
+        return html;
+    }
+
+    bool ReadFile(const char *path, std::string &data)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        data = buffer.str();
+        // GumboInterface parses from after the xml declaration
+        if (data.compare(0, 5, "<?xml") == 0) {
+            size_t end = data.find_first_of('>', 5);
+            end = data.find_first_not_of("\n\r\t\v\f ", end + 1);
+            data.erase(0, end == std::string::npos ? data.length() : end);
+        }
+        return true;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool use_arena = true;
+    int iterations = 20;
+    std::vector<std::string> sources;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-arena") == 0) {
+            use_arena = false;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            std::string data;
+            if (!ReadFile(argv[i], data)) {
+                fprintf(stderr, "can not read %s\n", argv[i]);
+                return 1;
+            }
+            sources.push_back(data);
+        }
+    }
+    if (sources.empty()) {
+        static const int paragraphs[] = { 10, 50, 200, 800, 3200 };
+        for (int i = 0; i < 5; i++) {
+            sources.push_back(GenerateChapter(paragraphs[i], i + 1));
+        }
+    }
+
+    if (use_arena) {
+        GumboArena::Install();
+    }
+
+    GumboOptions options = kGumboDefaultOptions;
+    options.tab_stop = 4;
+    options.use_xhtml_rules = true;
+    options.stop_on_first_error = false;
+    options.max_tree_depth = 400;
+    options.max_errors = 50;
+
+    size_t input_bytes = 0;
+    for (const std::string &source : sources) {
+        input_bytes += source.length();
+    }
+
+    Clock::duration parse_time(0);
+    Clock::duration teardown_time(0);
+    size_t kept_bytes = 0;
+
+    for (int n = 0; n < iterations; n++) {
+        for (const std::string &source : sources) {
+            GumboArena *arena = use_arena ? new GumboArena() : NULL;
+            Clock::time_point start = Clock::now();
+            GumboOutput *output;
+            {
+                GumboArena::Scope scope(arena);
+                output = gumbo_parse_with_options(&options, source.data(), source.length());
+            }
+            Clock::time_point parsed = Clock::now();
+            if (arena) {
+                if (n == 0) {
+                    kept_bytes += arena->GetAllocatedSize();
+                }
+                if (GumboArena::HasMallocBlocks()) {
+                    gumbo_destroy_output(output);
+                }
+                delete arena;
+            } else {
+                gumbo_destroy_output(output);
+            }
+            teardown_time += Clock::now() - parsed;
+            parse_time += parsed - start;
+        }
+    }
+
+    printf("%s: %zu files, %zu bytes, %d iterations\n", use_arena ? "arena" : "malloc",
+           sources.size(), input_bytes, iterations);
+    printf("parse    %10.1f ms  %6.1f MB/s\n", Msecs(parse_time),
+           input_bytes * iterations / (1024.0 * 1024.0) / (Msecs(parse_time) / 1000.0));
+    printf("teardown %10.1f ms\n", Msecs(teardown_time));
+    if (use_arena) {
+        printf("arena memory kept by the trees %zu KB\n", kept_bytes / 1024);
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// Times Replace All over generated chapters of doubling size, building
+// the result in one pass with the PCREReplaceAllBuilder and replacing
+// each match in place from the end of the text backwards, the way it
+// was done before. The time per match stays flat with the builder and
+// grows with the length of the text when replacing in place.
+//
+// replace_all_bench [--in-place] [-n iterations] [pattern replacement]
+//
+// Matching is not timed, both ways replace the same list of matches.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include <QList>
+#include <QString>
+
+#include "PCRE2/PCREReplaceAllBuilder.h"
+#include "PCRE2/SPCRE.h"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double Msecs(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // A chapter of paragraphs of words with some inline markup
+    QString GenerateChapter(int paragraphs, unsigned int seed)
+    {
+        static const char *words[] = {
+            "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+            "chapter", "reading", "caf\xc3\xa9", "sigil"
+        };
+        const int word_count = sizeof(words) / sizeof(words[0]);
+        QString html = "<body>\n";
+        for (int p = 0; p < paragraphs; p++) {
+            seed = seed * 1103515245 + 12345;
+            html += "  <p>";
+            int length = 20 + (seed >> 8) % 80;
+            for (int w = 0; w < length; w++) {
+                seed = seed * 1103515245 + 12345;
+                QString word = QString::fromUtf8(words[(seed >> 16) % word_count]);
+                if ((seed >> 8) % 17 == 0) {
+                    html += "<i>" + word + "</i>";
+                } else {
+                    html += word;
+                }
+                html += w + 1 < length ? " " : ".";
+            }
+            html += "</p>\n";
+        }
+        html += "</body>\n";
+        return html;
+    }
+
+    QString ReplaceWithBuilder(SPCRE &spcre, const QString &text, const QString &replacement,
+                               const QList<SPCRE::MatchInfo> &match_info)
+    {
+        PCREReplaceAllBuilder builder(spcre, text, replacement, match_info.count());
+        foreach(const SPCRE::MatchInfo &mi, match_info) {
+            builder.AppendReplacement(mi);
+        }
+        return builder.Finish();
+    }
+
+    QString ReplaceInPlace(SPCRE &spcre, const QString &original, const QString &replacement,
+                           const QList<SPCRE::MatchInfo> &match_info)
+    {
+        QString text = original;
+        for (int i = match_info.count() - 1; i >= 0; i--) {
+            const SPCRE::MatchInfo &mi = match_info.at(i);
+            QString replaced_text;
+            if (spcre.replaceText(text.mid(mi.offset.first, mi.offset.second - mi.offset.first),
+                                  mi.capture_groups_offsets, replacement, replaced_text)) {
+                text.replace(mi.offset.first, mi.offset.second - mi.offset.first, replaced_text);
+            }
+        }
+        return text;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool in_place = false;
+    int iterations = 5;
+    QString pattern = "\\b(the|fox)\\b";
+    QString replacement = "<b>\\1</b>";
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--in-place") == 0) {
+            in_place = true;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (positional == 0) {
+            pattern = QString::fromUtf8(argv[i]);
+            positional++;
+        } else {
+            replacement = QString::fromUtf8(argv[i]);
+            positional++;
+        }
+    }
+
+    SPCRE spcre(pattern);
+    if (!spcre.isValid()) {
+        fprintf(stderr, "invalid pattern: %s\n", spcre.getError().toUtf8().constData());
+        return 1;
+    }
+
+    printf("%s: %s -> %s, %d iterations\n", in_place ? "in place" : "builder",
+           pattern.toUtf8().constData(), replacement.toUtf8().constData(), iterations);
+    printf("%10s %10s %12s %12s\n", "chars", "matches", "ms", "ns/match");
+
+    static const int paragraphs[] = { 125, 250, 500, 1000, 2000 };
+    for (int i = 0; i < 5; i++) {
+        QString text = GenerateChapter(paragraphs[i], i + 1);
+        QList<SPCRE::MatchInfo> match_info = spcre.getEveryMatchInfo(text);
+
+        Clock::duration replace_time(0);
+        for (int n = 0; n < iterations; n++) {
+            Clock::time_point start = Clock::now();
+            QString result = in_place ? ReplaceInPlace(spcre, text, replacement, match_info)
+                                      : ReplaceWithBuilder(spcre, text, replacement, match_info);
+            replace_time += Clock::now() - start;
+            if (result.isEmpty()) {
+                return 1;
+            }
+        }
+        double msecs = Msecs(replace_time) / iterations;
+        printf("%10lld %10lld %12.2f %12.1f\n", (long long) text.length(), (long long) match_info.count(),
+               msecs, match_info.isEmpty() ? 0.0 : msecs * 1000000.0 / match_info.count());
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// Times how long GumboInterface takes to write a parsed tree back out
+// with getxhtml(), prettyprint(false) and prettyprint(true). Each source
+// is parsed once per iteration and for both epub versions, the parse is
+// not timed.
+//
+// serialize_bench [-n iterations] [file.xhtml ...]
+//
+// Without files a fixed set of generated chapters is serialized, so runs
+// on different builds write out exactly the same trees.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include "Parsers/GumboInterface.h"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double Msecs(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // A chapter of paragraphs with inline markup, entities and attributes
+    QString GenerateChapter(int paragraphs, unsigned int seed)
+    {
+        static const char *words[] = {
+            "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+            "chapter", "reading", "&amp;", "caf&#233;", "&#8220;quoted&#8221;", "sigil"
+        };
+        const int word_count = sizeof(words) / sizeof(words[0]);
+        QString html =
+            "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+            "<!DOCTYPE html>\n"
+            "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\">\n"
+            "<head>\n  <title>Chapter</title>\n"
+            "  <link href=\"../Styles/style.css\" type=\"text/css\" rel=\"stylesheet\"/>\n</head>\n"
+            "<body>\n  <h1 id=\"c1\">Chapter One</h1>\n";
+        for (int p = 0; p < paragraphs; p++) {
+            seed = seed * 1103515245 + 12345;
+            html += (seed >> 16) % 7 == 0 ? "  <p class=\"noindent\">" : "  <p>";
+            int length = 20 + (seed >> 8) % 80;
+            for (int w = 0; w < length; w++) {
+                seed = seed * 1103515245 + 12345;
+                QString word = words[(seed >> 16) % word_count];
+                switch ((seed >> 8) % 23) {
+                    case 0:
+                        html += "<i>" + word + "</i>";
+                        break;
+                    case 1:
+                        html += "<span class=\"smallcaps\">" + word + "</span>";
+                        break;
+                    case 2:
+                        html += "<a href=\"../Text/notes.xhtml#n" + QString::number(p) + "\">" + word + "</a>";
+                        break;
+                    case 3:
+                        html += word + "<br/>";
+                        break;
+                    default:
+                        html += word;
+                }
+                html += w + 1 < length ? " " : ".";
+            }
+            html += "</p>\n";
+        }
+        html += "</body>\n</html>\n";
+        return html;
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    int iterations = 10;
+    QList<QString> sources;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            QFile file(QString::fromLocal8Bit(argv[i]));
+            if (!file.open(QIODevice::ReadOnly)) {
+                fprintf(stderr, "can not read %s\n", argv[i]);
+                return 1;
+            }
+            sources.append(QString::fromUtf8(file.readAll()));
+        }
+    }
+    if (sources.isEmpty()) {
+        static const int paragraphs[] = { 10, 50, 200, 800, 3200 };
+        for (int i = 0; i < 5; i++) {
+            sources.append(GenerateChapter(paragraphs[i], i + 1));
+        }
+    }
+
+    size_t input_bytes = 0;
+    foreach(const QString &source, sources) {
+        input_bytes += source.toUtf8().length();
+    }
+
+    static const char *versions[] = { "2.0", "3.0" };
+    Clock::duration xhtml_time(0);
+    Clock::duration pretty_time(0);
+    Clock::duration keep_ws_time(0);
+    size_t output_chars = 0;
+
+    for (int n = 0; n < iterations; n++) {
+        foreach(const QString &source, sources) {
+            for (int v = 0; v < 2; v++) {
+                GumboInterface gi(source, versions[v]);
+                gi.parse();
+                Clock::time_point start = Clock::now();
+                QString xhtml = gi.getxhtml();
+                Clock::time_point serialized = Clock::now();
+                QString pretty = gi.prettyprint(false);
+                Clock::time_point prettyprinted = Clock::now();
+                QString keep_ws = gi.prettyprint(true);
+                keep_ws_time += Clock::now() - prettyprinted;
+                pretty_time += prettyprinted - serialized;
+                xhtml_time += serialized - start;
+                if (n == 0) {
+                    output_chars += xhtml.length() + pretty.length() + keep_ws.length();
+                }
+            }
+        }
+    }
+
+    // every source is written out once per epub version
+    double mbytes = 2.0 * input_bytes * iterations / (1024.0 * 1024.0);
+    printf("%lld files, %zu bytes, %d iterations, epub 2 and 3, %zu chars written per iteration\n",
+           (long long) sources.count(), input_bytes, iterations, output_chars);
+    printf("getxhtml              %10.1f ms  %6.1f MB/s\n", Msecs(xhtml_time),
+           mbytes / (Msecs(xhtml_time) / 1000.0));
+    printf("prettyprint           %10.1f ms  %6.1f MB/s\n", Msecs(pretty_time),
+           mbytes / (Msecs(pretty_time) / 1000.0));
+    printf("prettyprint(keep ws)  %10.1f ms  %6.1f MB/s\n", Msecs(keep_ws_time),
+           mbytes / (Msecs(keep_ws_time) / 1000.0));
+    return 0;
+}
@@ -0,0 +1,87 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// The routines GumboInterface, PrettyPrintProps and QuickParser use from
+// Utility, so the serializer benchmark does not need the rest of Sigil.
+// There is no preferences directory, the pretty printer always uses its
+// built in defaults, and the paths a source update would rewrite are
+// left as they are.
+
+#include <utility>
+
+#include <QString>
+#include <QStringView>
+
+#include "Misc/Utility.h"
+
+QString Utility::Substring(int start_index, int end_index, const QStringView string)
+{
+    return string.sliced(start_index, end_index - start_index).toString();
+}
+
+QString Utility::Substring(int start_index, int end_index, const QString &string)
+{
+    return string.mid(start_index, end_index - start_index);
+}
+
+QStringView Utility::SubstringView(int start_index, int end_index, const QString &string)
+{
+    return QStringView(string).sliced(start_index, end_index - start_index);
+}
+
+QString Utility::DefinePrefsDir()
+{
+    return QString();
+}
+
+QString Utility::ReadUnicodeTextFile(const QString &fullfilepath, bool canthrow)
+{
+    return QString();
+}
+
+void Utility::WriteUnicodeTextFile(const QString &text, const QString &fullfilepath, bool canthrow)
+{
+}
+
+QString Utility::URLEncodePath(const QString &path)
+{
+    return path;
+}
+
+QString Utility::URLDecodePath(const QString &path)
+{
+    return path;
+}
+
+QString Utility::buildBookPath(const QString &dest_relpath, const QString &start_folder)
+{
+    return dest_relpath;
+}
+
+QString Utility::buildRelativePath(const QString &from_file_bkpath, const QString &to_file_bkpath)
+{
+    return to_file_bkpath;
+}
+
+std::pair<QString, QString> Utility::parseRelativeHREF(const QString &relative_href)
+{
+    return std::pair<QString, QString>(relative_href, QString());
+}
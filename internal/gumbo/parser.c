@@ -999,8 +999,13 @@ static void insert_text_token(GumboParser* parser, GumboToken* token) {
     buffer_state->_start_original_text = token->original_text.data;
     buffer_state->_start_position = token->position;
   }
-  gumbo_string_buffer_append_codepoint(
-      token->v.character, &buffer_state->_buffer);
+  if (token->is_text_run) {
+    gumbo_string_buffer_append_string(
+        &token->original_text, &buffer_state->_buffer);
+  } else {
+    gumbo_string_buffer_append_codepoint(
+        token->v.character, &buffer_state->_buffer);
+  }
   if (token->type == GUMBO_TOKEN_CHARACTER) {
     buffer_state->_type = GUMBO_NODE_TEXT;
   } else if (token->type == GUMBO_TOKEN_CDATA) {
@@ -4582,6 +4587,14 @@ GumboOutput* gumbo_parse_fragment(
       gumbo_tokenizer_set_is_current_node_foreign(
           &parser, current_node &&
           current_node->v.element.tag_namespace != GUMBO_NAMESPACE_HTML);
+      // Text in the body of the document goes into the current text node
+      // character by character, so the tokenizer may hand it over in runs.
+      // Not right after <pre> and the like, which drop a leading line feed.
+      const GumboNode* adjusted_node = get_adjusted_current_node(&parser);
+      gumbo_tokenizer_set_emit_text_runs(
+          &parser, state->_insertion_mode == GUMBO_INSERTION_MODE_IN_BODY &&
+          !state->_ignore_next_linefeed && adjusted_node &&
+          adjusted_node->v.element.tag_namespace == GUMBO_NAMESPACE_HTML);
       has_error = !gumbo_lex(&parser, &token) || has_error;
     }
     const char* token_type = "text";
@@ -140,6 +140,10 @@ typedef struct GumboInternalTokenizerState {
   // text tokens emitted will be GUMBO_TOKEN_CDATA.
   bool _is_in_cdata;
 
+  // A flag indicating whether the data state may emit a run of plain text as
+  // one token.  This is set by gumbo_tokenizer_set_emit_text_runs.
+  bool _emit_text_runs;
+
   // Certain states (notably character references) may emit two character tokens
   // at once, but the contract for lex() fills in only one token at a time.  The
   // extra character is buffered here, and then this is checked on entry to
@@ -472,6 +476,7 @@ static void finish_doctype_system_id(GumboParser* parser) {
 static void emit_char(GumboParser* parser, int c, GumboToken* output) {
   output->type = get_char_token_type(parser->_tokenizer_state->_is_in_cdata, c);
   output->v.character = c;
+  output->is_text_run = false;
   finish_token(parser, output);
 }
 
@@ -499,6 +504,30 @@ static bool emit_current_char(GumboParser* parser, GumboToken* output) {
   return RETURN_SUCCESS;
 }
 
+// Writes the run of plain text starting at the current input character out as
+// one character or whitespace token, or just the current character if it does
+// not start a run.  Always returns RETURN_SUCCESS.
+static StateResult emit_text_run(GumboParser* parser, GumboToken* output) {
+  GumboTokenizerState* tokenizer = parser->_tokenizer_state;
+  // After a carriage return line feed pair the token starts at the carriage
+  // return, which must not end up in the run's original text.
+  if (tokenizer->_token_start != utf8iterator_get_char_pointer(&tokenizer->_input)) {
+    return emit_current_char(parser, output);
+  }
+  int c = utf8iterator_current(&tokenizer->_input);
+  bool has_non_whitespace = false;
+  if (utf8iterator_next_text_run(&tokenizer->_input, &has_non_whitespace) == 0) {
+    return emit_current_char(parser, output);
+  }
+  output->type = has_non_whitespace ? GUMBO_TOKEN_CHARACTER : GUMBO_TOKEN_WHITESPACE;
+  output->v.character = c;
+  output->is_text_run = true;
+  // The input is already past the run, so finish_token must not advance it.
+  tokenizer->_reconsume_current_input = true;
+  finish_token(parser, output);
+  return RETURN_SUCCESS;
+}
+
 // Writes out a doctype token, copying it from the tokenizer state.
 static void emit_doctype(GumboParser* parser, GumboToken* output) {
   output->type = GUMBO_TOKEN_DOCTYPE;
@@ -842,6 +871,7 @@ void gumbo_tokenizer_state_init(
   tokenizer->_reconsume_current_input = false;
   tokenizer->_is_current_node_foreign = false;
   tokenizer->_is_in_cdata = false;
+  tokenizer->_emit_text_runs = false;
   tokenizer->_tag_state._last_start_tag = GUMBO_TAG_LAST;
 
   tokenizer->_buffered_emit_char = kGumboNoChar;
@@ -880,6 +910,10 @@ void gumbo_tokenizer_set_is_current_node_foreign(
   parser->_tokenizer_state->_is_current_node_foreign = is_foreign;
 }
 
+void gumbo_tokenizer_set_emit_text_runs(GumboParser* parser, bool emit_text_runs) {
+  parser->_tokenizer_state->_emit_text_runs = emit_text_runs;
+}
+
 // http://www.whatwg.org/specs/web-apps/current-work/complete5/tokenization.html#data-state
 static StateResult handle_data_state(
     GumboParser* parser, GumboTokenizerState* tokenizer,
@@ -902,6 +936,9 @@ static StateResult handle_data_state(
       emit_char(parser, c, output);
       return RETURN_ERROR;
     default:
+      if (tokenizer->_emit_text_runs) {
+        return emit_text_run(parser, output);
+      }
       return emit_current_char(parser, output);
   }
 }
@@ -61,6 +61,10 @@ typedef struct GumboInternalToken {
   GumboSourcePosition position;
   GumboStringPiece original_text;
   bool is_injected;
+  // Set for a character or whitespace token that stands for a whole run of
+  // plain text, original_text is then its content and v.character its first
+  // character.
+  bool is_text_run;
   union {
     GumboTokenDocType doc_type;
     GumboTokenStartTag start_tag;
@@ -92,6 +96,13 @@ void gumbo_tokenizer_set_state(
 void gumbo_tokenizer_set_is_current_node_foreign(
     struct GumboInternalParser* parser, bool is_foreign);
 
+// Flags whether runs of plain text in the data state may be emitted as a
+// single character token (see GumboToken.is_text_run) instead of one token per
+// character.  The parser sets this only where it would insert each of those
+// characters into the same text node without looking at them.
+void gumbo_tokenizer_set_emit_text_runs(
+    struct GumboInternalParser* parser, bool emit_text_runs);
+
 // Lexes a single token from the specified buffer, filling the output with the
 // parsed GumboToken data structure.  Returns true for a successful
 // tokenization, false if a parse error occurs.
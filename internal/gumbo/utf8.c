@@ -216,6 +216,93 @@ void utf8iterator_next(Utf8Iterator* iter) {
   read_char(iter);
 }
 
+// Printable ASCII other than '<' and '&'.  These need no decoding and
+// advance the position by one column each.
+static inline bool is_plain_ascii(unsigned char c) {
+  return c >= 0x20 && c < 0x7F && c != '<' && c != '&';
+}
+
+// Returns a pointer to the first byte in [c, end) that is not plain ASCII.
+static const char* skip_plain_ascii(const char* c, const char* end) {
+  while (c < end && is_plain_ascii((unsigned char) *c)) {
+    ++c;
+  }
+  return c;
+}
+
+size_t utf8iterator_next_text_run(Utf8Iterator* iter, bool* has_non_whitespace) {
+  const char* start = iter->_start;
+  const char* end = iter->_end;
+  const char* c = start;
+  GumboSourcePosition pos = iter->_pos;
+  int tab_stop = iter->_parser->_options->tab_stop;
+  bool non_whitespace = false;
+
+  while (c < end) {
+    const char* plain_end = skip_plain_ascii(c, end);
+    if (plain_end != c) {
+      if (!non_whitespace) {
+        for (const char* p = c; p < plain_end; ++p) {
+          if (*p != ' ') {
+            non_whitespace = true;
+            break;
+          }
+        }
+      }
+      pos.column += (unsigned int) (plain_end - c);
+      pos.offset += (unsigned int) (plain_end - c);
+      c = plain_end;
+      if (c == end) {
+        break;
+      }
+    }
+    // The same position updates as update_position for the characters that
+    // end the plain ASCII scan but not the run.
+    unsigned char byte = (unsigned char) *c;
+    if (byte == '\n') {
+      ++pos.line;
+      pos.column = 1;
+      ++pos.offset;
+      ++c;
+    } else if (byte == '\t') {
+      pos.column = ((pos.column / tab_stop) + 1) * tab_stop;
+      ++pos.offset;
+      ++c;
+    } else if (byte == '\f') {
+      ++pos.column;
+      ++pos.offset;
+      ++c;
+    } else if (byte >= 0x80) {
+      uint32_t code_point = 0;
+      uint32_t state = UTF8_ACCEPT;
+      const char* next = c;
+      do {
+        decode(&state, &code_point, (uint32_t) (unsigned char) (*next));
+        ++next;
+      } while (next < end && state != UTF8_ACCEPT && state != UTF8_REJECT);
+      if (state != UTF8_ACCEPT || utf8_is_invalid_code_point(code_point)) {
+        // read_char reports these
+        break;
+      }
+      non_whitespace = true;
+      ++pos.column;
+      pos.offset += (unsigned int) (next - c);
+      c = next;
+    } else {
+      break;
+    }
+  }
+
+  if (c == start) {
+    return 0;
+  }
+  *has_non_whitespace = non_whitespace;
+  iter->_start = c;
+  iter->_pos = pos;
+  read_char(iter);
+  return (size_t) (c - start);
+}
+
 int utf8iterator_current(const Utf8Iterator* iter) {
   return iter->_current;
 }
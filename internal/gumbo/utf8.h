@@ -88,6 +88,14 @@ void utf8iterator_init(
 // Advances the current position by one code point.
 void utf8iterator_next(Utf8Iterator* iter);
 
+// Advances the current position over the run of plain text that starts at the
+// current code point: everything up to the next '<', '&', NUL, carriage
+// return, invalid or truncated UTF-8 sequence or code point the spec forbids,
+// which the iterator is left on.  Returns the length of the run in bytes, 0 if
+// the current code point does not start one.  *has_non_whitespace is set if
+// the run holds anything besides spaces, tabs, line feeds and form feeds.
+size_t utf8iterator_next_text_run(Utf8Iterator* iter, bool* has_non_whitespace);
+
 // Returns the current code point as an integer.
 int utf8iterator_current(const Utf8Iterator* iter);
 
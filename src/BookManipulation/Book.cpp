@@ -30,6 +30,8 @@
 #include "BookManipulation/Book.h"
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/DocumentFactsCache.h"
+#include "BookManipulation/StylesheetGraph.h"
 #include "Parsers/GumboInterface.h"
 #include "Parsers/CSSToolbox.h"
 #include "Parsers/CSSInfo.h"
@@ -226,6 +228,7 @@ const QString HTML5_COVER_SOURCE =
 Book::Book()
     :
     m_Mainfolder(new FolderKeeper(this)),
+    m_StylesheetGraph(new StylesheetGraph()),
     m_IsModified(false)
 {
 }
@@ -233,6 +236,7 @@ Book::Book()
 Book::~Book()
 {
     delete m_Mainfolder;
+    delete m_StylesheetGraph;
 }
 
 
@@ -816,38 +820,8 @@ std::tuple<QString, QList<XhtmlDoc::XMLElement>> Book::GetLinkElementsInHTMLFile
 
 QStringList Book::GetStyleUrlsInHTMLFiles()
 {
-    QStringList styles_in_html;
-    const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture<std::tuple<QString, QStringList>> future = QtConcurrent::mapped(html_resources, GetStyleUrlsInHTMLFileMapped);
-
-    for (int i = 0; i < future.results().count(); i++) {
-        QString bookpath;
-        QStringList style_bookpaths;
-        std::tie(bookpath, style_bookpaths) = future.resultAt(i);
-        // Each target entry has a list of filenames that contain it
-        styles_in_html.append(style_bookpaths);
-    }
-    return styles_in_html;
-}
-
-std::tuple<QString, QStringList> Book::GetStyleUrlsInHTMLFileMapped(HTMLResource *html_resource)
-{
-    QString html_bookpath = html_resource->GetRelativePath();
-    QString startdir = html_resource->GetFolder();
-    // we need to convert this hreflist to bookpaths if possible
-    QStringList urllist = XhtmlDoc::GetAllDescendantStyleUrls(html_resource->GetText());
-    QStringList bookpaths;
-    QRegularExpression url_file_search("url\\s*\\(\\s*['\"]?([^\\(\\)'\"]*)[\"']?\\)");
-    foreach (QString url, urllist) {
-        QRegularExpressionMatch match = url_file_search.match(url);
-        if (match.hasMatch()) {
-            QString ahref = match.captured(1);
-            if (ahref.indexOf(":") == -1) {
-                bookpaths << Utility::buildBookPath(ahref, startdir);
-            }
-        }
-    }
-    return std::make_tuple(html_bookpath, bookpaths);
+    RefreshStylesheetGraph();
+    return m_StylesheetGraph->GetHTMLFilesUsingUrls().keys();
 }
 
 QHash<QString, QStringList> Book::GetIdsInHTMLFiles()
@@ -870,12 +844,12 @@ QHash<QString, QStringList> Book::GetIdsInHTMLFiles()
 std::tuple<QString, QStringList> Book::GetIdsInHTMLFileMapped(HTMLResource *html_resource)
 {
     return std::make_tuple(html_resource->GetRelativePath(),
-                           XhtmlDoc::GetAllDescendantIDs(html_resource->GetText()));
+                           DocumentFactsCache::instance().GetFacts(html_resource)->ids);
 }
 
 QStringList Book::GetIdsInHTMLFile(HTMLResource *html_resource)
 {
-    return XhtmlDoc::GetAllDescendantIDs(html_resource->GetText());
+    return DocumentFactsCache::instance().GetFacts(html_resource)->ids;
 }
 
 
@@ -923,12 +897,12 @@ QHash<QString, QStringList> Book::GetHrefsInHTMLFiles()
 std::tuple<QString, QStringList> Book::GetHrefsInHTMLFileMapped(HTMLResource *html_resource)
 {
     return std::make_tuple(html_resource->GetRelativePath(),
-                           XhtmlDoc::GetAllDescendantHrefs(html_resource->GetText()));
+                           DocumentFactsCache::instance().GetFacts(html_resource)->hrefs);
 }
 
 QStringList Book::GetClassesInHTMLFile(HTMLResource *html_resource)
 {
-    return XhtmlDoc::GetAllDescendantClasses(html_resource->GetText());
+    return DocumentFactsCache::instance().GetFacts(html_resource)->classes;
 }
 
 QHash<QString, QStringList> Book::GetImagesInHTMLFiles()
@@ -1021,39 +995,14 @@ QHash<QString, QStringList> Book::GetHTMLFilesUsingMedia()
 
 QHash<QString, QStringList> Book::GetHTMLFilesUsingMediaInStyleUrls()
 {
-    QHash<QString, QStringList> html_files;
-    const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-
-    QFuture<std::tuple<QString, QStringList>> future = QtConcurrent::mapped(html_resources, GetStyleUrlsInHTMLFileMapped);
-
-    for (int i = 0; i < future.results().count(); i++) {
-        QString html_bookpath;
-        QStringList url_bookpaths;
-        std::tie(html_bookpath, url_bookpaths) = future.resultAt(i);
-        foreach(QString url_bookpath, url_bookpaths) {
-            html_files[url_bookpath].append(html_bookpath);
-        }
-    }
-    return html_files;
+    RefreshStylesheetGraph();
+    return m_StylesheetGraph->GetHTMLFilesUsingUrls();
 }
 
 QHash<QString, QStringList> Book::GetCSSFilesUsingUrls()
 {
-    QHash<QString, QStringList> css_files;
-    const QList<CSSResource*> css_resources = m_Mainfolder->GetResourceTypeList<CSSResource>(false);
-
-    QFuture<std::tuple<QString, QStringList>> future = QtConcurrent::mapped(css_resources, GetUrlsInCSSFileMapped);
-
-    for (int i = 0; i < future.results().count(); i++) {
-        QString css_bookpath;
-        QStringList url_bookpaths;
-        std::tie(css_bookpath, url_bookpaths) = future.resultAt(i);
-        foreach(QString url_bookpath, url_bookpaths) {
-            css_files[url_bookpath].append(css_bookpath);
-        }
-    }
-
-    return css_files;
+    RefreshStylesheetGraph();
+    return m_StylesheetGraph->GetCSSFilesUsingUrls();
 }
 
 QHash<QString, QStringList> Book::GetHTMLFilesUsingImages()
@@ -1080,8 +1029,7 @@ std::tuple<QString, QStringList> Book::GetMediaInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList media_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), 
-                                                                       GIMAGE_TAGS + GVIDEO_TAGS + GAUDIO_TAGS);
+    QStringList media_hrefs = DocumentFactsCache::instance().GetFacts(html_resource)->media_paths;
     QStringList media_bookpaths;
     foreach(QString ahref, media_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1091,32 +1039,11 @@ std::tuple<QString, QStringList> Book::GetMediaInHTMLFileMapped(HTMLResource *ht
     return std::make_tuple(html_bookpath, media_bookpaths);
 }
 
-std::tuple<QString, QStringList> Book::GetUrlsInCSSFileMapped(CSSResource *css_resource)
-{
-    QString css_bookpath = css_resource->GetRelativePath();
-    QString startdir = css_resource->GetFolder();
-    QRegularExpression url_file_search("url\\s*\\(\\s*['\"]?([^\\(\\)'\"]*)[\"']?\\)");
-
-    QStringList url_bookpaths;
-    CSSInfo css_info(css_resource->GetText());
-    QStringList urllist = css_info.getAllPropertyValues("");
-    foreach (QString url, urllist) {
-        QRegularExpressionMatch match = url_file_search.match(url);
-        if (match.hasMatch()) {
-            QString ahref = match.captured(1);
-            if (ahref.indexOf(":") == -1) {
-                url_bookpaths << Utility::buildBookPath(ahref, startdir);
-            }
-        }
-    }
-    return std::make_tuple(css_bookpath, url_bookpaths);
-}
-
 std::tuple<QString, QStringList> Book::GetImagesInHTMLFileMapped(HTMLResource *html_resource)
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList image_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GIMAGE_TAGS);
+    QStringList image_hrefs = DocumentFactsCache::instance().GetFacts(html_resource)->image_paths;
     QStringList image_bookpaths;
     foreach(QString ahref, image_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1130,7 +1057,7 @@ std::tuple<QString, QStringList> Book::GetVideoInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList video_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GVIDEO_TAGS);
+    QStringList video_hrefs = DocumentFactsCache::instance().GetFacts(html_resource)->video_paths;
     QStringList video_bookpaths;
     foreach(QString ahref, video_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1144,7 +1071,7 @@ std::tuple<QString, QStringList> Book::GetAudioInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList audio_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GAUDIO_TAGS);
+    QStringList audio_hrefs = DocumentFactsCache::instance().GetFacts(html_resource)->audio_paths;
     QStringList audio_bookpaths;
     foreach(QString ahref, audio_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1241,38 +1168,26 @@ QHash<QString, int> Book::GetUniqueWordsInHTMLFiles()
 
 QHash<QString, QStringList> Book::GetStylesheetsInHTMLFiles()
 {
-    QHash<QString, QStringList> links_in_html;
-    const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture<std::tuple<QString, QStringList>> future = QtConcurrent::mapped(html_resources, GetStylesheetsInHTMLFileMapped);
+    RefreshStylesheetGraph();
+    return m_StylesheetGraph->GetStylesheetsInHTMLFiles();
+}
 
-    for (int i = 0; i < future.results().count(); i++) {
-        QString bookpath;
-        QStringList links;
-        std::tie(bookpath, links) = future.resultAt(i);
-        links_in_html[bookpath] = links;
-    }
-    return links_in_html;
+QHash<QString, QStringList> Book::GetEffectiveStylesheetsInHTMLFiles()
+{
+    RefreshStylesheetGraph();
+    return m_StylesheetGraph->GetEffectiveStylesheetsInHTMLFiles();
 }
 
-std::tuple<QString, QStringList> Book::GetStylesheetsInHTMLFileMapped(HTMLResource *html_resource)
+void Book::RefreshStylesheetGraph()
 {
-    QString html_bookpath = html_resource->GetRelativePath();
-    QString startdir = html_resource->GetFolder();
-    QStringList link_hrefs = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
-    QStringList link_bookpaths;
-    foreach(QString ahref, link_hrefs) {
-        if (ahref.indexOf(":") == -1) {
-            std::pair<QString, QString> parts = Utility::parseRelativeHREF(ahref);
-            link_bookpaths << Utility::buildBookPath(parts.first, startdir);
-        }
-    }
-    return std::make_tuple(html_bookpath, link_bookpaths);
+    m_StylesheetGraph->Refresh(m_Mainfolder->GetResourceTypeList<HTMLResource>(false),
+                               m_Mainfolder->GetResourceTypeList<CSSResource>(false));
 }
 
 QStringList Book::GetStylesheetsInHTMLFile(HTMLResource *html_resource)
 {
     // convert encoded links relative to a html resource to their book paths
-    QStringList stylelinks = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList stylelinks = DocumentFactsCache::instance().GetFacts(html_resource)->linked_stylesheets;
     QStringList results;
     QString html_folder = html_resource->GetFolder();
     foreach(QString stylelink, stylelinks) {
@@ -1604,7 +1519,7 @@ QPair<QString, QStringList> Book::GetRelLinksInOneFile(HTMLResource *html_resour
     Q_ASSERT(html_resource);
     QReadLocker locker(&html_resource->GetLock());
     QString htmldir = html_resource->GetFolder();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), html_resource->GetEpubVersion());
+    GumboInterface gi = GumboInterface(html_resource->GetText(), html_resource->GetUtf8Text(), html_resource->GetEpubVersion());
     gi.parse();
     QPair<QString, QStringList> link_pair;
     QStringList hreflist;
@@ -36,6 +36,7 @@
 class CSSResource;
 class SVGResource;
 class FolderKeeper;
+class StylesheetGraph;
 class HTMLResource;
 class NCXResource;
 class OPFResource;
@@ -217,7 +218,6 @@ public:
                                             const QString newname);
 
     QStringList GetStyleUrlsInHTMLFiles();
-    static std::tuple<QString, QStringList> GetStyleUrlsInHTMLFileMapped(HTMLResource *html_resource);
     QHash<QString, QStringList> GetIdsInHTMLFiles();
     static std::tuple<QString, QStringList> GetIdsInHTMLFileMapped(HTMLResource *html_resource);
     QStringList GetIdsInHTMLFile(HTMLResource *html_resource);
@@ -234,9 +234,14 @@ public:
     QHash<QString, int> GetUniqueWordsInHTMLFiles();
 
     QHash<QString, QStringList> GetStylesheetsInHTMLFiles();
-    static std::tuple<QString, QStringList> GetStylesheetsInHTMLFileMapped(HTMLResource *html_resource);
     QStringList GetStylesheetsInHTMLFile(HTMLResource *html_resource);
 
+    /**
+     * Book path of each html file to the stylesheets it links together
+     * with everything they @import, in cascade order
+     */
+    QHash<QString, QStringList> GetEffectiveStylesheetsInHTMLFiles();
+
     QHash<QString, QStringList> GetImagesInHTMLFiles();
     QHash<QString, QStringList> GetVideoInHTMLFiles();
     QHash<QString, QStringList> GetAudioInHTMLFiles();
@@ -246,7 +251,6 @@ public:
     QHash<QString, QStringList> GetCSSFilesUsingUrls();
     QHash<QString, QStringList> GetHTMLFilesUsingImages();
 
-    static std::tuple<QString, QStringList> GetUrlsInCSSFileMapped(CSSResource *css_resource);
     static std::tuple<QString, QStringList> GetMediaInHTMLFileMapped(HTMLResource *html_resource);
     static std::tuple<QString, QStringList> GetImagesInHTMLFileMapped(HTMLResource *html_resource);
     static std::tuple<QString, QStringList> GetVideoInHTMLFileMapped(HTMLResource *html_resource);
@@ -407,6 +411,12 @@ private:
      */
     static void SaveOneResourceToDisk(Resource *resource);
 
+    /**
+     * Brings m_StylesheetGraph up to date with the
+     * current html and css resources.
+     */
+    void RefreshStylesheetGraph();
+
     /**
      * Creates one new section/XHTML document.
      *
@@ -447,6 +457,12 @@ private:
      */
     FolderKeeper *m_Mainfolder;
 
+    /**
+     * Which stylesheets and url() targets the book's files use,
+     * brought up to date by RefreshStylesheetGraph().
+     */
+    StylesheetGraph *m_StylesheetGraph;
+
     /**
      * Stores the modified state of the book.
      */
@@ -33,9 +33,12 @@
 #include "BookManipulation/Book.h"
 #include "BookManipulation/BookReports.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/ParsedDocumentCache.h"
+#include "BookManipulation/ParsedStylesheetCache.h"
 #include "Parsers/CSSInfo.h"
 #include "Parsers/HTMLStyleInfo.h"
 #include "Parsers/GumboInterface.h"
+#include "Parsers/SelectorIndex.h"
 #include "Query/CSelection.h"
 #include "Query/CNode.h"
 #include "Misc/SettingsStore.h"
@@ -53,13 +56,15 @@ QList<BookReports::StyleData *> BookReports::GetHTMLClassUsage(QSharedPointer<Bo
     QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
     QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
-    // Parse each css file once and store its parser object
+    // Get each parsed css file once and hold on to it while in use
     QHash<QString, CSSInfo * > css_parsers;
+    QList<std::shared_ptr<CSSInfo> > css_stylesheets;
     foreach(CSSResource * css_resource, css_resources) {
         QString css_filename = css_resource->GetRelativePath();
         if (!css_parsers.contains(css_filename)) {
-            CSSInfo * cp = new CSSInfo(css_resource->GetText()); 
-            css_parsers[css_filename] = cp;
+            std::shared_ptr<CSSInfo> cp = ParsedStylesheetCache::instance().GetStylesheet(css_resource);
+            css_stylesheets.append(cp);
+            css_parsers[css_filename] = cp.get();
         }
     }
 
@@ -74,12 +79,9 @@ QList<BookReports::StyleData *> BookReports::GetHTMLClassUsage(QSharedPointer<Bo
         html_classes_usage.append(usage_future.resultAt(i));
     }
     
-    // clean up after ourselves
-    foreach(QString css_filename, css_parsers.keys()) {
-        CSSInfo* cp = css_parsers[css_filename];
-        delete cp;
-    }
+    // the parsed css files stay in the cache for the next report
     css_parsers.clear();
+    css_stylesheets.clear();
     return html_classes_usage;
 }
 
@@ -165,14 +167,26 @@ QList<BookReports::StyleData *> BookReports::GetAllCSSSelectorsUsed(QSharedPoint
 
     QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
-    // Parse each css file once and store its parser object
+    // Get each parsed css file once and hold on to it while in use
     QHash<QString, CSSInfo * > css_parsers;
+    QList<std::shared_ptr<CSSInfo> > css_stylesheets;
     foreach(CSSResource * css_resource, css_resources) {
         QString css_filename = css_resource->GetRelativePath();
         if (!css_parsers.contains(css_filename)) {
-            CSSInfo * cp = new CSSInfo(css_resource->GetText());
-            css_parsers[css_filename] = cp;
+            std::shared_ptr<CSSInfo> cp = ParsedStylesheetCache::instance().GetStylesheet(css_resource);
+            css_stylesheets.append(cp);
+            css_parsers[css_filename] = cp.get();
+        }
+    }
+
+    // and compile its selectors once for all the html files that link to it
+    QHash<QString, SelectorIndex * > css_indexes;
+    foreach(QString css_filename, css_parsers.keys()) {
+        SelectorIndex * index = new SelectorIndex();
+        foreach(CSSInfo::CSSSelector * selector, css_parsers[css_filename]->getAllSelectors()) {
+            index->AddSelector(selector->text);
         }
+        css_indexes[css_filename] = index;
     }
 
     QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
@@ -180,7 +194,7 @@ QList<BookReports::StyleData *> BookReports::GetAllCSSSelectorsUsed(QSharedPoint
     QFuture< QList< std::pair<QString,QString> > > usage_future;
     usage_future = QtConcurrent::mapped(html_resources,
                                         std::bind(AllSelectorsUsedInHTMLFileMapped,
-                                                  std::placeholders::_1, css_parsers));
+                                                  std::placeholders::_1, css_parsers, css_indexes));
 
     int num_futures = usage_future.results().count();
     for (int i = 0; i < num_futures; ++i) {
@@ -232,48 +246,65 @@ QList<BookReports::StyleData *> BookReports::GetAllCSSSelectorsUsed(QSharedPoint
         }
     }
 
-    // clean up after ourselves
-    foreach(QString css_filename, css_parsers.keys()) {
-        CSSInfo* cp = css_parsers[css_filename];
-        delete cp;
+    // clean up after ourselves, the parsed css files stay in the cache
+    foreach(QString css_filename, css_indexes.keys()) {
+        delete css_indexes[css_filename];
     }
     css_parsers.clear();
+    css_stylesheets.clear();
+    css_indexes.clear();
 
     return css_selector_usage;
 }
 
 
+// Records the selectors of one stylesheet that matched something in html_resource.
+// If a Query selector parse error occurs to be most safe assume that selector is used.
+static void AppendSelectorsUsed(const QString &css_filename,
+                                const QList<CSSInfo::CSSSelector *> &selectors,
+                                const SelectorIndex &index,
+                                GumboNode *root,
+                                HTMLResource *html_resource,
+                                QList< std::pair<QString, QString> > &selectors_used)
+{
+    std::vector<bool> matched = index.MatchTree(root);
+    for (int i = 0; i < selectors.count(); ++i) {
+        if (matched[i] || index.HasParseError(i)) {
+            CSSInfo::CSSSelector * selector = selectors.at(i);
+            std::pair<QString, QString> res;
+            res.first = css_filename + USEP + QString::number(selector->pos) + USEP + selector->text;
+            res.second = index.HasParseError(i) ? "*** Selector Parse Error ***" : html_resource->GetRelativePath();
+            selectors_used.append(res);
+        }
+    }
+}
+
+
 QList< std::pair<QString,QString> > BookReports::AllSelectorsUsedInHTMLFileMapped(HTMLResource* html_resource,
-                                                                          const QHash<QString, CSSInfo *> &css_parsers)
+                                                                          const QHash<QString, CSSInfo *> &css_parsers,
+                                                                          const QHash<QString, SelectorIndex *> &css_indexes)
 {
     QList< std::pair<QString, QString> > selectors_used;
 
     QStringList linked_stylesheets = html_resource->GetLinkedStylesheets();
     
-    GumboInterface gi = GumboInterface(html_resource->GetText(), "any_version");
+    // shared with the other read only analyses of this revision
+    std::shared_ptr<GumboInterface> document = ParsedDocumentCache::instance().GetDocument(html_resource);
+    GumboNode *root = document->get_root_node();
+    if (!root) {
+        // nothing to match against
+        return selectors_used;
+    }
     
     // Look at each selector from linked CSS files and internal html style tags
-    // and see if they match something in this html file
+    // and see if they match something in this html file, all selectors of a
+    // stylesheet are matched together in one walk of the tree
     // file names are all bookpaths
 
     foreach(QString css_filename, linked_stylesheets) {
         if (css_parsers.contains(css_filename)) {
-            CSSInfo * cp = css_parsers[css_filename];
-            QList<CSSInfo::CSSSelector *> selectors = cp->getAllSelectors();
-            foreach(CSSInfo::CSSSelector * selector, selectors) {
-                // Use Gumbo Query Library to see if selector is found
-                CSelection c = gi.find(selector->text);
-                // if Query selector parse error occurs to be most safe
-                // assume this selector is used in this file
-                std::pair<QString, QString> res;
-                QString foundin = html_resource->GetRelativePath();
-                if (c.parseError()) foundin = "*** Selector Parse Error ***";
-                if (c.parseError() || (c.nodeNum() > 0 && c.nodeAt(0).valid())) {
-                    res.first = css_filename + USEP + QString::number(selector->pos) + USEP + selector->text;
-                    res.second = foundin;
-                    selectors_used.append(res);
-                }
-            }
+            AppendSelectorsUsed(css_filename, css_parsers[css_filename]->getAllSelectors(),
+                                *css_indexes[css_filename], root, html_resource, selectors_used);
         }
     }
 
@@ -281,19 +312,11 @@ QList< std::pair<QString,QString> > BookReports::AllSelectorsUsedInHTMLFileMappe
     HTMLStyleInfo hp(html_resource->GetText());
     if (hp.hasStyles()) {
         QList<CSSInfo::CSSSelector *> selectors = hp.getAllSelectors();
+        SelectorIndex index;
         foreach(CSSInfo::CSSSelector * selector, selectors) {
-            CSelection c = gi.find(selector->text);
-            // if Query selector parse error occurs to be most safe
-            // assume this selector is used in this file
-            std::pair<QString, QString> res;
-            QString foundin = html_resource->GetRelativePath();
-            if (c.parseError()) foundin = "*** Selector Parse Error ***";
-            if (c.parseError() || (c.nodeNum() > 0 && c.nodeAt(0).valid())) {
-                res.first = html_resource->GetRelativePath() + USEP + QString::number(selector->pos) + USEP + selector->text;
-                res.second = foundin;
-                selectors_used.append(res);
-            }
+            index.AddSelector(selector->text);
         }
+        AppendSelectorsUsed(html_resource->GetRelativePath(), selectors, index, root, html_resource, selectors_used);
     }
     return selectors_used;
 }
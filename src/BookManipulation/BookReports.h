@@ -31,6 +31,7 @@
 
 
 class QString;
+class SelectorIndex;
 
 
 class BookReports
@@ -59,7 +60,8 @@ public:
                                                                   bool show_progress = false);
 
     static QList< std::pair<QString,QString> > AllSelectorsUsedInHTMLFileMapped(HTMLResource* html_resource,
-                                                                            const QHash<QString, CSSInfo*> &css_parsers);
+                                                                            const QHash<QString, CSSInfo*> &css_parsers,
+                                                                            const QHash<QString, SelectorIndex*> &css_indexes);
 
 
 };
@@ -33,6 +33,8 @@
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/XhtmlDoc.h"
 #include "Parsers/GumboInterface.h"
+#include "Parsers/WellFormedXMLChecker.h"
+#include "Parsers/XMLPrettyPrinter.h"
 #include "Misc/SettingsStore.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
@@ -42,6 +44,13 @@
 static const QString HEAD_END = "</\\s*head\\s*>";
 const QString SVG_NAMESPACE_PREFIX = "<\\s*[^>]*(xmlns\\s*:\\s*svg\\s*=\\s*(?:\"|')[^\"']+(?:\"|'))[^>]*>";
 
+static const QRegularExpression XML_HEADER("<\\s*\\?xml\\s*[^\\?>]*\\?*>\\s*", QRegularExpression::CaseInsensitiveOption);
+
+static const QString OPF_MEDIA_TYPE = "application/oebps-package+xml";
+
+// the tags xmlprocessor lets bs4 write as empty elements in an opf
+static const QStringList OPF_VOID_TAGS = QStringList() << "item" << "itemref" << "mediatype" << "mediaType" << "reference";
+
 static const QStringList NUMERIC_NBSP = QStringList() << "&#160;" << "&#xa0;" << "&#x00a0;";
 
 
@@ -108,7 +117,26 @@ QString CleanSource::ToValidXHTML(const QString &source, const QString &version)
 
 XhtmlDoc::WellFormedError CleanSource::WellFormedXMLCheck(const QString &source, const QString mtype)
 {
-    XhtmlDoc::WellFormedError error; 
+    XhtmlDoc::WellFormedError error;
+    WellFormedXMLChecker::Error result = CheckXMLWithoutHeader(source);
+    if (result.unsupported) {
+        return WellFormedXMLCheckInPython(source, mtype);
+    }
+    error.line = result.line;
+    error.column = result.column;
+    error.message = result.message;
+    return error;
+}
+
+bool CleanSource::IsWellFormedXML(const QString &source, const QString mtype)
+{
+    return WellFormedXMLCheck(source, mtype).line == -1;
+}
+
+// for the documents WellFormedXMLChecker does not handle
+XhtmlDoc::WellFormedError CleanSource::WellFormedXMLCheckInPython(const QString &source, const QString mtype)
+{
+    XhtmlDoc::WellFormedError error;
     int rv = 0;
     QString error_traceback;
     QList<QVariant> args;
@@ -116,12 +144,12 @@ XhtmlDoc::WellFormedError CleanSource::WellFormedXMLCheck(const QString &source,
     args.append(QVariant(mtype));
 
     QVariant res = EmbeddedPython::instance().runInPython( QString("xmlprocessor"),
-                                         QString("WellFormedXMLCheck"),
+                                         QString("WellFormedXMLErrorCheck"),
                                          args,
                                          &rv,
-                                         error_traceback);    
+                                         error_traceback);
     if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor WellFormedXMLCheck: ") + QString::number(rv), 
+        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor WellFormedXMLErrorCheck: ") + QString::number(rv),
                                          error_traceback);
         // an error happened during check, return well-formed as true
         return error;
@@ -133,26 +161,51 @@ XhtmlDoc::WellFormedError CleanSource::WellFormedXMLCheck(const QString &source,
     return error;
 }
 
-bool CleanSource::IsWellFormedXML(const QString &source, const QString mtype)
+// the xml declaration is removed before the check just as xmlprocessor did
+// so the line numbers reported are relative to what follows it
+WellFormedXMLChecker::Error CleanSource::CheckXMLWithoutHeader(const QString &source)
 {
-    int rv = 0;
-    QString error_traceback;
-    QList<QVariant> args;
-    args.append(QVariant(source));
-    args.append(QVariant(mtype));
+    QString buffer;
+    return WellFormedXMLChecker::Check(WithoutXMLHeader(source, buffer));
+}
 
-    QVariant res = EmbeddedPython::instance().runInPython( QString("xmlprocessor"),
-                                         QString("IsWellFormedXML"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor IsWellFormedXML: ") + QString::number(rv), 
-                                         error_traceback);
-        // an error happened during check return well-formed as true
-        return true;
+// a view of source with its first xml declaration removed, when that is
+// not at the start the text is copied into buffer
+QStringView CleanSource::WithoutXMLHeader(const QString &source, QString &buffer)
+{
+    QRegularExpressionMatch mo = XML_HEADER.match(source);
+    if (!mo.hasMatch()) {
+        return QStringView(source);
+    }
+    if (mo.capturedStart() == 0) {
+        return QStringView(source).mid(mo.capturedEnd());
     }
-    return res.toBool();
+    buffer = source;
+    buffer.remove(mo.capturedStart(), mo.capturedLength());
+    return QStringView(buffer);
+}
+
+// Does what xmlprocessor's repairXML does for xml that is already
+// well-formed without calling into python. Returns a null string when
+// the source needs repairing or is something only the python code
+// handles, a DOCTYPE with an internal subset or an opf Opf_Parser
+// would fail on.
+QString CleanSource::XMLPrettyPrint(const QString &source, const QString mtype)
+{
+    QString buffer;
+    QStringView newsource = WithoutXMLHeader(source, buffer);
+    WellFormedXMLChecker::Error error = WellFormedXMLChecker::Check(newsource);
+    if ((error.line != -1) || error.unsupported) {
+        return QString();
+    }
+    if (mtype != OPF_MEDIA_TYPE) {
+        return source;
+    }
+    QString pretty = XMLPrettyPrinter::PrettyPrint(newsource, OPF_VOID_TAGS);
+    if (pretty.isNull()) {
+        return QString();
+    }
+    return XMLPrettyPrinter::RebuildOPF(pretty);
 }
 
 QString CleanSource::ProcessXML(const QString &source, const QString mtype)
@@ -163,7 +216,11 @@ QString CleanSource::ProcessXML(const QString &source, const QString mtype)
             return source;
         }
     }
-    return XMLPrettyPrintBS4(source, mtype);
+    QString newsource = XMLPrettyPrint(source, mtype);
+    if (newsource.isNull()) {
+        newsource = XMLPrettyPrintBS4(source, mtype);
+    }
+    return newsource;
 }
 
 QString CleanSource::RemoveMetaCharset(const QString &source)
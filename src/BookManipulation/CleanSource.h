@@ -28,6 +28,7 @@
 
 #include "ResourceObjects/HTMLResource.h"
 #include "BookManipulation/XhtmlDoc.h"
+#include "Parsers/WellFormedXMLChecker.h"
 
 class CleanSource
 {
@@ -47,6 +48,8 @@ public:
 
     static QString PrettyPrint(const QString &source, bool keep_whitespace, const QString &version);
 
+    static QString XMLPrettyPrint(const QString &source, const QString mtype="");
+
     static QString XMLPrettyPrintBS4(const QString &source, const QString mtype="");
 
     static QString PrettifyDOCTYPEHeader(const QString &source);
@@ -76,6 +79,13 @@ private:
      */
     static QString RemoveMetaCharset(const QString &source);
 
+    // Checks xml source with its xml declaration removed
+    static WellFormedXMLChecker::Error CheckXMLWithoutHeader(const QString &source);
+
+    static XhtmlDoc::WellFormedError WellFormedXMLCheckInPython(const QString &source, const QString mtype);
+
+    static QStringView WithoutXMLHeader(const QString &source, QString &buffer);
+
 };
 
 
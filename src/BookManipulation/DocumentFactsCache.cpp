@@ -0,0 +1,185 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include "BookManipulation/DocumentFactsCache.h"
+#include "BookManipulation/ParsedDocumentCache.h"
+#include "BookManipulation/XhtmlDoc.h"
+#include "Parsers/GumboInterface.h"
+#include "ResourceObjects/HTMLResource.h"
+
+static const QStringList STYLESHEET_TYPES = QStringList() << "text/css" << "text/x-oeb1-css";
+static const QStringList JAVASCRIPT_TYPES = QStringList() << "text/javascript" << "text/ecmascript" << "application/javascript";
+
+// Far more than the facts of any real book
+static const size_t MAX_CACHE_COST = 16 * 1024 * 1024;
+
+
+static QString AttributeValue(GumboNode *node, const char *name)
+{
+    GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, name);
+    if (attr) {
+        return QString::fromUtf8(attr->value);
+    }
+    return QString();
+}
+
+
+DocumentFactsCache::DocumentFactsCache()
+    :
+    m_Facts(MAX_CACHE_COST)
+{
+}
+
+
+std::shared_ptr<const HTMLDocumentFacts> DocumentFactsCache::GetFacts(HTMLResource *html_resource)
+{
+    const QString identifier = html_resource->GetIdentifier();
+    quint64 revision = html_resource->GetTextRevision();
+    std::shared_ptr<const HTMLDocumentFacts> facts = m_Facts.Find(identifier, revision);
+    if (facts) {
+        return facts;
+    }
+
+    // The document reports the revision it was really parsed from
+    // which may be newer than the one read above
+    std::shared_ptr<GumboInterface> document = ParsedDocumentCache::instance().GetDocument(html_resource, &revision);
+    std::shared_ptr<HTMLDocumentFacts> new_facts = Extract(*document);
+    return m_Facts.Insert(identifier, revision, new_facts, Cost(*new_facts));
+}
+
+
+void DocumentFactsCache::Remove(const QString &resource_id)
+{
+    m_Facts.Remove(resource_id);
+}
+
+
+void DocumentFactsCache::Clear()
+{
+    m_Facts.Clear();
+}
+
+
+size_t DocumentFactsCache::Cost(const HTMLDocumentFacts &facts)
+{
+    const QList<const QStringList *> lists = QList<const QStringList *>()
+        << &facts.ids << &facts.hrefs << &facts.classes << &facts.style_urls
+        << &facts.image_paths << &facts.video_paths << &facts.audio_paths << &facts.media_paths
+        << &facts.linked_stylesheets << &facts.linked_javascripts;
+    size_t cost = sizeof(HTMLDocumentFacts);
+    foreach(const QStringList *list, lists) {
+        foreach(const QString &value, *list) {
+            // the string data plus its header and the list slot
+            cost += value.size() * sizeof(QChar) + 32;
+        }
+    }
+    return cost;
+}
+
+
+std::shared_ptr<HTMLDocumentFacts> DocumentFactsCache::Extract(GumboInterface &gi)
+{
+    std::shared_ptr<HTMLDocumentFacts> facts = std::make_shared<HTMLDocumentFacts>();
+    GumboNode *root = gi.get_root_node();
+    if (root) {
+        // XhtmlDoc::GetAllDescendantIDs lists every id before the anchor names
+        QStringList anchor_names;
+        ExtractFromNode(gi, root, false, *facts, anchor_names);
+        facts->ids.append(anchor_names);
+    }
+    return facts;
+}
+
+
+void DocumentFactsCache::ExtractFromNode(GumboInterface &gi, GumboNode *node, bool in_head,
+                                         HTMLDocumentFacts &facts, QStringList &anchor_names)
+{
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return;
+    }
+    GumboTag tag = node->v.element.tag;
+    GumboVector *attributes = &node->v.element.attributes;
+
+    if (attributes->length > 0) {
+        GumboAttribute *id_attr = gumbo_get_attribute(attributes, "id");
+        if (id_attr) {
+            facts.ids.append(QString::fromUtf8(id_attr->value));
+        }
+        GumboAttribute *name_attr = gumbo_get_attribute(attributes, "name");
+        if (name_attr) {
+            if (id_attr) {
+                anchor_names.append(QString::fromUtf8(id_attr->value));
+            } else if (tag == GUMBO_TAG_A) {
+                // legacy <a name="xxx">, names of other elements like <meta> are not ids
+                anchor_names.append(QString::fromUtf8(name_attr->value));
+            }
+        }
+
+        GumboAttribute *attr = gumbo_get_attribute(attributes, "href");
+        if (attr) {
+            facts.hrefs.append(QString::fromUtf8(attr->value));
+        }
+
+        attr = gumbo_get_attribute(attributes, "class");
+        if (attr) {
+            QString element_name = QString::fromStdString(gi.get_tag_name(node));
+            QString class_values = QString::fromUtf8(attr->value);
+            foreach(QString class_name, class_values.split(" ")) {
+                facts.classes.append(element_name + "." + class_name);
+            }
+        }
+
+        QString style_url = XhtmlDoc::GetStyleUrlOfNode(node);
+        if (!style_url.isEmpty()) {
+            facts.style_urls.append(style_url);
+        }
+
+        bool is_image = GIMAGE_TAGS.contains(tag);
+        bool is_video = GVIDEO_TAGS.contains(tag);
+        bool is_audio = GAUDIO_TAGS.contains(tag);
+        QString media_path;
+        if ((is_image || is_video || is_audio) && XhtmlDoc::GetMediaPathOfNode(node, media_path)) {
+            if (is_image) facts.image_paths.append(media_path);
+            if (is_video) facts.video_paths.append(media_path);
+            if (is_audio) facts.audio_paths.append(media_path);
+            facts.media_paths.append(media_path);
+        }
+
+        if (in_head && (tag == GUMBO_TAG_LINK)) {
+            if (STYLESHEET_TYPES.contains(AttributeValue(node, "type").toLower()) &&
+                (AttributeValue(node, "rel").toLower() == "stylesheet") &&
+                gumbo_get_attribute(attributes, "href")) {
+                facts.linked_stylesheets.append(AttributeValue(node, "href"));
+            }
+        } else if (in_head && (tag == GUMBO_TAG_SCRIPT)) {
+            if (JAVASCRIPT_TYPES.contains(AttributeValue(node, "type").toLower()) &&
+                gumbo_get_attribute(attributes, "src")) {
+                facts.linked_javascripts.append(AttributeValue(node, "src"));
+            }
+        }
+    }
+
+    bool children_in_head = in_head || (tag == GUMBO_TAG_HEAD);
+    GumboVector *children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        ExtractFromNode(gi, static_cast<GumboNode*>(children->data[i]), children_in_head, facts, anchor_names);
+    }
+}
@@ -0,0 +1,128 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef DOCUMENTFACTSCACHE_H
+#define DOCUMENTFACTSCACHE_H
+
+#include <memory>
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include "gumbo.h"
+#include "BookManipulation/RevisionCache.h"
+
+class GumboInterface;
+class HTMLResource;
+
+/**
+ * The facts about one xhtml file the book wide reports and link checks
+ * ask for, all gathered in a single walk over its parsed tree.
+ * Lists are in document order and hold raw attribute values unless
+ * noted otherwise, exactly as the XhtmlDoc functions return them.
+ *
+ * Word counts are not kept here: they depend on the spell check
+ * settings and dictionaries as well as the text, so a record keyed by
+ * text revision alone would go stale. Language spans are left out
+ * until something asks for them.
+ */
+struct HTMLDocumentFacts
+{
+    // id attributes followed by the names of <a name="..."> anchors
+    QStringList ids;
+
+    QStringList hrefs;
+
+    // element.class for every class of every element
+    QStringList classes;
+
+    // the url(...) parts of style attributes
+    QStringList style_urls;
+
+    // url decoded local media paths by kind of element
+    QStringList image_paths;
+    QStringList video_paths;
+    QStringList audio_paths;
+    QStringList media_paths;
+
+    // hrefs of the stylesheets and srcs of the scripts linked in the head
+    QStringList linked_stylesheets;
+    QStringList linked_javascripts;
+};
+
+
+/**
+ * Singleton. Book wide cache of HTMLDocumentFacts.
+ *
+ * Facts are keyed by resource identifier and text revision like the
+ * parsed documents they are taken from, so the book wide queries
+ * (ids, hrefs, classes, media, stylesheets ...) walk a file once per
+ * edit instead of once per query. The least recently used facts are
+ * dropped once the cache holds more than its cost limit.
+ */
+class DocumentFactsCache
+{
+
+public:
+    static DocumentFactsCache &instance() {
+        static DocumentFactsCache the_instance;
+        return the_instance;
+    }
+
+    DocumentFactsCache(const DocumentFactsCache&) = delete;
+    DocumentFactsCache& operator=(const DocumentFactsCache&) = delete;
+
+    /**
+     * Returns the facts for the current text of html_resource,
+     * gathering them first if needed. Safe to call from worker threads.
+     */
+    std::shared_ptr<const HTMLDocumentFacts> GetFacts(HTMLResource *html_resource);
+
+    /**
+     * Drops the cached facts of the resource with identifier resource_id.
+     */
+    void Remove(const QString &resource_id);
+
+    /**
+     * Drops every cached entry.
+     */
+    void Clear();
+
+    /**
+     * Gathers the facts of an already parsed document.
+     */
+    static std::shared_ptr<HTMLDocumentFacts> Extract(GumboInterface &gi);
+
+private:
+    DocumentFactsCache();
+    ~DocumentFactsCache() = default;
+
+    // Rough memory footprint of facts, for the cost limit.
+    static size_t Cost(const HTMLDocumentFacts &facts);
+
+    static void ExtractFromNode(GumboInterface &gi, GumboNode *node, bool in_head,
+                                HTMLDocumentFacts &facts, QStringList &anchor_names);
+
+    RevisionCache<const HTMLDocumentFacts> m_Facts;
+};
+
+#endif // DOCUMENTFACTSCACHE_H
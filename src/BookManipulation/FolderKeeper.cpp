@@ -34,6 +34,9 @@
 #include <QDebug>
 
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/DocumentFactsCache.h"
+#include "BookManipulation/ParsedDocumentCache.h"
+#include "BookManipulation/ParsedStylesheetCache.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
 #include "ResourceObjects/AudioResource.h"
@@ -43,6 +46,7 @@
 #include "ResourceObjects/PdfResource.h"
 #include "Misc/Utility.h"
 #include "Misc/OpenExternally.h"
+#include "Misc/SearchMatchIndex.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/MediaTypes.h"
 
@@ -263,6 +267,8 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
 
     connect(resource, SIGNAL(Deleted(const Resource *)),
             this,     SLOT(RemoveResource(const Resource *)), Qt::DirectConnection);
+    connect(resource, SIGNAL(Deleted(const Resource *)),
+            this,     SLOT(ForgetResource(const Resource *)), Qt::DirectConnection);
     connect(resource, SIGNAL(Renamed(const Resource *, QString)),
             this,     SLOT(ResourceRenamed(const Resource *, QString)), Qt::DirectConnection);
     connect(resource, SIGNAL(Moved(const Resource *, QString)),
@@ -454,6 +460,8 @@ OPFResource*FolderKeeper::AddOPFToFolder(const QString &version, const QString &
     }
 
     connect(m_OPF, SIGNAL(Deleted(const Resource *)), this, SLOT(RemoveResource(const Resource *)));
+    connect(m_OPF, SIGNAL(Deleted(const Resource *)),
+            this,  SLOT(ForgetResource(const Resource *)), Qt::DirectConnection);
     // For ResourceAdded, the connection has to be DirectConnection,
     // otherwise the default of AutoConnection screws us when
     // AddContentFileToFolder is called from multiple threads.
@@ -509,6 +517,8 @@ NCXResource*FolderKeeper::AddNCXToFolder(const QString &version,
         m_FileIconCache["application/x-dtbncx+xml"] = QFileIconProvider().icon(fi);
     }
     connect(m_NCX, SIGNAL(Deleted(const Resource *)), this, SLOT(RemoveResource(const Resource *)));
+    connect(m_NCX, SIGNAL(Deleted(const Resource *)),
+            this,  SLOT(ForgetResource(const Resource *)), Qt::DirectConnection);
     connect(m_NCX, SIGNAL(Renamed(const Resource *, QString)),
             this,     SLOT(ResourceRenamed(const Resource *, QString)), Qt::DirectConnection);
     connect(m_NCX, SIGNAL(Moved(const Resource *, QString)),
@@ -591,6 +601,17 @@ void FolderKeeper::RemoveResource(const Resource *resource)
     emit ResourceRemoved(resource);
 }
 
+// Stays connected on every removal path, including the bulk ones and
+// the FolderKeeper destructor, so data cached about a resource never
+// outlives it.
+void FolderKeeper::ForgetResource(const Resource *resource)
+{
+    SearchMatchIndex::instance().Remove(resource->GetIdentifier());
+    ParsedDocumentCache::instance().Remove(resource->GetIdentifier());
+    DocumentFactsCache::instance().Remove(resource->GetIdentifier());
+    ParsedStylesheetCache::instance().Remove(resource->GetIdentifier());
+}
+
 void FolderKeeper::RemoveWithoutUpdatingOPF(Resource* resource)
 {
     m_Resources.remove(resource->GetIdentifier());
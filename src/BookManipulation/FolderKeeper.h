@@ -283,6 +283,11 @@ private slots:
 
     void ResourceMoved(const Resource *resource, const QString &old_full_path);
 
+    /**
+     * Drops everything cached about a resource that is being deleted.
+     */
+    void ForgetResource(const Resource *resource);
+
     /**
      * Called by the FSWatcher when a watched file has changed on disk.
      */
@@ -0,0 +1,79 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QReadLocker>
+
+#include "BookManipulation/ParsedDocumentCache.h"
+#include "Parsers/GumboInterface.h"
+#include "ResourceObjects/HTMLResource.h"
+
+// Several hundred typical chapters
+static const size_t MAX_CACHE_COST = 64 * 1024 * 1024;
+
+ParsedDocumentCache::ParsedDocumentCache()
+    :
+    m_Documents(MAX_CACHE_COST)
+{
+}
+
+
+std::shared_ptr<GumboInterface> ParsedDocumentCache::GetDocument(HTMLResource *html_resource, quint64 *revision_out)
+{
+    const QString identifier = html_resource->GetIdentifier();
+    // Only the revision is needed to find a hit, the text is copied on a miss
+    quint64 revision = html_resource->GetTextRevision();
+    std::shared_ptr<GumboInterface> document = m_Documents.Find(identifier, revision);
+    if (!document) {
+        QString text;
+        QByteArray utf8text;
+        {
+            QReadLocker locker(&html_resource->GetLock());
+            // The revision is bumped after the text changes so reading it
+            // first can at worst cache newer text under an older revision
+            revision = html_resource->GetTextRevision();
+            text = html_resource->GetText();
+            utf8text = html_resource->GetUtf8Text();
+        }
+
+        // Parsed without holding the lock so other resources can be parsed at
+        // the same time. The tree is built here, before the document is shared,
+        // since GumboInterface otherwise parses lazily on first use.
+        document = std::make_shared<GumboInterface>(text, utf8text, "any_version");
+        document->parse();
+        document = m_Documents.Insert(identifier, revision, document, document->memory_usage());
+    }
+    if (revision_out) {
+        *revision_out = revision;
+    }
+    return document;
+}
+
+
+void ParsedDocumentCache::Remove(const QString &resource_id)
+{
+    m_Documents.Remove(resource_id);
+}
+
+
+void ParsedDocumentCache::Clear()
+{
+    m_Documents.Clear();
+}
@@ -0,0 +1,85 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef PARSEDDOCUMENTCACHE_H
+#define PARSEDDOCUMENTCACHE_H
+
+#include <memory>
+
+#include <QtCore/QString>
+
+#include "BookManipulation/RevisionCache.h"
+
+class GumboInterface;
+class HTMLResource;
+
+/**
+ * Singleton. Book wide cache of parsed HTML documents.
+ *
+ * Entries are keyed by resource identifier and text revision so a
+ * resource is parsed once per edit however many read only analyses
+ * (ids, hrefs, media, reports ...) look at it. The least recently used
+ * documents are dropped once the cache holds more than its cost limit.
+ *
+ * The documents handed out are shared and must not be changed, use a
+ * GumboInterface of your own for anything that edits or serializes
+ * with updates. A document stays valid for as long as it is held even
+ * if it has since been evicted.
+ */
+class ParsedDocumentCache
+{
+
+public:
+    static ParsedDocumentCache &instance() {
+        static ParsedDocumentCache the_instance;
+        return the_instance;
+    }
+
+    ParsedDocumentCache(const ParsedDocumentCache&) = delete;
+    ParsedDocumentCache& operator=(const ParsedDocumentCache&) = delete;
+
+    /**
+     * Returns the parsed document for the current text of html_resource,
+     * parsing it first if needed. Safe to call from worker threads.
+     * If revision is given it is set to the text revision the document
+     * was parsed from.
+     */
+    std::shared_ptr<GumboInterface> GetDocument(HTMLResource *html_resource, quint64 *revision = nullptr);
+
+    /**
+     * Drops the cached document of the resource with identifier resource_id.
+     */
+    void Remove(const QString &resource_id);
+
+    /**
+     * Drops every cached document.
+     */
+    void Clear();
+
+private:
+    ParsedDocumentCache();
+    ~ParsedDocumentCache() = default;
+
+    RevisionCache<GumboInterface> m_Documents;
+};
+
+#endif // PARSEDDOCUMENTCACHE_H
@@ -0,0 +1,77 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QReadLocker>
+
+#include "BookManipulation/ParsedStylesheetCache.h"
+#include "Parsers/CSSInfo.h"
+#include "ResourceObjects/CSSResource.h"
+
+// Far more than the stylesheets of any real book
+static const size_t MAX_CACHE_COST = 16 * 1024 * 1024;
+
+
+ParsedStylesheetCache::ParsedStylesheetCache()
+    :
+    m_Stylesheets(MAX_CACHE_COST)
+{
+}
+
+
+std::shared_ptr<CSSInfo> ParsedStylesheetCache::GetStylesheet(CSSResource *css_resource)
+{
+    const QString identifier = css_resource->GetIdentifier();
+    quint64 revision = css_resource->GetTextRevision();
+    std::shared_ptr<CSSInfo> stylesheet = m_Stylesheets.Find(identifier, revision);
+    if (stylesheet) {
+        return stylesheet;
+    }
+
+    QString text;
+    QByteArray utf8text;
+    {
+        QReadLocker locker(&css_resource->GetLock());
+        // The revision is bumped after the text changes so reading it
+        // first can at worst cache newer text under an older revision
+        revision = css_resource->GetTextRevision();
+        text = css_resource->GetText();
+        utf8text = css_resource->GetUtf8Text();
+    }
+
+    // Parsed without holding the lock so other stylesheets can be parsed
+    // at the same time
+    stylesheet = std::make_shared<CSSInfo>(text, utf8text);
+    // CSSInfo keeps the text; its selectors and indexes take about as much again
+    size_t cost = 2 * text.length() * sizeof(QChar);
+    return m_Stylesheets.Insert(identifier, revision, stylesheet, cost);
+}
+
+
+void ParsedStylesheetCache::Remove(const QString &resource_id)
+{
+    m_Stylesheets.Remove(resource_id);
+}
+
+
+void ParsedStylesheetCache::Clear()
+{
+    m_Stylesheets.Clear();
+}
@@ -0,0 +1,82 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef PARSEDSTYLESHEETCACHE_H
+#define PARSEDSTYLESHEETCACHE_H
+
+#include <memory>
+
+#include <QtCore/QString>
+
+#include "BookManipulation/RevisionCache.h"
+
+class CSSInfo;
+class CSSResource;
+
+/**
+ * Singleton. Book wide cache of parsed stylesheets.
+ *
+ * Entries are keyed by resource identifier and text revision like the
+ * ParsedDocumentCache, so a stylesheet and its selector indexes are
+ * built once per edit however many reports and style lookups use it.
+ * The least recently used stylesheets are dropped once the cache holds
+ * more than its cost limit.
+ *
+ * The CSSInfo handed out is shared and must not be changed. A stylesheet
+ * stays valid for as long as it is held even if it has since been replaced.
+ */
+class ParsedStylesheetCache
+{
+
+public:
+    static ParsedStylesheetCache &instance() {
+        static ParsedStylesheetCache the_instance;
+        return the_instance;
+    }
+
+    ParsedStylesheetCache(const ParsedStylesheetCache&) = delete;
+    ParsedStylesheetCache& operator=(const ParsedStylesheetCache&) = delete;
+
+    /**
+     * Returns the parsed stylesheet for the current text of css_resource,
+     * parsing it first if needed. Safe to call from worker threads.
+     */
+    std::shared_ptr<CSSInfo> GetStylesheet(CSSResource *css_resource);
+
+    /**
+     * Drops the cached stylesheet of the resource with identifier resource_id.
+     */
+    void Remove(const QString &resource_id);
+
+    /**
+     * Drops every cached stylesheet.
+     */
+    void Clear();
+
+private:
+    ParsedStylesheetCache();
+    ~ParsedStylesheetCache() = default;
+
+    RevisionCache<CSSInfo> m_Stylesheets;
+};
+
+#endif // PARSEDSTYLESHEETCACHE_H
@@ -0,0 +1,163 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef REVISIONCACHE_H
+#define REVISIONCACHE_H
+
+#include <memory>
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+/**
+ * Thread safe cache of values built from the text of a resource,
+ * keyed by resource identifier and text revision.
+ *
+ * Each entry is given a cost when it is stored and the least recently
+ * used entries are dropped once the total cost is above max_cost.
+ * Values are shared, so one dropped or replaced stays valid for as long
+ * as somebody still holds it.
+ *
+ * Callers look up the current revision of the resource first and only
+ * copy its text and build a new value on a miss.
+ */
+template <class T>
+class RevisionCache
+{
+
+public:
+    explicit RevisionCache(size_t max_cost)
+        :
+        m_MaxCost(max_cost),
+        m_TotalCost(0),
+        m_UseCounter(0)
+    {
+    }
+
+    RevisionCache(const RevisionCache&) = delete;
+    RevisionCache& operator=(const RevisionCache&) = delete;
+
+    /**
+     * Returns the value cached for resource_id at revision,
+     * or a null pointer if there is none.
+     */
+    std::shared_ptr<T> Find(const QString &resource_id, quint64 revision)
+    {
+        QMutexLocker locker(&m_Mutex);
+        auto it = m_Entries.find(resource_id);
+        if (it == m_Entries.end() || it->revision != revision) {
+            return std::shared_ptr<T>();
+        }
+        it->last_used = ++m_UseCounter;
+        return it->value;
+    }
+
+    /**
+     * Stores value for resource_id at revision, replacing any older one,
+     * and returns the value callers should use. If another thread stored
+     * the same revision first that one is kept and returned instead.
+     */
+    std::shared_ptr<T> Insert(const QString &resource_id, quint64 revision, std::shared_ptr<T> value, size_t cost)
+    {
+        QMutexLocker locker(&m_Mutex);
+        auto it = m_Entries.find(resource_id);
+        if (it != m_Entries.end()) {
+            if (it->revision == revision) {
+                it->last_used = ++m_UseCounter;
+                return it->value;
+            }
+            m_TotalCost -= it->cost;
+            m_Entries.erase(it);
+        }
+        CacheEntry entry;
+        entry.revision = revision;
+        entry.value = value;
+        entry.cost = cost;
+        entry.last_used = ++m_UseCounter;
+        m_Entries.insert(resource_id, entry);
+        m_TotalCost += cost;
+        Evict();
+        return value;
+    }
+
+    /**
+     * Drops the entry of resource_id.
+     */
+    void Remove(const QString &resource_id)
+    {
+        QMutexLocker locker(&m_Mutex);
+        auto it = m_Entries.find(resource_id);
+        if (it != m_Entries.end()) {
+            m_TotalCost -= it->cost;
+            m_Entries.erase(it);
+        }
+    }
+
+    /**
+     * Drops every entry.
+     */
+    void Clear()
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Entries.clear();
+        m_TotalCost = 0;
+    }
+
+private:
+    struct CacheEntry {
+        quint64 revision;
+        std::shared_ptr<T> value;
+        size_t cost;
+        quint64 last_used;
+    };
+
+    // Drops the least recently used entries until the cost is in bounds.
+    // Linear scans are fine for the few hundred entries a book has.
+    void Evict()
+    {
+        while (m_TotalCost > m_MaxCost && m_Entries.count() > 1) {
+            auto oldest = m_Entries.begin();
+            for (auto it = m_Entries.begin(); it != m_Entries.end(); ++it) {
+                if (it->last_used < oldest->last_used) {
+                    oldest = it;
+                }
+            }
+            m_TotalCost -= oldest->cost;
+            m_Entries.erase(oldest);
+        }
+    }
+
+    QHash<QString, CacheEntry> m_Entries;
+
+    const size_t m_MaxCost;
+
+    size_t m_TotalCost;
+
+    // Source of last_used values.
+    quint64 m_UseCounter;
+
+    QMutex m_Mutex;
+};
+
+#endif // REVISIONCACHE_H
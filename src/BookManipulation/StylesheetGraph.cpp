@@ -0,0 +1,244 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <memory>
+
+#include <QtConcurrent/QtConcurrent>
+#include <QRegularExpression>
+
+#include "BookManipulation/DocumentFactsCache.h"
+#include "BookManipulation/ParsedStylesheetCache.h"
+#include "BookManipulation/StylesheetGraph.h"
+#include "Misc/Utility.h"
+#include "Parsers/CSSInfo.h"
+#include "ResourceObjects/CSSResource.h"
+#include "ResourceObjects/HTMLResource.h"
+
+static const QRegularExpression URL_FILE_SEARCH("url\\s*\\(\\s*['\"]?([^\\(\\)'\"]*)[\"']?\\)");
+
+
+void StylesheetGraph::Refresh(const QList<HTMLResource *> &html_resources, const QList<CSSResource *> &css_resources)
+{
+    QMutexLocker locker(&m_Mutex);
+
+    QStringList html_order;
+    QList<HTMLResource *> stale_html;
+    foreach(HTMLResource *html_resource, html_resources) {
+        QString identifier = html_resource->GetIdentifier();
+        html_order << identifier;
+        auto it = m_HTMLNodes.constFind(identifier);
+        if (it == m_HTMLNodes.constEnd() ||
+            it->revision != html_resource->GetTextRevision() ||
+            it->bookpath != html_resource->GetRelativePath()) {
+            stale_html << html_resource;
+        }
+    }
+    QStringList css_order;
+    QList<CSSResource *> stale_css;
+    foreach(CSSResource *css_resource, css_resources) {
+        QString identifier = css_resource->GetIdentifier();
+        css_order << identifier;
+        auto it = m_CSSNodes.constFind(identifier);
+        if (it == m_CSSNodes.constEnd() ||
+            it->revision != css_resource->GetTextRevision() ||
+            it->bookpath != css_resource->GetRelativePath()) {
+            stale_css << css_resource;
+        }
+    }
+
+    if (stale_html.isEmpty() && stale_css.isEmpty() &&
+        html_order == m_HTMLOrder && css_order == m_CSSOrder) {
+        return;
+    }
+
+    // only the changed resources are looked at again
+    QList<HTMLNode> html_nodes = QtConcurrent::blockingMapped(stale_html, BuildHTMLNode);
+    for (int i = 0; i < stale_html.count(); i++) {
+        m_HTMLNodes.insert(stale_html.at(i)->GetIdentifier(), html_nodes.at(i));
+    }
+    QList<CSSNode> css_nodes = QtConcurrent::blockingMapped(stale_css, BuildCSSNode);
+    for (int i = 0; i < stale_css.count(); i++) {
+        m_CSSNodes.insert(stale_css.at(i)->GetIdentifier(), css_nodes.at(i));
+    }
+
+    // forget resources that have been removed
+    if (m_HTMLNodes.count() != html_order.count()) {
+        QSet<QString> present(html_order.begin(), html_order.end());
+        for (auto it = m_HTMLNodes.begin(); it != m_HTMLNodes.end();) {
+            if (present.contains(it.key())) {
+                ++it;
+            } else {
+                it = m_HTMLNodes.erase(it);
+            }
+        }
+    }
+    if (m_CSSNodes.count() != css_order.count()) {
+        QSet<QString> present(css_order.begin(), css_order.end());
+        for (auto it = m_CSSNodes.begin(); it != m_CSSNodes.end();) {
+            if (present.contains(it.key())) {
+                ++it;
+            } else {
+                it = m_CSSNodes.erase(it);
+            }
+        }
+    }
+    m_HTMLOrder = html_order;
+    m_CSSOrder = css_order;
+    RebuildLookups();
+}
+
+
+QHash<QString, QStringList> StylesheetGraph::GetStylesheetsInHTMLFiles()
+{
+    QMutexLocker locker(&m_Mutex);
+    QHash<QString, QStringList> links_in_html;
+    foreach(const HTMLNode &node, m_HTMLNodes) {
+        links_in_html[node.bookpath] = node.stylesheets;
+    }
+    return links_in_html;
+}
+
+
+QHash<QString, QStringList> StylesheetGraph::GetCSSFilesUsingUrls()
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_CSSFilesUsingUrls;
+}
+
+
+QHash<QString, QStringList> StylesheetGraph::GetHTMLFilesUsingUrls()
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_HTMLFilesUsingUrls;
+}
+
+
+QHash<QString, QStringList> StylesheetGraph::GetEffectiveStylesheetsInHTMLFiles()
+{
+    QMutexLocker locker(&m_Mutex);
+    QHash<QString, QStringList> stylesheets_in_html;
+    foreach(const HTMLNode &node, m_HTMLNodes) {
+        QStringList stylesheets;
+        QSet<QString> visited;
+        foreach(QString css_bookpath, node.stylesheets) {
+            AddWithImports(css_bookpath, stylesheets, visited);
+        }
+        stylesheets_in_html[node.bookpath] = stylesheets;
+    }
+    return stylesheets_in_html;
+}
+
+
+StylesheetGraph::HTMLNode StylesheetGraph::BuildHTMLNode(HTMLResource *html_resource)
+{
+    HTMLNode node;
+    node.revision = html_resource->GetTextRevision();
+    node.bookpath = html_resource->GetRelativePath();
+    QString startdir = html_resource->GetFolder();
+    std::shared_ptr<const HTMLDocumentFacts> facts = DocumentFactsCache::instance().GetFacts(html_resource);
+    foreach(QString ahref, facts->linked_stylesheets) {
+        if (ahref.indexOf(":") == -1) {
+            std::pair<QString, QString> parts = Utility::parseRelativeHREF(ahref);
+            node.stylesheets << Utility::buildBookPath(parts.first, startdir);
+        }
+    }
+    foreach(QString url, facts->style_urls) {
+        QRegularExpressionMatch match = URL_FILE_SEARCH.match(url);
+        if (match.hasMatch()) {
+            QString ahref = match.captured(1);
+            if (ahref.indexOf(":") == -1) {
+                node.urls << Utility::buildBookPath(ahref, startdir);
+            }
+        }
+    }
+    return node;
+}
+
+
+StylesheetGraph::CSSNode StylesheetGraph::BuildCSSNode(CSSResource *css_resource)
+{
+    // @import takes either a url() or a plain string followed by optional media queries
+    static const QRegularExpression import_search("^\\s*(?:url\\s*\\(\\s*)?['\"]?([^\\(\\)'\"\\s]+)");
+
+    CSSNode node;
+    node.revision = css_resource->GetTextRevision();
+    node.bookpath = css_resource->GetRelativePath();
+    QString startdir = css_resource->GetFolder();
+    std::shared_ptr<CSSInfo> css_info = ParsedStylesheetCache::instance().GetStylesheet(css_resource);
+    foreach(QString import, css_info->getImports()) {
+        QRegularExpressionMatch match = import_search.match(import);
+        if (match.hasMatch()) {
+            QString ahref = match.captured(1);
+            if (ahref.indexOf(":") == -1) {
+                std::pair<QString, QString> parts = Utility::parseRelativeHREF(ahref);
+                node.imports << Utility::buildBookPath(parts.first, startdir);
+            }
+        }
+    }
+    foreach(QString url, css_info->getAllPropertyValues("")) {
+        QRegularExpressionMatch match = URL_FILE_SEARCH.match(url);
+        if (match.hasMatch()) {
+            QString ahref = match.captured(1);
+            if (ahref.indexOf(":") == -1) {
+                node.urls << Utility::buildBookPath(ahref, startdir);
+            }
+        }
+    }
+    return node;
+}
+
+
+void StylesheetGraph::RebuildLookups()
+{
+    m_HTMLFilesUsingUrls.clear();
+    foreach(QString identifier, m_HTMLOrder) {
+        const HTMLNode &node = m_HTMLNodes[identifier];
+        foreach(QString url_bookpath, node.urls) {
+            m_HTMLFilesUsingUrls[url_bookpath].append(node.bookpath);
+        }
+    }
+    m_CSSByBookPath.clear();
+    m_CSSFilesUsingUrls.clear();
+    foreach(QString identifier, m_CSSOrder) {
+        const CSSNode &node = m_CSSNodes[identifier];
+        m_CSSByBookPath.insert(node.bookpath, identifier);
+        foreach(QString url_bookpath, node.urls) {
+            m_CSSFilesUsingUrls[url_bookpath].append(node.bookpath);
+        }
+    }
+}
+
+
+void StylesheetGraph::AddWithImports(const QString &css_bookpath, QStringList &stylesheets, QSet<QString> &visited) const
+{
+    // visited also breaks @import cycles
+    if (visited.contains(css_bookpath)) {
+        return;
+    }
+    visited.insert(css_bookpath);
+    QString identifier = m_CSSByBookPath.value(css_bookpath);
+    if (!identifier.isEmpty()) {
+        foreach(QString import_bookpath, m_CSSNodes.value(identifier).imports) {
+            AddWithImports(import_bookpath, stylesheets, visited);
+        }
+    }
+    stylesheets << css_bookpath;
+}
@@ -0,0 +1,123 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef STYLESHEETGRAPH_H
+#define STYLESHEETGRAPH_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class CSSResource;
+class HTMLResource;
+
+/**
+ * Graph of a book: which stylesheets each html file links, which
+ * stylesheets each stylesheet @imports, and which files each stylesheet
+ * and each html file's style attributes refer to with url().
+ *
+ * Every node remembers the text revision and book path it was built
+ * from, so Refresh() only looks again at the resources that changed,
+ * moved, or were added since the last time. All edges are book paths.
+ */
+class StylesheetGraph
+{
+
+public:
+    StylesheetGraph() = default;
+    ~StylesheetGraph() = default;
+
+    StylesheetGraph(const StylesheetGraph&) = delete;
+    StylesheetGraph& operator=(const StylesheetGraph&) = delete;
+
+    /**
+     * Brings the graph up to date with the given resources, dropping the
+     * nodes of any resources that are no longer in the lists.
+     */
+    void Refresh(const QList<HTMLResource *> &html_resources, const QList<CSSResource *> &css_resources);
+
+    /**
+     * Book path of each html file to the book paths of the stylesheets it links.
+     */
+    QHash<QString, QStringList> GetStylesheetsInHTMLFiles();
+
+    /**
+     * Book path of each url() target to the book paths of the stylesheets
+     * that refer to it.
+     */
+    QHash<QString, QStringList> GetCSSFilesUsingUrls();
+
+    /**
+     * Book path of each url() target in a style attribute to the book paths
+     * of the html files that refer to it.
+     */
+    QHash<QString, QStringList> GetHTMLFilesUsingUrls();
+
+    /**
+     * Book path of each html file to the stylesheets that apply to it:
+     * its linked stylesheets with their @imports (recursively) ahead of
+     * the stylesheet that imports them, in cascade order.
+     */
+    QHash<QString, QStringList> GetEffectiveStylesheetsInHTMLFiles();
+
+private:
+    struct HTMLNode {
+        quint64 revision;
+        QString bookpath;
+        QStringList stylesheets;
+        QStringList urls;
+    };
+
+    struct CSSNode {
+        quint64 revision;
+        QString bookpath;
+        QStringList imports;
+        QStringList urls;
+    };
+
+    static HTMLNode BuildHTMLNode(HTMLResource *html_resource);
+    static CSSNode BuildCSSNode(CSSResource *css_resource);
+
+    // Recreates the lookups by book path after nodes changed.
+    void RebuildLookups();
+
+    void AddWithImports(const QString &css_bookpath, QStringList &stylesheets, QSet<QString> &visited) const;
+
+    // Keyed by resource identifier
+    QHash<QString, HTMLNode> m_HTMLNodes;
+    QHash<QString, CSSNode> m_CSSNodes;
+
+    // Identifiers in the order the resources were last given
+    QStringList m_HTMLOrder;
+    QStringList m_CSSOrder;
+
+    QHash<QString, QString> m_CSSByBookPath;
+    QHash<QString, QStringList> m_CSSFilesUsingUrls;
+    QHash<QString, QStringList> m_HTMLFilesUsingUrls;
+
+    QMutex m_Mutex;
+};
+
+#endif // STYLESHEETGRAPH_H
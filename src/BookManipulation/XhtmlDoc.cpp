@@ -184,6 +184,12 @@ QList<QString> XhtmlDoc::GetAllDescendantClasses(const QString & source)
 {
     QString version = "any_version";
     GumboInterface gi = GumboInterface(source, version);
+    return GetAllDescendantClasses(gi);
+}
+
+
+QList<QString> XhtmlDoc::GetAllDescendantClasses(GumboInterface & gi)
+{
     QList<GumboNode*> nodes = gi.get_all_nodes_with_attribute(QString("class"));
     QStringList classes;
     foreach(GumboNode * node, nodes) {
@@ -228,27 +234,49 @@ QList<QString> XhtmlDoc::GetAllDescendantStyleUrls(const QString & source)
 {
     QString version = "any_version";
     GumboInterface gi = GumboInterface(source, version);
+    return GetAllDescendantStyleUrls(gi);
+}
+
+
+QList<QString> XhtmlDoc::GetAllDescendantStyleUrls(GumboInterface & gi)
+{
     QList<GumboNode*> nodes = gi.get_all_nodes_with_attribute(QString("style"));
     QStringList styles;
     foreach(GumboNode * node, nodes) {
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "style");
-        if (attr) {
-            QString style_value = QString::fromUtf8(attr->value);
-            QRegularExpression url_search(URL_ATTRIBUTE_SEARCH);
-            QRegularExpressionMatch match = url_search.match(style_value);
-            if (match.hasMatch()) {
-                styles.append(match.captured(1));
-            }
+        QString url = GetStyleUrlOfNode(node);
+        if (!url.isEmpty()) {
+            styles.append(url);
         }
     }
     return styles;
 }
 
 
+QString XhtmlDoc::GetStyleUrlOfNode(GumboNode *node)
+{
+    GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "style");
+    if (attr) {
+        QString style_value = QString::fromUtf8(attr->value);
+        static const QRegularExpression url_search(URL_ATTRIBUTE_SEARCH);
+        QRegularExpressionMatch match = url_search.match(style_value);
+        if (match.hasMatch()) {
+            return match.captured(1);
+        }
+    }
+    return QString();
+}
+
+
 QList<QString> XhtmlDoc::GetAllDescendantIDs(const QString & source)
 {
     QString version = "any_version";
     GumboInterface gi = GumboInterface(source, version);
+    return GetAllDescendantIDs(gi);
+}
+
+
+QList<QString> XhtmlDoc::GetAllDescendantIDs(GumboInterface & gi)
+{
     QList<GumboNode*> nodes = gi.get_all_nodes_with_attribute(QString("id"));
     nodes.append(gi.get_all_nodes_with_attribute(QString("name")));
     QStringList IDs;
@@ -275,6 +303,12 @@ QList<QString> XhtmlDoc::GetAllDescendantHrefs(const QString & source)
 {
     QString version = "any_version";
     GumboInterface gi = GumboInterface(source, version);
+    return GetAllDescendantHrefs(gi);
+}
+
+
+QList<QString> XhtmlDoc::GetAllDescendantHrefs(GumboInterface & gi)
+{
     QList<GumboNode*> nodes = gi.get_all_nodes_with_attribute(QString("href"));
     QStringList hrefs;
     foreach(GumboNode * node, nodes) {
@@ -700,34 +734,50 @@ QStringList XhtmlDoc::GetAllMediaPathsFromMediaChildren(const QString & source,
 {
     QString version = "any_version";
     GumboInterface gi = GumboInterface(source, version);
+    return GetAllMediaPathsFromMediaChildren(gi, tags);
+}
+
+
+QStringList XhtmlDoc::GetAllMediaPathsFromMediaChildren(GumboInterface & gi, QList<GumboTag> tags)
+{
     QStringList media_paths;
     QList<GumboNode*> nodes = gi.get_all_nodes_with_tags(tags);
     for (int i = 0; i < nodes.count(); ++i) {
-        GumboNode* node = nodes.at(i);
-        // each element node will only hold one of the following attributes
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "src");
-        if (!attr) {
-            // search for xlink:href using gumbo attribute namespace
-            attr = gumbo_get_attribute(&node->v.element.attributes, "href");
-            if (attr && attr->attr_namespace != GUMBO_ATTR_NAMESPACE_XLINK) attr = NULL;
-        }
-        if (!attr) {
-            // search for altimg attribute from math tag
-            attr = gumbo_get_attribute(&node->v.element.attributes, "altimg");
-            if (attr && node->v.element.tag != GUMBO_TAG_MATH) attr = NULL;
-        }
-        if (attr) {
-            QString relative_path = QString::fromUtf8(attr->value);
-            if (relative_path.indexOf(":") == -1) {
-                std::pair<QString, QString> parts = Utility::parseRelativeHREF(relative_path);
-                media_paths << parts.first;
-            }
+        QString media_path;
+        if (GetMediaPathOfNode(nodes.at(i), media_path)) {
+            media_paths << media_path;
         }
     }
     return media_paths;
 }
 
 
+bool XhtmlDoc::GetMediaPathOfNode(GumboNode *node, QString &media_path)
+{
+    // each element node will only hold one of the following attributes
+    GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "src");
+    if (!attr) {
+        // search for xlink:href using gumbo attribute namespace
+        attr = gumbo_get_attribute(&node->v.element.attributes, "href");
+        if (attr && attr->attr_namespace != GUMBO_ATTR_NAMESPACE_XLINK) attr = NULL;
+    }
+    if (!attr) {
+        // search for altimg attribute from math tag
+        attr = gumbo_get_attribute(&node->v.element.attributes, "altimg");
+        if (attr && node->v.element.tag != GUMBO_TAG_MATH) attr = NULL;
+    }
+    if (attr) {
+        QString relative_path = QString::fromUtf8(attr->value);
+        if (relative_path.indexOf(":") == -1) {
+            std::pair<QString, QString> parts = Utility::parseRelativeHREF(relative_path);
+            media_path = parts.first;
+            return true;
+        }
+    }
+    return false;
+}
+
+
 // Accepts a reference to an XML stream reader positioned on an XML element.
 // Returns an XMLElement struct with the data in the stream.
 XhtmlDoc::XMLElement XhtmlDoc::CreateXMLElement(QXmlStreamReader &reader)
@@ -75,9 +75,13 @@ public:
     // static QList<xc::DOMNode *> GetNodeChildren(const xc::DOMNode &node);
 
     static QList<QString> GetAllDescendantStyleUrls(const QString & source);
+    static QList<QString> GetAllDescendantStyleUrls(GumboInterface & gi);
     static QList<QString> GetAllDescendantHrefs(const QString & source);
+    static QList<QString> GetAllDescendantHrefs(GumboInterface & gi);
     static QList<QString> GetAllDescendantIDs(const QString & );
+    static QList<QString> GetAllDescendantIDs(GumboInterface & gi);
     static QList<QString> GetAllDescendantClasses(const QString & source);
+    static QList<QString> GetAllDescendantClasses(GumboInterface & gi);
     static int GetFirstUseOfClass(const QString& source, const QString& class_name_to_find);
 
     struct WellFormedError {
@@ -150,6 +154,14 @@ public:
     static QStringList GetAllURLPathsFromStylesheet(const QString & source, const QString & csspath);
 
     static QStringList GetAllMediaPathsFromMediaChildren(const QString &source, QList<GumboTag> tags);
+    static QStringList GetAllMediaPathsFromMediaChildren(GumboInterface &gi, QList<GumboTag> tags);
+
+    // Sets media_path to the url decoded local media path an image, video,
+    // audio or math element refers to. Returns false if it has none.
+    static bool GetMediaPathOfNode(GumboNode *node, QString &media_path);
+
+    // Returns the url(...) part of the style attribute of node, if any
+    static QString GetStyleUrlOfNode(GumboNode *node);
 
     static QStringList GetUnmatchedTagsForPosition(int split_position, TagLister& m_TagList);
 
@@ -92,8 +92,14 @@ void CountsReport::SetupTable(int sort_column, Qt::SortOrder sort_order)
     ui.countsTree->header()->setSortIndicatorShown(true);
     int total_count = 0;
     int num_entries = 0;
+    QList<SearchEditorModel::searchEntry*> entries;
     foreach(SearchEditorModel::searchEntry* entry, m_entries) {
-        if (!entry) continue;
+        if (entry) entries << entry;
+    }
+    // All counts are requested at once so files are only visited once
+    QList<int> counts;
+    emit CountsRequest(entries, counts);
+    foreach(SearchEditorModel::searchEntry* entry, entries) {
         QString fullname = entry->fullname;
         QString find = entry->find;
         QString controls = entry->controls;
@@ -125,8 +131,7 @@ void CountsReport::SetupTable(int sort_column, Qt::SortOrder sort_order)
         item ->setText(target);
         rowItems << item;
         // Count
-        int count = -1;
-        emit CountRequest(entry, count);
+        int count = counts.value(num_entries - 1, -1);
         if (count > -1) total_count += count;
         NumericItem *count_item = new NumericItem();
         count_item->setText(QString::number(count));
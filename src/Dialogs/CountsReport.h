@@ -52,7 +52,7 @@ public slots:
 
 signals:
     // void CountRequest2(SearchEditorModel::searchEntry* entry, int& count);
-    void CountRequest(SearchEditorModel::searchEntry* entry, int& count);
+    void CountsRequest(QList<SearchEditorModel::searchEntry*> entries, QList<int>& counts);
 
 private slots:
     void Sort(int logicalindex, Qt::SortOrder order);
@@ -152,7 +152,7 @@ void DryRunReplace::CreateTable()
         PythonRoutines pr;
         fsp = pr.SetupInitialFunctionSearchEnvInPython(functionname);
     }
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     
     int count = 0;
     foreach(Resource* resource, resources ) {
@@ -172,6 +172,12 @@ void DryRunReplace::CreateTable()
 
             QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
 
+            // all function replacements for this file come from one call into python
+            QStringList function_replacements;
+            if (!functionname.isEmpty()) {
+                spcre->functionReplaceTexts(bookpath, text, match_info, fsp, function_replacements);
+            }
+
             // loop through matches to build up before and after snippets for table
             // and build table in backwards order in case ever hand applied
             for (int i = match_info.count()-1; i >= 0; i--) {
@@ -185,9 +191,10 @@ void DryRunReplace::CreateTable()
                     can_replace = spcre->replaceText(match_segment, match_info.at(i).capture_groups_offsets,
                                                       replace_text, new_text);
                 } else {
-                    can_replace = spcre->functionReplaceText(bookpath, match_segment,
-                                                             match_info.at(i).capture_groups_offsets,
-                                                             fsp, new_text);
+                    can_replace = i < function_replacements.count();
+                    if (can_replace) {
+                        new_text = function_replacements.at(i);
+                    }
                 }
 
                 // set pre and post context strings
@@ -142,7 +142,7 @@ void ReplacementChooser::CreateTable()
         PythonRoutines pr;
         fsp = pr.SetupInitialFunctionSearchEnvInPython(functionname);
     }
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     
     m_current_count = 0;
     foreach(Resource* resource, resources ) {
@@ -161,6 +161,12 @@ void ReplacementChooser::CreateTable()
         if (!text.isEmpty()) {
             QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
 
+            // all function replacements for this file come from one call into python
+            QStringList function_replacements;
+            if (!functionname.isEmpty()) {
+                spcre->functionReplaceTexts(bookpath, text, match_info, fsp, function_replacements);
+            }
+
             // loop through matches to build up before and after snippets for table
             // in forward order but apply them in reverse order
             for (int i = 0; i <  match_info.count(); i++) {
@@ -173,9 +179,10 @@ void ReplacementChooser::CreateTable()
                     can_replace = spcre->replaceText(match_segment, match_info.at(i).capture_groups_offsets, 
                                                       replace_text, new_text);
                 } else {
-                    can_replace = spcre->functionReplaceText(bookpath, match_segment,
-                                                             match_info.at(i).capture_groups_offsets,
-                                                             fsp, new_text);
+                    can_replace = i < function_replacements.count();
+                    if (can_replace) {
+                        new_text = function_replacements.at(i);
+                    }
                 }
                 // set pre and post context strings
                 QString prior_context  = GetPriorContext(match_info.at(i).offset.first, text, m_context_amt);
@@ -82,10 +82,11 @@ void CSSFilesWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
     ui.fileTree->header()->setSortIndicatorShown(true);
     // Get all a count of all the linked stylesheets
     QHash<QString, int> linked_stylesheets_hash;
+    // The stylesheets used by each file, including the ones
+    // only reached through @import, as book paths
+    QHash<QString, QStringList> effective_stylesheets_hash = m_Book->GetEffectiveStylesheetsInHTMLFiles();
     foreach(HTMLResource * html_resource, m_HTMLResources) {
-        // Get the linked stylesheets for this file
-        // linked_stylesheets now uses book paths to each stylesheets
-        QStringList linked_stylesheets = m_Book->GetStylesheetsInHTMLFile(html_resource);
+        QStringList linked_stylesheets = effective_stylesheets_hash.value(html_resource->GetRelativePath());
         foreach(QString stylesheet, linked_stylesheets) {
             if (linked_stylesheets.contains(stylesheet)) {
                 linked_stylesheets_hash[stylesheet]++;
@@ -1194,8 +1194,8 @@ void SearchEditor::MakeCountsReport()
 {
     // non-modal dialog
     CountsReport* crpt = new CountsReport(this);
-    connect(crpt, SIGNAL(CountRequest(SearchEditorModel::searchEntry*, int&)),
-            this, SIGNAL(CountsReportCountRequest(SearchEditorModel::searchEntry*, int&)));
+    connect(crpt, SIGNAL(CountsRequest(QList<SearchEditorModel::searchEntry*>, QList<int>&)),
+            this, SIGNAL(CountsReportCountsRequest(QList<SearchEditorModel::searchEntry*>, QList<int>&)));
     crpt->CreateReport(GetSelectedEntries());
     crpt->show();
     crpt->raise();
@@ -77,7 +77,7 @@ signals:
     void ReplaceAllSelectedSearchRequest();
     void RestartSearch();
     void ShowStatusMessageRequest(const QString &message);
-    void CountsReportCountRequest(SearchEditorModel::searchEntry* entry, int& count);
+    void CountsReportCountsRequest(QList<SearchEditorModel::searchEntry*> entries, QList<int>& counts);
 
 protected:
     bool eventFilter(QObject *obj, QEvent *ev);
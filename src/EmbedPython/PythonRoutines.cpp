@@ -508,6 +508,31 @@ QString PythonRoutines::GetSingleReplacementByFunction(PyObjectPtr FSO,
 }
 
 
+QStringList PythonRoutines::GetReplacementsByFunction(PyObjectPtr FSO,
+                                                      const QString& bookpath,
+                                                      const QString& text,
+                                                      const QList<int>& match_offsets)
+{
+    if (FSO.isNull()) {
+        fprintf(stderr, "get_replacements_by_function error - null Search Environment\n");
+        return QStringList();
+    }
+    int rv = 0;
+    QString traceback;
+    QList<QVariant> args;
+    args.append(QVariant(bookpath));
+    args.append(QVariant(text));
+    args.append(QVariant::fromValue(match_offsets));
+
+    QVariant res = EmbeddedPython::instance().callPyObjMethod(FSO, QString("get_replacements_by_function"), args, &rv, traceback);
+    if (rv) {
+        fprintf(stderr, "get_replacements_by_function error %d traceback %s\n",rv, traceback.toStdString().c_str());
+        return QStringList();
+    }
+    return res.toStringList();
+}
+
+
 bool PythonRoutines::CreateUserJsonFileInPython()
 {
     int rv = 0;
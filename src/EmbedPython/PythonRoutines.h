@@ -117,6 +117,13 @@ public:
                                            const QString& text,
                                            const QList<std::pair<int,int>>capture_groups);
 
+    // All replacements for one text in a single call, match_offsets is
+    // laid out as by SearchUtils::ConvertMatchInfostoUTF32Offsets
+    QStringList GetReplacementsByFunction(PyObjectPtr FSO,
+                                          const QString& bookpath,
+                                          const QString& text,
+                                          const QList<int>& match_offsets);
+
     bool CreateUserJsonFileInPython();
 
     QString GetNameOfCurrentCodepointInPython(int cp);
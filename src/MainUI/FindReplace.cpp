@@ -50,6 +50,7 @@
 #include "Misc/SearchUtils.h"
 #include "Misc/FindReplaceQLineEdit.h"
 #include "PCRE2/PCREErrors.h"
+#include "PCRE2/PCRECache.h"
 #include "ResourceObjects/Resource.h"
 #include "ResourceObjects/TextResource.h"
 #include "sigil_constants.h"
@@ -61,6 +62,8 @@ static const QString REGEX_OPTION_UCP = "(*UCP)";
 static const QString REGEX_OPTION_IGNORE_CASE = "(?i)";
 static const QString REGEX_OPTION_DOT_ALL = "(?s)";
 static const QString REGEX_OPTION_MINIMAL_MATCH = "(?U)";
+// SPCRE recognises this prefix and skips the matches starting in a tag
+// instead of handing the alternation to PCRE
 static const QString REGEX_OPTION_TEXT_ONLY = "<[^<>]*>(*SKIP)(*F)|";
 
 static const int SHOW_FIND_RESULTS_MESSAGE_DELAY_MS = 20000;
@@ -237,13 +240,18 @@ bool FindReplace::isSearchXML()
     if (isWhereSVG() || isWhereMiscXML()) return true;
     if (isWhereCSS() || isWhereJS()) return false;
     if (isWhereCF() || m_LookWhereCurrentFile) {
-        Resource * current_resource = GetCurrentResource();
-        QString mt = current_resource->GetMediaType();
-        if (mt.endsWith("+xml") || mt == "application/xml" || mt == "text/xml") return true;
+        return isCurrentResourceXML();
     }
     return false;
 }
 
+bool FindReplace::isCurrentResourceXML()
+{
+    Resource * current_resource = GetCurrentResource();
+    QString mt = current_resource->GetMediaType();
+    return mt.endsWith("+xml") || mt == "application/xml" || mt == "text/xml";
+}
+
 
 bool FindReplace::isWhereSVG()
 {
@@ -887,8 +895,18 @@ bool FindReplace::FindText(Searchable::Direction direction)
             return found;
         }
 
+        if (!m_SpellCheck) {
+            // Only make this the indexed pattern, the editor indexes
+            // the current file itself when searching up
+            SearchMatchIndex::instance().Prepare(GetSearchRegex(), QList<Resource *>(), QList<Resource *>());
+        }
         found = searchable->FindNext(GetSearchRegex(), direction, false, false, m_OptionWrap, IsMarkedText());
     } else {
+        if (!m_SpellCheck) {
+            // Index the other files while the user looks at this match
+            SearchMatchIndex::instance().Prepare(GetSearchRegex(), GetFilesToSearch(true),
+                                                 m_MainWindow->GetTabbedResources());
+        }
         found = FindInAllFiles(direction);
     }
 
@@ -980,41 +998,98 @@ QString FindReplace::GetSearchRegex()
         return QString();
     }
 
-    QString text = GetFind();
+    QString search = BuildSearchRegex(GetFind(), GetSearchMode(), m_RegexOptionTextOnly && isSearchXML(),
+                                      m_RegexOptionDotAll, m_RegexOptionMinimalMatch, m_RegexOptionUnicodeProperty);
+    // qDebug() << "GetSearchRegex returns: " << search;
+    return search;
+}
+
+QString FindReplace::BuildSearchRegex(const QString &find, FindReplace::SearchMode search_mode, bool text_only,
+                                      bool dot_all, bool minimal_match, bool unicode_property)
+{
+    QString text = find;
     // Convert &#x2029; to match line separator used by plainText.
     text.replace(QRegularExpression("\\R"), "\n");
 
     QString search(text);
 
     // Search type
-    if (GetSearchMode() == FindReplace::SearchMode_Normal || GetSearchMode() == FindReplace::SearchMode_Case_Sensitive) {
+    if (search_mode == FindReplace::SearchMode_Normal || search_mode == FindReplace::SearchMode_Case_Sensitive) {
         search = QRegularExpression::escape(search);
-        if (m_RegexOptionTextOnly && isSearchXML()) {
+        if (text_only) {
             // must be immediately before the user search
             search = PrependRegexOptionToSearch(REGEX_OPTION_TEXT_ONLY, search);
         }
-        if (GetSearchMode() == FindReplace::SearchMode_Normal) {
+        if (search_mode == FindReplace::SearchMode_Normal) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_IGNORE_CASE, search);
         }
     } else {
         // must be immediately before the user search
-        if (m_RegexOptionTextOnly && isSearchXML()) {
+        if (text_only) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_TEXT_ONLY, search);
         }
-        if (m_RegexOptionDotAll) {
+        if (dot_all) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_DOT_ALL, search);
         }
-        if (m_RegexOptionMinimalMatch) {
+        if (minimal_match) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_MINIMAL_MATCH, search);
         }
-        if (m_RegexOptionUnicodeProperty) {
+        if (unicode_property) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_UCP, search);
         }
     }
-    // qDebug() << "GetSearchRegex returns: " << search;
     return search;
 }
 
+// Reads the controls of a saved search the way UpdateSearchControls
+// does, falling back to the current settings where it would keep them.
+QString FindReplace::GetSearchRegex(const SearchEditorModel::searchEntry *search_entry)
+{
+    const QString &controls = search_entry->controls;
+    if (controls.isEmpty()) {
+        return BuildSearchRegex(Utility::UseNFC(search_entry->find), GetSearchMode(),
+                                m_RegexOptionTextOnly && isSearchXML(), m_RegexOptionDotAll,
+                                m_RegexOptionMinimalMatch, m_RegexOptionUnicodeProperty);
+    }
+
+    FindReplace::SearchMode search_mode = GetSearchMode();
+    if (controls.contains("NL")) {
+        search_mode = FindReplace::SearchMode_Normal;
+    } else if (controls.contains("RX")) {
+        search_mode = FindReplace::SearchMode_Regex;
+    } else if (controls.contains("CS")) {
+        search_mode = FindReplace::SearchMode_Case_Sensitive;
+    }
+
+    // The look where codes in the order UpdateSearchControls checks them
+    // and whether they search xml
+    static const QList<std::pair<QString, bool>> look_where_xml = {
+        { "AH", true }, { "SH", true }, { "TH", true }, { "AC", false }, { "SC", false },
+        { "TC", false }, { "OP", true }, { "NX", true }, { "SV", true }, { "SJ", false },
+        { "SX", true }
+    };
+    bool search_xml = false;
+    if (controls.contains("CF")) {
+        search_xml = isCurrentResourceXML();
+    } else {
+        bool found = false;
+        for (const auto &code : look_where_xml) {
+            if (controls.contains(code.first)) {
+                search_xml = code.second;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            search_xml = isSearchXML();
+        }
+    }
+
+    return BuildSearchRegex(Utility::UseNFC(search_entry->find), search_mode,
+                            controls.contains("TO") && search_xml, controls.contains("DA"),
+                            controls.contains("MM"), controls.contains("UN"));
+}
+
 QString FindReplace::PrependRegexOptionToSearch(const QString &option, const QString &search)
 {
     if (search.startsWith(REGEX_OPTION_UCP)) {
@@ -1227,18 +1302,8 @@ int FindReplace::ReplaceInAllFiles()
                     GetReplace(),
                     search_files);
     } else {
-        // clean up flags that do not exist in python re
-        QString pattern = GetSearchRegex();
-        if (pattern.contains("(*UCP)")) {
-            int i = pattern.indexOf("(*UCP)");
-            pattern.remove(i,6);
-        }
-        if (pattern.contains("(?U)")) {
-            int i = pattern.indexOf("(?U)");
-            pattern.remove(i,4);
-        }
         count = SearchOperations::FunctionReplaceInAllFiles(
-                    pattern,
+                    GetSearchRegex(),
                     functionname,
                     search_files);
     }
@@ -1863,6 +1928,7 @@ void FindReplace::FindSearch()
 
     SetKeyModifiers();
     m_IsSearchGroupRunning = true;
+    PrecompileSearches(search_entries);
     foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
         LoadSearch(search_entry);
         if (Find()) {
@@ -1906,6 +1972,7 @@ void FindReplace::ReplaceSearch()
 
     SetKeyModifiers();
     m_IsSearchGroupRunning = true;
+    PrecompileSearches(search_entries);
 
     foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
         LoadSearch(search_entry);
@@ -1929,14 +1996,12 @@ void FindReplace::CountAllSearch()
         return;
     }
 
-    SetKeyModifiers();
-    m_IsSearchGroupRunning = true;
+    QList<int> counts;
+    CountsReportCounts(search_entries, counts);
     int count = 0;
-    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
-        LoadSearch(search_entry);
-        count += Count();
+    foreach(int entry_count, counts) {
+        count += entry_count;
     }
-    m_IsSearchGroupRunning = false;
 
     if (count == 0) {
         CannotFindSearchTerm();
@@ -1944,22 +2009,41 @@ void FindReplace::CountAllSearch()
         QString message = tr("Matches found: %n", "", count);
         ShowMessage(message);
     }
-    ResetKeyModifiers();
 }
 
 
-void FindReplace::CountsReportCount(SearchEditorModel::searchEntry* entry, int& count)
+void FindReplace::CountsReportCounts(QList<SearchEditorModel::searchEntry*> entries, QList<int>& counts)
 {
-    if (entry) {
-        SetKeyModifiers();
-        m_IsSearchGroupRunning = true;
-        LoadSearch(entry);
-        count = Count();
-        m_IsSearchGroupRunning = false;
-    } else {
-        qDebug() << "why am I here";
-        count = -1;
+    counts.clear();
+    m_MainWindow->GetCurrentContentTab()->SaveTabContent();
+
+    SetKeyModifiers();
+    m_IsSearchGroupRunning = true;
+    // Searches over files are counted together in one pass over the files,
+    // the rest are counted as before. Counting changes nothing so the
+    // order the searches run in does not matter.
+    QList<SearchOperations::SearchGroupEntry> batch;
+    QList<int> batch_indexes;
+    foreach(SearchEditorModel::searchEntry * search_entry, entries) {
+        if (!search_entry) {
+            counts << -1;
+            continue;
+        }
+        LoadSearch(search_entry);
+        if (IsBatchableSearch(false)) {
+            batch_indexes << counts.count();
+            counts << 0;
+            AddToSearchBatch(batch);
+        } else {
+            counts << Count();
+        }
+    }
+    QList<int> batch_counts = CountSearchBatch(batch);
+    for (int i = 0; i < batch_counts.count(); i++) {
+        counts[batch_indexes.at(i)] = batch_counts.at(i);
     }
+    m_IsSearchGroupRunning = false;
+    ResetKeyModifiers();
 }
 
 
@@ -1973,14 +2057,37 @@ int FindReplace::ReplaceAllSearch()
         return -1;
     }
 
+    m_MainWindow->GetCurrentContentTab()->SaveTabContent();
+
     SetKeyModifiers();
     m_IsSearchGroupRunning = true;
+    PrecompileSearches(search_entries);
     int count = 0;
+    // Consecutive searches over files are replaced together in one pass over
+    // the files. A search that has to run on its own first flushes the
+    // searches before it so the replacements still happen in group order.
+    // If the user cancels a batch the group stops there and the entries
+    // from that batch on are left not completed.
+    QList<SearchOperations::SearchGroupEntry> batch;
+    QList<SearchEditorModel::searchEntry*> batch_entries;
+    bool cancelled = false;
     foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
         LoadSearch(search_entry);
+        if (IsBatchableSearch(true)) {
+            AddToSearchBatch(batch);
+            batch_entries << search_entry;
+            continue;
+        }
+        if (!ReplaceSearchBatch(batch, batch_entries, count)) {
+            cancelled = true;
+            break;
+        }
         count += ReplaceAll();
         m_MainWindow->SearchEditorRecordEntryAsCompleted(search_entry);
     }
+    if (!cancelled) {
+        ReplaceSearchBatch(batch, batch_entries, count);
+    }
     m_IsSearchGroupRunning = false;
 
     if (count == 0) {
@@ -1994,6 +2101,102 @@ int FindReplace::ReplaceAllSearch()
 }
 
 
+// Lets the patterns of a search group compile in the background while
+// the first searches of the group run
+void FindReplace::PrecompileSearches(const QList<SearchEditorModel::searchEntry*> &search_entries)
+{
+    if (search_entries.count() < 2) {
+        return;
+    }
+    QStringList patterns;
+    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
+        if (search_entry) {
+            patterns << GetSearchRegex(search_entry);
+        }
+    }
+    PCRECache::instance().precompile(patterns);
+}
+
+
+bool FindReplace::IsBatchableSearch(bool is_replace)
+{
+    if (isWhereCF() || m_LookWhereCurrentFile || IsMarkedText() || !IsValidFindText()) {
+        return false;
+    }
+    if (is_replace) {
+        // python function replacements run through their own path
+        QString replacer = GetReplace().trimmed();
+        if (replacer.startsWith("\\F<") && replacer.endsWith(">")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void FindReplace::AddToSearchBatch(QList<SearchOperations::SearchGroupEntry> &batch)
+{
+    if (IsNewSearch()) {
+        SetStartingResource(true);
+        SetPreviousSearch();
+    }
+    SearchOperations::SearchGroupEntry entry;
+    entry.search_regex = GetSearchRegex();
+    entry.replacement = GetReplace();
+    entry.resources = GetFilesToSearch(true);
+    batch << entry;
+    UpdatePreviousFindStrings();
+    UpdatePreviousReplaceStrings();
+}
+
+
+QList<int> FindReplace::CountSearchBatch(QList<SearchOperations::SearchGroupEntry> &batch)
+{
+    if (batch.isEmpty()) {
+        return QList<int>();
+    }
+    QList<int> counts = SearchOperations::CountGroupInFiles(batch);
+    // a cancelled batch counts nothing
+    if (counts.isEmpty()) {
+        counts = QList<int>(batch.count(), 0);
+    }
+    batch.clear();
+    return counts;
+}
+
+
+bool FindReplace::ReplaceSearchBatch(QList<SearchOperations::SearchGroupEntry> &batch,
+                                     QList<SearchEditorModel::searchEntry*> &batch_entries,
+                                     int &count)
+{
+    if (batch.isEmpty()) {
+        return true;
+    }
+    QList<int> counts = SearchOperations::ReplaceGroupInFiles(batch);
+    batch.clear();
+    // a cancelled batch replaced nothing and completed nothing
+    if (counts.isEmpty()) {
+        batch_entries.clear();
+        return false;
+    }
+    int batch_count = 0;
+    foreach(int entry_count, counts) {
+        batch_count += entry_count;
+    }
+    if (batch_count > 0) {
+        // Signal that the contents have changed and update the view
+        m_MainWindow->GetCurrentBook()->SetModified(true);
+        m_MainWindow->GetCurrentContentTab()->ContentChangedExternally();
+    }
+    foreach(SearchEditorModel::searchEntry * search_entry, batch_entries) {
+        m_MainWindow->SearchEditorRecordEntryAsCompleted(search_entry);
+    }
+    batch_entries.clear();
+    count += batch_count;
+    return true;
+}
+
+
 
 void FindReplace::SetSearchMode(int search_mode)
 {
@@ -31,8 +31,10 @@
 #include "ui_FindReplace.h"
 #include "BookManipulation/FolderKeeper.h"
 #include "MainUI/MainWindow.h"
+#include "Misc/SearchMatchIndex.h"
 #include "Misc/SearchOperations.h"
 #include "MiscEditors/SearchEditorModel.h"
+#include "ResourceObjects/TextResource.h"
 #include "ViewEditors/Searchable.h"
 
 class QMenu;
@@ -144,7 +146,7 @@ public slots:
 
     void ValidateRegex();
 
-    void CountsReportCount(SearchEditorModel::searchEntry* entry, int& count);
+    void CountsReportCounts(QList<SearchEditorModel::searchEntry*> entries, QList<int>& counts);
 
     void DoPythonFunction();
     
@@ -252,6 +254,16 @@ private:
     // options and fields and then returns it.
     QString PrependRegexOptionToSearch(const QString &option, const QString &search);
 
+    // Constructs the searching regex for find text and options
+    QString BuildSearchRegex(const QString &find, FindReplace::SearchMode search_mode, bool text_only,
+                             bool dot_all, bool minimal_match, bool unicode_property);
+
+    // The searching regex a saved search would have once loaded,
+    // without loading it
+    QString GetSearchRegex(const SearchEditorModel::searchEntry *search_entry);
+
+    bool isCurrentResourceXML();
+
     QList <Resource *> GetFilesToSearch(bool force_all = false);
 
     bool IsCurrentFileInSelection();
@@ -316,6 +328,23 @@ private:
     // Checks if Find is empty when not checking spelling
     bool IsValidFindText();
 
+    // Starts compiling the patterns of a group of saved searches
+    void PrecompileSearches(const QList<SearchEditorModel::searchEntry*> &search_entries);
+
+    // Checks if the loaded search can be run over files as part of a
+    // batch of saved searches rather than on its own
+    bool IsBatchableSearch(bool is_replace);
+
+    // Adds the loaded search to a batch of saved searches
+    void AddToSearchBatch(QList<SearchOperations::SearchGroupEntry> &batch);
+
+    // Runs and empties a batch of saved searches
+    QList<int> CountSearchBatch(QList<SearchOperations::SearchGroupEntry> &batch);
+    // Adds the replacements made to count, false if the user cancelled
+    bool ReplaceSearchBatch(QList<SearchOperations::SearchGroupEntry> &batch,
+                            QList<SearchEditorModel::searchEntry*> &batch_entries,
+                            int &count);
+
     // Reads all the stored dialog settings
     void ReadSettings();
 
@@ -403,6 +432,10 @@ bool FindReplace::ResourceContainsCurrentRegex(T *resource)
     // For now, this must hold
     // Q_ASSERT(GetLookWhere() == FindReplace::LookWhere_AllHTMLFiles || GetLookWhere() == FindReplace::LookWhere_SelectedHTMLFiles);
     Resource *generic_resource = resource;
+    TextResource *text_resource = qobject_cast<TextResource *>(generic_resource);
+    if (!m_SpellCheck && text_resource) {
+        return SearchMatchIndex::instance().GetMatchCount(GetSearchRegex(), text_resource) > 0;
+    }
     QList<Resource*> reslist;
     reslist << generic_resource;
     return SearchOperations::CountInFiles(
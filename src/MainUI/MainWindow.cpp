@@ -55,6 +55,7 @@
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/Index.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/ParsedStylesheetCache.h"
 #include "Dialogs/About.h"
 #include "Dialogs/AddClips.h"
 #include "Dialogs/AddRoles.h"
@@ -111,6 +112,7 @@
 #include "Misc/Utility.h"
 #include "MiscEditors/IndexHTMLWriter.h"
 #include "Parsers/HTMLStyleInfo.h"
+#include "PCRE2/PCRECache.h"
 #include "ResourceObjects/HTMLResource.h"
 #include "ResourceObjects/NCXResource.h"
 #include "ResourceObjects/OPFResource.h"
@@ -368,6 +370,9 @@ bool MainWindow::Automate(const QStringList &commands)
     QStringList plugin_names = plugins.keys();
     bool has_error = false;
     int countReplaced = -1;
+    // Log how the regex cache did over the saved searches of this list
+    bool ran_saved_search = false;
+    PCRECache::instance().resetStatistics();
     
     foreach(QString cmd , commands) {
         bool success = false;
@@ -460,6 +465,7 @@ bool MainWindow::Automate(const QStringList &commands)
                 connect(m_FindReplace, SIGNAL(ShowMessageRequest(const QString &)),
                         this, SLOT(ShowMessageOnStatusBar(const QString &)));
                 countReplaced = m_FindReplace->ReplaceAllSearch();
+                ran_saved_search = true;
                 disconnect(m_FindReplace, SIGNAL(ShowMessageRequest(const QString &)),
                            this, SLOT(ShowMessageOnStatusBar(const QString &)));
                 success = true;
@@ -479,6 +485,7 @@ bool MainWindow::Automate(const QStringList &commands)
                     connect(m_FindReplace, SIGNAL(ShowMessageRequest(const QString &)),
                             this, SLOT(ShowMessageOnStatusBar(const QString &)));
                     countReplaced = m_FindReplace->ReplaceAllSearch();
+                    ran_saved_search = true;
                     disconnect(m_FindReplace, SIGNAL(ShowMessageRequest(const QString &)),
                             this, SLOT(ShowMessageOnStatusBar(const QString &)));
                     success = true;
@@ -503,6 +510,7 @@ bool MainWindow::Automate(const QStringList &commands)
                     connect(m_FindReplace, SIGNAL(ShowMessageRequest(const QString &)),
                             this, SLOT(ShowMessageOnStatusBar(const QString &)));
                     countReplaced = m_FindReplace->ReplaceAllSearch();
+                    ran_saved_search = true;
                     disconnect(m_FindReplace, SIGNAL(ShowMessageRequest(const QString &)),
                             this, SLOT(ShowMessageOnStatusBar(const QString &)));
                     success = true;
@@ -553,6 +561,14 @@ bool MainWindow::Automate(const QStringList &commands)
         qApp->processEvents();
         m_AutomateLog << "";
     }
+    if (ran_saved_search) {
+        PCRECache::Statistics statistics = PCRECache::instance().getStatistics();
+        ShowMessageOnStatusBar(tr("Regex cache: %1 hits, %2 misses, %3 precompiled, %4 ms compiling, %5 of %6 KB used")
+                               .arg(statistics.hits).arg(statistics.misses).arg(statistics.precompiled)
+                               .arg(statistics.compile_nsecs / 1000000)
+                               .arg(statistics.total_cost / 1024).arg(statistics.max_cost / 1024));
+        m_AutomateLog << "";
+    }
     if (has_error) {
         ShowMessageOnStatusBar(tr("Automation List Failed"));
     } else {
@@ -1602,6 +1618,12 @@ QList <Resource *> MainWindow::GetValidSelectedMiscXMLResources()
 }
 
 
+QList <Resource*> MainWindow::GetTabbedResources()
+{
+    return m_TabManager->GetTabResources();
+}
+
+
 QList <Resource*> MainWindow::GetTabbedHTMLResources()
 {
     return m_TabManager->GetTabResourcesOfType(Resource::HTMLResourceType);
@@ -2375,8 +2397,8 @@ void MainWindow::GoToLinkedStyleDefinition(const QString &element_name, const QS
                 first_css_resource = css_resource;
             }
             if (css_resource) {
-                CSSInfo css_info(css_resource->GetText());
-                CSSInfo::CSSSelector *selector = css_info.getCSSSelectorForElementClass(element_name, style_class_name);
+                std::shared_ptr<CSSInfo> css_info = ParsedStylesheetCache::instance().GetStylesheet(css_resource);
+                CSSInfo::CSSSelector *selector = css_info->getCSSSelectorForElementClass(element_name, style_class_name);
 
                 // All of this is actually handled in CSSInfo and is NOT needed here
 
@@ -2405,8 +2427,8 @@ void MainWindow::GoToLinkedStyleDefinition(const QString &element_name, const QS
                 Resource * resource = m_Book->GetFolderKeeper()->GetResourceByBookPath(bookpath);
                 CSSResource *css_resource = qobject_cast<CSSResource*>( resource );
                 if (css_resource) {
-                    CSSInfo css_info(css_resource->GetText());
-                    QList<CSSInfo::CSSSelector*> combinators = css_info.getAllSelectorsWithCombinators();
+                    std::shared_ptr<CSSInfo> css_info = ParsedStylesheetCache::instance().GetStylesheet(css_resource);
+                    QList<CSSInfo::CSSSelector*> combinators = css_info->getAllSelectorsWithCombinators();
                     foreach(CSSInfo::CSSSelector* selector, combinators) {
                         QString asel = selector->text;
                         if (asel.startsWith(sel1) || asel.startsWith(sel2)) {
@@ -6952,8 +6974,8 @@ void MainWindow::ConnectSignalsToSlots()
     connect(m_SearchEditor, SIGNAL(LoadSelectedSearchRequest(SearchEditorModel::searchEntry *)),
             m_FindReplace,   SLOT(LoadSearch(SearchEditorModel::searchEntry *)));
     connect(m_SearchEditor, SIGNAL(RestartSearch()), m_FindReplace, SLOT(DoRestart()));
-    connect(m_SearchEditor, SIGNAL(CountsReportCountRequest(SearchEditorModel::searchEntry*, int&)),
-            m_FindReplace, SLOT(CountsReportCount(SearchEditorModel::searchEntry*, int&)));
+    connect(m_SearchEditor, SIGNAL(CountsReportCountsRequest(QList<SearchEditorModel::searchEntry*>, QList<int>&)),
+            m_FindReplace, SLOT(CountsReportCounts(QList<SearchEditorModel::searchEntry*>, QList<int>&)));
 
     connect(m_ClipboardHistorySelector, SIGNAL(PasteRequest(const QString &)), this, SLOT(PasteTextIntoCurrentTarget(const QString &)));
     connect(m_SelectCharacter, SIGNAL(SelectedCharacter(const QString &)), this, SLOT(PasteTextIntoCurrentTarget(const QString &)));
@@ -156,6 +156,7 @@ public:
     QList <Resource *> GetValidSelectedJSResources();
     QList <Resource *> GetValidSelectedMiscXMLResources();
 
+    QList <Resource *> GetTabbedResources();
     QList <Resource *> GetTabbedHTMLResources();
     QList <Resource *> GetTabbedCSSResources();
 
@@ -51,13 +51,15 @@ void HTMLSpellCheckML::parse_text_into_words(QList<HTMLSpellCheckML::AWord> &wor
                                              const QString &wc,
                                              bool  use_nums,
                                              const QString &lang,
-                                             const QString &parsetext,
+                                             const QStringView parsetext,
                                              int   pos)
 {
     bool in_entity = false;
     bool in_invalid_word = false;
     int word_start = 0;
-    QString text = QChar(' ') + parsetext + QChar(' ');
+    QString text;
+    text.reserve(parsetext.size() + 2);
+    text.append(QChar(' ')).append(parsetext).append(QChar(' '));
     for (int i = 0; i < text.length(); i++) {
         QChar c = text.at(i);
         QChar prev_c = i > 0 ? text.at(i - 1) : QChar(' ');
@@ -25,6 +25,7 @@
 #define HTMLSPELLCHECKML_H
 
 #include <QStringList>
+#include <QStringView>
 
 class HTMLSpellCheckML
 {
@@ -52,7 +53,7 @@ private:
                                       const QString &wc,
                                       bool  use_nums,
                                       const QString &lang,
-                                      const QString &parsetext,
+                                      const QStringView parsetext,
                                       int   pos);
 };
 
@@ -109,7 +109,7 @@ void PrettyPrintProps::ParsePrettyPrintXml()
         QuickParser::MarkupInfo mi = qp.parse_next();
         if (mi.pos < 0) break;
         if (!mi.text.isEmpty() && get_text) {
-            data = data + mi.text;
+            data.append(mi.text);
 	    }
         if (mi.text.isEmpty()) {
 	        if (mi.ttype == "begin") {
@@ -0,0 +1,224 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <memory>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "Misc/SearchMatchIndex.h"
+#include "PCRE2/PCRECache.h"
+#include "ResourceObjects/TextResource.h"
+
+SearchMatchIndex::SearchMatchIndex()
+    :
+    m_Generation(0)
+{
+}
+
+
+void SearchMatchIndex::Prepare(const QString &search_regex, const QList<Resource *> &resources,
+                               const QList<Resource *> &open_resources)
+{
+    if (search_regex.isEmpty()) {
+        return;
+    }
+
+    int generation;
+    {
+        QMutexLocker locker(&m_Mutex);
+        if (search_regex != m_Pattern) {
+            m_Pattern = search_regex;
+            m_Entries.clear();
+            m_Pending.clear();
+            m_Generation++;
+        }
+        generation = m_Generation;
+    }
+
+    QList<IndexJob> jobs;
+    foreach(Resource *resource, resources) {
+        TextResource *text_resource = qobject_cast<TextResource *>(resource);
+        if (!text_resource) {
+            continue;
+        }
+        IndexJob job;
+        job.resource_id = text_resource->GetIdentifier();
+        job.revision = text_resource->GetTextRevision();
+        job.resource = text_resource;
+        {
+            QMutexLocker locker(&m_Mutex);
+            if (m_Entries.contains(job.resource_id) && m_Entries.value(job.resource_id).revision == job.revision) {
+                continue;
+            }
+            if (m_Pending.contains(job.resource_id) && m_Pending.value(job.resource_id) == job.revision) {
+                continue;
+            }
+            m_Pending.insert(job.resource_id, job.revision);
+        }
+        if (open_resources.contains(resource)) {
+            QReadLocker locker(&text_resource->GetLock());
+            job.text = text_resource->GetText();
+            job.resource = NULL;
+        }
+        jobs << job;
+    }
+
+    if (!jobs.isEmpty()) {
+        QMutexLocker locker(&m_Mutex);
+        for (int i = m_Jobs.count() - 1; i >= 0; i--) {
+            if (m_Jobs.at(i).isFinished()) {
+                m_Jobs.removeAt(i);
+            }
+        }
+        m_Jobs << QtConcurrent::run(&SearchMatchIndex::IndexTexts, this, search_regex, generation, jobs);
+    }
+}
+
+
+bool SearchMatchIndex::Lookup(const QString &search_regex, const QString &resource_id,
+                              quint64 revision, Matches &matches)
+{
+    QMutexLocker locker(&m_Mutex);
+    if (search_regex != m_Pattern) {
+        return false;
+    }
+    QHash<QString, IndexEntry>::const_iterator it = m_Entries.constFind(resource_id);
+    if (it == m_Entries.constEnd() || it->revision != revision) {
+        return false;
+    }
+    matches = it->matches;
+    return true;
+}
+
+
+void SearchMatchIndex::Store(const QString &search_regex, const QString &resource_id,
+                             quint64 revision, const Matches &matches)
+{
+    QMutexLocker locker(&m_Mutex);
+    if (search_regex != m_Pattern) {
+        return;
+    }
+    // Never replace a newer entry with an older one
+    QHash<QString, IndexEntry>::iterator it = m_Entries.find(resource_id);
+    if (it != m_Entries.end() && it->revision > revision) {
+        return;
+    }
+    IndexEntry entry;
+    entry.revision = revision;
+    entry.matches = matches;
+    m_Entries.insert(resource_id, entry);
+    if (m_Pending.value(resource_id, 0) <= revision) {
+        m_Pending.remove(resource_id);
+    }
+}
+
+
+int SearchMatchIndex::GetMatchCount(const QString &search_regex, TextResource *resource)
+{
+    QString resource_id = resource->GetIdentifier();
+    QReadLocker locker(&resource->GetLock());
+    quint64 revision = resource->GetTextRevision();
+    Matches matches;
+    if (!Lookup(search_regex, resource_id, revision, matches)) {
+        std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
+        matches = spcre->getEveryMatchInfo(resource->GetText());
+        Store(search_regex, resource_id, revision, matches);
+    }
+    return matches.count();
+}
+
+
+void SearchMatchIndex::Remove(const QString &resource_id)
+{
+    StopJobs();
+    QMutexLocker locker(&m_Mutex);
+    m_Entries.remove(resource_id);
+}
+
+
+void SearchMatchIndex::Clear()
+{
+    StopJobs();
+    QMutexLocker locker(&m_Mutex);
+    m_Pattern.clear();
+    m_Entries.clear();
+}
+
+
+void SearchMatchIndex::StopJobs()
+{
+    QList<QFuture<void>> jobs;
+    {
+        QMutexLocker locker(&m_Mutex);
+        if (m_Jobs.isEmpty()) {
+            return;
+        }
+        // The jobs check the generation before every resource they read,
+        // and whatever they did not get to must be indexed again later
+        m_Generation++;
+        m_Pending.clear();
+        jobs = m_Jobs;
+        m_Jobs.clear();
+    }
+    foreach(QFuture<void> job, jobs) {
+        job.waitForFinished();
+    }
+}
+
+
+void SearchMatchIndex::IndexTexts(const QString &search_regex, int generation, const QList<IndexJob> &jobs)
+{
+    // Pinned so the PCRECache can not free it while we run
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
+    if (!spcre->isValid()) {
+        QMutexLocker locker(&m_Mutex);
+        if (generation == m_Generation) {
+            m_Pending.clear();
+        }
+        return;
+    }
+
+    foreach(const IndexJob &job, jobs) {
+        {
+            QMutexLocker locker(&m_Mutex);
+            if (generation != m_Generation) {
+                return;
+            }
+        }
+        QString text = job.text;
+        quint64 revision = job.revision;
+        if (job.resource) {
+            // Never wait for the lock, whoever holds it for writing may be
+            // waiting for us to finish.
+            if (!job.resource->GetLock().tryLockForRead()) {
+                QMutexLocker locker(&m_Mutex);
+                if (generation == m_Generation && m_Pending.value(job.resource_id) == job.revision) {
+                    m_Pending.remove(job.resource_id);
+                }
+                continue;
+            }
+            revision = job.resource->GetTextRevision();
+            text = job.resource->GetText();
+            job.resource->GetLock().unlock();
+        }
+        Store(search_regex, job.resource_id, revision, spcre->getEveryMatchInfo(text));
+    }
+}
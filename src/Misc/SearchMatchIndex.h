@@ -0,0 +1,157 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef SEARCHMATCHINDEX_H
+#define SEARCHMATCHINDEX_H
+
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "PCRE2/SPCRE.h"
+
+class Resource;
+class TextResource;
+
+/**
+ * Singleton. Book wide index of the matches of the current search
+ * pattern.
+ *
+ * Entries are keyed by resource identifier and text revision, so only
+ * resources whose text changed since they were indexed are searched
+ * again. Finding the next resource that contains a match and counting
+ * matches then only need to look up the stored matches. Find Next and
+ * Find Previous inside a file still search the text from the cursor,
+ * which can find a match that is not in the list.
+ *
+ * Only one pattern is indexed at a time, the last one passed to Prepare().
+ * Entries of deleted resources are dropped with Remove().
+ */
+class SearchMatchIndex
+{
+
+public:
+    typedef QList<SPCRE::MatchInfo> Matches;
+
+    static SearchMatchIndex &instance() {
+        static SearchMatchIndex the_instance;
+        return the_instance;
+    }
+
+    SearchMatchIndex(const SearchMatchIndex&) = delete;
+    SearchMatchIndex& operator=(const SearchMatchIndex&) = delete;
+
+    /**
+     * Makes search_regex the indexed pattern and indexes every resource
+     * in the background that is not already indexed at its current
+     * revision. Must be called from the GUI thread.
+     *
+     * Only the text of the resources open in a tab is read here, since
+     * the user can edit those while the background job runs. The others
+     * are read by the background job itself.
+     *
+     * @param search_regex The regex to index.
+     * @param resources The resources that will be searched.
+     * @param open_resources The resources open in a tab.
+     */
+    void Prepare(const QString &search_regex, const QList<Resource *> &resources,
+                 const QList<Resource *> &open_resources);
+
+    /**
+     * Looks up the matches of search_regex in a resource.
+     *
+     * @return true if the resource is indexed for this pattern at revision.
+     */
+    bool Lookup(const QString &search_regex, const QString &resource_id,
+                quint64 revision, Matches &matches);
+
+    /**
+     * Stores the matches of search_regex in a resource if search_regex
+     * is the indexed pattern.
+     */
+    void Store(const QString &search_regex, const QString &resource_id,
+               quint64 revision, const Matches &matches);
+
+    /**
+     * Returns the number of matches of search_regex in the resource,
+     * searching and indexing it first if needed.
+     */
+    int GetMatchCount(const QString &search_regex, TextResource *resource);
+
+    /**
+     * Drops the entry of a resource. Called when the resource is deleted.
+     */
+    void Remove(const QString &resource_id);
+
+    /**
+     * Drops the index.
+     */
+    void Clear();
+
+private:
+    SearchMatchIndex();
+    ~SearchMatchIndex() = default;
+
+    struct IndexEntry {
+        quint64 revision;
+        Matches matches;
+    };
+
+    struct IndexJob {
+        QString resource_id;
+        quint64 revision;
+        // Set for resources open in a tab, otherwise read by the worker
+        QString text;
+        TextResource *resource;
+    };
+
+    /**
+     * Searches the resources in a worker thread. Results are only
+     * stored if the index was not cleared or switched to another
+     * pattern in the meantime.
+     */
+    void IndexTexts(const QString &search_regex, int generation, const QList<IndexJob> &jobs);
+
+    /**
+     * Stops the background jobs and waits for them to finish, so none of
+     * them touches a resource that is about to be deleted.
+     */
+    void StopJobs();
+
+    QString m_Pattern;
+
+    // Bumped whenever the indexed pattern changes or the index is cleared.
+    int m_Generation;
+
+    QHash<QString, IndexEntry> m_Entries;
+
+    // Resource revisions handed to a background job but not yet stored.
+    QHash<QString, quint64> m_Pending;
+
+    QList<QFuture<void>> m_Jobs;
+
+    QMutex m_Mutex;
+};
+
+#endif // SEARCHMATCHINDEX_H
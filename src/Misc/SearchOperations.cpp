@@ -24,14 +24,17 @@
 #include <signal.h>
 
 #include <QtCore/QtCore>
+#include <QtConcurrent/QtConcurrent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QProgressDialog>
 
 #include "BookManipulation/CleanSource.h"
+#include "Misc/SearchMatchIndex.h"
 #include "Misc/SearchOperations.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 #include "PCRE2/PCRECache.h"
+#include "PCRE2/PCREReplaceAllBuilder.h"
 #include "Misc/HTMLSpellCheck.h"
 #include "ResourceObjects/HTMLResource.h"
 #include "ResourceObjects/TextResource.h"
@@ -43,16 +46,33 @@ int SearchOperations::CountInFiles(const QString &search_regex,
                                    QList<Resource *> resources,
                                    bool check_spelling)
 {
-    QProgressDialog progress(QObject::tr("Counting occurrences.."), 0, 0, resources.count(), Utility::GetMainWindow());
+    // Make sure the compiled regex is in the cache before the workers need it
+    std::shared_ptr<SPCRE> spcre;
+    if (!check_spelling) {
+        spcre = PCRECache::instance().getObject(search_regex);
+    }
+
+    // A single resource (Find Next across files) is not worth a thread pool
+    if (resources.count() == 1) {
+        return CountInFile(search_regex, resources.first(), check_spelling);
+    }
+
+    // The workers hold on to the resources, the book must not be edited
+    // or closed until they are done
+    QProgressDialog progress(QObject::tr("Counting occurrences.."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+    progress.setWindowModality(Qt::ApplicationModal);
     progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    // Count sequentially in order to see if occassional crashes are due to threading
+    progress.setValue(0);
+
+    QFuture<int> future = QtConcurrent::mapped(resources, std::bind(CountInFile, search_regex, std::placeholders::_1, check_spelling));
+    if (!WaitForFuture(future, progress)) {
+        return 0;
+    }
+
+    // Merge the per file counts in resource order
     int count = 0;
-    foreach(Resource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        count += CountInFile(search_regex, resource, check_spelling);
+    for (int i = 0; i < future.resultCount(); i++) {
+        Accumulate(count, future.resultAt(i));
     }
     return count;
 }
@@ -62,21 +82,90 @@ int SearchOperations::ReplaceInAllFIles(const QString &search_regex,
                                         const QString &replacement,
                                         QList<Resource *> resources)
 {
-    QProgressDialog progress(QObject::tr("Replacing search term..."), 0, 0, resources.count(), Utility::GetMainWindow());
+    // The workers share this compiled pattern, holding on to it here keeps
+    // it alive even if the cache evicts it while they run
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
+
+    QProgressDialog progress(QObject::tr("Replacing search term..."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+    progress.setWindowModality(Qt::ApplicationModal);
     progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    // Replace sequentially in order to see if occassional crashes are due to threading
+    progress.setValue(0);
+
+    // The new text for every file is built in parallel but only stored back
+    // into the resources here on the GUI thread once all files are done. That
+    // way a cancel leaves the book untouched and SetText never has to defer
+    // the update of an open tab's QTextDocument.
+    QFuture<std::tuple<QString, int, quint64>> future = QtConcurrent::mapped(resources, std::bind(ReplaceInFile, spcre, replacement, std::placeholders::_1));
+    if (!WaitForFuture(future, progress)) {
+        return 0;
+    }
+
+    QList<quint64> revisions;
+    for (int i = 0; i < future.resultCount(); i++) {
+        revisions << std::get<2>(future.resultAt(i));
+    }
+    if (!IsUnchangedSince(resources, revisions)) {
+        return 0;
+    }
+
     int count = 0;
-    foreach(Resource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        count += ReplaceInFile(search_regex, replacement, resource);
+    for (int i = 0; i < future.resultCount(); i++) {
+        QString new_text;
+        int file_count;
+        std::tie(new_text, file_count, std::ignore) = future.resultAt(i);
+        if (file_count > 0) {
+            TextResource *text_resource = qobject_cast<TextResource *>(resources.at(i));
+            if (text_resource) {
+                QWriteLocker locker(&text_resource->GetLock());
+                text_resource->SetText(new_text);
+                Accumulate(count, file_count);
+            }
+        }
     }
     return count;
 }
 
 
+bool SearchOperations::IsUnchangedSince(const QList<Resource *> &resources, const QList<quint64> &revisions)
+{
+    for (int i = 0; i < resources.count(); i++) {
+        TextResource *text_resource = qobject_cast<TextResource *>(resources.at(i));
+        if (text_resource && (text_resource->GetTextRevision() != revisions.at(i))) {
+            Utility::DisplayStdWarningDialog(QObject::tr("Nothing was replaced because %1 was changed while the replacements were being made.")
+                                             .arg(text_resource->ShortPathName()));
+            return false;
+        }
+    }
+    return true;
+}
+
+
+template <typename T>
+bool SearchOperations::WaitForFuture(QFuture<T> &future, QProgressDialog &progress)
+{
+    QFutureWatcher<T> watcher;
+    QEventLoop loop;
+    QObject::connect(&watcher, &QFutureWatcherBase::progressValueChanged, &progress, &QProgressDialog::setValue);
+    QObject::connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+    QObject::connect(&progress, &QProgressDialog::canceled, &watcher, &QFutureWatcherBase::cancel);
+    watcher.setFuture(future);
+    // Until the dialog shows up after its minimum duration nothing would
+    // block the user from editing or closing the book under the workers,
+    // so user input waits until then. After that the modal dialog blocks
+    // everything but its Cancel button.
+    if (!watcher.isFinished()) {
+        QTimer::singleShot(progress.minimumDuration(), &loop, &QEventLoop::quit);
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+    if (!watcher.isFinished()) {
+        progress.show();
+        loop.exec();
+    }
+    future.waitForFinished();
+    return !future.isCanceled();
+}
+
+
 int SearchOperations::CountInFile(const QString &search_regex,
                                   Resource *resource,
                                   bool check_spelling)
@@ -104,75 +193,46 @@ int SearchOperations::CountInHTMLFile(const QString &search_regex,
                                       HTMLResource *html_resource,
                                       bool check_spelling)
 {
+    if (!check_spelling) {
+        return CountInTextFile(search_regex, html_resource);
+    }
     QReadLocker locker(&html_resource->GetLock());
     // note you can not use a reference here because the text returned from
     // any text resource can come from an internal cache that can go away
     const QString text = html_resource->GetText();
-    if (check_spelling) {
-        return HTMLSpellCheck::CountMisspelledWords(text, 0, text.length(), search_regex);
-    } else {
-        return PCRECache::instance().getObject(search_regex)->getEveryMatchInfo(text).count();
-    }
+    return HTMLSpellCheck::CountMisspelledWords(text, 0, text.length(), search_regex);
 }
 
 int SearchOperations::CountInTextFile(const QString &search_regex, TextResource *text_resource)
 {
-    QReadLocker locker(&text_resource->GetLock());
-    // note you can not use a reference here because the text returned from
-    // any text resource can come from an internal cache that can go away
-    const QString text = text_resource->GetText();
-    return PCRECache::instance().getObject(search_regex)->getEveryMatchInfo(text).count();
+    // Uses the offsets already found by Find Next when the text is unchanged
+    return SearchMatchIndex::instance().GetMatchCount(search_regex, text_resource);
 }
 
 
-int SearchOperations::ReplaceInFile(const QString &search_regex,
-                                    const QString &replacement,
-                                    Resource *resource)
+std::tuple<QString, int, quint64> SearchOperations::ReplaceInFile(const std::shared_ptr<SPCRE> &spcre,
+                                                                  const QString &replacement,
+                                                                  Resource *resource)
 {
-    // QWriteLocker locker(&resource->GetLock());
-    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
-
-    if (html_resource) {
-        return ReplaceHTMLInFile(search_regex, replacement, html_resource);
-    }
-
+    // HTMLResources are TextResources and are replaced the same way
     TextResource *text_resource = qobject_cast<TextResource *>(resource);
 
-    if (text_resource) {
-        return ReplaceTextInFile(search_regex, replacement, text_resource);
+    if (!text_resource) {
+        // We should never get here.
+        return std::make_tuple(QString(), 0, Q_UINT64_C(0));
     }
 
-    // We should never get here.
-    return 0;
-}
-
-
-int SearchOperations::ReplaceHTMLInFile(const QString &search_regex,
-                                        const QString &replacement,
-                                        HTMLResource *html_resource)
-{
-    // SettingsStore ss;
-    QWriteLocker locker(&html_resource->GetLock());
-    int count;
+    QReadLocker locker(&text_resource->GetLock());
+    // The revision is read first so a change made while the text is being
+    // read shows up as a changed revision
+    quint64 revision = text_resource->GetTextRevision();
+    // note you can not use a reference here because the text returned from
+    // any text resource can come from an internal cache that can go away
+    const QString text = text_resource->GetText();
     QString new_text;
-    QString text = html_resource->GetText();
-    std::tie(new_text, count) = PerformGlobalReplace(text, search_regex, replacement);
-    html_resource->SetText(new_text);
-    return count;
- }
-
-
-int SearchOperations::ReplaceTextInFile(const QString &search_regex,
-                                        const QString &replacement,
-                                        TextResource *text_resource)
-{
-    QWriteLocker locker(&text_resource->GetLock());
     int count;
-    QString new_text;
-    QString text = text_resource->GetText();
-    std::tie(new_text, count) = PerformGlobalReplace(text, search_regex, replacement);
-    text_resource->SetText(new_text);
-    return count;
+    std::tie(new_text, count) = PerformGlobalReplace(text, spcre.get(), replacement);
+    return std::make_tuple(new_text, count, revision);
 }
 
 
@@ -180,22 +240,25 @@ std::tuple<QString, int> SearchOperations::PerformGlobalReplace(const QString &t
         const QString &search_regex,
         const QString &replacement)
 {
-    QString new_text = text;
-    int count = 0;
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
-    QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+    return PerformGlobalReplace(text, PCRECache::instance().getObject(search_regex).get(), replacement);
+}
 
-    for (int i =  match_info.count() - 1; i >= 0; i--) {
-        QString match_segement = Utility::Substring(match_info.at(i).offset.first, match_info.at(i).offset.second, new_text);
-        QString replacement_text;
 
-        if (spcre->replaceText(match_segement, match_info.at(i).capture_groups_offsets, replacement, replacement_text)) {
-            new_text.replace(match_info.at(i).offset.first, match_info.at(i).offset.second - match_info.at(i).offset.first, replacement_text);
-            count++;
-        }
+std::tuple<QString, int> SearchOperations::PerformGlobalReplace(const QString &text,
+        SPCRE *spcre,
+        const QString &replacement)
+{
+    QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+    if (match_info.isEmpty()) {
+        return std::make_tuple(text, 0);
     }
 
-    return std::make_tuple(new_text, count);
+    PCREReplaceAllBuilder builder(*spcre, text, replacement, match_info.count());
+    foreach(const SPCRE::MatchInfo &mi, match_info) {
+        builder.AppendReplacement(mi);
+    }
+    int count = builder.GetReplacementCount();
+    return std::make_tuple(builder.Finish(), count);
 }
 
 
@@ -203,25 +266,172 @@ std::tuple<QString, int> SearchOperations::PerformHTMLSpellCheckReplace(const QS
         const QString &search_regex,
         const QString &replacement)
 {
-    QString new_text = text;
-    int count = 0;
-    int offset = 0;
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     QList<HTMLSpellCheck::MisspelledWord> check_spelling = HTMLSpellCheck::GetMisspelledWords(text, 0, text.length(), search_regex);
+    PCREReplaceAllBuilder builder(*spcre, text, replacement, check_spelling.count());
     foreach(HTMLSpellCheck::MisspelledWord misspelled_word, check_spelling) {
         SPCRE::MatchInfo match_info = spcre->getFirstMatchInfo(misspelled_word.text);
 
         if (match_info.offset.first != -1) {
-            QString replacement_text;
+            // capture offsets are relative to the match so only the match itself moves
+            builder.AppendReplacement(misspelled_word.offset + match_info.offset.first,
+                                      misspelled_word.offset + match_info.offset.second,
+                                      match_info.capture_groups_offsets);
+        }
+    }
+    int count = builder.GetReplacementCount();
+    return std::make_tuple(builder.Finish(), count);
+}
+
+
+QList<int> SearchOperations::CountGroupInFiles(const QList<SearchGroupEntry> &entries)
+{
+    QHash<Resource *, QList<int>> entries_for_resource;
+    QList<Resource *> resources = GetGroupResources(entries, entries_for_resource);
+    SPCREList spcres = CompileGroup(entries);
+
+    // The workers hold on to the resources, the book must not be edited
+    // or closed until they are done
+    QProgressDialog progress(QObject::tr("Counting occurrences.."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+    progress.setValue(0);
+
+    QFuture<QList<int>> future = QtConcurrent::mapped(resources, std::bind(CountGroupInFile, spcres, entries_for_resource, std::placeholders::_1));
+    if (!WaitForFuture(future, progress)) {
+        return QList<int>();
+    }
+
+    QList<int> counts(entries.count(), 0);
+    for (int i = 0; i < future.resultCount(); i++) {
+        QList<int> file_counts = future.resultAt(i);
+        for (int j = 0; j < counts.count(); j++) {
+            Accumulate(counts[j], file_counts.at(j));
+        }
+    }
+    return counts;
+}
 
-            if (spcre->replaceText(Utility::Substring(match_info.offset.first, match_info.offset.second, misspelled_word.text), match_info.capture_groups_offsets, replacement, replacement_text)) {
-                new_text.replace(offset + misspelled_word.offset + match_info.offset.first, match_info.offset.second - match_info.offset.first, replacement_text);
-                offset += replacement_text.length() - (match_info.offset.second - match_info.offset.first);
-                count++;
+
+QList<int> SearchOperations::ReplaceGroupInFiles(const QList<SearchGroupEntry> &entries)
+{
+    QHash<Resource *, QList<int>> entries_for_resource;
+    QList<Resource *> resources = GetGroupResources(entries, entries_for_resource);
+    SPCREList spcres = CompileGroup(entries);
+
+    QProgressDialog progress(QObject::tr("Replacing search term..."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+    progress.setValue(0);
+
+    // As with ReplaceInAllFIles nothing is stored back until all files are done
+    QFuture<std::tuple<QString, QList<int>, quint64>> future = QtConcurrent::mapped(resources,
+        std::bind(ReplaceGroupInFile, entries, spcres, entries_for_resource, std::placeholders::_1));
+    if (!WaitForFuture(future, progress)) {
+        return QList<int>();
+    }
+
+    QList<quint64> revisions;
+    for (int i = 0; i < future.resultCount(); i++) {
+        revisions << std::get<2>(future.resultAt(i));
+    }
+    if (!IsUnchangedSince(resources, revisions)) {
+        return QList<int>();
+    }
+
+    QList<int> counts(entries.count(), 0);
+    for (int i = 0; i < future.resultCount(); i++) {
+        QString new_text;
+        QList<int> file_counts;
+        std::tie(new_text, file_counts, std::ignore) = future.resultAt(i);
+        int file_total = 0;
+        for (int j = 0; j < counts.count(); j++) {
+            Accumulate(counts[j], file_counts.at(j));
+            Accumulate(file_total, file_counts.at(j));
+        }
+        if (file_total > 0) {
+            TextResource *text_resource = qobject_cast<TextResource *>(resources.at(i));
+            if (text_resource) {
+                QWriteLocker locker(&text_resource->GetLock());
+                text_resource->SetText(new_text);
             }
         }
     }
-    return std::make_tuple(new_text, count);
+    return counts;
+}
+
+
+QList<Resource *> SearchOperations::GetGroupResources(const QList<SearchGroupEntry> &entries,
+                                                      QHash<Resource *, QList<int>> &entries_for_resource)
+{
+    QList<Resource *> resources;
+    for (int i = 0; i < entries.count(); i++) {
+        foreach(Resource *resource, entries.at(i).resources) {
+            if (!entries_for_resource.contains(resource)) {
+                resources << resource;
+            }
+            entries_for_resource[resource] << i;
+        }
+    }
+    return resources;
+}
+
+
+// Each group gets its own compiled patterns. A group can have many more
+// entries than the PCRECache holds and workers must not have a pattern
+// evicted from under them.
+SearchOperations::SPCREList SearchOperations::CompileGroup(const QList<SearchGroupEntry> &entries)
+{
+    SPCREList spcres;
+    foreach(const SearchGroupEntry &entry, entries) {
+        spcres << std::make_shared<SPCRE>(entry.search_regex);
+    }
+    return spcres;
+}
+
+
+QList<int> SearchOperations::CountGroupInFile(const SPCREList &spcres,
+                                              const QHash<Resource *, QList<int>> &entries_for_resource,
+                                              Resource *resource)
+{
+    QList<int> counts(spcres.count(), 0);
+    TextResource *text_resource = qobject_cast<TextResource *>(resource);
+    if (!text_resource) {
+        return counts;
+    }
+
+    QReadLocker locker(&text_resource->GetLock());
+    const QString text = text_resource->GetText();
+    foreach(int i, entries_for_resource.value(resource)) {
+        counts[i] = spcres.at(i)->getEveryMatchInfo(text).count();
+    }
+    return counts;
+}
+
+
+std::tuple<QString, QList<int>, quint64> SearchOperations::ReplaceGroupInFile(const QList<SearchGroupEntry> &entries,
+                                                                              const SPCREList &spcres,
+                                                                              const QHash<Resource *, QList<int>> &entries_for_resource,
+                                                                              Resource *resource)
+{
+    QList<int> counts(entries.count(), 0);
+    TextResource *text_resource = qobject_cast<TextResource *>(resource);
+    if (!text_resource) {
+        return std::make_tuple(QString(), counts, Q_UINT64_C(0));
+    }
+
+    QString text;
+    quint64 revision;
+    {
+        QReadLocker locker(&text_resource->GetLock());
+        revision = text_resource->GetTextRevision();
+        text = text_resource->GetText();
+    }
+    // Each entry sees the text as left by the entries before it
+    foreach(int i, entries_for_resource.value(resource)) {
+        std::tie(text, counts[i]) = PerformGlobalReplace(text, spcres.at(i).get(), entries.at(i).replacement);
+    }
+    return std::make_tuple(text, counts, revision);
 }
 
 
@@ -241,25 +451,34 @@ int SearchOperations::FunctionReplaceInAllFiles(const QString &search_regex,
     progress.setValue(progress_value);
     PythonRoutines pr;
     PyObjectPtr fsp = pr.SetupInitialFunctionSearchEnvInPython(function_name);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
+    int count = 0;
 
+    // Matches are found with PCRE, as for Find and the Dry Run, and all the
+    // replacements for a file come back from python in a single call
     foreach(Resource * resource, resources) {
        progress.setValue(progress_value++);
         qApp->processEvents();
         QString bookpath = resource->GetRelativePath();
-        HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+        // HTMLResources are TextResources and are replaced the same way
         TextResource *text_resource = qobject_cast<TextResource *>(resource);
-        if (html_resource) {
-            QWriteLocker locker(&html_resource->GetLock());
-            QString text = html_resource->GetText();
-            QString new_text = pr.DoFunctionSearchTextReplacementsInPython(fsp, search_regex, bookpath, text);
-            html_resource->SetText(new_text);
-        } else if (text_resource) {
-            QWriteLocker locker(&text_resource->GetLock());
-            QString text = text_resource->GetText();
-            QString new_text = pr.DoFunctionSearchTextReplacementsInPython(fsp, search_regex, bookpath, text);
-            text_resource->SetText(new_text);
+        if (!text_resource) {
+            continue;
+        }
+        QWriteLocker locker(&text_resource->GetLock());
+        QString text = text_resource->GetText();
+        QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+        QStringList replacements;
+        if (match_info.isEmpty() || !spcre->functionReplaceTexts(bookpath, text, match_info, fsp, replacements)) {
+            continue;
+        }
+        const QString no_pattern;
+        PCREReplaceAllBuilder builder(*spcre, text, no_pattern, match_info.count());
+        for (int i = 0; i < match_info.count(); i++) {
+            builder.AppendReplacementText(match_info.at(i).offset.first, match_info.at(i).offset.second, replacements.at(i));
         }
+        count += builder.GetReplacementCount();
+        text_resource->SetText(builder.Finish());
     }
-    int count = pr.GetCurrentReplacementCountInPython(fsp);
     return count;
 }
@@ -24,30 +24,71 @@
 #ifndef SEARCHOPERATIONS_H
 #define SEARCHOPERATIONS_H
 
+#include <memory>
+
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+
 class Resource;
 class TextResource;
 class HTMLResource;
+class QProgressDialog;
+class SPCRE;
 
 class SearchOperations
 {
 
 public:
 
+    /**
+     * One entry of a saved search group that is run over files.
+     */
+    struct SearchGroupEntry {
+        QString search_regex;
+        QString replacement;
+        QList<Resource *> resources;
+    };
+
     /**
      * Returns the number of matching occurrences.
      *
+     * The resources are searched in parallel and the per file
+     * counts are merged in resource order.
+     *
      * @param search_regex The regex to match with.
-     * @return The number of matching occurrences.
+     * @return The number of matching occurrences, 0 if cancelled.
      */
     static int CountInFiles(const QString &search_regex,
                             QList<Resource *> resources,
                             bool check_spelling = false);
 
 
+    /**
+     * Replaces every match in all resources.
+     *
+     * Replacement texts are built in parallel and only stored back
+     * into the resources if the user did not cancel and none of the
+     * resources was changed in the meantime.
+     *
+     * @return The number of replacements made, 0 if cancelled.
+     */
     static int ReplaceInAllFIles(const QString &search_regex,
                                  const QString &replacement,
                                  QList<Resource *> resources);
 
+    /**
+     * Runs a group of searches over their files visiting each file once.
+     *
+     * Every file's text is read once and all of the entries that target
+     * it are applied to it in group order, in parallel across files.
+     * The results are the same as running the entries one after the other.
+     *
+     * @return The count for each entry, in entry order. Empty if cancelled.
+     */
+    static QList<int> CountGroupInFiles(const QList<SearchGroupEntry> &entries);
+
+    static QList<int> ReplaceGroupInFiles(const QList<SearchGroupEntry> &entries);
+
     static int FunctionReplaceInAllFiles(const QString &search_regex,
                                          const QString &function_name,
                                          QList<Resource *> resources);
@@ -67,28 +108,64 @@ private:
     static int CountInTextFile(const QString &search_regex,
                                TextResource *text_resource);
 
-    static int ReplaceInFile(const QString &search_regex,
-                             const QString &replacement,
-                             Resource *resource);
-
-    static int ReplaceHTMLInFile(const QString &search_regex,
-                                 const QString &replacement,
-                                 HTMLResource *html_resource);
+    // Also returns the text revision the replacements were made in
+    static std::tuple<QString, int, quint64> ReplaceInFile(const std::shared_ptr<SPCRE> &spcre,
+                                                           const QString &replacement,
+                                                           Resource *resource);
 
-    static int ReplaceTextInFile(const QString &search_regex,
-                                 const QString &replacement,
-                                 TextResource *text_resource);
+    /**
+     * Checks that no resource was changed since its replacements were
+     * made, warning the user if one was.
+     *
+     * @return false if a resource's revision is not the one given for it.
+     */
+    static bool IsUnchangedSince(const QList<Resource *> &resources, const QList<quint64> &revisions);
 
     static std::tuple<QString, int> PerformGlobalReplace(const QString &text,
             const QString &search_regex,
             const QString &replacement);
 
+    static std::tuple<QString, int> PerformGlobalReplace(const QString &text,
+            SPCRE *spcre,
+            const QString &replacement);
+
+    typedef QList<std::shared_ptr<SPCRE>> SPCREList;
+
+    /**
+     * Maps each file of a search group to the entries that target it
+     * and returns the files in first seen order.
+     */
+    static QList<Resource *> GetGroupResources(const QList<SearchGroupEntry> &entries,
+                                               QHash<Resource *, QList<int>> &entries_for_resource);
+
+    static SPCREList CompileGroup(const QList<SearchGroupEntry> &entries);
+
+    static QList<int> CountGroupInFile(const SPCREList &spcres,
+                                       const QHash<Resource *, QList<int>> &entries_for_resource,
+                                       Resource *resource);
+
+    static std::tuple<QString, QList<int>, quint64> ReplaceGroupInFile(const QList<SearchGroupEntry> &entries,
+                                                                       const SPCREList &spcres,
+                                                                       const QHash<Resource *, QList<int>> &entries_for_resource,
+                                                                       Resource *resource);
+
     static std::tuple<QString, int> PerformHTMLSpellCheckReplace(const QString &text,
             const QString &search_regex,
             const QString &replacement);
 
     static void Accumulate(int &first, const int &second);
 
+    /**
+     * Runs the event loop until the future is finished, reporting
+     * progress and forwarding a cancel from the progress dialog.
+     * The dialog should be application modal, user input is held
+     * back until it is shown.
+     *
+     * @return false if the user cancelled.
+     */
+    template <typename T>
+    static bool WaitForFuture(QFuture<T> &future, QProgressDialog &progress);
+
 };
 
 #endif // SEARCHOPERATIONS_H
@@ -19,6 +19,7 @@
 **
 *************************************************************************/
 
+#include <algorithm>
 #include <QFile>
 #include <QVariant>
 #include <QMap>
@@ -54,14 +55,10 @@ int SearchUtils::ConvertUTF16Posto32(const QList<std::pair<int,int> > &table, in
     if (table.isEmpty()) return pos;  // no table
     if (pos < table.at(0).first) return pos; // before table
     if (pos >= table.last().first) return pos - table.last().second; // last or after table
-    // pos lies in table someplace
-    int i = 0;
-    while (i < table.size() - 1) {
-         if ((pos >= table.at(i).first) && (pos < table.at(i+1).first)) return pos - table.at(i).second;
-         i++;
-    }
-    // should never reach here
-    return pos;
+    // pos lies in table someplace so find the last entry at or before pos
+    auto it = std::upper_bound(table.begin(), table.end(), pos,
+                               [](int p, const std::pair<int, int> &entry) { return p < entry.first; });
+    return pos - (it - 1)->second;
 }
 
 
@@ -102,6 +99,45 @@ QList<std::pair<int, int> > SearchUtils::ConvertCaptureGroupstoUTF32(const QStri
     return ncgs;
 }
 
+QList<int> SearchUtils::ConvertMatchInfostoUTF32Offsets(const QString& text,
+                                                        const QList<SPCRE::MatchInfo>& match_info)
+{
+    QList<int> offsets;
+    QList<std::pair<int, int>> table = UTF16to32_PositionTable(text);
+    foreach(const SPCRE::MatchInfo &mi, match_info) {
+        int start = mi.offset.first;
+        int new_start = ConvertUTF16Posto32(table, start);
+        offsets << new_start << ConvertUTF16Posto32(table, mi.offset.second);
+        offsets << mi.capture_groups_offsets.size();
+        foreach(const auto &cg, mi.capture_groups_offsets) {
+            offsets << ConvertUTF16Posto32(table, cg.first + start) - new_start;
+            offsets << ConvertUTF16Posto32(table, cg.second + start) - new_start;
+        }
+    }
+    return offsets;
+}
+
+
+SPCRE::MatchInfo SearchUtils::FindFromPosition(SPCRE &spcre, const QString& text, int position,
+                                               int start, int end, bool backwards)
+{
+    SPCRE::MatchInfo mi;
+    int offset;
+    if (backwards) {
+        offset = start;
+        mi = spcre.getLastMatchInfo(text.mid(start, position - start));
+    } else {
+        offset = position;
+        mi = spcre.getFirstMatchInfo(text.mid(position, end - position));
+    }
+    if (mi.offset.first != -1) {
+        mi.offset.first += offset;
+        mi.offset.second += offset;
+    }
+    return mi;
+}
+
+
 QByteArray SearchUtils::ReadFileAsBinary(const QString& fullfilepath)
 {
     QFile file(fullfilepath);
@@ -50,6 +50,21 @@ public:
     static QList<std::pair<int, int> > ConvertCaptureGroupstoUTF32(const QString& text,
                                                                    const QList<std::pair<int, int> > &cgs);
 
+    // Flattens all matches in text into code point offsets for a batched
+    // function replace. Each match is its start and end in text, the
+    // number of capture groups and then each group's start and end
+    // relative to the match start.
+    static QList<int> ConvertMatchInfostoUTF32Offsets(const QString& text,
+                                                      const QList<SPCRE::MatchInfo>& match_info);
+
+    // The match a Find Next from position lands on: the first match in
+    // the text from position to end, or with backwards (Find Previous)
+    // the last match in the text from start to position. The pattern
+    // only sees that part of the text, so a search from inside a match
+    // can find a shorter one. The offsets are in text, -1 if none.
+    static SPCRE::MatchInfo FindFromPosition(SPCRE &spcre, const QString& text, int position,
+                                             int start, int end, bool backwards);
+
     static QByteArray ReadFileAsBinary(const QString& fullfilepath);
 
     static bool WriteFileAsBinary(const QString& fullfilepath, const QByteArray& data);
@@ -0,0 +1,86 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#include "Misc/Utf8OffsetMap.h"
+
+// Bytes per checkpoint
+static const size_t BLOCK_SIZE = 64;
+
+Utf8OffsetMap::Utf8OffsetMap()
+    :
+    m_Data(NULL),
+    m_Length(0)
+{
+}
+
+
+Utf8OffsetMap::Utf8OffsetMap(const char *utf8, size_t length)
+    :
+    m_Data(NULL),
+    m_Length(0)
+{
+    Build(utf8, length);
+}
+
+
+void Utf8OffsetMap::Build(const char *utf8, size_t length)
+{
+    m_Data = utf8;
+    m_Length = length;
+    m_Checkpoints.clear();
+    m_Checkpoints.reserve(length / BLOCK_SIZE + 1);
+    const unsigned char *data = reinterpret_cast<const unsigned char*>(utf8);
+    int utf16_pos = 0;
+    size_t block_start = 0;
+    while (block_start < length) {
+        m_Checkpoints.push_back(utf16_pos);
+        size_t block_end = block_start + BLOCK_SIZE;
+        if (block_end > length) block_end = length;
+        // simple enough for the compiler to vectorize
+        int units = 0;
+        for (size_t i = block_start; i < block_end; ++i) {
+            units += Utf16Units(data[i]);
+        }
+        utf16_pos += units;
+        block_start = block_end;
+    }
+    // checkpoint for the very end
+    m_Checkpoints.push_back(utf16_pos);
+}
+
+
+int Utf8OffsetMap::ToUtf16(size_t utf8_offset) const
+{
+    if (m_Checkpoints.empty()) {
+        return 0;
+    }
+    if (utf8_offset >= m_Length) {
+        return m_Checkpoints.back();
+    }
+    size_t block = utf8_offset / BLOCK_SIZE;
+    int utf16_pos = m_Checkpoints[block];
+    const unsigned char *data = reinterpret_cast<const unsigned char*>(m_Data);
+    for (size_t i = block * BLOCK_SIZE; i < utf8_offset; ++i) {
+        utf16_pos += Utf16Units(data[i]);
+    }
+    return utf16_pos;
+}
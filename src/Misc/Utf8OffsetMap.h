@@ -0,0 +1,72 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef UTF8OFFSETMAP_H
+#define UTF8OFFSETMAP_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Maps byte offsets into a UTF-8 buffer to the matching UTF-16 offsets,
+ * for turning positions in parser output (gumbo, css) into positions
+ * in the QString the buffer was made from without transcoding it again.
+ *
+ * A checkpoint is kept every few bytes so a lookup scans at most one
+ * block. The buffer is not copied and must outlive the map.
+ */
+class Utf8OffsetMap
+{
+
+public:
+    Utf8OffsetMap();
+
+    Utf8OffsetMap(const char *utf8, size_t length);
+
+    /**
+     * (Re)builds the map for the given buffer.
+     */
+    void Build(const char *utf8, size_t length);
+
+    bool IsEmpty() const { return m_Checkpoints.empty(); }
+
+    /**
+     * Returns the UTF-16 offset of the character starting at byte offset
+     * utf8_offset. Offsets past the end map to the UTF-16 length.
+     */
+    int ToUtf16(size_t utf8_offset) const;
+
+private:
+    // UTF-16 code units a byte starts, 0 for continuation bytes
+    static inline int Utf16Units(unsigned char c) {
+        return ((c & 0xC0) == 0x80) ? 0 : ((c >= 0xF0) ? 2 : 1);
+    }
+
+    const char *m_Data;
+    size_t m_Length;
+
+    // UTF-16 offset at the start of every block
+    std::vector<int> m_Checkpoints;
+};
+
+#endif // UTF8OFFSETMAP_H
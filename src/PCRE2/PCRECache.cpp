@@ -20,26 +20,124 @@
 **
 *************************************************************************/
 
+#include <QtCore/QElapsedTimer>
+#include <QtConcurrent/QtConcurrent>
+
 #include "PCRE2/PCRECache.h"
 
-  // defaults to maxCacheCost of 100
+// Enough for several hundred typical search patterns
+static const qsizetype PCRE_CACHE_MAX_COST = 4 * 1024 * 1024;
+
+PCRECache::PCRECache()
+{
+    m_cache.setMaxCost(PCRE_CACHE_MAX_COST);
+}
 
 bool PCRECache::insert(const QString &key, SPCRE *object)
 {
-    // raise cost of each entry to 5 to reduce memory footprint
-    return m_cache.insert(key, object, 5);
+    QMutexLocker locker(&m_mutex);
+    return insertObject(key, std::shared_ptr<SPCRE>(object));
 }
 
-SPCRE *PCRECache::getObject(const QString &key)
+std::shared_ptr<SPCRE> PCRECache::getObject(const QString &key)
 {
+    {
+        QMutexLocker locker(&m_mutex);
+        std::shared_ptr<SPCRE> *cached = m_cache.object(key);
+        if (cached) {
+            m_statistics.hits++;
+            return *cached;
+        }
+        m_statistics.misses++;
+    }
+
     // Create a new SPCRE if it doesn't already exist.
     // The key is the pattern for initializing the SPCRE.
-    if (!m_cache.contains(key)) {
-        SPCRE *spcre = new SPCRE(key);
-        // raise cost of each entry to 5 to reduce memory footprint
-        m_cache.insert(key, spcre, 5);
-        return spcre;
+    // It is compiled without holding the lock so lookups of other
+    // patterns are not held up by it.
+    quint64 nsecs = 0;
+    std::shared_ptr<SPCRE> spcre = compile(key, nsecs);
+    QMutexLocker locker(&m_mutex);
+    m_statistics.compile_nsecs += nsecs;
+    // another thread may have compiled the same pattern meanwhile,
+    // everyone should share the one that is cached
+    std::shared_ptr<SPCRE> *cached = m_cache.object(key);
+    if (cached) {
+        return *cached;
+    }
+    insertObject(key, spcre);
+    return spcre;
+}
+
+void PCRECache::precompile(const QStringList &keys)
+{
+    QStringList missing;
+    {
+        QMutexLocker locker(&m_mutex);
+        foreach(QString key, keys) {
+            if (!key.isEmpty() && !m_cache.contains(key) && !missing.contains(key)) {
+                missing << key;
+            }
+        }
+    }
+    if (!missing.isEmpty()) {
+        QtConcurrent::run(&PCRECache::precompileKeys, this, missing);
+    }
+}
+
+void PCRECache::precompileKeys(const QStringList &keys)
+{
+    foreach(QString key, keys) {
+        // Compiled without holding the lock so searches are not held up
+        quint64 nsecs = 0;
+        std::shared_ptr<SPCRE> spcre = compile(key, nsecs);
+        QMutexLocker locker(&m_mutex);
+        m_statistics.compile_nsecs += nsecs;
+        if (m_cache.contains(key) || (m_cache.totalCost() + cost(*spcre) > m_cache.maxCost())) {
+            continue;
+        }
+        insertObject(key, spcre);
+        m_statistics.precompiled++;
     }
+}
 
-    return m_cache.object(key);
+void PCRECache::setMaxCost(qsizetype cost)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(cost);
+}
+
+PCRECache::Statistics PCRECache::getStatistics()
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.entries = m_cache.count();
+    statistics.total_cost = m_cache.totalCost();
+    statistics.max_cost = m_cache.maxCost();
+    return statistics;
+}
+
+void PCRECache::resetStatistics()
+{
+    QMutexLocker locker(&m_mutex);
+    m_statistics = Statistics();
+}
+
+std::shared_ptr<SPCRE> PCRECache::compile(const QString &key, quint64 &nsecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    std::shared_ptr<SPCRE> spcre = std::make_shared<SPCRE>(key);
+    nsecs += timer.nsecsElapsed();
+    return spcre;
+}
+
+bool PCRECache::insertObject(const QString &key, const std::shared_ptr<SPCRE> &object)
+{
+    return m_cache.insert(key, new std::shared_ptr<SPCRE>(object), cost(*object));
+}
+
+qsizetype PCRECache::cost(const SPCRE &object) const
+{
+    return qMin(qsizetype(object.getMemoryUsage()), m_cache.maxCost());
 }
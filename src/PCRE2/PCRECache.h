@@ -25,20 +25,45 @@
 #ifndef PCRECACHE_H
 #define PCRECACHE_H
 
+#include <memory>
+
 #include <QtCore/QCache>
+#include <QtCore/QMutex>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 
 #include "PCRE2/SPCRE.h"
 
 /**
  * Singleton. A cache of SPCRE regular expression objects.
  *
- * The SPCRE's are cached to improve performance.
+ * The SPCRE's are cached to improve performance. Each entry costs
+ * the memory its compiled pattern uses so the cache holds many small
+ * patterns or a few large ones.
+ *
+ * The cache holds shared pointers and hands out copies of them. An entry
+ * can be evicted by another thread at any time, the SPCRE itself is only
+ * deleted once the last user lets go of it.
  */
 class PCRECache
 {
 
 public:
+    /**
+     * Counters for tuning the cache size.
+     */
+    struct Statistics {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        // Patterns compiled ahead of use by precompile
+        quint64 precompiled = 0;
+        // Total time spent compiling patterns in nanoseconds
+        quint64 compile_nsecs = 0;
+        int entries = 0;
+        qsizetype total_cost = 0;
+        qsizetype max_cost = 0;
+    };
+
     static PCRECache& instance() {
         static PCRECache the_instance;
         return the_instance;
@@ -61,22 +86,59 @@ public:
      * Retrieve the SPCRE object from the cache.
      *
      * If the object does not exist it is created and inserted into the cache
-     * then returned.
+     * then returned. Keep the returned pointer for as long as the SPCRE
+     * is used.
      *
      * @param key The key associated with the SPCRE.
      */
-    SPCRE *getObject(const QString &key);
+    std::shared_ptr<SPCRE> getObject(const QString &key);
+
+    /**
+     * Compile patterns that are not yet cached in the background.
+     *
+     * Precompiled patterns are only added while there is free room so
+     * they never evict a pattern that may be in use.
+     *
+     * @param keys The patterns about to be used, such as the searches
+     * of a saved search group.
+     */
+    void precompile(const QStringList &keys);
+
+    /**
+     * The maximum total cost in bytes.
+     */
+    void setMaxCost(qsizetype cost);
+
+    Statistics getStatistics();
+    void resetStatistics();
 
 private:
     /**
      * Private constructor.
      */
-    PCRECache() = default;
+    PCRECache();
 
     ~PCRECache() = default;
 
+    // Adds the time taken to nsecs
+    static std::shared_ptr<SPCRE> compile(const QString &key, quint64 &nsecs);
+
+    // Takes the cache's own reference to object
+    bool insertObject(const QString &key, const std::shared_ptr<SPCRE> &object);
+
+    void precompileKeys(const QStringList &keys);
+
+    // The cost of an object, never more than the cache can hold
+    // because QCache deletes such an object as soon as it is inserted.
+    qsizetype cost(const SPCRE &object) const;
+
     // The cache that we store the SPCRE's.
-    QCache<QString, SPCRE> m_cache;
+    QCache<QString, std::shared_ptr<SPCRE>> m_cache;
+
+    Statistics m_statistics;
+
+    // Guards m_cache and m_statistics since searches can run in worker threads
+    QMutex m_mutex;
 };
 
 #endif // PCRECACHE_H
@@ -0,0 +1,132 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford ON Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include "PCRE2/PCREReplaceAllBuilder.h"
+#include "Misc/Utility.h"
+
+PCREReplaceAllBuilder::PCREReplaceAllBuilder(SPCRE &sre,
+                                             const QString &text,
+                                             const QString &replacement_pattern,
+                                             int expected_matches)
+    :
+    m_sre(sre),
+    m_text(text),
+    m_replacementPattern(replacement_pattern),
+    m_isLiteral(!replacement_pattern.contains("\\")),
+    m_isFunction(false),
+    m_lastEnd(0),
+    m_count(0)
+{
+    QString rname = replacement_pattern.trimmed();
+    m_isFunction = rname.startsWith("\\F<") && rname.endsWith(">");
+
+    // Only grow past the original size when every replacement is longer
+    // than its match could ever be, otherwise QString's own growth is fine.
+    qsizetype reserve = text.length();
+    if (m_isLiteral && expected_matches > 0) {
+        reserve += qsizetype(expected_matches) * replacement_pattern.length();
+    }
+    m_out.reserve(reserve);
+}
+
+
+bool PCREReplaceAllBuilder::AppendReplacement(int start, int end,
+                                              const QList<std::pair<int, int>> &capture_groups_offsets)
+{
+    if (start < m_lastEnd || end < start || end > m_text.length()) {
+        return false;
+    }
+
+    if (m_isLiteral) {
+        if (!m_sre.isValid()) {
+            return false;
+        }
+        m_out.append(QStringView(m_text).sliced(m_lastEnd, start - m_lastEnd));
+        m_out.append(m_replacementPattern);
+    } else {
+        const QString match_segment = Utility::Substring(start, end, m_text);
+        bool made;
+        if (m_isFunction) {
+            made = m_sre.replaceText(match_segment, capture_groups_offsets, m_replacementPattern, m_replacement);
+        } else {
+            made = m_textBuilder.BuildReplacementText(m_sre, match_segment, capture_groups_offsets, m_replacementPattern, m_replacement);
+        }
+        if (!made) {
+            return false;
+        }
+        m_out.append(QStringView(m_text).sliced(m_lastEnd, start - m_lastEnd));
+        m_out.append(m_replacement);
+    }
+    m_lastEnd = end;
+    m_count++;
+    return true;
+}
+
+
+bool PCREReplaceAllBuilder::AppendReplacement(const SPCRE::MatchInfo &match_info)
+{
+    return AppendReplacement(match_info.offset.first, match_info.offset.second, match_info.capture_groups_offsets);
+}
+
+
+bool PCREReplaceAllBuilder::AppendReplacementText(int start, int end, const QString &replacement)
+{
+    if (start < m_lastEnd || end < start || end > m_text.length()) {
+        return false;
+    }
+    m_out.append(QStringView(m_text).sliced(m_lastEnd, start - m_lastEnd));
+    m_out.append(replacement);
+    m_lastEnd = end;
+    m_count++;
+    return true;
+}
+
+
+QString PCREReplaceAllBuilder::Finish()
+{
+    m_out.append(QStringView(m_text).sliced(m_lastEnd));
+    m_lastEnd = m_text.length();
+    return std::move(m_out);
+}
+
+
+int PCREReplaceAllBuilder::GetReplacementCount() const
+{
+    return m_count;
+}
+
+
+QList<SPCRE::MatchInfo> PCREReplaceAllBuilder::MatchesFromPosition(const QList<SPCRE::MatchInfo> &match_info,
+                                                                   int position, bool backwards)
+{
+    QList<SPCRE::MatchInfo> matches;
+    foreach(const SPCRE::MatchInfo &mi, match_info) {
+        if (backwards) {
+            if (mi.offset.first > position) {
+                break;
+            }
+        } else if (mi.offset.second < position) {
+            continue;
+        }
+        matches.append(mi);
+    }
+    return matches;
+}
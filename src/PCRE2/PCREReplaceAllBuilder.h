@@ -0,0 +1,125 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford ON Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef PCREREPLACEALLBUILDER_H
+#define PCREREPLACEALLBUILDER_H
+
+#include <QtCore/QString>
+
+#include "PCRE2/SPCRE.h"
+#include "PCRE2/PCREReplaceTextBuilder.h"
+
+/**
+ * Builds the result of replacing many matches in one text in a single pass.
+ *
+ * Matches must be appended in increasing, non overlapping order. The
+ * unchanged text between matches and the expanded replacements are
+ * streamed into one output buffer so the total cost is linear in the
+ * length of the text instead of matches x length when each match is
+ * replaced in place.
+ */
+class PCREReplaceAllBuilder
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param sre The SPCRE that produced the matches.
+     * @param text The full text the match offsets refer to.
+     * @param replacement_pattern The replacement pattern.
+     * @param expected_matches Used to pre-size the output buffer.
+     */
+    PCREReplaceAllBuilder(SPCRE &sre,
+                          const QString &text,
+                          const QString &replacement_pattern,
+                          int expected_matches = 0);
+
+    /**
+     * Replace one match.
+     *
+     * @param start The start of the match within the full text.
+     * @param end The end of the match within the full text.
+     * @param capture_groups_offsets The capture offsets relative to start.
+     *
+     * @return True if a replacement was made.
+     */
+    bool AppendReplacement(int start, int end,
+                           const QList<std::pair<int, int>> &capture_groups_offsets);
+
+    bool AppendReplacement(const SPCRE::MatchInfo &match_info);
+
+    /**
+     * Replace one match with text that is already built, such as
+     * the results of a batched function replace.
+     */
+    bool AppendReplacementText(int start, int end, const QString &replacement);
+
+    /**
+     * Copies the text after the last match and returns the result.
+     * The builder can not be used after this.
+     */
+    QString Finish();
+
+    /**
+     * The number of replacements made so far.
+     */
+    int GetReplacementCount() const;
+
+    /**
+     * The matches a Replace All without wrap replaces, the ones on the
+     * search direction side of position. Searching down those are the
+     * matches that end at or after position, searching up the matches
+     * that start at or before position. A match around position is
+     * replaced in both directions.
+     *
+     * @param match_info Every match in the text, in text order.
+     */
+    static QList<SPCRE::MatchInfo> MatchesFromPosition(const QList<SPCRE::MatchInfo> &match_info,
+                                                       int position, bool backwards);
+
+private:
+    SPCRE &m_sre;
+    const QString &m_text;
+    const QString &m_replacementPattern;
+
+    // True if the replacement pattern has no control sequences and can be
+    // copied as is.
+    bool m_isLiteral;
+
+    // True if the replacement is a \F<name> python function.
+    bool m_isFunction;
+
+    // End of the last match copied into the output.
+    int m_lastEnd;
+
+    int m_count;
+
+    PCREReplaceTextBuilder m_textBuilder;
+
+    // Scratch buffer for a single expanded replacement.
+    QString m_replacement;
+
+    QString m_out;
+};
+
+#endif // PCREREPLACEALLBUILDER_H
@@ -22,6 +22,8 @@
 #include "EmbedPython/PyObjectPtr.h"
 #include "EmbedPython/PythonRoutines.h"
 #include <QString>
+#include <QStringList>
+#include <vector>
 // #include <QDebug>
 
 #include "PCRE2/SPCRE.h"
@@ -35,44 +37,96 @@
 // The maximum number of catpures that we will allow.
 const int PCRE_MAX_CAPTURE_GROUPS = 30;
 
-SPCRE::SPCRE(const QString &patten)
+// The prefix FindReplace uses for the Text Only option and the options
+// that can be placed in front of it.
+static const QString TEXT_ONLY_PREFIX = "<[^<>]*>(*SKIP)(*F)|";
+static const QStringList TEXT_ONLY_LEADING_OPTIONS = QStringList() << "(*UCP)" << "(?i)" << "(?s)" << "(?U)";
+
+// The maximum number of idle match data blocks kept per pattern.
+const int PCRE_MAX_POOLED_MATCH_DATA = 16;
+
+namespace
 {
-    m_pattern = patten;
-    m_re = NULL;
-    m_matchdata = NULL;
-    m_mcontext = NULL;
+    // The match context and JIT stack are not tied to any one pattern but
+    // can not be used by two matches at the same time, so every thread that
+    // runs a match gets its own. They are freed when the thread exits.
+    struct ThreadMatchContext {
+        pcre2_match_context *mcontext = NULL;
+#ifndef PCRE_NO_JIT
+        pcre2_jit_stack *jitstack = NULL;
+#endif
+
+        ThreadMatchContext() {
+#ifndef PCRE_NO_JIT
+            mcontext = pcre2_match_context_create_16(NULL);
+            jitstack = pcre2_jit_stack_create_16(32*1024, 1024*1024, NULL);
+            if (mcontext != NULL && jitstack != NULL) {
+                pcre2_jit_stack_assign_16(mcontext, NULL, jitstack);
+            }
+#endif
+        }
 
+        ~ThreadMatchContext() {
 #ifndef PCRE_NO_JIT
-    m_jitstack = NULL;
+            if (jitstack != NULL) {
+                pcre2_jit_stack_free_16(jitstack);
+            }
+            if (mcontext != NULL) {
+                pcre2_match_context_free_16(mcontext);
+            }
 #endif
+        }
+    };
+
+    pcre2_match_context *GetThreadMatchContext()
+    {
+        thread_local ThreadMatchContext tmc;
+        return tmc.mcontext;
+    }
+}
 
+SPCRE::SPCRE(const QString &patten)
+{
+    m_pattern = patten;
+    m_re = NULL;
+    m_textOnly = false;
+    m_isLiteral = false;
     m_captureSubpatternCount = 0;
+    m_memoryUsage = 0;
     m_error = QString();
     m_errpos = -1;
     int errorno = -1;
     PCRE2_SIZE erroroffset = 0;
-    m_re = pcre2_compile_16(m_pattern.utf16(), PCRE2_ZERO_TERMINATED, PCRE2_UTF | PCRE2_MULTILINE, &errorno, &erroroffset, NULL);
+    parseTextOnly();
+    m_re = pcre2_compile_16(m_matchPattern.utf16(), PCRE2_ZERO_TERMINATED, PCRE2_UTF | PCRE2_MULTILINE, &errorno, &erroroffset, NULL);
 
     // Pattern is valid.
     if (m_re != NULL) {
         m_valid = true;
-        m_matchdata = pcre2_match_data_create_from_pattern_16(m_re, NULL);
-
 
 #ifndef PCRE_NO_JIT
-        int rc = pcre2_jit_compile_16(m_re, PCRE2_JIT_COMPLETE);
-        if (rc == 0) {
-            m_mcontext = pcre2_match_context_create_16(NULL);
-            m_jitstack = pcre2_jit_stack_create_16(32*1024, 1024*1024, NULL);
-            if (m_jitstack != NULL) {
-                pcre2_jit_stack_assign_16(m_mcontext, NULL, m_jitstack);
-            }
-        }
+        // The JIT code becomes part of m_re and is read only from here on
+        pcre2_jit_compile_16(m_re, PCRE2_JIT_COMPLETE);
 #endif
 
         // Store the number of capture patterns (pairs).
         // pcre2_pattern_info_16(m_re, PCRE2_INFO_CAPTURECOUNT, &m_captureSubpatternCount);
-        m_captureSubpatternCount = pcre2_get_ovector_count_16(m_matchdata);
+        pcre2_match_data *matchdata = acquireMatchData();
+        m_captureSubpatternCount = pcre2_get_ovector_count_16(matchdata);
+        releaseMatchData(matchdata);
+
+        // The compiled pattern is still needed for replacements and
+        // pattern info even when matching is done without PCRE
+        parseLiteral();
+
+        size_t code_size = 0;
+        pcre2_pattern_info_16(m_re, PCRE2_INFO_SIZE, &code_size);
+        m_memoryUsage += code_size;
+#ifndef PCRE_NO_JIT
+        size_t jit_size = 0;
+        pcre2_pattern_info_16(m_re, PCRE2_INFO_JITSIZE, &jit_size);
+        m_memoryUsage += jit_size;
+#endif
     }
     // Pattern is not valid.
     else {
@@ -86,31 +140,127 @@ SPCRE::SPCRE(const QString &patten)
         // qDebug() << "SPCRE error position: " << m_errpos;
 
     }
+    // The JIT stack belongs to the thread not the pattern so it is not counted
+    m_memoryUsage += sizeof(SPCRE) + (m_pattern.capacity() + m_matchPattern.capacity() + m_literal.capacity()) * sizeof(QChar);
 }
 
 SPCRE::~SPCRE()
 {
+    foreach(pcre2_match_data *matchdata, m_matchDataPool) {
+        pcre2_match_data_free_16(matchdata);
+    }
+    m_matchDataPool.clear();
+
     if (m_re != NULL) {
         pcre2_code_free_16(m_re);
         m_re = NULL;
     }
+}
+
+// The Text Only search option is expressed in the pattern by inserting
+// TEXT_ONLY_PREFIX after any leading option settings. Rather than have
+// PCRE try the tag alternative at every position, strip it and skip the
+// matches that start where the prefix would not let one start.
+void SPCRE::parseTextOnly()
+{
+    m_matchPattern = m_pattern;
+    int pos = 0;
+    bool found_option = true;
+    while (found_option) {
+        found_option = false;
+        foreach(const QString &option, TEXT_ONLY_LEADING_OPTIONS) {
+            if (QStringView(m_pattern).sliced(pos).startsWith(option)) {
+                pos += option.length();
+                found_option = true;
+            }
+        }
+    }
+    if (QStringView(m_pattern).sliced(pos).startsWith(TEXT_ONLY_PREFIX)) {
+        m_matchPattern = m_pattern.left(pos) + m_pattern.mid(pos + TEXT_ONLY_PREFIX.length());
+        m_textOnly = true;
+    }
+}
 
-    if (m_matchdata != NULL) {
-        pcre2_match_data_free_16(m_matchdata);
-        m_matchdata = NULL;
+// A pattern is a literal if it is made only of word characters, characters
+// outside of ASCII and backslash escaped non-alphanumeric ASCII characters,
+// optionally preceded by (?i). That covers every pattern produced by
+// QRegularExpression::escape for the Normal and Case Sensitive modes.
+void SPCRE::parseLiteral()
+{
+    QStringView pattern(m_matchPattern);
+    Qt::CaseSensitivity cs = Qt::CaseSensitive;
+    if (pattern.startsWith(u"(?i)")) {
+        cs = Qt::CaseInsensitive;
+        pattern = pattern.sliced(4);
     }
 
-#ifndef PCRE_NO_JIT
-    if (m_jitstack) {
-        pcre2_jit_stack_free_16(m_jitstack);
-        m_jitstack = NULL;
+    QString literal;
+    literal.reserve(pattern.length());
+    for (int i = 0; i < pattern.length(); i++) {
+        QChar c = pattern.at(i);
+        if (c == '\\') {
+            i++;
+            if (i >= pattern.length()) {
+                return;
+            }
+            c = pattern.at(i);
+            // a backslash before an ascii letter or digit is a regex escape
+            if (c.unicode() < 128 && c.isLetterOrNumber()) {
+                return;
+            }
+        } else if (c.unicode() < 128 && !c.isLetterOrNumber() && c != '_') {
+            return;
+        }
+        literal.append(c);
     }
-    if (m_mcontext) {
-        pcre2_match_context_free_16(m_mcontext);
-        m_mcontext = NULL;
+
+    if (literal.isEmpty()) {
+        return;
     }
-#endif
 
+    m_literal = literal;
+    m_literalMatcher.setPattern(m_literal);
+    m_literalMatcher.setCaseSensitivity(cs);
+    m_isLiteral = true;
+}
+
+int SPCRE::indexOfLiteral(const QString &text, int from, int end)
+{
+    return m_literalMatcher.indexIn(QStringView(text).first(end), from);
+}
+
+SPCRE::MatchInfo SPCRE::generateLiteralMatchInfo(int start)
+{
+    MatchInfo match_info;
+    match_info.offset = std::pair<int, int>(start, start + m_literal.length());
+    match_info.capture_groups_offsets.append(std::pair<int, int>(0, m_literal.length()));
+    return match_info;
+}
+
+pcre2_match_data *SPCRE::acquireMatchData()
+{
+    {
+        QMutexLocker locker(&m_poolMutex);
+        if (!m_matchDataPool.isEmpty()) {
+            return m_matchDataPool.takeLast();
+        }
+    }
+    return pcre2_match_data_create_from_pattern_16(m_re, NULL);
+}
+
+void SPCRE::releaseMatchData(pcre2_match_data *matchdata)
+{
+    if (matchdata == NULL) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_poolMutex);
+        if (m_matchDataPool.count() < PCRE_MAX_POOLED_MATCH_DATA) {
+            m_matchDataPool.append(matchdata);
+            return;
+        }
+    }
+    pcre2_match_data_free_16(matchdata);
 }
 
 bool SPCRE::isValid()
@@ -118,6 +268,11 @@ bool SPCRE::isValid()
     return m_valid;
 }
 
+bool SPCRE::isLiteral()
+{
+    return m_isLiteral;
+}
+
 QString SPCRE::getError()
 {
     return m_error;
@@ -143,6 +298,11 @@ int SPCRE::getCaptureSubpatternCount()
     return m_captureSubpatternCount;
 }
 
+size_t SPCRE::getMemoryUsage() const
+{
+    return m_memoryUsage;
+}
+
 // get capture group number for named capture group
 int SPCRE::getCaptureStringNumber(const QString &name)
 {
@@ -165,16 +325,77 @@ int SPCRE::getCaptureStringNumber(const QString &name)
 
 QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
 {
-    // This function is very similar to getNextMatchInfo but we don't
-    // want to put a call to getNextMatchInfo in a loop because it allocates
-    // a new ovector. We want to avoid this and only do one allocation so we
-    // reuse the logic and put the call to generateMatchInfo in the loop.
     QList<SPCRE::MatchInfo> info;
 
     if (m_re == NULL || text.isEmpty()) {
         return info;
     }
 
+    collectMatchInfo(text, 0, text.length(), MatchScope_Every, info);
+    return info;
+}
+
+SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
+{
+    QList<SPCRE::MatchInfo> info;
+
+    if (m_re == NULL || text.isEmpty()) {
+        return SPCRE::MatchInfo();
+    }
+
+    collectMatchInfo(text, 0, text.length(), MatchScope_First, info);
+
+    if (info.isEmpty()) {
+        return SPCRE::MatchInfo();
+    }
+    return info.first();
+}
+
+void SPCRE::collectMatchInfo(const QString &text, int start, int end, MatchScope scope, QList<MatchInfo> &info)
+{
+    // With Text Only a match may not start in a tag, which TEXT_ONLY_PREFIX
+    // makes PCRE skip whole when it reaches one. The text is searched
+    // without the prefix and the tags are walked along behind the matches:
+    // the tags that end before a match are passed over, and the search is
+    // only started again (after the tag) when the match begins in one.
+    int tag_start = -1;
+    int tag_end = 0;
+
+    if (m_isLiteral) {
+        int last_pos = -1;
+        int from = start;
+        int pos = indexOfLiteral(text, from, end);
+        while (pos != -1) {
+            if (m_textOnly) {
+                if (from > tag_start) {
+                    tag_start = nextTag(text, from, end, tag_end);
+                }
+                while (tag_end <= pos) {
+                    tag_start = nextTag(text, tag_end, end, tag_end);
+                }
+                if (pos >= tag_start) {
+                    from = tag_end;
+                    pos = indexOfLiteral(text, from, end);
+                    continue;
+                }
+            }
+            if (scope == MatchScope_Last) {
+                last_pos = pos;
+            } else {
+                info.append(generateLiteralMatchInfo(pos));
+                if (scope == MatchScope_First) {
+                    return;
+                }
+            }
+            from = pos + m_literal.length();
+            pos = indexOfLiteral(text, from, end);
+        }
+        if (last_pos != -1) {
+            info.append(generateLiteralMatchInfo(last_pos));
+        }
+        return;
+    }
+
     int rc = 0;
 
     PCRE2_SIZE * ovector = NULL;
@@ -187,80 +408,130 @@ QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
         ovector_count = PCRE_MAX_CAPTURE_GROUPS;
     }
 
+    // The match data comes from a pool (not a single member) so that one
+    // cached SPCRE can be used by multiple threads at the same time
+    pcre2_match_data *matchdata = acquireMatchData();
+    if (matchdata == NULL) {
+        return;
+    }
+    pcre2_match_context *mcontext = GetThreadMatchContext();
+
+    // The subject always starts at the beginning of the text so
+    // lookbehinds, ^ and \b see the real preceding characters.
+    // A $ must not match where the subject was cut.
+    uint32_t options = PCRE2_NOTEMPTY;
+    if (end < text.length()) {
+        options |= PCRE2_NOTEOL;
+    }
+
     // We keep track of the last offsets as we move though the string matching
     // sub strings.
-    unsigned int last_offset[2] = {0};
-    bool done = false;
-    
+    PCRE2_SIZE last_offset = start;
+
+    // The matches are still found front to back so they are exactly the
+    // ones getEveryMatchInfo would return, only the latest is remembered
+    std::vector<PCRE2_SIZE> last_ovector;
+
     // Run until no matches are found.
-    do {
+    while (true) {
+
+        rc = pcre2_match_16(m_re, text.utf16(), end, last_offset, options, matchdata, mcontext);
+
+        if (rc < 0) {
+            break;
+        }
 
-        rc = pcre2_match_16(m_re, text.utf16(), text.length(), last_offset[1], PCRE2_NOTEMPTY, m_matchdata, m_mcontext);
+        // The first call checked that the text is valid UTF-16, without
+        // this every later call would check the rest of the text again.
+        options |= PCRE2_NO_UTF_CHECK;
 
-        // NOTE: until a call to pcre2_match_16 happens even through m_matchdata exists
+        // NOTE: until a call to pcre2_match_16 happens even through matchdata exists
         // and the ovector count is known, the pcre2_get_ovector_pointer returns a pointer
         // to invalid ovector data
-        ovector = pcre2_get_ovector_pointer_16(m_matchdata);
+        ovector = pcre2_get_ovector_pointer_16(matchdata);
 
-        done = (ovector[1] == last_offset[1]) || (ovector[0] >= ovector[1]);
+        if (m_textOnly) {
+            if ((int) last_offset > tag_start) {
+                tag_start = nextTag(text, last_offset, end, tag_end);
+            }
+            while (tag_end <= (int) ovector[0]) {
+                tag_start = nextTag(text, tag_end, end, tag_end);
+            }
+            if ((int) ovector[0] >= tag_start) {
+                last_offset = tag_end;
+                continue;
+            }
+        }
+
+        bool done = (ovector[1] == last_offset) || (ovector[0] >= ovector[1]);
 
-        last_offset[0] = (unsigned int)ovector[0];
-        last_offset[1] = (unsigned int)ovector[1];
+        last_offset = ovector[1];
 
-        if (rc >= 0 && ovector[0] != ovector[1] && ovector[0] < ovector[1]) {
-            info.append(generateMatchInfo(ovector, ovector_count));
+        if (ovector[0] < ovector[1]) {
+            if (scope == MatchScope_Last) {
+                last_ovector.assign(ovector, ovector + 2 * ovector_count);
+            } else {
+                info.append(generateMatchInfo(ovector, ovector_count));
+                if (scope == MatchScope_First) {
+                    break;
+                }
+            }
         }
-    } while (rc >= 0 && !done);
-    
-    return info;
-}
 
-SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
-{
-    SPCRE::MatchInfo match_info;
+        if (done) {
+            break;
+        }
+    }
 
-    if (m_re == NULL || text.isEmpty()) {
-        return match_info;
+    if (!last_ovector.empty()) {
+        info.append(generateMatchInfo(last_ovector.data(), ovector_count));
     }
 
-    int rc = 0;
-    // Set the size of the array based on the number of capture subpatterns
-    // if it does not exceed our maximum size.
-    int ovector_count = getCaptureSubpatternCount();
+    releaseMatchData(matchdata);
+}
 
-    if (ovector_count > PCRE_MAX_CAPTURE_GROUPS) {
-        ovector_count = PCRE_MAX_CAPTURE_GROUPS;
-    }
+// A tag is exactly what TEXT_ONLY_PREFIX skips: a < followed by anything
+// but < or > up to the next >. A < that is followed by another < before
+// any > is text.
+int SPCRE::nextTag(const QString &text, int from, int end, int &tag_end)
+{
+    const QChar *p = text.constData();
+    int i = from;
 
-    // The vector needs to be a multiple of 3 and have at least one location
-    // for the full matched string.
-    // int ovector_size = (1 + ovector_count) * 3;
-    // Allocate only the amount of memory we need for the search pattern and
-    // the number of capture patterns it contains.
-    // Can't use dynamic array alloction (int ovector[ovector_size]) because
-    // MSVC doesn't support it.
-    // int *ovector = new int[ovector_size];
-    // memset(ovector, 0, sizeof(int)*ovector_size);
-    rc = pcre2_match_16(m_re, text.utf16(), text.length(), 0, PCRE2_NOTEMPTY, m_matchdata, m_mcontext);
-    PCRE2_SIZE * ovector = pcre2_get_ovector_pointer_16(m_matchdata);
-
-    if (rc >= 0 && ovector[0] != ovector[1]) {
-        match_info = generateMatchInfo(ovector, ovector_count);
+    while (i < end) {
+        if (p[i] != '<') {
+            i++;
+            continue;
+        }
+        int j = i + 1;
+        while (j < end && p[j] != '<' && p[j] != '>') {
+            j++;
+        }
+        if (j < end && p[j] == '>') {
+            tag_end = j + 1;
+            return i;
+        }
+        // not a tag, resume at the next < (if any)
+        i = j;
     }
-
-    return match_info;
+    tag_end = end;
+    return end;
 }
 
 SPCRE::MatchInfo SPCRE::getLastMatchInfo(const QString &text)
 {
     QList<SPCRE::MatchInfo> info;
-    info = getEveryMatchInfo(text);
 
-    if (!info.isEmpty()) {
-        return info.last();
-    } else {
+    if (m_re == NULL || text.isEmpty()) {
         return SPCRE::MatchInfo();
     }
+
+    collectMatchInfo(text, 0, text.length(), MatchScope_Last, info);
+
+    if (info.isEmpty()) {
+        return SPCRE::MatchInfo();
+    }
+    return info.first();
 }
 
 bool SPCRE::replaceText(const QString &text, const QList<std::pair<int, int>> &capture_groups_offsets,
@@ -296,6 +567,19 @@ bool SPCRE::functionReplaceText(const QString &bookpath, const QString &text,
     return true;
 }
 
+bool SPCRE::functionReplaceTexts(const QString &bookpath, const QString &text,
+                                 const QList<MatchInfo> &match_info,
+                                 PyObjectPtr fsp, QStringList &out)
+{
+    out.clear();
+    if (!isValid()) return false;
+    if (match_info.isEmpty()) return true;
+    QList<int> offsets = SearchUtils::ConvertMatchInfostoUTF32Offsets(text, match_info);
+    PythonRoutines pr;
+    out = pr.GetReplacementsByFunction(fsp, bookpath, text, offsets);
+    return out.count() == match_info.count();
+}
+
 SPCRE::MatchInfo SPCRE::generateMatchInfo(PCRE2_SIZE* ovector, int capture_pattern_count)
 {
     MatchInfo match_info;
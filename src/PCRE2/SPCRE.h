@@ -31,7 +31,10 @@
 #include <utility>
 
 #include <QList>
+#include <QMutex>
 #include <QString>
+#include <QStringList>
+#include <QStringMatcher>
 
 using std::pair;
 
@@ -43,6 +46,11 @@ class PyObjectPtr;
  * Used to find matches within a string and create replacements.
  *
  * This class is a wrapper for the PCRE2 C library.
+ *
+ * The compiled pattern is never modified after construction. All mutable
+ * match state (match data, match context and JIT stack) is taken from a
+ * pool or is per thread, so one SPCRE can be used by several threads at
+ * the same time.
  */
 class SPCRE
 {
@@ -82,6 +90,17 @@ public:
      */
     bool isValid();
 
+    /**
+     * Is the pattern a plain (possibly case insensitive) string.
+     *
+     * Literal patterns, such as the escaped ones built for Normal and
+     * Case Sensitive searches, are matched with a substring search
+     * instead of PCRE.
+     *
+     * @return True if the pattern has no regex semantics.
+     */
+    bool isLiteral();
+
     /**
      * Error message if not valid or null string
      *
@@ -110,6 +129,15 @@ public:
      * pattern.
      */
     int getCaptureSubpatternCount();
+
+    /**
+     * The approximate memory held by this object: the compiled code,
+     * any JIT code and the pattern strings. Used as its cost in the
+     * PCRECache.
+     *
+     * @return The size in bytes.
+     */
+    size_t getMemoryUsage() const;
     /**
      * Convert a named capture group to its absolute numbered group equivelent.
      *
@@ -152,9 +180,75 @@ public:
                              const QList<std::pair<int, int>> &capture_groups_offsets,
                              PyObjectPtr fsp, QString &out);
 
+    /**
+     * Function replacements for every match in text in one call
+     * into python.
+     *
+     * @param[out] out The replacement for each match, in match order.
+     *
+     * @return true if every replacement was created.
+     */
+    bool functionReplaceTexts(const QString &bookpath, const QString &text,
+                              const QList<MatchInfo> &match_info,
+                              PyObjectPtr fsp, QStringList &out);
+
 private:
+    /**
+     * Which of the matches in a span of text are wanted.
+     */
+    enum MatchScope {
+        MatchScope_Every,
+        MatchScope_First,
+        MatchScope_Last
+    };
+
     MatchInfo generateMatchInfo(PCRE2_SIZE* ovector, int ovector_count);
 
+    /**
+     * Detect the Text Only prefix and set the pattern that is compiled.
+     */
+    void parseTextOnly();
+
+    /**
+     * Detect if the pattern is a literal and if so set up the substring
+     * matcher for it.
+     */
+    void parseLiteral();
+
+    /**
+     * Append the matches found in text between start and end. With Text
+     * Only matches that start inside a tag are skipped, the same as if
+     * PCRE had matched the pattern with the Text Only prefix.
+     * For MatchScope_Last only the offsets of the latest match are kept
+     * while scanning so no MatchInfo is built for the others.
+     */
+    void collectMatchInfo(const QString &text, int start, int end, MatchScope scope, QList<MatchInfo> &info);
+
+    /**
+     * The start of the first tag at or after from that ends before end,
+     * or end if there is none. tag_end is set to the offset after the tag.
+     */
+    static int nextTag(const QString &text, int from, int end, int &tag_end);
+
+    /**
+     * The start offset of the first literal match at or after from
+     * that ends before end, or -1.
+     */
+    int indexOfLiteral(const QString &text, int from, int end);
+
+    MatchInfo generateLiteralMatchInfo(int start);
+
+    /**
+     * Take a match data block sized for this pattern from the pool,
+     * creating a new one if none are free.
+     */
+    pcre2_match_data *acquireMatchData();
+
+    /**
+     * Return a match data block to the pool once the match is done.
+     */
+    void releaseMatchData(pcre2_match_data *matchdata);
+
     // Store if the pattern is valid.
     bool m_valid;
 
@@ -165,22 +259,30 @@ private:
     // The regular expression as a string.
     QString m_pattern;
 
+    // The pattern actually compiled, which is m_pattern without
+    // the Text Only prefix.
+    QString m_matchPattern;
+
+    // Only match text outside of tags.
+    bool m_textOnly;
+
     // The compiled regular expression.
     pcre2_code *m_re;
 
-    // The place to store match data results.
-    pcre2_match_data *m_matchdata;
-
     // The number of capture subpatterns with the expression.
     int m_captureSubpatternCount;
 
-    // The place to store match context info such as JIT
-    pcre2_match_context * m_mcontext;
+    // Set once the pattern is compiled.
+    size_t m_memoryUsage;
 
-#ifndef PCRE_NO_JIT
-    pcre2_jit_stack* m_jitstack;
-#endif
+    // The unescaped pattern and its matcher when the pattern is a literal.
+    bool m_isLiteral;
+    QString m_literal;
+    QStringMatcher m_literalMatcher;
 
+    // Match data blocks not currently used by a match.
+    QList<pcre2_match_data *> m_matchDataPool;
+    QMutex m_poolMutex;
 };
 
 #endif // SPCRE_H
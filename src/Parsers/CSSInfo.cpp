@@ -40,7 +40,15 @@ CSSInfo::CSSInfo(const QString &text, int offset)
     : m_source(text)
 {
     m_posoffset = offset;
-    parseStyles(text, m_posoffset);
+    parseStyles(text);
+}
+
+
+CSSInfo::CSSInfo(const QString &text, const QByteArray &utf8text)
+    : m_source(text)
+{
+    m_posoffset = 0;
+    parseStyles(text, utf8text);
 }
 
 
@@ -67,11 +75,15 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectors()
 QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterClassName)
 {
     QList<CSSInfo::CSSSelector *> selectors;
+    if (!filterClassName.isEmpty()) {
+        foreach(int i, m_ClassIndex.value(filterClassName)) {
+            selectors.append(m_CSSSelectors.at(i));
+        }
+        return selectors;
+    }
     foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
         if (!cssSelector->className.isEmpty()) {
-            if (filterClassName.isEmpty() || cssSelector->className == filterClassName) {
-                selectors.append(cssSelector);
-            }
+            selectors.append(cssSelector);
         }
     }
     return selectors;
@@ -81,33 +93,35 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterCla
 CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className)
 {
     if (!className.isEmpty()) {
-        // Find the selector(s) if any with this class name
-        QList<CSSInfo::CSSSelector *> class_selectors = getClassSelectors(className);
-
-        if (class_selectors.count() > 0) {
-            // First look for match on element and class
-            foreach(CSSInfo::CSSSelector * cssSelector, class_selectors) {
-                // Always match on wildcard class selector
-                if (cssSelector->elementName.isEmpty()) {
-                    return cssSelector;
-                }
-                if (cssSelector->elementName == elementName) {
-                    // Doublecheck that the full element.class is actually in the text
-                    // to avoid, e.g.,  div class="test" matching p.test + div
-                    if (cssSelector->text.contains(elementName % "." % className)) {
-                        return cssSelector;
-                    }
-                }
-            }
-        }
-    } else {
-        // try match on element name alone
-        foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
-            if ((cssSelector->elementName == elementName) && (cssSelector->className.isEmpty())) {
-                return cssSelector;
-            }
+        return firstForElementClass(elementName, className);
+    }
+    // try match on element name alone
+    QList<int> element_selectors = m_ElementIndex.value(elementName);
+    if (!element_selectors.isEmpty()) {
+        return m_CSSSelectors.at(element_selectors.first());
+    }
+    return NULL;
+}
+
+
+// The first selector with className that either has no element name (always
+// matches) or is for elementName, same as walking getClassSelectors(className)
+CSSInfo::CSSSelector *CSSInfo::firstForElementClass(const QString &elementName, const QString &className) const
+{
+    QList<int> wildcards = m_WildcardClassIndex.value(className);
+    int limit = wildcards.isEmpty() ? m_CSSSelectors.size() : wildcards.first();
+    const QString element_class = elementName % "." % className;
+    foreach(int i, m_ElementClassIndex.value(element_class)) {
+        if (i >= limit) break;
+        // Doublecheck that the full element.class is actually in the text
+        // to avoid, e.g.,  div class="test" matching p.test + div
+        if (m_CSSSelectors.at(i)->text.contains(element_class)) {
+            return m_CSSSelectors.at(i);
         }
     }
+    if (!wildcards.isEmpty()) {
+        return m_CSSSelectors.at(wildcards.first());
+    }
     return NULL;
 }
 
@@ -130,27 +144,23 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const Q
 {
     QList<CSSInfo::CSSSelector *> matches;
     if (!className.isEmpty()) {
-        // Find the selector(s) if any with this class name
-        QList<CSSInfo::CSSSelector *> class_selectors = getClassSelectors(className);
-
-        if (class_selectors.count() > 0) {
-            // First look for match on element and class
-            foreach(CSSInfo::CSSSelector * cssSelector, class_selectors) {
-                // Always match on wildcard class selector
-                if (cssSelector->elementName.isEmpty()) {
-                    matches.append(cssSelector);;
-                }
-                if (cssSelector->elementName == elementName) {
-                    matches.append(cssSelector);
-                }
+        // Merge the wildcard class selectors, which always match, with the
+        // element.class ones keeping their order in the stylesheet
+        QList<int> wildcards = m_WildcardClassIndex.value(className);
+        QList<int> elements = m_ElementClassIndex.value(elementName % "." % className);
+        int w = 0;
+        int e = 0;
+        while (w < wildcards.size() || e < elements.size()) {
+            if (e == elements.size() || (w < wildcards.size() && wildcards.at(w) <= elements.at(e))) {
+                matches.append(m_CSSSelectors.at(wildcards.at(w++)));
+            } else {
+                matches.append(m_CSSSelectors.at(elements.at(e++)));
             }
         }
     } else {
         // try match on element name alone
-        foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
-            if ((cssSelector->elementName == elementName) && (cssSelector->className.isEmpty())) {
-                matches.append(cssSelector);
-            }
+        foreach(int i, m_ElementIndex.value(elementName)) {
+            matches.append(m_CSSSelectors.at(i));
         }
     }
     return matches;
@@ -163,16 +173,16 @@ QStringList CSSInfo::getAllPropertyValues(QString property)
     bool inselector = false;
     bool get_value = false;
     int i = 0;
-    while(i < m_csstokens.size()) {
-        CSSParser::csstoken atoken = m_csstokens[i];
+    while(i < m_parser.get_token_count()) {
+        const CSSParser::tokenspan &atoken = m_parser.get_token(i);
         if (atoken.type == TKN_SELECTOR) inselector = true;
         if (atoken.type == TKN_SEL_BLOCK_END) inselector = false;
         if (atoken.type == TKN_PROPERTY && inselector) {
-            get_value = (atoken.data == property) || property.isEmpty();
+            get_value = (m_parser.get_token_data(i) == property) || property.isEmpty();
         }
         if (atoken.type == TKN_PROPERTY_VALUE && inselector) {
             if (get_value) {
-                property_values << atoken.data;
+                property_values << m_parser.get_token_data(i).toString();
                 get_value = false;
             }
         }
@@ -182,14 +192,18 @@ QStringList CSSInfo::getAllPropertyValues(QString property)
 }
 
 
+QStringList CSSInfo::getImports()
+{
+    return m_parser.get_imports();
+}
+
+
 QString CSSInfo::getReformattedCSSText(bool multipleLineFormat)
 {
     QString csstext(m_source);
 
-    CSSParser cp;
-    cp.parse_css(csstext);
-
-    QVector<QString> errors = cp.get_parse_errors();
+    // m_parser already holds the tokens of m_source
+    QVector<QString> errors = m_parser.get_parse_errors();
     if (!errors.isEmpty()) {
         QString error_msg = "";
         for(int i = 0; i < errors.size(); i++) {
@@ -200,7 +214,7 @@ QString CSSInfo::getReformattedCSSText(bool multipleLineFormat)
         return csstext;
     }
     
-    QString new_csstext = cp.serialize_css(false, multipleLineFormat);
+    QString new_csstext = m_parser.serialize_css(false, multipleLineFormat);
     return new_csstext;
 }
 
@@ -226,22 +240,25 @@ QString CSSInfo::removeMatchingSelectors(QList<CSSSelector *> cssSelectors)
     // Sort the selectors by pos ascending.
     std::sort(remove_selectors.begin(), remove_selectors.end(), dereferencedLessThan<CSSSelector>);
 
-    QVector<CSSParser::csstoken> new_csstokens;
+    CSSParser cp;
 
     int i = 0;
-    while(i < m_csstokens.size()) {
-        CSSParser::csstoken atoken = m_csstokens[i];
+    while(i < m_parser.get_token_count()) {
+        CSSParser::tokenspan atoken = m_parser.get_token(i);
+        QStringView data = m_parser.get_token_data(i);
+        QString groupdata;
         bool store_it = true;
-        if (atoken.type == TKN_SELECTOR && !atoken.data.startsWith('@')) {
+        if (atoken.type == TKN_SELECTOR && !data.startsWith(u'@')) {
             // we have a selector
-            QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+            QStringList sels = CSSParser::splitGroupSelector(data);
+            int pos = atoken.pos + m_posoffset;
 
             // now walk though the remove selector list looking
             // for matching selector by position (unique key) and text and if matching
             // remove this selector
             foreach(CSSSelector * css_selector, remove_selectors) {
-                if (css_selector->pos < (int) atoken.pos) continue;
-                if (css_selector->pos == (int) atoken.pos) {
+                if (css_selector->pos < pos) continue;
+                if (css_selector->pos == pos) {
                     int found = -1;
                     for (int i = 0; i < sels.size(); i++) {
                         if (css_selector->text == sels.at(i)) {
@@ -251,30 +268,29 @@ QString CSSInfo::removeMatchingSelectors(QList<CSSSelector *> cssSelectors)
                     }
                     if (found != -1) sels.removeAt(found);
                 }
-                if (css_selector->pos > (int)atoken.pos) break;
+                if (css_selector->pos > pos) break;
             }
             if (!sels.isEmpty()) {
                 // recreate this token
                 if (sels.size() == 1) {
-                    atoken.data = sels.at(0);
+                    groupdata = sels.at(0);
                 } else {
-                    atoken.data = sels.join(',');
+                    groupdata = sels.join(',');
                 }
+                data = groupdata;
             } else {
                 // skip this SEL_START all of the way to the SEL_END
                 store_it = false;
                 while(atoken.type != TKN_SEL_BLOCK_END) {
                     i++;
-                    if (i >=  m_csstokens.size()) break;
-                    atoken = m_csstokens[i];
+                    if (i >=  m_parser.get_token_count()) break;
+                    atoken = m_parser.get_token(i);
                 }
             }
         }
-        if (store_it) new_csstokens.push_back(atoken);
+        if (store_it) cp.append_csstoken(atoken, data);
         i++;
     }
-    CSSParser cp;
-    cp.set_csstokens(new_csstokens);
     QString new_text = cp.serialize_css(false);
     if (new_text.isEmpty()) new_text = "/* CSS */\n";
 
@@ -285,38 +301,22 @@ QString CSSInfo::removeMatchingSelectors(QList<CSSSelector *> cssSelectors)
 }
 
 
-void CSSInfo::parseStyles(const QString &text, int offset)
+void CSSInfo::parseStyles(const QString &text, const QByteArray &utf8text)
 {
-    CSSParser cp;
-    cp.parse_css(text);
+    // keep the parser and its tokens, token positions are relative
+    // to text and need m_posoffset added
+    if (utf8text.isEmpty()) {
+        m_parser.parse_css(text);
+    } else {
+        m_parser.parse_css(text, utf8text);
+    }
 
     // report any parser errors (should we abort?)
-    QVector<QString> errors = cp.get_parse_errors();
+    QVector<QString> errors = m_parser.get_parse_errors();
     for(int i = 0; i < errors.size(); i++) {
         qDebug() << errors[i] << "\n";
     }
 
-    // now store the sequence of parsed tokens
-    CSSParser::csstoken atoken = cp.get_next_token();
-    while(atoken.type != TKN_CSS_END)
-    {
-        CSSParser::csstoken temp;
-        temp.pos = atoken.pos + offset;
-        temp.line = atoken.line;
-        temp.col = atoken.col;
-        temp.type = atoken.type;
-        temp.data = atoken.data;
-        m_csstokens.append(temp);
-        atoken = cp.get_next_token();
-    }
-    CSSParser::csstoken temp;
-    temp.pos = 0;
-    temp.line = 0;
-    temp.col = 0;
-    temp.type = TKN_CSS_END;
-    temp.data = "";
-    m_csstokens.append(temp);  // end marker token
-
     generateSelectorsList();
 }
 
@@ -325,17 +325,18 @@ void CSSInfo::generateSelectorsList()
 {
     // now walk the sequence of previously parsed tokens
     int i = 0;
-    while(i < m_csstokens.size()) {
-        CSSParser::csstoken atoken = m_csstokens[i];
+    while(i < m_parser.get_token_count()) {
+        const CSSParser::tokenspan &atoken = m_parser.get_token(i);
+        QStringView data = m_parser.get_token_data(i);
 
-        if (atoken.type == TKN_SELECTOR && !atoken.data.startsWith('@')) {
-            QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+        if (atoken.type == TKN_SELECTOR && !data.startsWith(u'@')) {
+            QStringList sels = CSSParser::splitGroupSelector(data);
 
             foreach(QString asel, sels) {
 
                 CSSSelector *selector = new CSSSelector();
                 selector->text = asel;
-                selector->pos = atoken.pos;
+                selector->pos = atoken.pos + m_posoffset;
 
                 // if a pure class selector or pure element selector
                 bool uses_pseudoclasses = asel.contains(':');
@@ -356,4 +357,22 @@ void CSSInfo::generateSelectorsList()
         }
         i++;
     }
+    indexSelectors();
+}
+
+
+void CSSInfo::indexSelectors()
+{
+    for (int i = 0; i < m_CSSSelectors.size(); i++) {
+        const CSSSelector *selector = m_CSSSelectors.at(i);
+        if (selector->className.isEmpty()) {
+            m_ElementIndex[selector->elementName].append(i);
+            continue;
+        }
+        m_ClassIndex[selector->className].append(i);
+        if (selector->elementName.isEmpty()) {
+            m_WildcardClassIndex[selector->className].append(i);
+        }
+        m_ElementClassIndex[selector->elementName % "." % selector->className].append(i);
+    }
 }
@@ -27,6 +27,7 @@
 #define CSSINFO_H
 
 #include <QObject>
+#include <QHash>
 #include <QStringList>
 #include "Parsers/CSSParser.h"
 
@@ -40,6 +41,11 @@ public:
      */
     CSSInfo(const QString &text, int offset = 0);
 
+    /**
+     * As above but reusing an existing utf-8 encoding of text
+     */
+    CSSInfo(const QString &text, const QByteArray &utf8text);
+
     ~CSSInfo();
 
     struct CSSSelector {
@@ -82,6 +88,11 @@ public:
      */
     QStringList getAllPropertyValues(QString property);
 
+    /**
+     * Return the arguments of each @import rule in the CSS.
+     */
+    QStringList getImports();
+
     /**
      * Return the original text with a reformatted appearance either to
      * a multiple line style (each property on its own line) or single line style.
@@ -99,11 +110,22 @@ public:
     // QString replaceBlockComments(const QString &text);
 
 private:
-    void parseStyles(const QString &text, int offsetPos);
+    void parseStyles(const QString &text, const QByteArray &utf8text = QByteArray());
     void generateSelectorsList();
+    void indexSelectors();
+    CSSSelector *firstForElementClass(const QString &elementName, const QString &className) const;
 
     QList<CSSSelector *> m_CSSSelectors;
-    QVector<CSSParser::csstoken> m_csstokens;
+
+    // positions in m_CSSSelectors, in ascending order, of the selectors
+    // with a given className, with a className and no elementName,
+    // with a given elementName and className (keyed "element.class"),
+    // and with a given elementName and no className
+    QHash<QString, QList<int> > m_ClassIndex;
+    QHash<QString, QList<int> > m_WildcardClassIndex;
+    QHash<QString, QList<int> > m_ElementClassIndex;
+    QHash<QString, QList<int> > m_ElementIndex;
+    CSSParser m_parser;
 
     QString m_source;
     int m_posoffset;
@@ -7,14 +7,15 @@
 #include "Parsers/CSSDeNest.h"
 #include "Parsers/CSSParser.h"
 
-// This source buffer is provided by the m_utf8src std::string
+// This source buffer is provided by the m_utf8src QByteArray
 // which should always exist unchanged while the parser is active
 
 // Do NOT change or delete m_utf8src once set
 
 CSSParser::CSSParser()
     : m_source(""),
-      m_utf8src("")
+      m_utf8src(""),
+      m_toUtf16(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless)
 {
     reset_parser();
     
@@ -82,31 +83,56 @@ void CSSParser::parse_css(const QString &source)
     QString nsource = source;
     nsource.replace("\r\n","\n");
     nsource += "\n";
-    m_utf8src = nsource.toStdString();
+    parse_utf8(nsource.toUtf8());
+}
+
+void CSSParser::parse_css(const QString &source, const QByteArray &utf8source)
+{
+    // the lexer wants unix line endings and a final newline, only
+    // copy the utf-8 source when it does not have them already
+    if (utf8source.contains('\r')) {
+        parse_css(source);
+        return;
+    }
+    reset_parser();
+    m_source = source;
+    if (utf8source.endsWith('\n')) {
+        parse_utf8(utf8source);
+    } else {
+        parse_utf8(utf8source + '\n');
+    }
+}
+
+void CSSParser::parse_utf8(const QByteArray &utf8src)
+{
+    m_utf8src = utf8src;
     // m_utf8src = CSSDeNest::denest_css(nsource.toStdString());
-    if (m_utf8src.empty()) return;
+    if (m_utf8src.isEmpty()) return;
+
+    // the token text is roughly as long as the source
+    m_tokentext.reserve(m_utf8src.size());
 
-    parse_css_structure_with_user_context(m_utf8src.data(), m_utf8src.length(), 
+    parse_css_structure_with_user_context(m_utf8src.constData(), m_utf8src.length(), 
                                           ((void*) (this)),
                                           &CSSParser::add_csstoken,
                                           &CSSParser::add_error);
 
     // parsing complete
     // add an "end" token to complete the csstokens list
-    csstoken atok;
+    tokenspan atok;
     atok.type = TKN_CSS_END;
     atok.pos = 0;
     atok.line = 0;
     atok.col = 0;
-    atok.data = QString("EOF");
-    m_csstokens.append(atok);
+    append_csstoken(atok, u"EOF");
         
 #if 0
     // validate csstokens and error messages
-    foreach(csstoken atk, m_csstokens) {
+    for (int i = 0; i < m_csstokens.size(); i++) {
+        const tokenspan &atk = m_csstokens.at(i);
         size_t idx = (size_t) atk.type;
         QString name = m_csstoken_type_names.at(idx);
-        qDebug() << atk.line << atk.col << atk.pos << name << atk.data;
+        qDebug() << atk.line << atk.col << atk.pos << name << get_token_data(i);
     }
 #endif
 
@@ -123,17 +149,40 @@ void CSSParser::parse_css(const QString &source)
 void CSSParser::add_csstoken_to_csstokens(csstoken_type st, size_t pos,
                                               size_t line, size_t col, const char* data)
 {
-    csstoken atok;
+    QByteArrayView utf8data(data);
+    tokenspan atok;
     atok.type = st;
     atok.pos = pos;
     atok.line = line;
     atok.col = col;
-    atok.data = QString::fromUtf8(data);
+    atok.start = m_tokentext.size();
+    // decode straight onto the end of the token text, utf-16 never
+    // needs more code units than utf-8 needs bytes
+    m_tokentext.resize(atok.start + utf8data.size());
+    QChar *tkbegin = m_tokentext.data() + atok.start;
+    QChar *tkend = m_toUtf16.appendToBuffer(tkbegin, utf8data);
+    atok.length = tkend - tkbegin;
+    m_tokentext.resize(atok.start + atok.length);
     m_csstokens.append(atok);
-    if (atok.type == TKN_CHARSET_AT) m_charset = atok.data;
-    if (atok.type == TKN_IMPORT_AT) m_imports.append(atok.data);
-    if (atok.type == TKN_NAMESPACE_AT) m_namesp = atok.data;
-    if (atok.type == TKN_LAYER_AT) m_layer = atok.data;
+    if (atok.type == TKN_CHARSET_AT) m_charset = get_token_data(m_csstokens.size() - 1).toString();
+    if (atok.type == TKN_IMPORT_AT) m_imports.append(get_token_data(m_csstokens.size() - 1).toString());
+    if (atok.type == TKN_NAMESPACE_AT) m_namesp = get_token_data(m_csstokens.size() - 1).toString();
+    if (atok.type == TKN_LAYER_AT) m_layer = get_token_data(m_csstokens.size() - 1).toString();
+}
+
+void CSSParser::append_csstoken(const tokenspan &tk, QStringView data)
+{
+    tokenspan atok = tk;
+    atok.start = m_tokentext.size();
+    atok.length = data.size();
+    m_tokentext.append(data);
+    m_csstokens.append(atok);
+}
+
+QStringView CSSParser::get_token_data(int i) const
+{
+    const tokenspan &atok = m_csstokens.at(i);
+    return QStringView(m_tokentext).mid(atok.start, atok.length);
 }
 
 void CSSParser::add_error_to_errors(const char* msg)
@@ -180,6 +229,25 @@ int CSSParser::_seeknocomment(const int key, int move)
 }
 
 
+// write the non-empty comma separated parts of sel joined by sep,
+// same as implode(sep, explode(",", sel, false)) without the copies
+static void write_group_selector(QTextStream &output, QStringView sel, const QString &sep)
+{
+    bool first = true;
+    qsizetype pos = 0;
+    while (pos <= sel.size()) {
+        qsizetype comma = sel.indexOf(u',', pos);
+        if (comma == -1) comma = sel.size();
+        if (comma > pos) {
+            if (!first) output << sep;
+            output << sel.mid(pos, comma - pos);
+            first = false;
+        }
+        pos = comma + 1;
+    }
+}
+
+
 QString CSSParser::serialize_css(bool tostdout, bool multiline)
 {
     QString output_string;
@@ -202,48 +270,48 @@ QString CSSParser::serialize_css(bool tostdout, bool multiline)
         switch (m_csstokens[i].type)
         {
             case TKN_CHARSET_AT:
-                output << "@charset " << m_csstokens[i].data << csstemplate[6];
+                output << "@charset " << get_token_data(i) << csstemplate[6];
                 break;
 
             case TKN_IMPORT_AT:
                 indent = CSSUtils::indent(lvl, csstemplate[0]);
-                output << indent << "@import " << m_csstokens[i].data << csstemplate[6];
+                output << indent << "@import " << get_token_data(i) << csstemplate[6];
                 break;
 
             case TKN_NAMESPACE_AT:
-                output << "@namespace " << m_csstokens[i].data << csstemplate[6];
+                output << "@namespace " << get_token_data(i) << csstemplate[6];
                 break;
 
             case TKN_LAYER_AT:
-                output << "@layer " << m_csstokens[i].data << csstemplate[6];
+                output << "@layer " << get_token_data(i) << csstemplate[6];
                 break;
 
             case TKN_AT_RULE_BEGIN:
             case TKN_AT_RULE_UNKNOWN:
                 indent = CSSUtils::indent(lvl, csstemplate[0]);
-                output << indent << m_csstokens[i].data << csstemplate[1];
+                output << indent << get_token_data(i) << csstemplate[1];
                 break;
 
             case TKN_SELECTOR:
             case TKN_INVALID_RULE:
                 indent = CSSUtils::indent(lvl, csstemplate[0]);
-                output << indent
-                       << CSSUtils::implode("," + csstemplate[2], CSSUtils::explode(",",
-                          m_csstokens[i].data, false)) << csstemplate[3];
+                output << indent;
+                write_group_selector(output, get_token_data(i), "," + csstemplate[2]);
+                output << csstemplate[3];
                 break;
 
             case TKN_PROPERTY:
                 indent = CSSUtils::indent(lvl, csstemplate[0]);
-                output << indent << m_csstokens[i].data << ":" << csstemplate[5];
+                output << indent << get_token_data(i) << ":" << csstemplate[5];
                 break;
 
             case TKN_PROPERTY_VALUE:
                 /* allow for tail comments after property values */
                 if ((m_csstokens[i+1].type == TKN_COMMENT) && (m_csstokens[i].line == m_csstokens[i+1].line)) {
                     tail_comment = true;
-                    output << m_csstokens[i].data << ";";
+                    output << get_token_data(i) << ";";
                 } else {
-                    output << m_csstokens[i].data << csstemplate[6];
+                    output << get_token_data(i) << csstemplate[6];
                 }
                 break;
 
@@ -282,9 +350,9 @@ QString CSSParser::serialize_css(bool tostdout, bool multiline)
                     } else {
                         indent = CSSUtils::indent(lvl, csstemplate[0]);
                     }
-                    output << indent << csstemplate[11] << m_csstokens[i].data << csstemplate[12];
+                    output << indent << csstemplate[11] << get_token_data(i) << csstemplate[12];
                 } else {
-                    output << csstemplate[11] << m_csstokens[i].data;
+                    output << csstemplate[11] << get_token_data(i);
                 }
                 tail_comment = false;
                 break;
@@ -313,6 +381,7 @@ void CSSParser::reset_parser()
     m_layer = "";
     m_imports.clear();
     m_csstokens.clear();
+    m_tokentext.clear();
     m_errors.clear();
     m_utf8src = "";
 }
@@ -330,7 +399,12 @@ CSSParser::csstoken CSSParser::get_next_token(int start_ptr)
 
     if (m_token_ptr < m_csstokens.size())
     {
-        atoken = m_csstokens[m_token_ptr];
+        const tokenspan &tk = m_csstokens.at(m_token_ptr);
+        atoken.type = tk.type;
+        atoken.pos = tk.pos;
+        atoken.line = tk.line;
+        atoken.col = tk.col;
+        atoken.data = get_token_data(m_token_ptr).toString();
         m_token_ptr++;
     }
     return atoken;
@@ -351,7 +425,7 @@ QString CSSParser::get_type_name(csstoken_type t)
 // So we need to keep track of brackets and parens.
 // And we need to ignore any spurious [, ], (, ), ', or " in any quoted strings.
 // Luckily AFAIK  no nesting of [] or () allowed (yet) in the selector.
-QStringList CSSParser::splitGroupSelector(const QString& sel)
+QStringList CSSParser::splitGroupSelector(QStringView sel)
 {
     QStringList res;
     int pos = 0;
@@ -378,13 +452,13 @@ QStringList CSSParser::splitGroupSelector(const QString& sel)
         if (c == ',' && !inbracket && !inparen) 
         {
             // found split point
-            res << sel.mid(pos, i-pos).trimmed();
+            res << sel.mid(pos, i-pos).trimmed().toString();
             pos = i + 1;
         }
         else if (i == sel.length() - 1)
         {
             // we reached the end of the selector
-            res << sel.mid(pos, sel.length()-pos).trimmed();
+            res << sel.mid(pos, sel.length()-pos).trimmed().toString();
             pos = sel.length();
         }
     }
@@ -396,10 +470,16 @@ QStringList CSSParser::splitGroupSelector(const QString& sel)
 void CSSParser::set_csstokens(const QVector<csstoken> &ntokens)
 {
     m_csstokens.clear();
+    m_tokentext.clear();
     for(size_t i = 0; i < (size_t)ntokens.size(); i++)
     {
-        csstoken atemp = ntokens[i];
-        m_csstokens.push_back(atemp);
+        const csstoken &atemp = ntokens[i];
+        tokenspan atok;
+        atok.type = atemp.type;
+        atok.pos = atemp.pos;
+        atok.line = atemp.line;
+        atok.col = atemp.col;
+        append_csstoken(atok, atemp.data);
     }
 }
 
@@ -413,7 +493,7 @@ void CSSParser::set_csstokens(const QVector<csstoken> &ntokens)
 // So we need to keep track of brackets and parens.
 // And we need to ignore any spurious [, ], (, ), ', or " in any quoted strings.
 // Luckily AFAIK  no nesting of [] or () allowed (yet) in the selector.
-std::pair<int, QString> CSSParser::findNextClassInSelector(const QString &sel, int p)
+std::pair<int, QString> CSSParser::findNextClassInSelector(QStringView sel, int p)
 {
     std::pair<int, QString> res;
     res.first = -1;
@@ -5,6 +5,9 @@
 #include <string>
 
 #include <QString>
+#include <QStringView>
+#include <QByteArray>
+#include <QStringDecoder>
 #include <QList>
 #include <QVector>
 
@@ -24,6 +27,18 @@ public:
         QString data;
     };
 
+    // how the parser keeps a token, its data is the range start, length
+    // of the parser's token text so parsing allocates nothing per token
+    struct tokenspan
+    {
+        csstoken_type type;
+        size_t pos;
+        size_t line;
+        size_t col;
+        qsizetype start;
+        qsizetype length;
+    };
+
     CSSParser();
     ~CSSParser();
 
@@ -31,6 +46,10 @@ public:
 
     void parse_css(const QString &source);
 
+    // as above but reusing the utf-8 encoding of source if it has one,
+    // for example TextResource::GetUtf8Text()
+    void parse_css(const QString &source, const QByteArray &utf8source);
+
     // serialize the current list of csstokens back to css
     QString serialize_css(bool tostdout = true, bool multiline = true);
 
@@ -46,6 +65,19 @@ public:
     // last token is a dummy token with type set to CSS_END 
     csstoken get_next_token(int start_ptr = -1);
 
+    // direct access to the tokens without copying their data,
+    // last token is a dummy token with type set to CSS_END
+    int get_token_count() const { return m_csstokens.size(); };
+    const tokenspan &get_token(int i) const { return m_csstokens.at(i); };
+
+    // the data of token i, only valid until tokens are added to this parser
+    // or it is reset
+    QStringView get_token_data(int i) const;
+
+    // add a token with the type and position of tk and the given data,
+    // used to build a modified token list to serialize with serialize_css
+    void append_csstoken(const tokenspan &tk, QStringView data);
+
     // covert token type enum value to a descriptive string
     QString get_type_name(csstoken_type t);
 
@@ -71,19 +103,23 @@ public:
      // callbacks from lxbcss interface C code
     static void add_error(const char* emessage, void* context);
 
-    static QStringList splitGroupSelector(const QString &sel);
+    static QStringList splitGroupSelector(QStringView sel);
 
-    static std::pair<int, QString> findNextClassInSelector(const QString &sel, int p = 0);
+    static std::pair<int, QString> findNextClassInSelector(QStringView sel, int p = 0);
 
 
 private:
 
     int _seeknocomment(const int key, int move);
 
+    void parse_utf8(const QByteArray &utf8src);
+
     QString           m_source;
-    std::string       m_utf8src;
+    QByteArray        m_utf8src;
     QVector<QString>  m_csstoken_type_names;
-    QVector<csstoken> m_csstokens;
+    QVector<tokenspan> m_csstokens;
+    QString           m_tokentext;
+    QStringDecoder    m_toUtf16;
     QVector<QString>  m_errors;
     QVector<QString>  csstemplateM;
     QVector<QString>  csstemplate1;
@@ -59,10 +59,9 @@ QSet<QString> CSSToolbox::generate_class_set(const QString& cssdata)
         qDebug() << "  CSS Parser Error: " << errors[i] << "\n";
     }
     // now identify all class names
-    CSSParser::csstoken atoken = cp.get_next_token();
-    while(atoken.type != TKN_CSS_END) {
-        if (atoken.type == TKN_SELECTOR) {
-            QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+    for (int i = 0; i < cp.get_token_count() && cp.get_token(i).type != TKN_CSS_END; i++) {
+        if (cp.get_token(i).type == TKN_SELECTOR) {
+            QStringList sels = CSSParser::splitGroupSelector(cp.get_token_data(i));
             foreach(QString asel, sels) {
                 std::pair<int, QString> res = CSSParser::findNextClassInSelector(asel, 0);
                 while (res.first != -1) {
@@ -72,7 +71,6 @@ QSet<QString> CSSToolbox::generate_class_set(const QString& cssdata)
                 }
             }
         }
-        atoken = cp.get_next_token();
     }
     return classset;
 }
@@ -149,7 +147,7 @@ int CSSToolbox::compare_properties(const QHash<QString, QString> &tgt, const QHa
 // copy selector from css
 QString CSSToolbox::copy_selector_from_css(const QString& sel, const QString &cssdata)
 {
-    QVector<CSSParser::csstoken> csstokens;
+    CSSParser np;
     bool in_selector = false;
     bool in_group = false;
     CSSParser cp;
@@ -159,15 +157,16 @@ QString CSSToolbox::copy_selector_from_css(const QString& sel, const QString &cs
         qDebug() << "  CSS Parser Error: " << errors[i] << "\n";
     }
     // now store the sequence of parsed tokens for selector sel
-    CSSParser::csstoken atoken = cp.get_next_token();
-    while(atoken.type != TKN_CSS_END) {
+    for (int i = 0; i < cp.get_token_count() && cp.get_token(i).type != TKN_CSS_END; i++) {
+        const CSSParser::tokenspan &atoken = cp.get_token(i);
+        QStringView data = cp.get_token_data(i);
         if (atoken.type == TKN_SELECTOR) {
             // if matches entire selector or one of the selector group
-            if (atoken.data == sel) {
+            if (data == sel) {
                 in_selector = true;
                 in_group = false;
             } else {
-                QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+                QStringList sels = CSSParser::splitGroupSelector(data);
                 if (sels.contains(sel)) { 
                     in_selector = true;
                     in_group = true;
@@ -175,35 +174,25 @@ QString CSSToolbox::copy_selector_from_css(const QString& sel, const QString &cs
             }
         }
         if (in_selector) {
-            CSSParser::csstoken temp;
-            temp.pos = atoken.pos;
-            temp.line = atoken.line;
-            temp.col = atoken.col;
-            temp.type = atoken.type;
             if (in_group) {
-                temp.data = sel;
+                np.append_csstoken(atoken, sel);
             } else {
-                temp.data = atoken.data;
+                np.append_csstoken(atoken, data);
             }
-            csstokens.append(temp);        
         }
         if (atoken.type == TKN_SEL_BLOCK_END) {
-            if (atoken.data == sel || CSSParser::splitGroupSelector(atoken.data).contains(sel)) {
+            if (data == sel || CSSParser::splitGroupSelector(data).contains(sel)) {
                 in_selector = false;
                 in_group = false;
             }
         }
-        atoken = cp.get_next_token();
     }
-    CSSParser::csstoken temp;
+    CSSParser::tokenspan temp;
     temp.pos = 0;
     temp.line = 0;
     temp.col = 0;
     temp.type = TKN_CSS_END;
-    temp.data = "";
-    csstokens.append(temp);
-    CSSParser np;
-    np.set_csstokens(csstokens);
+    np.append_csstoken(temp, QStringView());
     QString ncssdata = np.serialize_css(false);
     return ncssdata;
 }
@@ -212,7 +201,7 @@ QString CSSToolbox::copy_selector_from_css(const QString& sel, const QString &cs
 // remove properties from css
 QString CSSToolbox::remove_properties_from_css(const QStringList& proplist, const QString &cssdata)
 {
-    QVector<CSSParser::csstoken> csstokens;
+    CSSParser np;
     bool in_selector = false;
     bool remove_property = false;
     CSSParser cp;
@@ -223,37 +212,28 @@ QString CSSToolbox::remove_properties_from_css(const QStringList& proplist, cons
     }
    
     // store the sequence of parsed tokens but skip the selector in question
-    CSSParser::csstoken atoken = cp.get_next_token();
-    while(atoken.type != TKN_CSS_END) {
+    for (int i = 0; i < cp.get_token_count() && cp.get_token(i).type != TKN_CSS_END; i++) {
+        const CSSParser::tokenspan &atoken = cp.get_token(i);
+        QStringView data = cp.get_token_data(i);
         if (atoken.type == TKN_SELECTOR) in_selector = true;
         if (atoken.type == TKN_SEL_BLOCK_END) in_selector = false;
         if (in_selector && atoken.type == TKN_PROPERTY) {
-            if (proplist.contains(atoken.data)) remove_property = true;
+            if (proplist.contains(data)) remove_property = true;
         }
         if (!remove_property) {
-            CSSParser::csstoken temp;
-            temp.pos = atoken.pos;
-            temp.line = atoken.line;
-            temp.col = atoken.col;
-            temp.type = atoken.type;
-            temp.data = atoken.data;
-            csstokens.append(temp);        
+            np.append_csstoken(atoken, data);
         }
         if (remove_property && atoken.type == TKN_PROPERTY_VALUE) {
             remove_property = false;
         }
-        atoken = cp.get_next_token();
     }
-    CSSParser::csstoken temp;
+    // now recreate the new cssdata
+    CSSParser::tokenspan temp;
     temp.pos = 0;
     temp.line = 0;
     temp.col = 0;
     temp.type = TKN_CSS_END;
-    temp.data = "";
-    csstokens.append(temp);
-    // now recreate the new cssdata
-    CSSParser np;
-    np.set_csstokens(csstokens);
+    np.append_csstoken(temp, QStringView());
     QString ncssdata = np.serialize_css(false);
     return ncssdata;
 }
@@ -262,7 +242,7 @@ QString CSSToolbox::remove_properties_from_css(const QStringList& proplist, cons
 // erase selector from css
 QString CSSToolbox::erase_selector_from_css(const QString& sel, const QString &cssdata)
 {
-    QVector<CSSParser::csstoken> csstokens;
+    CSSParser np;
     bool in_selector = false;
     bool in_group = false;
     CSSParser cp;
@@ -273,58 +253,53 @@ QString CSSToolbox::erase_selector_from_css(const QString& sel, const QString &c
     }
     // store the sequence of parsed tokens but skip the selector in question
     // if it is not part of a group
-    CSSParser::csstoken atoken = cp.get_next_token();
-    while(atoken.type != TKN_CSS_END) {
-        if (atoken.type == TKN_SELECTOR && !atoken.data.startsWith('@')) {
-            if (atoken.data == sel) {
+    for (int i = 0; i < cp.get_token_count() && cp.get_token(i).type != TKN_CSS_END; i++) {
+        const CSSParser::tokenspan &atoken = cp.get_token(i);
+        QStringView data = cp.get_token_data(i);
+        QString groupdata;
+        bool at_rule = data.startsWith(u'@');
+        if (atoken.type == TKN_SELECTOR && !at_rule) {
+            if (data == sel) {
                 in_selector = true;
             } else {
-                QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+                QStringList sels = CSSParser::splitGroupSelector(data);
                 if (sels.contains(sel)) {
                     sels.removeOne(sel);
                     if (sels.isEmpty()) {
                         in_selector = true;
                     } else {
-                        atoken.data = sels.join(",");
+                        groupdata = sels.join(",");
+                        data = groupdata;
                         in_group = true;
                     }
                 }
             }
         }
         
-        // update atoken.data for changed selectors of a group if needed
-        if (atoken.type == TKN_SEL_BLOCK_END && !atoken.data.startsWith('@')) {
+        // update data for changed selectors of a group if needed
+        if (atoken.type == TKN_SEL_BLOCK_END && !at_rule) {
             if (in_group) {
-                QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+                QStringList sels = CSSParser::splitGroupSelector(data);
                 sels.removeOne(sel);
-                atoken.data = sels.join(",");
+                groupdata = sels.join(",");
+                data = groupdata;
             }
         }
         if (!in_selector) {
-            CSSParser::csstoken temp;
-            temp.pos = atoken.pos;
-            temp.line = atoken.line;
-            temp.col = atoken.col;
-            temp.type = atoken.type;
-            temp.data = atoken.data;
-            csstokens.append(temp);        
+            np.append_csstoken(atoken, data);
         }
-        if (atoken.type == TKN_SEL_BLOCK_END && !atoken.data.startsWith('@')) {
+        if (atoken.type == TKN_SEL_BLOCK_END && !at_rule) {
             in_selector = false;
             in_group = false;
         }
-        atoken = cp.get_next_token();
     }
-    CSSParser::csstoken temp;
+    // now recreate the new cssdata
+    CSSParser::tokenspan temp;
     temp.pos = 0;
     temp.line = 0;
     temp.col = 0;
     temp.type = TKN_CSS_END;
-    temp.data = "";
-    csstokens.append(temp);
-    // now recreate the new cssdata
-    CSSParser np;
-    np.set_csstokens(csstokens);
+    np.append_csstoken(temp, QStringView());
     QString ncssdata = np.serialize_css(false);
     return ncssdata;
 }
@@ -333,7 +308,7 @@ QString CSSToolbox::erase_selector_from_css(const QString& sel, const QString &c
 // replace all occurences of oldclass in selectors with newclass in cssdata
 QString CSSToolbox::rename_class_in_css(const QString &oldclass, const QString &newclass, const QString &cssdata)
 {
-    QVector<CSSParser::csstoken> csstokens;
+    CSSParser np;
     CSSParser cp;
     cp.parse_css(cssdata);
     QVector<QString> errors = cp.get_parse_errors();
@@ -341,10 +316,10 @@ QString CSSToolbox::rename_class_in_css(const QString &oldclass, const QString &
         qDebug() << "  CSS Parser Error: " << errors[i] << "\n";
     }
     // now store the sequence of parsed tokens after making any modifications
-    CSSParser::csstoken atoken = cp.get_next_token();
-    while(atoken.type != TKN_CSS_END) {
+    for (int i = 0; i < cp.get_token_count() && cp.get_token(i).type != TKN_CSS_END; i++) {
+        const CSSParser::tokenspan &atoken = cp.get_token(i);
         if (atoken.type == TKN_SELECTOR) {
-            QStringList sels = CSSParser::splitGroupSelector(atoken.data);
+            QStringList sels = CSSParser::splitGroupSelector(cp.get_token_data(i));
             QStringList nsels;
             foreach(QString asel, sels) {
                 std::pair<int, QString> res = CSSParser::findNextClassInSelector(asel);
@@ -361,27 +336,18 @@ QString CSSToolbox::rename_class_in_css(const QString &oldclass, const QString &
                 }
                 nsels << asel;
             }
-            atoken.data = nsels.join(",");
+            np.append_csstoken(atoken, nsels.join(","));
+        } else {
+            np.append_csstoken(atoken, cp.get_token_data(i));
         }
-        CSSParser::csstoken temp;
-        temp.pos = atoken.pos;
-        temp.line = atoken.line;
-        temp.col = atoken.col;
-        temp.type = atoken.type;
-        temp.data = atoken.data;
-        csstokens.append(temp);        
-        atoken = cp.get_next_token();
     }
-    CSSParser::csstoken temp;
+    // now recreate the new cssdata
+    CSSParser::tokenspan temp;
     temp.pos = 0;
     temp.line = 0;
     temp.col = 0;
     temp.type = TKN_CSS_END;
-    temp.data = "";
-    csstokens.append(temp);
-    // now recreate the new cssdata
-    CSSParser np;
-    np.set_csstokens(csstokens);
+    np.append_csstoken(temp, QStringView());
     QString ncssdata = np.serialize_css(false);
     return ncssdata;
 }
@@ -471,7 +437,7 @@ std::pair<QString, QString> CSSToolbox::extract_style_tags(const QString &textda
         if (in_style_tag) {
             // no nesting of html tags allowed inside style tags
             // but do we need to handle cdata here? It should be within a css comment string
-            if (!mi.text.isEmpty()) stylesheet << mi.text;
+            if (!mi.text.isEmpty()) stylesheet << mi.text.toString();
         } else {
             ndata << qp.serialize_markup(mi);
         }
@@ -0,0 +1,312 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#include "gumbo.h"
+#include "Parsers/GumboArena.h"
+
+namespace
+{
+    // Keeps the memory after the header aligned like malloc's
+    struct alignas(alignof(max_align_t)) BlockHeader {
+        GumboArena *arena;
+        // what was asked for in malloc'd blocks, the size class in arena blocks
+        size_t size;
+    };
+
+    const size_t HEADER_SIZE = sizeof(BlockHeader);
+
+    const size_t ALIGNMENT = alignof(max_align_t);
+
+    // Large enough for most chapters to need only a few chunks
+    const size_t STANDARD_CHUNK_SIZE = 64 * 1024;
+
+    // Free standard chunks kept per thread for the next parse
+    const size_t MAX_SPARE_CHUNKS = 16;
+
+    // Blocks up to this size are rounded to a size class and reused once
+    // freed. Larger ones are rare and only rounded to the alignment.
+    const size_t MAX_CLASS_SIZE = 1024 * 1024;
+
+    // Multiples of 16 up to 128, then four classes per power of two
+    const int NUM_SIZE_CLASSES = 8 + 4 * 13;
+
+    thread_local GumboArena *t_current = NULL;
+
+    std::atomic<size_t> s_malloc_blocks(0);
+
+    struct SpareChunks {
+        std::vector<char *> chunks;
+        ~SpareChunks() {
+            for (char *chunk : chunks) {
+                free(chunk);
+            }
+        }
+    };
+
+    thread_local SpareChunks t_spares;
+
+    inline BlockHeader *HeaderOf(void *ptr)
+    {
+        return reinterpret_cast<BlockHeader *>(static_cast<char *>(ptr) - HEADER_SIZE);
+    }
+
+    inline size_t AlignUp(size_t size)
+    {
+        return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    // Rounds size up to its size class and returns the class,
+    // or -1 if the size is too large to have one
+    int SizeClass(size_t size, size_t &class_size)
+    {
+        if (size > MAX_CLASS_SIZE) {
+            class_size = AlignUp(size);
+            return -1;
+        }
+        if (size <= 128) {
+            class_size = std::max(size_t(16), (size + 15) & ~size_t(15));
+            return int(class_size / 16) - 1;
+        }
+        // 2^power < size <= 2^(power + 1)
+        int power = 7;
+        while ((size_t(1) << (power + 1)) < size) {
+            power++;
+        }
+        size_t step = size_t(1) << (power - 2);
+        class_size = (size + step - 1) & ~(step - 1);
+        return 8 + (power - 7) * 4 + int(class_size / step) - 5;
+    }
+
+    void *MallocBlock(size_t size)
+    {
+        BlockHeader *header = static_cast<BlockHeader *>(malloc(HEADER_SIZE + size));
+        if (!header) {
+            return NULL;
+        }
+        header->arena = NULL;
+        header->size = size;
+        s_malloc_blocks++;
+        return reinterpret_cast<char *>(header) + HEADER_SIZE;
+    }
+}
+
+
+GumboArena::GumboArena()
+    : m_pos(NULL),
+      m_end(NULL),
+      m_last(NULL),
+      m_free(NUM_SIZE_CLASSES, NULL)
+{
+}
+
+
+GumboArena::~GumboArena()
+{
+    for (const Chunk &chunk : m_chunks) {
+        if (chunk.standard && t_spares.chunks.size() < MAX_SPARE_CHUNKS) {
+            t_spares.chunks.push_back(chunk.data);
+        } else {
+            free(chunk.data);
+        }
+    }
+}
+
+
+GumboArena::Scope::Scope(GumboArena *arena)
+    : m_previous(t_current)
+{
+    t_current = arena;
+}
+
+
+GumboArena::Scope::~Scope()
+{
+    t_current = m_previous;
+}
+
+
+void GumboArena::Install()
+{
+    gumbo_memory_set_allocator(&GumboArena::Realloc);
+    gumbo_memory_set_free(&GumboArena::Free);
+}
+
+
+size_t GumboArena::GetAllocatedSize() const
+{
+    size_t size = 0;
+    for (const Chunk &chunk : m_chunks) {
+        size += chunk.size;
+    }
+    return size;
+}
+
+
+bool GumboArena::HasMallocBlocks()
+{
+    return s_malloc_blocks.load() != 0;
+}
+
+
+void *GumboArena::Realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return t_current ? t_current->Allocate(size) : MallocBlock(size);
+    }
+
+    BlockHeader *header = HeaderOf(ptr);
+    GumboArena *arena = header->arena;
+
+    if (arena == NULL) {
+        BlockHeader *grown = static_cast<BlockHeader *>(realloc(header, HEADER_SIZE + size));
+        if (!grown) {
+            return NULL;
+        }
+        grown->size = size;
+        return reinterpret_cast<char *>(grown) + HEADER_SIZE;
+    }
+
+    if (size <= header->size) {
+        return ptr;
+    }
+
+    // Only the arena that is current on this thread may be used, a block
+    // from any other arena is moved to malloc'd memory
+    void *moved;
+    if (arena == t_current) {
+        if (arena->Grow(ptr, size)) {
+            return ptr;
+        }
+        moved = arena->Allocate(size);
+    } else {
+        moved = MallocBlock(size);
+    }
+    if (moved) {
+        memcpy(moved, ptr, header->size);
+        arena->Release(ptr);
+    }
+    return moved;
+}
+
+
+void GumboArena::Free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    BlockHeader *header = HeaderOf(ptr);
+    if (header->arena == NULL) {
+        free(header);
+        s_malloc_blocks--;
+    } else {
+        header->arena->Release(ptr);
+    }
+}
+
+
+void *GumboArena::Allocate(size_t size)
+{
+    size_t class_size;
+    int size_class = SizeClass(size, class_size);
+    if (size_class >= 0 && m_free[size_class] != NULL) {
+        void *block = m_free[size_class];
+        m_free[size_class] = *static_cast<void **>(block);
+        return block;
+    }
+
+    size_t needed = HEADER_SIZE + class_size;
+    if (m_pos == NULL || size_t(m_end - m_pos) < needed) {
+        NewChunk(needed);
+        if (m_pos == NULL) {
+            return NULL;
+        }
+    }
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(m_pos);
+    header->arena = this;
+    header->size = class_size;
+    m_pos += needed;
+    m_last = reinterpret_cast<char *>(header) + HEADER_SIZE;
+    return m_last;
+}
+
+
+void GumboArena::Release(void *ptr)
+{
+    BlockHeader *header = HeaderOf(ptr);
+    size_t class_size;
+    int size_class = SizeClass(header->size, class_size);
+    if (ptr == m_last) {
+        // give the latest block back to the chunk instead
+        m_pos = static_cast<char *>(ptr) - HEADER_SIZE;
+        m_last = NULL;
+        return;
+    }
+    if (size_class < 0) {
+        return;
+    }
+    *static_cast<void **>(ptr) = m_free[size_class];
+    m_free[size_class] = ptr;
+}
+
+
+bool GumboArena::Grow(void *ptr, size_t size)
+{
+    if (ptr != m_last) {
+        return false;
+    }
+    BlockHeader *header = HeaderOf(ptr);
+    size_t class_size;
+    SizeClass(size, class_size);
+    char *block = static_cast<char *>(ptr);
+    if (size_t(m_end - block) < class_size) {
+        return false;
+    }
+    m_pos = block + class_size;
+    header->size = class_size;
+    return true;
+}
+
+
+void GumboArena::NewChunk(size_t min_size)
+{
+    Chunk chunk;
+    chunk.standard = min_size <= STANDARD_CHUNK_SIZE;
+    chunk.size = std::max(min_size, STANDARD_CHUNK_SIZE);
+    if (chunk.standard && !t_spares.chunks.empty()) {
+        chunk.data = t_spares.chunks.back();
+        t_spares.chunks.pop_back();
+    } else {
+        chunk.data = static_cast<char *>(malloc(chunk.size));
+    }
+    if (!chunk.data) {
+        m_pos = m_end = NULL;
+        return;
+    }
+    m_chunks.push_back(chunk);
+    m_pos = chunk.data;
+    m_end = chunk.data + chunk.size;
+    m_last = NULL;
+}
@@ -0,0 +1,116 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef GUMBOARENA_H
+#define GUMBOARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * A bump allocator for the memory of one gumbo parse.
+ *
+ * While a GumboArena::Scope is alive every gumbo allocation on that thread
+ * is carved out of the arena. Block sizes are rounded up to size classes
+ * and freed blocks, including the old block of every realloc that had to
+ * move, go on a free list per class that later allocations take from
+ * first. The whole arena is given back in one step when it is destroyed.
+ *
+ * Every block, from an arena or not, starts with a small header naming its
+ * arena so memory allocated later (for example by gumbo_edit when the tree
+ * is changed after the parse) is still malloc'd and freed normally. An
+ * arena must outlive the gumbo tree that was parsed into it.
+ *
+ * Install() must be called once at start up before anything is parsed.
+ */
+class GumboArena
+{
+public:
+    GumboArena();
+    ~GumboArena();
+
+    GumboArena(const GumboArena&) = delete;
+    GumboArena& operator=(const GumboArena&) = delete;
+
+    /**
+     * Makes the arena the one gumbo allocates from on this thread.
+     */
+    class Scope
+    {
+    public:
+        Scope(GumboArena *arena);
+        ~Scope();
+
+    private:
+        GumboArena *m_previous;
+    };
+
+    /**
+     * Routes all gumbo allocations through the arena aware allocator.
+     */
+    static void Install();
+
+    /**
+     * The memory held by the arena's chunks.
+     */
+    size_t GetAllocatedSize() const;
+
+    /**
+     * True while any gumbo block allocated outside of an arena is alive.
+     * Only then can a parsed tree hold memory that is not in its arena,
+     * so only then does it have to be walked to be freed.
+     */
+    static bool HasMallocBlocks();
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+        // chunks of the standard size are reused by later arenas
+        bool standard;
+    };
+
+    static void *Realloc(void *ptr, size_t size);
+    static void Free(void *ptr);
+
+    void *Allocate(size_t size);
+
+    // Puts a block of this arena on its free list
+    void Release(void *ptr);
+
+    // Grows the latest block in place if there is room after it
+    bool Grow(void *ptr, size_t size);
+
+    void NewChunk(size_t min_size);
+
+    std::vector<Chunk> m_chunks;
+    char *m_pos;
+    char *m_end;
+
+    // The latest block, the only one that can grow in place
+    void *m_last;
+
+    // Freed blocks per size class, linked through their first bytes
+    std::vector<void *> m_free;
+};
+
+#endif // GUMBOARENA_H
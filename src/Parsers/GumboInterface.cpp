@@ -19,6 +19,8 @@
 **
 *************************************************************************/
 
+#include <string.h>
+
 #include <QString>
 #include <QStringList>
 #include <QRegularExpression>
@@ -110,12 +112,37 @@ QHash<QString,QString> EmptyHash = QHash<QString,QString>();
 
 // These need to match the GumboAttributeNamespaceEnum sequence
 static const char * attribute_nsprefixes[4] = { "", "xlink:", "xml:", "xmlns:" };
+
+// Entities to substitute indexed by byte, NULL for bytes copied as is
+struct EntityTable
+{
+    const char * entity[256];
+
+    explicit EntityTable(char quote)
+    {
+        for (int i = 0; i < 256; ++i) entity[i] = NULL;
+        entity[static_cast<unsigned char>('&')] = "&amp;";
+        entity[static_cast<unsigned char>('<')] = "&lt;";
+        entity[static_cast<unsigned char>('>')] = "&gt;";
+        if (quote == '"') entity[static_cast<unsigned char>('"')] = "&quot;";
+        if (quote == '\'') entity[static_cast<unsigned char>('\'')] = "&apos;";
+    }
+};
+
+static const EntityTable TEXT_ENTITIES('\0');
+static const EntityTable DQUOTE_ATTRIBUTE_ENTITIES('"');
+static const EntityTable SQUOTE_ATTRIBUTE_ENTITIES('\'');
+
+static inline bool is_whitespace(char c)
+{
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == '\v') || (c == '\f');
+}
  
 // Note: m_output contains the gumbo output tree which 
 // has data structures with pointers into the original source
 // buffer passed in!!!!!!
 
-// This source buffer is provided by the m_utf8src std::string
+// This source buffer is provided by the m_utf8src QByteArray
 // which should always exist unchanged alongside the output tree
 
 // Do NOT change or delete m_utf8src once set until after you 
@@ -124,7 +151,8 @@ static const char * attribute_nsprefixes[4] = { "", "xlink:", "xml:", "xmlns:" }
 GumboInterface::GumboInterface(const QString &source, const QString &version)
     : m_source(source),
       m_output(NULL),
-      m_utf8src(""),
+      m_utf8start(0),
+      m_utf16_header_length(0),
       m_sourceupdates(EmptyHash),
       m_newcsslinks(""),
       m_currentbkpath(""),
@@ -139,7 +167,8 @@ GumboInterface::GumboInterface(const QString &source, const QString &version)
 GumboInterface::GumboInterface(const QString &source, const QString &version, const QHash<QString,QString> & source_updates)
     : m_source(source),
       m_output(NULL),
-      m_utf8src(""),
+      m_utf8start(0),
+      m_utf16_header_length(0),
       m_sourceupdates(source_updates),
       m_newcsslinks(""),
       m_currentbkpath(""),
@@ -151,12 +180,33 @@ GumboInterface::GumboInterface(const QString &source, const QString &version, co
 }
 
 
+GumboInterface::GumboInterface(const QString &source, const QByteArray &utf8source, const QString &version)
+    : m_source(source),
+      m_output(NULL),
+      m_utf8src(utf8source),
+      m_utf8start(0),
+      m_utf16_header_length(0),
+      m_sourceupdates(EmptyHash),
+      m_newcsslinks(""),
+      m_currentbkpath(""),
+      m_currentdir(""),
+      m_newbody(""),
+      m_version(version),
+      m_newbookpath("")
+{
+}
+
+
 GumboInterface::~GumboInterface()
 {
+    // The parse's own blocks go when m_arena does. The tree only has to be
+    // walked if gumbo_edit may have added malloc'd blocks to it after the parse.
     if (m_output != NULL) {
-        gumbo_destroy_output(m_output);
+        if (GumboArena::HasMallocBlocks()) {
+            gumbo_destroy_output(m_output);
+        }
         m_output = NULL;
-        m_utf8src = "";
+        m_utf8src.clear();
     }
 }
 
@@ -165,12 +215,12 @@ void GumboInterface::parse()
 {
     if (!m_source.isEmpty() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        // remove any xml header line and any trailing whitespace
-        if (m_utf8src.compare(0,5,"<?xml") == 0) {
-            size_t end = m_utf8src.find_first_of('>', 5);
-            end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
-            m_utf8src.erase(0,end);
+        load_utf8src();
+        // skip any xml header line and any trailing whitespace, without
+        // copying the source since m_utf8src may be shared with the resource
+        if (m_utf8src.startsWith("<?xml")) {
+            m_utf8start = xml_header_end(m_utf8src, 5);
+            m_utf16_header_length = QString::fromUtf8(m_utf8src.constData(), m_utf8start).length();
         }
 
         // In case we ever have to revert to earlier versions, please note the following
@@ -187,7 +237,8 @@ void GumboInterface::parse()
         myoptions.max_errors = 50;
 
         // GumboInterface::m_mutex.lock();
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        GumboArena::Scope arena_scope(&m_arena);
+        m_output = gumbo_parse_with_options(&myoptions, parsed_data(), parsed_length());
         // GumboInterface::m_mutex.unlock();
     }
 }
@@ -210,10 +261,11 @@ void GumboInterface::parse_fragment()
         myoptions.max_tree_depth = 400;
         myoptions.max_errors = 50;
 
-        m_utf8src = m_source.toStdString();
-        m_output = gumbo_parse_fragment(&myoptions, m_utf8src.data(), m_utf8src.length(),
+        load_utf8src();
+        GumboArena::Scope arena_scope(&m_arena);
+        m_output = gumbo_parse_fragment(&myoptions, parsed_data(), parsed_length(),
                                         GUMBO_TAG_BODY, GUMBO_NAMESPACE_HTML);
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        m_output = gumbo_parse_with_options(&myoptions, parsed_data(), parsed_length());
     }
 }
 
@@ -414,6 +466,10 @@ GumboNode * GumboInterface::get_root_node() {
             parse();
         }
     }
+    if (m_output == NULL) {
+        // nothing was parsed from an empty source
+        return NULL;
+    }
     return m_output->root;
 }
 
@@ -642,26 +698,29 @@ QList<GumboWellFormedError> GumboInterface::error_check()
 
     if (!m_source.isEmpty() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        // remove any xml header line and trailing whitespace
-        if (m_utf8src.compare(0,5,"<?xml") == 0) {
-            size_t end = m_utf8src.find_first_of('>', 0);
-            end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
-            m_utf8src.erase(0,end);
+        load_utf8src();
+        // skip any xml header line and trailing whitespace
+        if (m_utf8src.startsWith("<?xml")) {
+            m_utf8start = xml_header_end(m_utf8src, 0);
             line_offset++;
         }
         // add in epub version specific doctype if missing
-        if ((m_utf8src.compare(0,9,"<!DOCTYPE") != 0) && (m_utf8src.compare(0,9,"<!doctype") != 0)) {
+        QByteArray start = m_utf8src.mid(m_utf8start, 9);
+        if ((start != "<!DOCTYPE") && (start != "<!doctype")) {
+            QByteArray doctype;
             if (m_version.startsWith('3')) {
-                m_utf8src.insert(0,"<!DOCTYPE html>\n");
+                doctype = "<!DOCTYPE html>\n";
             } else {
-                m_utf8src.insert(0, "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n");
+                doctype = "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n";
             }
+            m_utf8src = doctype + m_utf8src.mid(m_utf8start);
+            m_utf8start = 0;
             line_offset--;
         }
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        GumboArena::Scope arena_scope(&m_arena);
+        m_output = gumbo_parse_with_options(&myoptions, parsed_data(), parsed_length());
     }
-    // qDebug() << QString::fromStdString(m_utf8src);
+    // qDebug() << QString::fromUtf8(parsed_data(), parsed_length());
     const GumboVector* errors  = &m_output->errors;
     for (unsigned int i=0; i< errors->length; ++i) {
         GumboError* er = static_cast<GumboError*>(errors->data[i]);
@@ -700,8 +759,9 @@ QList<GumboWellFormedError> GumboInterface::fragment_error_check()
     myoptions.max_errors = -1;
 
     if (!m_source.isEmpty() && (m_output == NULL)) {
-        m_utf8src = m_source.toStdString();
-        m_output = gumbo_parse_fragment(&myoptions, m_utf8src.data(), m_utf8src.length(),
+        load_utf8src();
+        GumboArena::Scope arena_scope(&m_arena);
+        m_output = gumbo_parse_fragment(&myoptions, parsed_data(), parsed_length(),
                                         GUMBO_TAG_BODY, GUMBO_NAMESPACE_HTML);
     }
     const GumboVector* errors  = &m_output->errors;
@@ -759,6 +819,13 @@ QList<GumboNode*> GumboInterface::get_element_nodes_with_prefix(GumboNode * node
 }
 
 
+size_t GumboInterface::memory_usage()
+{
+    // blocks gumbo_edit adds later are not in the arena and not counted
+    return m_source.capacity() * sizeof(QChar) + m_utf8src.capacity() + m_arena.GetAllocatedSize();
+}
+
+
 QList<GumboNode*> GumboInterface::get_all_nodes_with_attribute(const QString& attname)
 {
     QList<GumboNode*> nodes;
@@ -917,52 +984,98 @@ bool GumboInterface::in_set(std::unordered_set<std::string> &s, std::string &key
 }
 
 
-void GumboInterface::rtrim(std::string &s) 
+void GumboInterface::load_utf8src()
 {
-    s.erase(s.find_last_not_of(" \n\r\t\v\f")+1);
+    if (m_utf8src.isNull()) {
+        m_utf8src = m_source.toUtf8();
+    }
+    m_utf8start = 0;
 }
 
 
-void GumboInterface::ltrim(std::string &s)
+const char * GumboInterface::parsed_data() const
 {
-    s.erase(0,s.find_first_not_of(" \n\r\t\v\f"));
+    return m_utf8src.constData() + m_utf8start;
 }
 
 
-void GumboInterface::ltrimnewlines(std::string &s)
+size_t GumboInterface::parsed_length() const
 {
-    s.erase(0,s.find_first_not_of("\n\r"));
+    return m_utf8src.size() - m_utf8start;
 }
 
 
-// delete everything up to and including the newline
-void GumboInterface::newlinetrim(std::string &s)
+int GumboInterface::xml_header_end(const QByteArray &source, int from)
 {
-  size_t pos = s.find("\n");
-  if (pos != std::string::npos) {
-    s.erase(0, pos+1);
-  }
+    int end = source.indexOf('>', from) + 1;
+    while ((end < source.size()) && memchr("\n\r\t\v\f ", source.at(end), 6)) {
+        end++;
+    }
+    return end;
+}
+
+
+int GumboInterface::get_utf16_position(size_t utf8_offset)
+{
+    if (m_output == NULL) {
+        return 0;
+    }
+    // built on first use, shared documents may be asked from several threads
+    std::call_once(m_offsetmap_built, [this]() {
+        m_offsetmap.Build(parsed_data(), parsed_length());
+    });
+    return m_utf16_header_length + m_offsetmap.ToUtf16(utf8_offset);
+}
+
+
+// the trimming routines below only touch s from start on so they
+// can work on the tail of an output buffer in place
+
+void GumboInterface::rtrim(std::string &s, size_t start)
+{
+    size_t pos = s.find_last_not_of(" \n\r\t\v\f");
+    if ((pos == std::string::npos) || (pos < start)) {
+        s.resize(start);
+    } else {
+        s.resize(pos + 1);
+    }
+}
+
+
+void GumboInterface::ltrim(std::string &s, size_t start)
+{
+    s.erase(start, s.find_first_not_of(" \n\r\t\v\f", start) - start);
+}
+
+
+void GumboInterface::ltrimnewlines(std::string &s, size_t start)
+{
+    s.erase(start, s.find_first_not_of("\n\r", start) - start);
 }
 
 
-void GumboInterface::condense_whitespace(std::string &s)
+void GumboInterface::condense_whitespace(std::string &s, size_t start)
 {
     size_t n = s.length();
-    std::string val;
-    val.reserve(n);
-    std::string wspace = " \n\r\t\v\f";
+    size_t w = start;
     char last_c = 'x';
-    for (size_t i=0; i < n; i++) {
-        char c = s.at(i);
-        if (wspace.find(c) != std::string::npos) {
+    for (size_t i = start; i < n; i++) {
+        char c = s[i];
+        if (is_whitespace(c)) {
             c = ' ';
         }
         if ((c != ' ') || (last_c != ' ')) {
-            val.push_back(c);
+            s[w++] = c;
         }
         last_c = c;
     }
-    s = val;
+    s.resize(w);
+}
+
+
+bool GumboInterface::is_blank(const std::string &s, size_t start)
+{
+    return s.find_first_not_of(" \n\r\t\v\f", start) == std::string::npos;
 }
 
 
@@ -1075,26 +1188,20 @@ std::string GumboInterface::update_style_urls(const std::string &source)
 
 
 
-std::string GumboInterface::substitute_xml_entities_into_text(const std::string &text)
+void GumboInterface::append_escaped(std::string &out, const char *text, const char * const *entities)
 {
-    std::string result = text;
-    // replacing & must come first 
-    replace_all(result, "&", "&amp;");
-    replace_all(result, "<", "&lt;");
-    replace_all(result, ">", "&gt;");
-    return result;
-}
-
-
-std::string GumboInterface::substitute_xml_entities_into_attributes(char quote, const std::string &text)
-{
-    std::string result = substitute_xml_entities_into_text(text);
-    if (quote == '"') {
-        replace_all(result,"\"","&quot;");
-    } else if (quote == '\'') {
-        replace_all(result,"'","&apos;");
+    // copy the runs between characters needing an entity in one go
+    const char *run = text;
+    const char *p = text;
+    for (; *p; ++p) {
+        const char *entity = entities[static_cast<unsigned char>(*p)];
+        if (entity) {
+            out.append(run, p - run);
+            out.append(entity);
+            run = p + 1;
+        }
     }
-    return result;
+    out.append(run, p - run);
 }
 
 
@@ -1183,60 +1290,109 @@ std::string GumboInterface::get_attribute_name(GumboAttribute * at)
 }
 
 
-std::string GumboInterface::build_attributes(GumboAttribute * at, bool no_entities, 
-                                             bool run_src_updates, bool run_style_updates)
+void GumboInterface::append_attribute(std::string &out, GumboAttribute * at, bool no_entities,
+                                      bool run_src_updates, bool run_style_updates)
 {
-    std::string atts = " ";
-    std::string name = get_attribute_name(at);
-    std::string local_name = at->name;
-    atts.append(name);
-    std::string attvalue = at->value;
-
-    if (run_src_updates && (local_name == aHREF || local_name == aSRC || 
-                            local_name == aPOSTER || local_name == aDATA ||
-                            local_name == aSRCSET || local_name == aALTIMG)) {
-        attvalue = update_attribute_value(attvalue);
-    }
-
-    if (run_style_updates && (local_name == "style")) {
-        attvalue = update_style_urls(attvalue);
+    out.push_back(' ');
+    GumboAttributeNamespaceEnum attr_ns = at->attr_namespace;
+    if ((attr_ns != GUMBO_ATTR_NAMESPACE_NONE) && (strcmp(at->name, "xmlns") != 0)) {
+        out.append(attribute_nsprefixes[attr_ns]);
+    }
+    out.append(at->name);
+
+    const char * attvalue = at->value;
+    std::string updated_value;
+    bool run_updates = (run_src_updates || run_style_updates);
+    if (run_updates) {
+        std::string local_name = at->name;
+        if (run_src_updates && (local_name == aHREF || local_name == aSRC ||
+                                local_name == aPOSTER || local_name == aDATA ||
+                                local_name == aSRCSET || local_name == aALTIMG)) {
+            updated_value = update_attribute_value(attvalue);
+            attvalue = updated_value.c_str();
+        }
+        if (run_style_updates && (local_name == "style")) {
+            updated_value = update_style_urls(attvalue);
+            attvalue = updated_value.c_str();
+        }
     }
 
     // we handle empty attribute values like so: alt=""
     char quote = '"';
-    std::string qs="\"";
+    char qs = '"';
 
     // verify an original value existed since we create our own attributes
     // and if so determine the original quote character used if any
 
     if (at->original_value.data) {
-        if ( (!attvalue.empty())   || 
-             (at->original_value.data[0] == '"') || 
+        if ( (attvalue[0] != '\0')   ||
+             (at->original_value.data[0] == '"') ||
              (at->original_value.data[0] == '\'') ) {
 
           quote = at->original_value.data[0];
-          if (quote == '\'') qs = std::string("'");
-          if (quote == '"') qs = std::string("\"");
+          if (quote == '\'') qs = '\'';
         }
     }
 
-    atts.append("=");
-    atts.append(qs);
+    out.push_back('=');
+    out.push_back(qs);
     if (no_entities) {
-        atts.append(attvalue);
+        out.append(attvalue);
+    } else if (quote == '"') {
+        append_escaped(out, attvalue, DQUOTE_ATTRIBUTE_ENTITIES.entity);
+    } else if (quote == '\'') {
+        append_escaped(out, attvalue, SQUOTE_ATTRIBUTE_ENTITIES.entity);
     } else {
-        atts.append(substitute_xml_entities_into_attributes(quote, attvalue));
+        append_escaped(out, attvalue, TEXT_ENTITIES.entity);
     }
-    atts.append(qs);
-    return atts;
+    out.push_back(qs);
+}
+
+
+// The serializers append to a single output buffer reserved up front
+// rather than returning and concatenating strings for every node.
+
+std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdates)
+{
+    std::string results;
+    results.reserve(output_reserve_size());
+    serialize_into(results, node, doupdates);
+    return results;
+}
+
+
+std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes doupdates)
+{
+    std::string results;
+    results.reserve(output_reserve_size());
+    serialize_contents_into(results, node, doupdates);
+    return results;
+}
+
+
+std::string GumboInterface::prettyprint(GumboNode* node, int lvl)
+{
+    std::string results;
+    results.reserve(output_reserve_size());
+    prettyprint_into(results, node, lvl);
+    return results;
+}
+
+
+size_t GumboInterface::output_reserve_size()
+{
+    // room for the entities and whitespace normally added
+    return parsed_length() + parsed_length() / 8 + 1024;
 }
 
 
 // serialize children of a node
 // may be invoked recursively
 
-std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes doupdates) {
-    std::string contents        = "";
+void GumboInterface::serialize_contents_into(std::string &out, GumboNode* node, enum UpdateTypes doupdates)
+{
+    // the contents of node start here, earlier output must not be trimmed
+    const size_t start          = out.length();
     std::string tagname         = get_tag_name(node);
     bool no_entity_substitution = in_set(no_entity_sub, tagname);
     bool keep_whitespace        = in_set(preserve_whitespace, tagname);
@@ -1253,52 +1409,56 @@ std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes
         GumboNode* child = static_cast<GumboNode*> (children->data[i]);
 
         if (child->type == GUMBO_NODE_TEXT) {
-            std::string text;
+            const char * text = child->v.text.text;
+            // entities never start with a newline so this can be checked before substitution
+            if (injected_newline && (text[0] == '\n')) text++;
+            injected_newline = false;
             if (no_entity_substitution) {
-                text = std::string(child->v.text.text);
+                out.append(text);
             } else {
-                text = substitute_xml_entities_into_text(std::string(child->v.text.text));
+                append_escaped(out, text, TEXT_ENTITIES.entity);
             }
-            if (injected_newline && !text.empty() && (text.at(0) == '\n')) text.erase(0,1);
-            injected_newline = false;
-            contents.append(text);
 
         } else if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE) {
-            std::string tagstring = serialize(child, doupdates);
-            // empty tagstring means this tag node is being removed
-            if (tagstring.empty()) {
+            // nothing is output if this tag node is being removed
+            if (!serialize_into(out, child, doupdates)) {
                 // strip off trailing whitespace from predecessor tag
-                rtrim(contents);
-                contents.append("\n"); 
+                rtrim(out, start);
+                out.push_back('\n');
                 // strip out any associated newline in trailing whitespace node
                 injected_newline = true;
             } else {
-                contents.append(tagstring);
                 injected_newline = false;
                 std::string childname = get_tag_name(child);
                 if (in_head_without_title && (childname == "title")) in_head_without_title = false;
                 if (!is_inline && !keep_whitespace && !in_set(nonbreaking_inline,childname) && is_structural) {
-                    contents.append("\n");
+                    out.push_back('\n');
                     injected_newline = true;
                 }
             }
 
         } else if (child->type == GUMBO_NODE_WHITESPACE) {
             // try to keep all whitespace to keep as close to original as possible
-            std::string wspace = std::string(child->v.text.text);
+            const char * wspace = child->v.text.text;
             if (injected_newline) {
-                newlinetrim(wspace);
+                // delete everything up to and including the newline
+                const char * nl = strchr(wspace, '\n');
+                if (nl) wspace = nl + 1;
                 injected_newline = false;
             }
-            contents.append(wspace);
+            out.append(wspace);
             injected_newline = false;
 
         } else if (child->type == GUMBO_NODE_CDATA) {
-            contents.append("<![CDATA[" + std::string(child->v.text.text) + "]]>");
+            out.append("<![CDATA[");
+            out.append(child->v.text.text);
+            out.append("]]>");
             injected_newline = false;
 
         } else if (child->type == GUMBO_NODE_COMMENT) {
-            contents.append("<!--" + std::string(child->v.text.text) + "-->");
+            out.append("<!--");
+            out.append(child->v.text.text);
+            out.append("-->");
  
         } else {
             fprintf(stderr, "unknown element of type: %d\n", child->type); 
@@ -1306,38 +1466,36 @@ std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes
         }
 
     }
-    if (in_head_without_title) contents.append("<title></title>");
-    return contents;
+    if (in_head_without_title) out.append("<title></title>");
 }
 
 
 // serialize a GumboNode back to html/xhtml
 // may be invoked recursively
+// returns false without any output if the node is being removed
 
-std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdates) {
+bool GumboInterface::serialize_into(std::string &out, GumboNode* node, enum UpdateTypes doupdates)
+{
     // special case the document node
     if (node->type == GUMBO_NODE_DOCUMENT) {
-        std::string results = build_doctype(node);
-        results.append(serialize_contents(node, doupdates));
-        return results;
+        out.append(build_doctype(node));
+        serialize_contents_into(out, node, doupdates);
+        return true;
     }
 
-    std::string close = "";
-    std::string closeTag = "";
-    std::string atts = "";
     std::string tagname            = get_tag_name(node);
     bool need_special_handling     = in_set(special_handling, tagname);
     bool is_void_tag               = in_set(void_tags, tagname);
     bool no_entity_substitution    = in_set(no_entity_sub, tagname);
     bool is_href_src_tag           = in_set(href_src_tags, tagname);
     bool in_xml_ns                 = node->v.element.tag_namespace != GUMBO_NAMESPACE_HTML;
-    // bool is_inline                 = in_set(nonbreaking_inline, tagname);
+    bool in_head                   = (node->parent->type == GUMBO_NODE_ELEMENT) &&
+                                     (node->parent->v.element.tag == GUMBO_TAG_HEAD);
     bool is_jslink = false;
 
 
     // handle special case of stylesheet link missing type attribute
-    if ((tagname == "link") && (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
+    if ((tagname == "link") && in_head) {
         const GumboVector * attribs = &node->v.element.attributes;
         GumboAttribute* relatt = gumbo_get_attribute(attribs, "rel");
         GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
@@ -1348,111 +1506,111 @@ std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdate
             }
         }
     }
-    
-    // build attr string  
+
     GumboVector * attribs = &node->v.element.attributes;
-    for (unsigned int i=0; i< attribs->length; ++i) {
-        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
-        atts.append(build_attributes(at, no_entity_substitution, ((doupdates & SourceUpdates) && is_href_src_tag), (doupdates & StyleUpdates)));
-    }
-
-    if (tagname == "script") {
-        if ((node->parent->type == GUMBO_NODE_ELEMENT) && 
-            (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-            GumboAttribute* srcatt = gumbo_get_attribute(attribs, "src");
-            GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
-            if (srcatt && typeatt) {
-                std::string script_src = srcatt->value;
-                std::string script_type = typeatt->value;
-                if (script_src.find(":") == std::string::npos) {
-                    if ((script_type == "application/javascript") || (script_type == "text/javascript")) {
-                        is_jslink = true;
-                    }
+
+    if ((tagname == "script") && in_head) {
+        GumboAttribute* srcatt = gumbo_get_attribute(attribs, "src");
+        GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
+        if (srcatt && typeatt) {
+            std::string script_src = srcatt->value;
+            std::string script_type = typeatt->value;
+            if (script_src.find(":") == std::string::npos) {
+                if ((script_type == "application/javascript") || (script_type == "text/javascript")) {
+                    is_jslink = true;
                 }
             }
         }
     }
-    
+
+    // links and scripts being replaced are dropped entirely
+    if ((doupdates & LinkUpdates) && (tagname == "link") && in_head) {
+        return false;
+    }
+
+    if ((doupdates & JavascriptUpdates) && is_jslink) {
+        return false;
+    }
+
+    // build start tag and attr string
+    out.push_back('<');
+    out.append(tagname);
+    const size_t atts_start = out.length();
+    for (unsigned int i=0; i< attribs->length; ++i) {
+        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
+        append_attribute(out, at, no_entity_substitution, ((doupdates & SourceUpdates) && is_href_src_tag), (doupdates & StyleUpdates));
+    }
+
     // Make sure that the xmlns attribute exists as an html tag attribute
     if (tagname == "html") {
-        if (atts.find("xmlns=") == std::string::npos) {
-            atts.append(" xmlns=\"http://www.w3.org/1999/xhtml\"");
+        if (out.find("xmlns=", atts_start) == std::string::npos) {
+            out.append(" xmlns=\"http://www.w3.org/1999/xhtml\"");
         }
         if (m_version.startsWith('3')) {
-            if (atts.find("xmlns:epub") == std::string::npos) {
-                atts.append(" xmlns:epub=\"http://www.idpf.org/2007/ops\"");
+            if (out.find("xmlns:epub", atts_start) == std::string::npos) {
+                out.append(" xmlns:epub=\"http://www.idpf.org/2007/ops\"");
             }
         }
     }
 
+    // whether the tag self closes depends on its contents so
+    // the "/" is inserted here afterwards if need be
+    const size_t close_pos = out.length();
+    out.push_back('>');
+    if (need_special_handling) out.push_back('\n');
+
     // determine contents
-    std::string contents;
+    size_t contents_start = out.length();
 
     if ((tagname == "body") && (doupdates & BodyUpdates)) {
-        contents = m_newbody;
+        out.append(m_newbody);
     } else {
         // serialize your contents
-        contents = serialize_contents(node, doupdates);
+        serialize_contents_into(out, node, doupdates);
     }
 
     // determine closing tag type
-    std::string testcontents = contents;
-    ltrim(testcontents);
-    if (is_void_tag || (in_xml_ns && testcontents.empty())) {
-        close = "/";
-    } else {
-        closeTag = "</" + tagname + ">";
+    bool self_closing = is_void_tag || (in_xml_ns && is_blank(out, contents_start));
+    if (self_closing) {
+        out.insert(close_pos, 1, '/');
+        contents_start++;
     }
 
-    if ((doupdates & StyleUpdates) && (tagname == "style") && 
-        (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-        contents = update_style_urls(contents);
+    if ((doupdates & StyleUpdates) && (tagname == "style") && in_head) {
+        std::string contents = update_style_urls(out.substr(contents_start));
+        out.replace(contents_start, std::string::npos, contents);
     }
 
     if (need_special_handling) {
-        ltrimnewlines(contents);
-        rtrim(contents);
-        contents.append("\n");
-    }
-
-    // build results
-    std::string results;
-
-    if ((doupdates & LinkUpdates) && (tagname == "link") && 
-        (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-        return "";
-    }
-
-    if ((doupdates & JavascriptUpdates) && is_jslink) {
-        return "";
+        ltrimnewlines(out, contents_start);
+        rtrim(out, contents_start);
+        out.push_back('\n');
     }
 
-    results.append("<"+tagname+atts+close+">");
-    
-    if (need_special_handling) results.append("\n");
-    results.append(contents);
-
     if ((doupdates & LinkUpdates) && (tagname == "head")) {
-        results.append(m_newcsslinks);
+        out.append(m_newcsslinks);
     }
 
     if ((doupdates & JavascriptUpdates) && (tagname == "head")) {
-        results.append(m_newjslinks);
+        out.append(m_newjslinks);
     }
 
-    results.append(closeTag);
-    if (need_special_handling) results.append("\n");
-    return results;
+    if (!self_closing) {
+        out.append("</");
+        out.append(tagname);
+        out.push_back('>');
+    }
+    if (need_special_handling) out.push_back('\n');
+    return true;
 }
 
 
 
-std::string GumboInterface::prettyprint_contents(GumboNode* node, int lvl) 
+void GumboInterface::prettyprint_contents_into(std::string &out, GumboNode* node, int lvl) 
 {
     std::string indent_chars = PrettyPrintProps::instance().getIndentString();
-    std::string contents        = "";
+    // the contents of node start here, earlier output must not be trimmed
+    const size_t start          = out.length();
     std::string tagname         = get_tag_name(node);
     bool no_entity_substitution = PrettyPrintProps::instance().inset_noentitysub(tagname);
     bool keep_whitespace        = PrettyPrintProps::instance().inset_preservespace(tagname);
@@ -1476,104 +1634,111 @@ std::string GumboInterface::prettyprint_contents(GumboNode* node, int lvl)
         GumboNode* child = static_cast<GumboNode*> (children->data[i]);
 
         if (child->type == GUMBO_NODE_TEXT) {
-            std::string val;
+            // if child of a structual element is text and follows a newline, indent it properly
+            bool indent_text = is_structural && last_char == '\n';
+            if (indent_text) {
+                out.append(indent_space);
+            }
+            const size_t val_start = out.length();
 
             if (no_entity_substitution) {
-                val = std::string(child->v.text.text);
+                out.append(child->v.text.text);
             } else {
-                val = substitute_xml_entities_into_text(std::string(child->v.text.text));
+                append_escaped(out, child->v.text.text, TEXT_ENTITIES.entity);
             }
 
-            // if child of a structual element is text and follows a newline, indent it properly
-            if (is_structural && last_char == '\n') {
-                contents.append(indent_space);
-                ltrim(val);
+            if (indent_text) {
+                ltrim(out, val_start);
             }
             if (!keep_whitespace && !m_keep_whitespace) {
                 // this includes structural, inline, and other text holders 
                 // okay to condense whitespace
-                condense_whitespace(val);
+                condense_whitespace(out, val_start);
             }
-            contents.append(val);
 
         } else if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE) {
 
-            std::string val = prettyprint(child, lvl);
             std::string childname = get_tag_name(child);
             if (in_head_without_title && (childname == "title")) in_head_without_title = false;
             if (!PrettyPrintProps::instance().inset_inline(childname)) {
                 contains_block_tags = true;
                 if (last_char != '\n') {
-                    contents.append("\n");
-                    if (tagname != "head" && tagname != "html" && !singlespace) contents.append("\n");
+                    out.push_back('\n');
+                    if (tagname != "head" && tagname != "html" && !singlespace) out.push_back('\n');
                     last_char='\n';
                 }
             }
             // if child of a structual element is inline and follows a newline, indent it properly
-            if (is_structural && PrettyPrintProps::instance().inset_inline(childname) && (last_char == '\n')) {
-                contents.append(indent_space);
-                ltrim(val);
-            }    
-            contents.append(val);
+            bool indent_child = is_structural && PrettyPrintProps::instance().inset_inline(childname) && (last_char == '\n');
+            if (indent_child) {
+                out.append(indent_space);
+            }
+            const size_t val_start = out.length();
+            prettyprint_into(out, child, lvl);
+            if (indent_child) {
+                ltrim(out, val_start);
+            }
 
         } else if (child->type == GUMBO_NODE_WHITESPACE) {
 
             if (keep_whitespace) {
-                std::string wspace = std::string(child->v.text.text);
-                contents.append(wspace);
+                out.append(child->v.text.text);
             } else if (is_inline || PrettyPrintProps::instance().inset_textholder(tagname)) {
-                if (std::string(" \t\v\f\r\n").find(last_char) == std::string::npos) {
-                    contents.append(std::string(" "));
+                if (!is_whitespace(last_char)) {
+                    out.push_back(' ');
                 }
             }
 
         } else if (child->type == GUMBO_NODE_CDATA) {
-            contents.append("<![CDATA[" + std::string(child->v.text.text) + "]]>");
+            out.append("<![CDATA[");
+            out.append(child->v.text.text);
+            out.append("]]>");
 
         } else if (child->type == GUMBO_NODE_COMMENT) {
-            contents.append("<!--" + std::string(child->v.text.text) + "-->");
+            out.append("<!--");
+            out.append(child->v.text.text);
+            out.append("-->");
  
         } else {
             fprintf(stderr, "unknown element of type: %d\n", child->type); 
         }
 
         // update last character of current contents
-        if (!contents.empty()) {
-            last_char = contents.at(contents.length()-1);
+        if (out.length() > start) {
+            last_char = out.back();
         }
 
     }
 
     // inject epmpty title into head if one is missing
     if (in_head_without_title) {
-        if (last_char != '\n') contents.append("\n");
-        contents.append(indent_space + "<title></title>\n");
+        if (last_char != '\n') out.push_back('\n');
+        out.append(indent_space);
+        out.append("<title></title>\n");
         last_char = '\n';
     }
 
     // treat inline tags containing block tags like a block tag
     if (is_inline && contains_block_tags) {
-        if (last_char != '\n' && !singlespace) contents.append("\n\n");
-        contents.append(indent_space);
+        if (last_char != '\n' && !singlespace) out.append("\n\n");
+        out.append(indent_space);
     }
-
-    return contents;
 }
 
 
 // prettyprint a GumboNode back to html/xhtml
 // may be invoked recursively
 
-std::string GumboInterface::prettyprint(GumboNode* node, int lvl)
+void GumboInterface::prettyprint_into(std::string &out, GumboNode* node, int lvl)
 {
     std::string indent_chars = PrettyPrintProps::instance().getIndentString();
     bool singlespace = PrettyPrintProps::instance().getSingleSpace();
 
     // special case the document node
     if (node->type == GUMBO_NODE_DOCUMENT) {
-      std::string results = build_doctype(node);
-      results.append(prettyprint_contents(node,lvl+1));
-      return results;
+      out.append(build_doctype(node));
+      prettyprint_contents_into(out, node, lvl+1);
+      return;
     }
 
     std::string tagname = get_tag_name(node);
@@ -1597,80 +1762,98 @@ std::string GumboInterface::prettyprint(GumboNode* node, int lvl)
         }
     }
     
-    // build attr string
-    std::string atts = "";
     bool no_entity_substitution = PrettyPrintProps::instance().inset_noentitysub(tagname);
-    const GumboVector * attribs = &node->v.element.attributes;
-    for (unsigned int i=0; i< attribs->length; ++i) {
-        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
-        atts.append(build_attributes(at, no_entity_substitution));
-    }
-
     bool is_void_tag = PrettyPrintProps::instance().inset_void(tagname);
+    bool keep_whitespace = PrettyPrintProps::instance().inset_preservespace(tagname);
+    bool blank_line_after = !in_head && (tagname != "html") && !singlespace;
+
+    char c = indent_chars.at(0);
+    unsigned int  n = (unsigned int) indent_chars.length(); 
+    std::string indent_space = std::string((lvl-1)*n,c);
+
+    const size_t start = out.length();
 
-    // get tag contents
-    std::string contents = "";
+    // Handle the general case first, only tags in a foreign namespace
+    // find out from their contents that they self close after all
     if (!is_void_tag) {
+        if (is_structural || !is_inline) {
+            out.append(indent_space);
+        }
+        append_start_tag(out, node, tagname, no_entity_substitution);
+        out.push_back('>');
+        // dropped again below if there are no contents
+        if (is_structural) out.push_back('\n');
+        const size_t contents_start = out.length();
+
+        // get tag contents
         if (is_structural && tagname != "html") {
-            contents = prettyprint_contents(node, lvl+1);
+            prettyprint_contents_into(out, node, lvl+1);
         } else {
-            contents = prettyprint_contents(node, lvl);
+            prettyprint_contents_into(out, node, lvl);
         }
-    }
-
-    bool keep_whitespace = PrettyPrintProps::instance().inset_preservespace(tagname);
-    if (!keep_whitespace && !is_inline) {
-        rtrim(contents);
-    }
-
-    std::string testcontents = contents;
-    ltrim(testcontents);
-
-    bool single = is_void_tag || (in_xml_ns && testcontents.empty());
 
-    char c = indent_chars.at(0);
-    unsigned int  n = (unsigned int) indent_chars.length(); 
-    std::string indent_space = std::string((lvl-1)*n,c);
+        if (!keep_whitespace && !is_inline) {
+            rtrim(out, contents_start);
+        }
 
-    // handle self-closed tags with no contents first
-    if (single) {
-        std::string selfclosetag = "<" + tagname + atts + "/>";
-        if (is_inline) {
-            // always add newline after br tags when they are children of structural tags
-	  if ((tagname == "br") && PrettyPrintProps::instance().inset_structural(parentname)) {
-              selfclosetag.append("\n");
-              if (!in_head && (tagname != "html") && !singlespace) selfclosetag.append("\n");
+        if (!(in_xml_ns && is_blank(out, contents_start))) {
+            if (is_structural) {
+                if (out.length() == contents_start) {
+                    out.pop_back();
+                } else {
+                    out.push_back('\n');
+                    out.append(indent_space);
+                }
+                out.append("</");
+                out.append(tagname);
+                out.append(">\n");
+                if (blank_line_after) out.push_back('\n');
+            } else if (is_inline) {
+                out.append("</");
+                out.append(tagname);
+                out.push_back('>');
+            } else /** all others */ {
+                if (!keep_whitespace) {
+                    ltrim(out, contents_start);
+                }
+                out.append("</");
+                out.append(tagname);
+                out.append(">\n");
+                if (blank_line_after) out.push_back('\n');
             }
-            return selfclosetag;
+            return;
         }
-        if (!in_head && (tagname != "html") && !singlespace) selfclosetag.append("\n");
-        return indent_space + selfclosetag + "\n";
-    } 
 
-    // Handle the general case
-    std::string results;
-    std::string starttag = "<" + tagname +  atts + ">";
-    std::string closetag = "</" + tagname + ">";
+        // self closing after all so its contents are dropped
+        out.resize(start);
+    }
 
-    if (is_structural) {
-        results = indent_space + starttag;
-        if (!contents.empty()) {
-            results.append("\n" + contents + "\n" + indent_space);
-        }
-        results.append(closetag + "\n");
-        if (!in_head && (tagname != "html") && !singlespace) results.append("\n");
-    } else if (is_inline) {
-        results = starttag;
-        results.append(contents);
-        results.append(closetag);
-    } else /** all others */ {
-        results = indent_space + starttag;
-        if (!keep_whitespace) {
-            ltrim(contents);
+    // handle self-closed tags with no contents
+    if (is_inline) {
+        append_start_tag(out, node, tagname, no_entity_substitution);
+        out.append("/>");
+        // always add newline after br tags when they are children of structural tags
+        if ((tagname == "br") && PrettyPrintProps::instance().inset_structural(parentname)) {
+            out.push_back('\n');
+            if (blank_line_after) out.push_back('\n');
         }
-        results.append(contents);
-        results.append(closetag + "\n");
-        if (!in_head && (tagname != "html") && !singlespace) results.append("\n");
+        return;
+    }
+    out.append(indent_space);
+    append_start_tag(out, node, tagname, no_entity_substitution);
+    out.append("/>");
+    if (blank_line_after) out.push_back('\n');
+    out.push_back('\n');
+}
+
+
+void GumboInterface::append_start_tag(std::string &out, GumboNode* node, const std::string &tagname, bool no_entities)
+{
+    out.push_back('<');
+    out.append(tagname);
+    const GumboVector * attribs = &node->v.element.attributes;
+    for (unsigned int i=0; i< attribs->length; ++i) {
+        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
+        append_attribute(out, at, no_entities);
     }
-    return results;
 }
@@ -24,14 +24,18 @@
 #define GUMBO_INTERFACE
 
 #include <stdlib.h>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 
 #include "gumbo.h"
 #include "gumbo_edit.h"
+#include "Parsers/GumboArena.h"
+#include "Misc/Utf8OffsetMap.h"
 
 #include "Query/CSelection.h"
 
+#include <QByteArray>
 #include <QString>
 #include <QList>
 #include <QHash>
@@ -50,6 +54,8 @@ public:
 
     GumboInterface(const QString &source, const QString &version);
     GumboInterface(const QString &source, const QString &version, const QHash<QString, QString> &source_updates);
+    // utf8source is source already encoded as UTF-8, for callers that keep one
+    GumboInterface(const QString &source, const QByteArray &utf8source, const QString &version);
     ~GumboInterface();
 
     void    parse();
@@ -112,6 +118,12 @@ public:
     QList<GumboWellFormedError> error_check();
     QList<GumboWellFormedError> fragment_error_check();
 
+    // approximate memory held by the source and the parsed tree
+    size_t memory_usage();
+
+    // position in the source QString of a byte offset in the tree built by parse()
+    int get_utf16_position(size_t utf8_offset);
+
     // routines to work with node and its children only
     QList<GumboNode*> get_nodes_with_attribute(GumboNode* node, const char * att_name);
 
@@ -142,33 +154,53 @@ private:
 
     std::string prettyprint(GumboNode* node, int lvl);
 
-    std::string prettyprint_contents(GumboNode* node, int lvl);
+    // the *_into routines append their output to out
+    bool serialize_into(std::string &out, GumboNode* node, enum UpdateTypes doupdates);
+
+    void serialize_contents_into(std::string &out, GumboNode* node, enum UpdateTypes doupdates);
+
+    void prettyprint_into(std::string &out, GumboNode* node, int lvl);
+
+    void prettyprint_contents_into(std::string &out, GumboNode* node, int lvl);
+
+    void append_start_tag(std::string &out, GumboNode* node, const std::string &tagname, bool no_entities);
+
+    // fills m_utf8src from m_source unless the caller gave its UTF-8 copy
+    void load_utf8src();
+
+    // the part of m_utf8src that is parsed
+    const char * parsed_data() const;
+    size_t parsed_length() const;
+
+    // offset just past the xml header ending after from and the whitespace after it
+    static int xml_header_end(const QByteArray &source, int from);
+
+    // expected size of the serialized output
+    size_t output_reserve_size();
 
     std::string build_doctype(GumboNode *node);
 
     std::string get_attribute_name(GumboAttribute * at);
 
-    std::string build_attributes(GumboAttribute * at, bool no_entities, bool run_src_updates = false, bool run_style_updates = false);
+    void append_attribute(std::string &out, GumboAttribute * at, bool no_entities, bool run_src_updates = false, bool run_style_updates = false);
 
     std::string update_attribute_value(const std::string &href);
 
     std::string update_style_urls(const std::string& source);
 
-    std::string substitute_xml_entities_into_text(const std::string &text);
-
-    std::string substitute_xml_entities_into_attributes(char quote, const std::string &text);
+    static void append_escaped(std::string &out, const char *text, const char * const *entities);
 
     bool in_set(std::unordered_set<std::string> &s, std::string &key);
 
-    void rtrim(std::string &s);
+    void rtrim(std::string &s, size_t start = 0);
 
-    void ltrim(std::string &s);
+    void ltrim(std::string &s, size_t start = 0);
 
-    void ltrimnewlines(std::string &s);
+    void ltrimnewlines(std::string &s, size_t start = 0);
 
-    void newlinetrim(std::string &s);
+    void condense_whitespace(std::string &s, size_t start = 0);
 
-    void condense_whitespace(std::string &s);
+    bool is_blank(const std::string &s, size_t start = 0);
 
     void replace_all(std::string &s, const char * s1, const char * s2);
 
@@ -177,7 +209,16 @@ private:
 
     QString                         m_source;
     GumboOutput*                    m_output;
-    std::string                     m_utf8src;
+    // must outlive m_output, whose tree it holds
+    GumboArena                      m_arena;
+    // shared with the caller's UTF-8 copy of the source when it gave one
+    QByteArray                      m_utf8src;
+    // where the parsed part of m_utf8src starts
+    int                             m_utf8start;
+    // length in source of the xml header parse() strips off
+    int                             m_utf16_header_length;
+    Utf8OffsetMap                   m_offsetmap;
+    std::once_flag                  m_offsetmap_built;
     const QHash<QString, QString> & m_sourceupdates;
     std::string                     m_newcsslinks;
     std::string                     m_newjslinks;
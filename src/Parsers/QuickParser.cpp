@@ -23,6 +23,8 @@
 #include <QString>
 #include <QStringList>
 #include <QStringView>
+#include <QHash>
+#include <QList>
 #include <QDebug>
 
 #include "Parsers/TagAtts.h"
@@ -32,13 +34,23 @@
 
 const QString WHITESPACE_CHARS=" \v\t\n\r\f";
 
+static const QString TTYPE_XMLHEADER = "xmlheader";
+static const QString TTYPE_PI = "pi";
+static const QString TTYPE_COMMENT = "comment";
+static const QString TTYPE_DOCTYPE = "doctype";
+static const QString TTYPE_CDATA = "cdata";
+static const QString TTYPE_BEGIN = "begin";
+static const QString TTYPE_SINGLE = "single";
+static const QString TTYPE_END = "end";
+
 QuickParser::QuickParser(const QString &source, QString default_lang)
     : m_source(source),
       m_pos(0),
       m_next(0)
 {
     m_LangPath << default_lang;
-    m_TagPath << "root";
+    m_TagPath = "root";
+    m_TagPathEnds << m_TagPath.length();
 }
 
 
@@ -52,7 +64,8 @@ void QuickParser::reload_parser(const QString& source, QString default_language)
     m_pos = 0;
     m_next = 0;
     m_LangPath = QStringList() << default_language;
-    m_TagPath = QStringList() << "root";
+    m_TagPath = "root";
+    m_TagPathEnds = QList<int>() << m_TagPath.length();
 }
 
 
@@ -64,22 +77,25 @@ QuickParser::MarkupInfo QuickParser::parse_next()
     if (!markup.isNull()) {
         if ((markup.at(0) == '<') && (markup.at(markup.size() - 1) == '>')) {
             parseTag(markup, mi);
-            if (mi.ttype == "begin") {
-                m_TagPath << mi.tname;
+            if (mi.ttype == TTYPE_BEGIN) {
+                m_TagPath.append(QChar('.'));
+                m_TagPath.append(mi.tname);
+                m_TagPathEnds << m_TagPath.length();
                 QString lang = mi.tattr.value("lang", QString());
                 if (lang.isEmpty()) lang = mi.tattr.value("xml:lang", QString());
                 if (lang.isEmpty()) lang = m_LangPath.last();
                 m_LangPath << lang;
-            } else if (mi.ttype == "end") {
-                m_TagPath.removeLast();
+            } else if (mi.ttype == TTYPE_END) {
+                m_TagPathEnds.removeLast();
+                m_TagPath.truncate(m_TagPathEnds.isEmpty() ? 0 : m_TagPathEnds.last());
                 m_LangPath.removeLast();
             }
         } else {
-            mi.text = markup.toString();
+            mi.text = markup;
         }
         mi.pos = m_pos;
         mi.lang = m_LangPath.last();
-        mi.tpath = m_TagPath.join(".");
+        mi.tpath = m_TagPath;
     }
     return mi;
 }
@@ -91,7 +107,7 @@ QString QuickParser::serialize_markup(const QuickParser::MarkupInfo& mi)
     QString res;
     // handle leading text
     if (!mi.text.isEmpty()) {
-        res = mi.text;
+        res = mi.text.toString();
     }
 
     // if not tag info provided return just the text
@@ -184,11 +200,11 @@ void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo&
     if (c == '?') {
         if (tagstring.startsWith(QL1SV("<?xml"))) {
             mi.tname = "?xml";
-            mi.ttype = "xmlheader";
+            mi.ttype = TTYPE_XMLHEADER;
             mi.tattr["special"] = Utility::Substring(5, taglen-1, tagstring);
         } else {
             mi.tname = "?";
-            mi.ttype = "pi";
+            mi.ttype = TTYPE_PI;
             mi.tattr["special"] = Utility::Substring(1, taglen-1, tagstring);
         }
         return;
@@ -196,15 +212,15 @@ void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo&
     if (c == '!') {
         if (tagstring.startsWith(QL1SV("<!--"))) {
             mi.tname = "!--";
-            mi.ttype = "comment"; 
+            mi.ttype = TTYPE_COMMENT; 
             mi.tattr["special"] = Utility::Substring(4, taglen-3, tagstring);
         } else if (tagstring.startsWith(QL1SV("<!DOCTYPE")) || tagstring.startsWith(QL1SV("<!doctype"))) {
             mi.tname = "!DOCTYPE";
-            mi.ttype = "doctype";
+            mi.ttype = TTYPE_DOCTYPE;
             mi.tattr["special"] = Utility::Substring(9, taglen-1, tagstring);
         } else if (tagstring.startsWith(QL1SV("<![CDATA[")) || tagstring.startsWith(QL1SV("<![cdata["))) {
             mi.tname = "![CDATA[";
-            mi.ttype = "cdata";
+            mi.ttype = TTYPE_CDATA;
             mi.tattr["special"] = Utility::Substring(9, taglen-3, tagstring);
         }
         return;
@@ -213,13 +229,13 @@ void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo&
     // normal tag, extract tag name
     p = skipAnyBlanks(tagstring, 1);
     if (tagstring.at(p) == '/') {
-        mi.ttype = "end";
+        mi.ttype = TTYPE_END;
         p++;
         p = skipAnyBlanks(tagstring, p);
     }
     int b = p;
     p = stopWhenContains(tagstring, ">/ \f\t\r\n", p);
-    mi.tname = Utility::Substring(b, p, tagstring);
+    mi.tname = internName(tagstring.mid(b, p - b));
 
     // handle the possibility of attributes (so begin or single tag type, not end)
     if (mi.ttype.isEmpty()) {
@@ -245,8 +261,8 @@ void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo&
             }
             mi.tattr[aname] = avalue;
         }
-        mi.ttype = "begin";
-        if (tagstring.indexOf(QChar('/'), p) >= 0) mi.ttype = "single";
+        mi.ttype = TTYPE_BEGIN;
+        if (tagstring.indexOf(QChar('/'), p) >= 0) mi.ttype = TTYPE_SINGLE;
     }
     return;
 }
@@ -274,3 +290,15 @@ int QuickParser::stopWhenContains(const QStringView tgt, const QString& stopchar
     while((p < tgt.length()) && !stopchars.contains(tgt.at(p))) p++;
     return p;
 }
+
+
+QString QuickParser::internName(const QStringView name)
+{
+    auto it = m_Names.constFind(name);
+    if (it != m_Names.constEnd()) {
+        return it.value();
+    }
+    QString tname = name.toString();
+    m_Names.insert(QStringView(tname), tname);
+    return tname;
+}
@@ -24,6 +24,8 @@
 
 #include <QStringList>
 #include <QStringView>
+#include <QHash>
+#include <QList>
 
 #include "Parsers/TagAtts.h"
 
@@ -34,9 +36,11 @@ class QuickParser
 {
 public:
 
+    // text views the parser's source, it is only valid until the parser
+    // is reloaded or destroyed, tname and ttype are shared strings
     struct MarkupInfo {
         int     pos;
-        QString text;
+        QStringView text;
         QString lang;
         QString tpath;
         QString tname;
@@ -56,12 +60,17 @@ private:
     int findTarget(const QString &tgt, int p, bool after=false);
     int skipAnyBlanks(const QStringView segment, int p);
     int stopWhenContains(const QStringView segment, const QString& stopchars, int p);
+    QString internName(const QStringView name);
     
     QString      m_source;
     int          m_pos;
     int          m_next;
-    QStringList  m_TagPath;
+    QString      m_TagPath;      // dotted path of open tags
+    QList<int>   m_TagPathEnds;  // length of m_TagPath at each open tag
     QStringList  m_LangPath;
+
+    // tag names seen so far, the keys view their values
+    QHash<QStringView, QString> m_Names;
 };
 
 #endif
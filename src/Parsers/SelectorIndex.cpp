@@ -0,0 +1,308 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#include <stdexcept>
+
+#include <QString>
+
+#include "Parsers/SelectorIndex.h"
+#include "Query/CSelectorCache.h"
+#include "Query/CSelector.h"
+
+// same rules as CParser::nameChar, bytes of multibyte characters included
+static inline bool IsNameChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           (c == '_') || (c == '-') || (static_cast<unsigned char>(c) > 127);
+}
+
+static inline bool IsSpace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f');
+}
+
+// Steps over a quoted string starting at i, returns the index of the closing quote
+static size_t SkipQuoted(const std::string &text, size_t i)
+{
+    char quote = text[i];
+    for (++i; i < text.length(); ++i) {
+        if (text[i] == '\\') {
+            ++i;
+        } else if (text[i] == quote) {
+            break;
+        }
+    }
+    return i;
+}
+
+
+SelectorIndex::SelectorIndex()
+    :
+    m_TagBuckets(GUMBO_TAG_LAST + 1)
+{
+}
+
+
+SelectorIndex::~SelectorIndex()
+{
+    for (CSelector *selector : m_Selectors) {
+        if (selector) {
+            selector->release();
+        }
+    }
+}
+
+
+int SelectorIndex::AddSelector(const QString &selector_text)
+{
+    int selector_number = static_cast<int>(m_Selectors.size());
+    std::string text = selector_text.toStdString();
+    CSelector *selector = NULL;
+    try {
+        selector = CSelectorCache::get(text);
+    } catch (const std::runtime_error &) {
+        // left unmatched, callers check HasParseError
+        selector = NULL;
+    }
+    m_Selectors.push_back(selector);
+    if (!selector) {
+        return selector_number;
+    }
+
+    // a group matches a node if any of its selectors does so it goes in
+    // the bucket of each, unless one of them has to be tried everywhere
+    std::vector<SelectorKey> keys;
+    for (const std::string &alternative : SplitGroup(text)) {
+        SelectorKey key = GetKey(alternative);
+        if (key.type == KeyType_None) {
+            keys.clear();
+            break;
+        }
+        keys.push_back(key);
+    }
+    if (keys.empty()) {
+        m_Unkeyed.push_back(selector_number);
+    }
+    for (const SelectorKey &key : keys) {
+        AddToBucket(key, selector_number);
+    }
+    return selector_number;
+}
+
+
+void SelectorIndex::AddToBucket(const SelectorKey &key, int selector_number)
+{
+    std::vector<int> *bucket = NULL;
+    if (key.type == KeyType_Id) {
+        bucket = &m_IdBuckets[key.value];
+    } else if (key.type == KeyType_Class) {
+        bucket = &m_ClassBuckets[key.value];
+    } else {
+        bucket = &m_TagBuckets[gumbo_tag_enum(key.value.c_str())];
+    }
+    // the alternatives of a group may share a bucket
+    if (bucket->empty() || bucket->back() != selector_number) {
+        bucket->push_back(selector_number);
+    }
+}
+
+
+std::vector<std::string> SelectorIndex::SplitGroup(const std::string &selector)
+{
+    std::vector<std::string> alternatives;
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < selector.length(); ++i) {
+        char c = selector[i];
+        if (c == '\\') {
+            ++i;
+        } else if ((c == '"') || (c == '\'')) {
+            i = SkipQuoted(selector, i);
+        } else if ((c == '(') || (c == '[')) {
+            depth++;
+        } else if (((c == ')') || (c == ']')) && (depth > 0)) {
+            depth--;
+        } else if ((c == ',') && (depth == 0)) {
+            alternatives.push_back(selector.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    alternatives.push_back(selector.substr(start));
+    return alternatives;
+}
+
+
+SelectorIndex::SelectorKey SelectorIndex::GetKey(const std::string &selector)
+{
+    SelectorKey key;
+    key.type = KeyType_None;
+
+    // escapes would need decoding to compare, just try these everywhere
+    if (selector.find('\\') != std::string::npos) {
+        return key;
+    }
+
+    // find where the rightmost compound selector starts
+    size_t end = selector.length();
+    while ((end > 0) && IsSpace(selector[end - 1])) {
+        end--;
+    }
+    size_t start = 0;
+    while ((start < end) && IsSpace(selector[start])) {
+        start++;
+    }
+    int depth = 0;
+    size_t compound_start = start;
+    for (size_t i = start; i < end; ++i) {
+        char c = selector[i];
+        if ((c == '"') || (c == '\'')) {
+            i = SkipQuoted(selector, i);
+        } else if ((c == '(') || (c == '[')) {
+            depth++;
+        } else if (((c == ')') || (c == ']')) && (depth > 0)) {
+            depth--;
+        } else if ((depth == 0) && (IsSpace(c) || (c == '>') || (c == '+') || (c == '~'))) {
+            compound_start = i + 1;
+        }
+    }
+
+    // then look at what it requires outside of any brackets
+    std::string id;
+    std::string class_name;
+    std::string tag;
+    depth = 0;
+    for (size_t i = compound_start; i < end; ++i) {
+        char c = selector[i];
+        if ((c == '"') || (c == '\'')) {
+            i = SkipQuoted(selector, i);
+        } else if ((c == '(') || (c == '[')) {
+            depth++;
+        } else if (((c == ')') || (c == ']')) && (depth > 0)) {
+            depth--;
+        } else if (depth > 0) {
+            continue;
+        } else if ((c == '#') || (c == '.') || (c == ':') || (i == compound_start)) {
+            size_t name_start = (IsNameChar(c) && (i == compound_start)) ? i : i + 1;
+            size_t name_end = name_start;
+            while ((name_end < end) && IsNameChar(selector[name_end])) {
+                name_end++;
+            }
+            std::string name = selector.substr(name_start, name_end - name_start);
+            if (!name.empty()) {
+                if ((c == '#') && id.empty()) {
+                    id = name;
+                } else if ((c == '.') && class_name.empty()) {
+                    class_name = name;
+                } else if ((c != ':') && (i == compound_start)) {
+                    tag = name;
+                }
+            }
+            if (name_end > i + 1) {
+                i = name_end - 1;
+            }
+        }
+    }
+
+    if (!id.empty()) {
+        key.type = KeyType_Id;
+        key.value = id;
+    } else if (!class_name.empty()) {
+        key.type = KeyType_Class;
+        key.value = class_name;
+    } else if (!tag.empty()) {
+        key.type = KeyType_Tag;
+        key.value = tag;
+    }
+    return key;
+}
+
+
+std::vector<bool> SelectorIndex::MatchTree(GumboNode *root) const
+{
+    std::vector<bool> matched(m_Selectors.size(), false);
+    int unmatched = 0;
+    for (CSelector *selector : m_Selectors) {
+        if (selector) unmatched++;
+    }
+    if (root && (unmatched > 0)) {
+        MatchNode(root, matched, unmatched);
+    }
+    return matched;
+}
+
+
+void SelectorIndex::MatchNode(GumboNode *node, std::vector<bool> &matched, int &unmatched) const
+{
+    TryBucket(m_Unkeyed, node, matched, unmatched);
+
+    // walks the same nodes as CSelector::matchAll
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return;
+    }
+
+    TryBucket(m_TagBuckets[node->v.element.tag], node, matched, unmatched);
+
+    if (!m_IdBuckets.empty()) {
+        GumboAttribute *attr = gumbo_get_attribute(&node->v.element.attributes, "id");
+        if (attr) {
+            auto it = m_IdBuckets.find(attr->value);
+            if (it != m_IdBuckets.end()) {
+                TryBucket(it->second, node, matched, unmatched);
+            }
+        }
+    }
+
+    if (!m_ClassBuckets.empty()) {
+        GumboAttribute *attr = gumbo_get_attribute(&node->v.element.attributes, "class");
+        if (attr) {
+            const char *p = attr->value;
+            while (*p) {
+                while (*p && IsSpace(*p)) p++;
+                const char *class_start = p;
+                while (*p && !IsSpace(*p)) p++;
+                if (p > class_start) {
+                    auto it = m_ClassBuckets.find(std::string(class_start, p - class_start));
+                    if (it != m_ClassBuckets.end()) {
+                        TryBucket(it->second, node, matched, unmatched);
+                    }
+                }
+            }
+        }
+    }
+
+    GumboVector *children = &node->v.element.children;
+    for (unsigned int i = 0; (i < children->length) && (unmatched > 0); ++i) {
+        MatchNode(static_cast<GumboNode*>(children->data[i]), matched, unmatched);
+    }
+}
+
+
+void SelectorIndex::TryBucket(const std::vector<int> &bucket, GumboNode *node,
+                              std::vector<bool> &matched, int &unmatched) const
+{
+    for (int selector_number : bucket) {
+        if (!matched[selector_number] && m_Selectors[selector_number]->match(node)) {
+            matched[selector_number] = true;
+            unmatched--;
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef SELECTORINDEX_H
+#define SELECTORINDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gumbo.h"
+
+class CSelector;
+class QString;
+
+/**
+ * A set of CSS selectors compiled once and matched against whole
+ * documents in a single tree walk.
+ *
+ * Selectors are bucketed by the id, class or tag their rightmost
+ * compound selector requires, so each node is only tested against the
+ * selectors that could possibly match it. Selectors without any such
+ * requirement are tested against every node. The bucketing is only a
+ * prefilter, the compiled selector has the final say, so the results
+ * are those of running GumboInterface::find for every selector.
+ */
+class SelectorIndex
+{
+
+public:
+    SelectorIndex();
+    ~SelectorIndex();
+
+    SelectorIndex(const SelectorIndex&) = delete;
+    SelectorIndex& operator=(const SelectorIndex&) = delete;
+
+    /**
+     * Compiles and adds a selector.
+     *
+     * @return The number of the selector, in the order added.
+     */
+    int AddSelector(const QString &selector_text);
+
+    int Count() const { return static_cast<int>(m_Selectors.size()); }
+
+    /**
+     * Whether the selector could not be compiled. Such selectors never match.
+     */
+    bool HasParseError(int selector_number) const { return m_Selectors[selector_number] == NULL; }
+
+    /**
+     * Matches every selector against the tree below root (as gumbo query
+     * does from the root element) and returns for each one whether it
+     * matched at least one node. Safe to use from several threads at once.
+     */
+    std::vector<bool> MatchTree(GumboNode *root) const;
+
+private:
+    enum KeyType {
+        KeyType_None,
+        KeyType_Id,
+        KeyType_Class,
+        KeyType_Tag
+    };
+
+    struct SelectorKey {
+        KeyType type;
+        std::string value;
+    };
+
+    // Works out what the rightmost compound selector of one selector
+    // (no top level commas) requires of the node it matches
+    static SelectorKey GetKey(const std::string &selector);
+
+    // Splits a selector group at its top level commas
+    static std::vector<std::string> SplitGroup(const std::string &selector);
+
+    void AddToBucket(const SelectorKey &key, int selector_number);
+
+    void MatchNode(GumboNode *node, std::vector<bool> &matched, int &unmatched) const;
+
+    void TryBucket(const std::vector<int> &bucket, GumboNode *node,
+                   std::vector<bool> &matched, int &unmatched) const;
+
+    // compiled selectors, NULL for those that did not compile
+    std::vector<CSelector *> m_Selectors;
+
+    std::unordered_map<std::string, std::vector<int>> m_IdBuckets;
+    std::unordered_map<std::string, std::vector<int>> m_ClassBuckets;
+    std::vector<std::vector<int>> m_TagBuckets;
+
+    // selectors to try on every node
+    std::vector<int> m_Unkeyed;
+};
+
+#endif // SELECTORINDEX_H
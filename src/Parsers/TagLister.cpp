@@ -23,6 +23,7 @@
 #include <QString>
 #include <QStringList>
 #include <QList>
+#include <QHash>
 #include <QStringView>
 #include <QDebug>
 
@@ -32,6 +33,9 @@
 
 const QString WHITESPACE_CHARS=" \t\n\r";  // valid in pure xml
 
+// indexed by TagType
+static const QString TAG_TYPE_NAMES[] = { "", "xmlheader", "pi", "comment", "doctype", "cdata", "begin", "single", "end" };
+
 // public interface
 
 // Default Constructor
@@ -39,29 +43,20 @@ TagLister::TagLister()
     : m_source(""),
       m_pos(0),
       m_next(0),
-      m_child(-1),
       m_bodyStartPos(-1),
       m_bodyEndPos(-1),
       m_bodyOpenTag(-1),
       m_bodyCloseTag(-1)
 {
-    m_TagPath << "root";
-    m_TagPos << -1;
-    m_TagLen << 0;
-    m_TagChild << -1;
+    buildTagList();
 }
 
 // Normal Constructor
 TagLister::TagLister(const QString &source)
     : m_source(source),
       m_pos(0),
-      m_next(0),
-      m_child(-1)
+      m_next(0)
 {
-    m_TagPath << "root";
-    m_TagPos << -1;
-    m_TagLen << 0;
-    m_TagChild << -1;
     buildTagList();
 }
 
@@ -71,24 +66,190 @@ void TagLister::reloadLister(const QString& source)
     m_source = source;
     m_pos = 0;
     m_next = 0;
-    m_child = -1;
-    m_TagPath = QStringList() << "root";
-    m_TagPos = QList<int>() << -1;
-    m_TagLen = QList<int>() << 0;
-    m_TagChild = QList<int>() << -1;
     buildTagList();
 }
 
-const TagLister::TagInfo& TagLister::at(int i)
+
+// keeps every list the same length, values replace the entries first to last
+template <typename T>
+static void SpliceList(QList<T> &list, int first, int last, const QList<T> &values)
+{
+    int count_delta = values.size() - (last - first);
+    if (count_delta > 0) {
+        list.insert(last, count_delta, T());
+    } else if (count_delta < 0) {
+        list.remove(first + values.size(), -count_delta);
+    }
+    for (int i = 0; i < values.size(); i++) {
+        list[first + i] = values.at(i);
+    }
+}
+
+
+bool TagLister::updateLister(int position, int chars_removed, const QString &inserted)
+{
+    if ((position < 0) || (chars_removed < 0) || (position + chars_removed > m_source.length())) {
+        return false;
+    }
+    int delta = inserted.length() - chars_removed;
+    int old_end = position + chars_removed;
+    int new_end = position + inserted.length();
+    m_source.replace(position, chars_removed, inserted);
+
+    // the lists end with a dummy tag
+    int ntags = m_TagPos.size() - 1;
+
+    // tags that end before the edit lex the same, so restart
+    // the lexer at the end of the last of them
+    int lo = 0;
+    int hi = ntags;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_TagPos.at(mid) + m_TagLen.at(mid) < position) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int first = lo;
+    m_next = 0;
+    if (first > 0) {
+        m_next = m_TagPos.at(first - 1) + m_TagLen.at(first - 1);
+    }
+
+    // re-lex until a tag after the edit starts where an old tag did,
+    // from there on the lexer would produce the old tags again
+    QList<LexedTag> new_tags;
+    int last = first;
+    LexedTag lt = lexNext();
+    while (lt.len != -1) {
+        if (lt.pos >= new_end) {
+            int old_pos = lt.pos - delta;
+            while ((last < ntags) && (m_TagPos.at(last) < old_pos)) last++;
+            if ((last < ntags) && (m_TagPos.at(last) == old_pos)) break;
+        }
+        new_tags << lt;
+        lt = lexNext();
+    }
+    if (lt.len == -1) last = ntags;
+
+    // walk the old and the new tags side by side from the same open tags
+    // so we know when the pairing after the damaged tags is the same again
+    TagStack old_stack = stackBeforeTag(first);
+    TagStack new_stack = old_stack;
+    bool body_changed = false;
+    int child;
+    int parent;
+    for (int i = first; i < last; i++) {
+        LexedTag old_lt;
+        old_lt.pos = m_TagPos.at(i);
+        old_lt.len = m_TagLen.at(i);
+        old_lt.name = m_TagName.at(i);
+        old_lt.type = TagType(m_TagType.at(i));
+        if (m_Names.at(old_lt.name) == "body") body_changed = true;
+        placeTag(old_lt, i, old_stack, child, parent, true);
+    }
+    QList<int> new_pos, new_len, new_child, new_parent, new_name;
+    QList<quint8> new_type;
+    for (int i = 0; i < new_tags.size(); i++) {
+        const LexedTag &nlt = new_tags.at(i);
+        if (m_Names.at(nlt.name) == "body") body_changed = true;
+        placeTag(nlt, first + i, new_stack, child, parent);
+        new_pos << nlt.pos;
+        new_len << nlt.len;
+        new_child << child;
+        new_parent << parent;
+        new_name << nlt.name;
+        new_type << nlt.type;
+    }
+
+    // splice in the re-lexed tags
+    int count_delta = new_tags.size() - (last - first);
+    SpliceList(m_TagPos, first, last, new_pos);
+    SpliceList(m_TagLen, first, last, new_len);
+    SpliceList(m_TagChild, first, last, new_child);
+    SpliceList(m_TagParent, first, last, new_parent);
+    SpliceList(m_TagName, first, last, new_name);
+    SpliceList(m_TagType, first, last, new_type);
+
+    // shift the tags after them, re-pairing them only until both walks agree,
+    // then the open tags replaced above are renumbered from the stacks
+    bool in_step = isSameStack(old_stack, new_stack, old_end, delta);
+    QHash<int, int> renumbered;
+    if (in_step) {
+        for (int k = 0; k < old_stack.open.size(); k++) {
+            renumbered[old_stack.open.at(k).index] = new_stack.open.at(k).index;
+        }
+    }
+    for (int i = first + new_tags.size(); i < m_TagPos.size() - 1; i++) {
+        if (!in_step) {
+            LexedTag slt;
+            slt.pos = m_TagPos.at(i);
+            slt.len = m_TagLen.at(i);
+            slt.name = m_TagName.at(i);
+            slt.type = TagType(m_TagType.at(i));
+            placeTag(slt, i - count_delta, old_stack, child, parent, true);
+            slt.pos += delta;
+            placeTag(slt, i, new_stack, child, parent);
+            m_TagPos[i] = slt.pos;
+            m_TagChild[i] = child;
+            m_TagParent[i] = parent;
+            in_step = isSameStack(old_stack, new_stack, old_end, delta);
+            if (in_step) {
+                for (int k = 0; k < old_stack.open.size(); k++) {
+                    renumbered[old_stack.open.at(k).index] = new_stack.open.at(k).index;
+                }
+            }
+        } else {
+            m_TagPos[i] += delta;
+            int old_parent = m_TagParent.at(i);
+            if (old_parent >= last) {
+                m_TagParent[i] = old_parent + count_delta;
+            } else if (old_parent >= first) {
+                m_TagParent[i] = renumbered.value(old_parent, -1);
+            }
+        }
+    }
+
+    if (body_changed) {
+        findBodyTags();
+    } else {
+        if (m_bodyOpenTag >= last) {
+            m_bodyOpenTag += count_delta;
+            m_bodyStartPos += delta;
+        }
+        if (m_bodyCloseTag >= last) {
+            m_bodyCloseTag += count_delta;
+            m_bodyEndPos += delta;
+        }
+    }
+    return true;
+}
+
+
+TagLister::TagInfo TagLister::at(int i)
 {
-    if ((i < 0) || (i >= m_Tags.size())) {
-        i = m_Tags.size() - 1; // last entry in list is a dummy entry
+    if ((i < 0) || (i >= m_TagPos.size())) {
+        i = m_TagPos.size() - 1; // last entry in list is a dummy entry
+    }
+    TagInfo ti;
+    ti.pos = m_TagPos.at(i);
+    ti.len = m_TagLen.at(i);
+    ti.child = m_TagChild.at(i);
+    ti.tname = m_Names.at(m_TagName.at(i));
+    ti.ttype = TAG_TYPE_NAMES[m_TagType.at(i)];
+    ti.open_pos = -1;
+    ti.open_len = -1;
+    if (isEndOfOpenTag(i)) {
+        int open_tag = m_TagParent.at(i);
+        ti.open_pos = m_TagPos.at(open_tag);
+        ti.open_len = m_TagLen.at(open_tag);
     }
-    return m_Tags.at(i);
+    return ti;
 }
 
 
-size_t TagLister::size() { return m_Tags.size(); }
+size_t TagLister::size() { return m_TagPos.size(); }
 
 
 const QString& TagLister::getSource() { return m_source; }
@@ -104,8 +265,7 @@ bool TagLister::isPositionInBody(int pos)
 bool TagLister::isPositionInTag(int pos)
 {
     int i = findFirstTagOnOrAfter(pos);
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if ((pos >= ti.pos) && (pos < ti.pos + ti.len)) {
+    if ((pos >= m_TagPos.at(i)) && (pos < m_TagPos.at(i) + m_TagLen.at(i))) {
         return true;
     }
     return false;
@@ -114,9 +274,8 @@ bool TagLister::isPositionInTag(int pos)
 bool TagLister::isPositionInOpenTag(int pos)
 {
     int i = findFirstTagOnOrAfter(pos);
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if ((pos >= ti.pos) && (pos < ti.pos + ti.len)) {
-        if ((ti.ttype == "begin") || (ti.ttype == "single")) return true;
+    if ((pos >= m_TagPos.at(i)) && (pos < m_TagPos.at(i) + m_TagLen.at(i))) {
+        if ((m_TagType.at(i) == TagType_Begin) || (m_TagType.at(i) == TagType_Single)) return true;
     }
     return false;
 }
@@ -124,9 +283,8 @@ bool TagLister::isPositionInOpenTag(int pos)
 bool TagLister::isPositionInCloseTag(int pos)
 {
     int i = findFirstTagOnOrAfter(pos);
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if ((pos >= ti.pos) && (pos < ti.pos + ti.len)) {
-        if (ti.ttype == "end") return true;
+    if ((pos >= m_TagPos.at(i)) && (pos < m_TagPos.at(i) + m_TagLen.at(i))) {
+        if (m_TagType.at(i) == TagType_End) return true;
     }
     return false;
 }
@@ -134,45 +292,40 @@ bool TagLister::isPositionInCloseTag(int pos)
 
 int TagLister::findOpenTagForClose(int i)
 {
-    if ((i < 0) || (i >= m_Tags.size())) return -1;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if (ti.ttype != "end") return -1;
-    int open_pos = ti.open_pos;
-    for (int j=i-1; j >= 0; j--) {
-        TagInfo tb = m_Tags.at(j);
-        if (tb.pos == open_pos) return j;
-    }
-    return -1;
+    if ((i < 0) || (i >= m_TagPos.size())) return -1;
+    if (m_TagType.at(i) != TagType_End) return -1;
+    if (!isEndOfOpenTag(i)) return -1;
+    return m_TagParent.at(i);
 }
 
 int TagLister::findCloseTagForOpen(int i)
 {
-    if ((i < 0) || (i >= m_Tags.size())) return -1;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if (ti.ttype != "begin") return -1;
-    int open_pos = ti.pos;
-    for (int j=i+1; j < m_Tags.size(); j++) {
-        TagInfo te = m_Tags.at(j);
-        if (te.open_pos == open_pos) return j;
+    if ((i < 0) || (i >= m_TagPos.size())) return -1;
+    if (m_TagType.at(i) != TagType_Begin) return -1;
+    for (int j=i+1; j < m_TagPos.size(); j++) {
+        if ((m_TagParent.at(j) == i) && isEndOfOpenTag(j)) return j;
     }
     return -1;
 }
 
 // There may not be one here if no tags exists because
-// the front of m_Tags is not padded with a dummy tag
+// the front of the tag list is not padded with a dummy tag
 // so this can return -1 meaning none exists
 int TagLister::findLastTagOnOrBefore(int pos)
 {
     // find that tag that starts immediately **after** pos and then
-    // then use its predecessor 
-    int i = 0;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    while((ti.pos <= pos) && (ti.len != -1)) {
-        i++;
-        ti = m_Tags.at(i);
+    // then use its predecessor, tags are in position order
+    int lo = 0;
+    int hi = m_TagPos.size() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_TagPos.at(mid) <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    i--;
-    return i;
+    return lo - 1;
 }
 
 // this routine can return -1 meaning none exists
@@ -185,39 +338,32 @@ int TagLister::findLastOpenOrSingleTagThatContainsYou(int pos)
     if (bpos < m_bodyStartPos) bpos = m_bodyStartPos;
 
     int k = findLastTagOnOrBefore(bpos);
-    TagLister::TagInfo ti = m_Tags.at(k);
+    if (k < 0) return -1;
 
     // test if it contains you
     // if bpos inside a single tag use it
-    if (ti.ttype == "single") {
-        if ((bpos >= ti.pos) && (bpos < ti.pos + ti.len)) return k;
+    if (m_TagType.at(k) == TagType_Single) {
+        if ((bpos >= m_TagPos.at(k)) && (bpos < m_TagPos.at(k) + m_TagLen.at(k))) return k;
     }
 
     // if bpos inside a begin tag and a child of it, use it
-    if (ti.ttype == "begin") {
+    if (m_TagType.at(k) == TagType_Begin) {
         int ci  = findCloseTagForOpen(k);
         if (ci != -1) {
-            TagLister::TagInfo cls = m_Tags.at(ci);
-            if ((bpos >= ti.pos) && (bpos < (cls.pos + cls.len))) return k;
+            if ((bpos >= m_TagPos.at(k)) && (bpos < (m_TagPos.at(ci) + m_TagLen.at(ci)))) return k;
         }
     }
 
     // ow. start search at last tag on or before and stop for closest single or begin tag
     int i = k;
-    bool found = false;
-    while ((i >= 0) && !found) {
-        TagLister::TagInfo ti = m_Tags.at(i);
-        if (ti.ttype == "single") {
-            found = true;
-        }
-        if (ti.ttype == "begin") {
-            found = true;
+    while (i >= 0) {
+        if ((m_TagType.at(i) == TagType_Single) || (m_TagType.at(i) == TagType_Begin)) {
+            return i;
         }
         // if not found try the preceding tag
-        if (!found) i = i - 1;
+        i = i - 1;
     }
-    if (!found) return -1;
-    return i;
+    return -1;
 }
 
 // this routine can return -1 meaning none exists
@@ -230,15 +376,11 @@ int TagLister::findLastOpenTagOnOrBefore(int pos)
     if (bpos <= m_bodyStartPos) bpos = m_bodyStartPos;
 
     int i = findLastTagOnOrBefore(bpos);
-    bool found = false;
-    while ((i >= 0) && !found) {
-        if (m_Tags.at(i).ttype == "begin") found = true;
-        if (!found) i = i - 1;
-    }
-    if (!found) {
-        return -1;
+    while (i >= 0) {
+        if (m_TagType.at(i) == TagType_Begin) return i;
+        i = i - 1;
     }
-    return i;
+    return -1;
 }
 
 QString TagLister::GeneratePathToTag(int pos)
@@ -246,21 +388,25 @@ QString TagLister::GeneratePathToTag(int pos)
     int i = findLastOpenOrSingleTagThatContainsYou(pos);
     // int i = findLastOpenTagOnOrBefore(pos);
     if (i < 0) return "html -1";
-    TagInfo ti = m_Tags.at(i);
-    return ti.tpath;
+    return makePathToTag(i);
 }
 
-// m_Tags is padded with an ending dummy tag
+// the tag list is padded with an ending dummy tag
 // So finding first tag on or after a pos will always work
 int TagLister::findFirstTagOnOrAfter(int pos)
 {
-    int i = 0;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    while((ti.pos + ti.len <= pos) && (ti.len != -1)) {
-        i++;
-        ti = m_Tags.at(i);
+    // tags do not overlap so their ends are in order too
+    int lo = 0;
+    int hi = m_TagPos.size() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_TagPos.at(mid) + m_TagLen.at(mid) <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    return i;
+    return lo;
 }
 
 
@@ -377,77 +523,166 @@ QString TagLister::extractAllAttributes(const QStringView tagstring)
 
 // private routines
 
-QString TagLister::makePathToTag()
+// the path of a begin or single tag, its ancestors with the child number
+// of the next tag down, ending with the tag itself
+QString TagLister::makePathToTag(int i)
 {
-    int i = 1; // skip over root
     QStringList tagpath;
-    while (i < m_TagPath.size()) {
-        int child_index = -1;
-        if (i+1 < m_TagPath.size()) child_index = m_TagChild.at(i+1);
-        tagpath << m_TagPath.at(i) + " " + QString::number(child_index);
-        i = i + 1;
+    int child_index = -1;
+    while (i != -1) {
+        tagpath.prepend(m_Names.at(m_TagName.at(i)) + " " + QString::number(child_index));
+        child_index = m_TagChild.at(i);
+        i = m_TagParent.at(i);
     }
     return tagpath.join(",");
 }
 
-TagLister::TagInfo TagLister::getNext()
+// an end tag that closed an open tag has its child number set
+bool TagLister::isEndOfOpenTag(int i)
+{
+    return (m_TagType.at(i) == TagType_End) && (m_TagChild.at(i) != -1);
+}
+
+int TagLister::internName(const QStringView name)
 {
-    TagInfo mi;
-    mi.pos = -1;
-    mi.len = -1;
-    mi.open_pos = -1;
-    mi.open_len = -1;
-    mi.child = -1;
+    auto it = m_NameIds.constFind(name);
+    if (it != m_NameIds.constEnd()) {
+        return it.value();
+    }
+    int id = m_Names.size();
+    m_Names << name.toString();
+    m_NameIds.insert(QStringView(m_Names.last()), id);
+    return id;
+}
+
+// finds the next tag but leaves its place in the tree unset
+TagLister::LexedTag TagLister::lexNext()
+{
+    LexedTag lt;
+    lt.pos = -1;
+    lt.len = -1;
+    lt.name = 0;
+    lt.type = TagType_None;
     QStringView markup = parseML();
     while (!markup.isNull()) {
         if ((markup.at(0) == '<') && (markup.at(markup.size() - 1) == '>')) {
-            mi.pos = m_pos;
-            parseTag(markup, mi);
-            if (mi.ttype == "begin") {
-                m_TagPos << mi.pos;
-                m_TagLen << mi.len;
-                mi.child = ++m_child;
-                m_TagChild << mi.child;
-                m_child = -1;
-                m_TagPath << mi.tname;
-                mi.tpath = makePathToTag();
-
-            } else if (mi.ttype == "single") {
-                // for path purposes temporarily treat like open tag
-                // until makePathToTag is calculated
-                mi.child = ++m_child;
-                m_TagChild << mi.child;
-                m_TagPath << mi.tname;
-                mi.tpath = makePathToTag();
-                // then remove it from tagpath since single and has no children
-                m_TagPath.removeLast();
-                m_TagChild.removeLast();
-
-            } else if (mi.ttype == "end") {
-                QString pathnode = m_TagPath.last();
-                if (pathnode.startsWith(mi.tname)) {
-                    m_TagPath.removeLast();
-                    mi.open_pos = m_TagPos.takeLast();
-                    mi.open_len = m_TagLen.takeLast();
-                    mi.child = m_TagChild.takeLast();
-                    m_child = mi.child;
-                } else {
-                    qDebug() << "TagLister Error: Not well formed -  open close mismatch: ";
-                    qDebug() << "   open Tag: " << pathnode << " at position: " << m_TagPos.last();
-                    qDebug() << "   close Tag: " << mi.tname << " at position: " << mi.pos;
-                    mi.open_pos = -1;
-                    mi.open_len = -1;
-                    mi.child = -1;
-                }
-                mi.tpath = makePathToTag();
-            }
-            return mi;
+            lt.pos = m_pos;
+            parseTag(markup, lt);
+            return lt;
         }
         // skip anything not a tag
         markup = parseML();
     }
     // done
-    return mi;
+    return lt;
+}
+
+// works out the child number and parent of tag number index
+// a replay of already known tags reports no errors
+void TagLister::placeTag(const LexedTag &lt, int index, TagStack &stack, int &child, int &parent, bool replay)
+{
+    child = -1;
+    parent = -1;
+    if (!stack.open.isEmpty()) parent = stack.open.last().index;
+
+    if (lt.type == TagType_Begin) {
+        child = ++stack.last_child;
+        OpenTag ot;
+        ot.index = index;
+        ot.pos = lt.pos;
+        ot.len = lt.len;
+        ot.child = child;
+        ot.name = lt.name;
+        stack.open << ot;
+        stack.last_child = -1;
+
+    } else if (lt.type == TagType_Single) {
+        child = ++stack.last_child;
+
+    } else if (lt.type == TagType_End) {
+        // an end tag with an empty name must not close anything
+        if (!stack.open.isEmpty() &&
+            m_Names.at(stack.open.last().name).startsWith(m_Names.at(lt.name))) {
+            child = stack.open.takeLast().child;
+            stack.last_child = child;
+        } else if (!replay) {
+            qDebug() << "TagLister Error: Not well formed -  open close mismatch: ";
+            if (!stack.open.isEmpty()) {
+                qDebug() << "   open Tag: " << m_Names.at(stack.open.last().name) << " at position: " << stack.open.last().pos;
+            }
+            qDebug() << "   close Tag: " << m_Names.at(lt.name) << " at position: " << lt.pos;
+        }
+    }
+}
+
+void TagLister::appendTag(const LexedTag &lt, int child, int parent)
+{
+    m_TagPos << lt.pos;
+    m_TagLen << lt.len;
+    m_TagChild << child;
+    m_TagParent << parent;
+    m_TagName << lt.name;
+    m_TagType << lt.type;
+}
+
+// the open tags just before tag i, from the tags before it
+TagLister::TagStack TagLister::stackBeforeTag(int i)
+{
+    TagStack stack;
+    stack.last_child = -1;
+    if (i == 0) {
+        return stack;
+    }
+    int j = i - 1;
+    int top;
+    if (m_TagType.at(j) == TagType_Begin) {
+        top = j;
+    } else if (isEndOfOpenTag(j)) {
+        top = m_TagParent.at(m_TagParent.at(j));
+    } else {
+        top = m_TagParent.at(j);
+    }
+    while (top != -1) {
+        OpenTag ot;
+        ot.index = top;
+        ot.pos = m_TagPos.at(top);
+        ot.len = m_TagLen.at(top);
+        ot.child = m_TagChild.at(top);
+        ot.name = m_TagName.at(top);
+        stack.open.prepend(ot);
+        top = m_TagParent.at(top);
+    }
+
+    // the child number last handed out at this level
+    while (j >= 0) {
+        if (m_TagType.at(j) == TagType_Begin) {
+            break;
+        }
+        if ((m_TagType.at(j) == TagType_Single) || isEndOfOpenTag(j)) {
+            stack.last_child = m_TagChild.at(j);
+            break;
+        }
+        j--;
+    }
+    return stack;
+}
+
+// static
+bool TagLister::isSameStack(const TagStack &old_stack, const TagStack &new_stack, int old_end, int delta)
+{
+    if ((old_stack.last_child != new_stack.last_child) || (old_stack.open.size() != new_stack.open.size())) {
+        return false;
+    }
+    for (int i = old_stack.open.size() - 1; i >= 0; i--) {
+        const OpenTag &ot = old_stack.open.at(i);
+        const OpenTag &nt = new_stack.open.at(i);
+        int pos = ot.pos;
+        if (pos >= old_end) pos += delta;
+        if ((pos != nt.pos) || (ot.len != nt.len) || (ot.child != nt.child) || (ot.name != nt.name)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 
@@ -485,33 +720,33 @@ QStringView TagLister::parseML()
 }
 
 
-void TagLister::parseTag(const QStringView tagstring, TagLister::TagInfo& mi)
+void TagLister::parseTag(const QStringView tagstring, TagLister::LexedTag& lt)
 {
-    mi.len = tagstring.length();
+    lt.len = tagstring.length();
     QChar c = tagstring.at(1);
     int p = 0;
     
     // first handle special cases
     if (c == '?') {
         if (tagstring.startsWith(QL1SV("<?xml"))) {
-            mi.tname = "?xml";
-            mi.ttype = "xmlheader";
+            lt.name = internName(u"?xml");
+            lt.type = TagType_XmlHeader;
         } else {
-            mi.tname = "?";
-            mi.ttype = "pi";
+            lt.name = internName(u"?");
+            lt.type = TagType_PI;
         }
         return;
     }
     if (c == '!') {
         if (tagstring.startsWith(QL1SV("<!--"))) {
-            mi.tname = "!--";
-            mi.ttype = "comment"; 
+            lt.name = internName(u"!--");
+            lt.type = TagType_Comment;
         } else if (tagstring.startsWith(QL1SV("<!DOCTYPE")) || tagstring.startsWith(QL1SV("<!doctype"))) {
-            mi.tname = "!DOCTYPE";
-            mi.ttype = "doctype";
+            lt.name = internName(u"!DOCTYPE");
+            lt.type = TagType_Doctype;
         } else if (tagstring.startsWith(QL1SV("<![CDATA[")) || tagstring.startsWith(QL1SV("<![cdata["))) {
-            mi.tname = "![CDATA[";
-            mi.ttype = "cdata";
+            lt.name = internName(u"![CDATA[");
+            lt.type = TagType_CData;
         }
         return;
     }
@@ -519,19 +754,19 @@ void TagLister::parseTag(const QStringView tagstring, TagLister::TagInfo& mi)
     // normal tag, extract tag name
     p = skipAnyBlanks(tagstring, 1);
     if (tagstring.at(p) == '/') {
-        mi.ttype = "end";
+        lt.type = TagType_End;
         p++;
         p = skipAnyBlanks(tagstring, p);
     };
     int b = p;
     p = stopWhenContains(tagstring, ">/ \f\t\r\n", p);
-    mi.tname = Utility::Substring(b, p, tagstring);
+    lt.name = internName(tagstring.mid(b, p - b));
 
     // fill in tag type
-    if (mi.ttype.isEmpty()) {
-        mi.ttype = "begin";
+    if (lt.type == TagType_None) {
+        lt.type = TagType_Begin;
         if (tagstring.endsWith(QL1SV("/>")) || tagstring.endsWith(QL1SV("/ >"))) {
-            mi.ttype = "single";
+            lt.type = TagType_Single;
         }
     }
     return;
@@ -564,32 +799,48 @@ int TagLister::stopWhenContains(const QStringView tgt, const QString& stopchars,
 
 void TagLister::buildTagList()
 {
-        m_Tags.clear();
+        m_TagPos.clear();
+        m_TagLen.clear();
+        m_TagChild.clear();
+        m_TagParent.clear();
+        m_TagName.clear();
+        m_TagType.clear();
+        m_NameIds.clear();
+        m_Names.clear();
+        // name 0 is the empty name of the dummy tag
+        internName(QStringView());
+
+        TagStack stack;
+        stack.last_child = -1;
+        int child;
+        int parent;
+        LexedTag lt = lexNext();
+        while(lt.len != -1) {
+            placeTag(lt, m_TagPos.size(), stack, child, parent);
+            appendTag(lt, child, parent);
+            lt = lexNext();
+        }
+        // set stop indicator as last record
+        appendTag(lt, -1, -1);
+        findBodyTags();
+}
+
+
+void TagLister::findBodyTags()
+{
         m_bodyStartPos = -1;
         m_bodyEndPos = -1;
         m_bodyOpenTag = -1;
         m_bodyCloseTag = -1;
-        int i = 0;
-        TagLister::TagInfo ti = getNext();
-        while(ti.len != -1) {
-            if ((ti.tname == "body") && (ti.ttype == "begin")) {
-                m_bodyStartPos = ti.pos + ti.len;
+        for (int i = 0; i < m_TagPos.size() - 1; i++) {
+            if (m_Names.at(m_TagName.at(i)) != "body") continue;
+            if (m_TagType.at(i) == TagType_Begin) {
+                m_bodyStartPos = m_TagPos.at(i) + m_TagLen.at(i);
                 m_bodyOpenTag = i;
             }
-            if ((ti.tname == "body") && (ti.ttype == "end")) {
-                m_bodyEndPos = ti.pos - 1;
+            if (m_TagType.at(i) == TagType_End) {
+                m_bodyEndPos = m_TagPos.at(i) - 1;
                 m_bodyCloseTag = i;
             }
-            TagLister::TagInfo temp = ti;
-            m_Tags << temp;
-            i++;
-            ti = getNext();
         }
-        // set stop indicator as last record
-        TagLister::TagInfo temp;
-        temp.pos = -1;
-        temp.len = -1;
-        temp.open_pos = -1;
-        temp.open_len = -1;
-        m_Tags << temp;
 }
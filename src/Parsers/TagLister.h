@@ -25,6 +25,7 @@
 #include <QStringList>
 #include <QStringView>
 #include <QList>
+#include <QHash>
 
 class QString;
 
@@ -32,11 +33,23 @@ class TagLister
 {
 public:
 
+    enum TagType {
+        TagType_None,
+        TagType_XmlHeader,
+        TagType_PI,
+        TagType_Comment,
+        TagType_Doctype,
+        TagType_CData,
+        TagType_Begin,
+        TagType_Single,
+        TagType_End
+    };
+
+    // a copy of one tag's entry, tname and ttype share the lister's strings
     struct TagInfo {
         int     pos;      // position of tag in source
         int     len;      // length of tag in source
         int     child;    // child number of this tag in its parent
-        QString tpath;    // path of tag names to this tag ("." joined)
         QString tname;    // tag name, ?xml, ?, !--, !DOCTYPE, ![CDATA[
         QString ttype;    // xmlheader, pi, comment, doctype, cdata, begin, single, end
         int     open_pos; // set if end tag to position of its corresponding begin tag
@@ -60,7 +73,13 @@ public:
 
     void reloadLister(const QString &source);
 
-    const TagInfo& at(int i);
+    // Brings the list up to date after chars_removed characters at position
+    // in the source were replaced by inserted, re-lexing only the damaged tags.
+    // Returns false if the edit does not fit the current source, the caller
+    // must then use reloadLister instead.
+    bool updateLister(int position, int chars_removed, const QString &inserted);
+
+    TagInfo at(int i);
     size_t size();
 
     bool isPositionInBody(int pos);
@@ -85,13 +104,43 @@ public:
     static QString extractAllAttributes(const QStringView tagstring);
     
 private:
-    TagInfo getNext();
+    // a tag as found by the lexer, before it is placed in the tree
+    struct LexedTag {
+        int     pos;
+        int     len;
+        int     name;
+        TagType type;
+    };
+
+    struct OpenTag {
+        int index;
+        int pos;
+        int len;
+        int child;
+        int name;
+    };
+
+    // the currently open tags while walking the tags in order
+    struct TagStack {
+        QList<OpenTag> open;
+        int            last_child;
+    };
+
+    LexedTag lexNext();
+    void  placeTag(const LexedTag &lt, int index, TagStack &stack, int &child, int &parent, bool replay = false);
+    void  appendTag(const LexedTag &lt, int child, int parent);
     void  buildTagList();
-    QString makePathToTag();
+    void  findBodyTags();
+    QString makePathToTag(int i);
+    int   internName(const QStringView name);
+    bool  isEndOfOpenTag(int i);
+
+    TagStack stackBeforeTag(int i);
+    static bool isSameStack(const TagStack &old_stack, const TagStack &new_stack, int old_end, int delta);
 
     QStringView parseML();
 
-    void parseTag(const QStringView tagstring, TagInfo &mi);
+    void parseTag(const QStringView tagstring, LexedTag &lt);
 
     int findTarget(const QString &tgt, int p, bool after=false);
     static int skipAnyBlanks(const QStringView segment, int p);
@@ -100,12 +149,19 @@ private:
     QString        m_source;
     int            m_pos;
     int            m_next;
-    int            m_child;
-    QStringList    m_TagPath;
+
+    // one entry per tag in source order followed by a dummy stop entry
     QList<int>     m_TagPos;
     QList<int>     m_TagLen;
     QList<int>     m_TagChild;
-    QList<TagInfo> m_Tags;
+    QList<int>     m_TagParent;  // innermost open begin tag, for an end tag its begin tag
+    QList<int>     m_TagName;    // index into m_Names
+    QList<quint8>  m_TagType;
+
+    // interned tag names, the views point into m_Names
+    QStringList    m_Names;
+    QHash<QStringView, int> m_NameIds;
+
     int            m_bodyStartPos;
     int            m_bodyEndPos;
     int            m_bodyOpenTag;
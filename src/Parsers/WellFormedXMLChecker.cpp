@@ -0,0 +1,2405 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks Stratford, ON, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <cstring>
+
+#include <QString>
+#include <QStringView>
+
+#include "Parsers/WellFormedXMLChecker.h"
+
+// The messages and the positions they are reported at follow libxml2 so
+// the results match what lxml reported when this check was done in python
+
+static const QString XML_NAMESPACE = "http://www.w3.org/XML/1998/namespace";
+static const QString XMLNS_NAMESPACE = "http://www.w3.org/2000/xmlns/";
+static const int MAX_ENTITY_DEPTH = 40;
+static const QString ENTITY_LOOP_ERROR = "Detected an entity reference loop";
+static const QString ATTVALUE_LENGTH_ERROR = "AttValue length too long";
+// libxml2 gives up on an attribute value longer than this and on entities
+// that expand far beyond the part of the document read so far
+static const qint64 MAX_TEXT_LENGTH = 10000000;
+static const qint64 BIG_ENTITY = 1000;
+static const qint64 NON_LINEAR = 10;
+// the buffer an entity is expanded into, its size is checked as it grows
+static const qint64 EXPANSION_BUFFER = 300;
+static const qint64 EXPANSION_MARGIN = 100;
+static const QString CONTENT_BOUNDARY_ERROR = "Element content declaration doesn't start and stop in the same entity";
+static const QString PI_BOUNDARY_ERROR = "PI declaration doesn't start and stop in the same entity";
+static const QString INTERNAL_SUBSET_ERROR = "internal error: xmlParseInternalSubset: error detected in Markup declaration";
+
+static bool is_blank(char32_t c)
+{
+    return (c == 0x20) || (c == 0x09) || (c == 0x0A) || (c == 0x0D);
+}
+
+// anything libxml2 lets into the attribute loop of a start tag
+static bool is_byte_char(char32_t c)
+{
+    return (c >= 0x20) || (c == 0x09) || (c == 0x0A) || (c == 0x0D);
+}
+
+static bool is_xml_char(char32_t c)
+{
+    if (c < 0x20) return (c == 0x09) || (c == 0x0A) || (c == 0x0D);
+    if (c <= 0xD7FF) return true;
+    if (c < 0xE000) return false;
+    if (c <= 0xFFFD) return true;
+    return (c >= 0x10000) && (c <= 0x10FFFF);
+}
+
+static bool is_name_start_char(char32_t c)
+{
+    if (c < 0x80) {
+        return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_') || (c == ':');
+    }
+    return ((c >= 0xC0) && (c <= 0xD6)) || ((c >= 0xD8) && (c <= 0xF6)) ||
+           ((c >= 0xF8) && (c <= 0x2FF)) || ((c >= 0x370) && (c <= 0x37D)) ||
+           ((c >= 0x37F) && (c <= 0x1FFF)) || ((c >= 0x200C) && (c <= 0x200D)) ||
+           ((c >= 0x2070) && (c <= 0x218F)) || ((c >= 0x2C00) && (c <= 0x2FEF)) ||
+           ((c >= 0x3001) && (c <= 0xD7FF)) || ((c >= 0xF900) && (c <= 0xFDCF)) ||
+           ((c >= 0xFDF0) && (c <= 0xFFFD)) || ((c >= 0x10000) && (c <= 0xEFFFF));
+}
+
+static bool is_name_char(char32_t c)
+{
+    if (c < 0x80) {
+        return is_name_start_char(c) || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '.');
+    }
+    return is_name_start_char(c) || (c == 0xB7) ||
+           ((c >= 0x300) && (c <= 0x36F)) || ((c >= 0x203F) && (c <= 0x2040));
+}
+
+static bool in_set(ushort c, const char *set)
+{
+    return (c != 0) && (c < 0x80) && strchr(set, c);
+}
+
+static bool is_digit(ushort c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+static bool is_alpha(ushort c)
+{
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'));
+}
+
+static bool is_hex(ushort c)
+{
+    return is_digit(c) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'));
+}
+
+static bool is_pubid_char(char32_t c)
+{
+    return (c == 0x20) || (c == 0x0D) || (c == 0x0A) || (c < 0x80 && (is_alpha(c) || is_digit(c))) ||
+           in_set(c, "-'()+,./:=?;!*#@$_%");
+}
+
+
+static bool is_predefined_entity(QStringView name)
+{
+    return (name == u"lt") || (name == u"gt") || (name == u"amp") || (name == u"apos") || (name == u"quot");
+}
+
+
+static int utf8_length(char32_t c)
+{
+    return (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+}
+
+
+// libxml2 counts what it has read in utf-8 bytes, each half of a
+// surrogate pair is taken as two of the four bytes
+static qint64 utf8_bytes(QStringView text)
+{
+    qint64 bytes = 0;
+    foreach(QChar c, text) {
+        ushort u = c.unicode();
+        bytes += (u < 0x80) ? 1 : ((u < 0x800) || c.isSurrogate()) ? 2 : 3;
+    }
+    return bytes;
+}
+
+
+// columns count characters and do not count a byte order mark
+static void line_column(QStringView source, qsizetype pos, int &line, int &column)
+{
+    line = 1;
+    column = 1;
+    qsizetype i = 0;
+    if (!source.isEmpty() && (source.at(0).unicode() == 0xFEFF)) {
+        i = 1;
+    }
+    pos = qMin(pos, source.size());
+    for (; i < pos; i++) {
+        QChar c = source.at(i);
+        if (c == u'\n') {
+            line++;
+            column = 1;
+        } else if (!c.isLowSurrogate() || (i == 0) || !source.at(i - 1).isHighSurrogate()) {
+            column++;
+        }
+    }
+}
+
+
+// the character at i with a broken surrogate read as a replacement character
+static char32_t char_at(QStringView text, qsizetype i, int *len = nullptr)
+{
+    int n = 1;
+    char32_t c = 0;
+    if (i < text.size()) {
+        QChar ch = text.at(i);
+        c = ch.unicode();
+        if (ch.isSurrogate()) {
+            if (ch.isHighSurrogate() && (i + 1 < text.size()) && text.at(i + 1).isLowSurrogate()) {
+                c = QChar::surrogateToUcs4(ch, text.at(i + 1));
+                n = 2;
+            } else {
+                c = 0xFFFD;
+            }
+        }
+    }
+    if (len) *len = n;
+    return c;
+}
+
+
+// end of the name that starts at i, i itself if there is none
+static qsizetype name_end(QStringView text, qsizetype i)
+{
+    qsizetype end = i;
+    int len;
+    char32_t c = char_at(text, end, &len);
+    if ((end >= text.size()) || !is_name_start_char(c)) return i;
+    end += len;
+    while (end < text.size()) {
+        c = char_at(text, end, &len);
+        if (!is_name_char(c)) break;
+        end += len;
+    }
+    return end;
+}
+
+
+// length of the scheme and its colon, 0 if uri has none
+static qsizetype scheme_length(QStringView uri)
+{
+    if (uri.isEmpty() || !is_alpha(uri.at(0).unicode())) return 0;
+    for (qsizetype i = 1; i < uri.size(); i++) {
+        ushort c = uri.at(i).unicode();
+        if (c == ':') return i + 1;
+        if (!is_alpha(c) && !is_digit(c) && (c != '+') && (c != '-') && (c != '.')) return 0;
+    }
+    return 0;
+}
+
+// steps over one unreserved, sub-delims or extra character or a %xx escape
+static bool uri_char(QStringView uri, qsizetype &i, const char *extra)
+{
+    if (i >= uri.size()) return false;
+    ushort c = uri.at(i).unicode();
+    if (c == '%') {
+        if ((i + 2 < uri.size()) && is_hex(uri.at(i + 1).unicode()) && is_hex(uri.at(i + 2).unicode())) {
+            i += 3;
+            return true;
+        }
+        return false;
+    }
+    if (is_alpha(c) || is_digit(c) || in_set(c, "-._~!$&'()*+,;=") || in_set(c, extra)) {
+        i++;
+        return true;
+    }
+    return false;
+}
+
+static void uri_authority(QStringView uri, qsizetype &i)
+{
+    qsizetype j = i;
+    while (uri_char(uri, j, ":")) {}
+    if ((j < uri.size()) && (uri.at(j) == u'@')) {
+        i = j + 1;
+    }
+    if ((i < uri.size()) && (uri.at(i) == u'[')) {
+        qsizetype end = uri.indexOf(u']', i);
+        i = (end == -1) ? uri.size() + 1 : end + 1;
+        if (i > uri.size()) return;
+    } else {
+        while (uri_char(uri, i, "")) {}
+    }
+    // libxml2 wants at least one digit after the colon
+    if ((i < uri.size()) && (uri.at(i) == u':')) {
+        i++;
+        if ((i >= uri.size()) || !is_digit(uri.at(i).unicode())) {
+            i = uri.size() + 1;
+            return;
+        }
+        while ((i < uri.size()) && is_digit(uri.at(i).unicode())) i++;
+    }
+}
+
+// whatever follows the authority (or the scheme) up to the end
+static bool uri_rest(QStringView uri, qsizetype i, bool after_authority)
+{
+    if (i > uri.size()) return false;
+    if (after_authority && (i < uri.size()) && !in_set(uri.at(i).unicode(), "/?#")) return false;
+    while (uri_char(uri, i, ":@/")) {}
+    if ((i < uri.size()) && (uri.at(i) == u'?')) {
+        i++;
+        while (uri_char(uri, i, ":@/?")) {}
+    }
+    if ((i < uri.size()) && (uri.at(i) == u'#')) {
+        i++;
+        while (uri_char(uri, i, ":@/?")) {}
+    }
+    return i == uri.size();
+}
+
+// The rfc 3986 uri reference grammar libxml2 checks namespace names with
+static bool is_valid_uri(QStringView uri)
+{
+    qsizetype i = scheme_length(uri);
+    if (i > 0) {
+        bool authority = (uri.mid(i).startsWith(u"//"));
+        if (authority) {
+            i += 2;
+            uri_authority(uri, i);
+        }
+        if (uri_rest(uri, i, authority)) return true;
+    }
+    if (uri.startsWith(u"//")) {
+        i = 2;
+        uri_authority(uri, i);
+        return uri_rest(uri, i, true);
+    }
+    // a relative path may not have a colon in its first segment
+    for (i = 0; (i < uri.size()) && !in_set(uri.at(i).unicode(), "/?#"); i++) {
+        if (uri.at(i) == u':') return false;
+    }
+    return uri_rest(uri, 0, false);
+}
+
+// line ends have been normalized by the time libxml2 copies source text
+// into a message
+static QString normalized_line_ends(QStringView text)
+{
+    QString result = text.toString();
+    if (result.contains(QChar('\r'))) {
+        result.replace("\r\n", "\n");
+        result.replace(QChar('\r'), QChar('\n'));
+    }
+    return result;
+}
+
+
+// the %.50s libxml2 puts into some messages counts utf-8 bytes
+static QString first_50_bytes(QStringView source)
+{
+    QString text = normalized_line_ends(source);
+    int bytes = 0;
+    qsizetype n = 0;
+    while (n < text.size()) {
+        ushort c = text.at(n).unicode();
+        int len = (c < 0x80) ? 1 : (c < 0x800) ? 2 : 3;
+        int units = 1;
+        if (QChar::isHighSurrogate(c) && (n + 1 < text.size()) && text.at(n + 1).isLowSurrogate()) {
+            len = 4;
+            units = 2;
+        }
+        if (bytes + len > 50) break;
+        bytes += len;
+        n += units;
+    }
+    return text.left(n);
+}
+
+static QString out_of_range(char32_t c)
+{
+    return QString("Char 0x%1 out of allowed range").arg(QString::number(c, 16).toUpper());
+}
+
+
+WellFormedXMLChecker::Error WellFormedXMLChecker::Check(QStringView source)
+{
+    WellFormedXMLChecker checker(source);
+    checker.parseDocument();
+    Error error;
+    if (checker.m_Unsupported) {
+        error.unsupported = true;
+        return error;
+    }
+    // lxml also fails a document if the last thing libxml2 complained
+    // about was an error rather than a warning
+    if (checker.m_Fatal || checker.m_LastWasError) {
+        error.line = checker.m_ErrorLine;
+        error.column = checker.m_ErrorColumn;
+        error.message = checker.m_ErrorMessage;
+        while (error.message.endsWith('\n')) {
+            error.message.chop(1);
+        }
+    }
+    return error;
+}
+
+
+WellFormedXMLChecker::WellFormedXMLChecker(QStringView source)
+    : m_source(source),
+      m_pos(0),
+      m_ValuesLength(0),
+      m_HasExternalSubset(false),
+      m_HasPERefs(false),
+      m_InSubset(false),
+      m_InputId(0),
+      m_LastInputId(0),
+      m_Depth(0),
+      m_InheritedNamespaces(0),
+      m_EntityReferences(0),
+      m_LargestReferences(0),
+      m_DeepestExpansion(0),
+      m_FirstExpansions(0),
+      m_SizeChecks(0),
+      m_Reports(0),
+      m_HasText(false),
+      m_HasMarkup(false),
+      m_ValueLength(0),
+      m_ConsumedSource(nullptr),
+      m_ConsumedPos(0),
+      m_ConsumedBytes(0),
+      m_HaveError(false),
+      m_Fatal(false),
+      m_Unsupported(false),
+      m_LastWasError(false),
+      m_ErrorLine(-1),
+      m_ErrorColumn(-1)
+{
+}
+
+
+bool WellFormedXMLChecker::parseDocument()
+{
+    if (!m_source.isEmpty() && (m_source.at(0).unicode() == 0xFEFF)) {
+        m_pos = 1;
+    }
+    // libxml2 stops reading at a nul wherever it looks for the next item
+    if (atEnd() || (m_source.at(m_pos) == QChar(0))) {
+        return fatal(m_pos, "Document is empty");
+    }
+    if (!parseMisc()) return false;
+    if (lookingAt("<!DOCTYPE")) {
+        if (!parseDocType()) return false;
+        if (!atEnd() && (m_source.at(m_pos) == u'[')) {
+            if (!parseInternalSubset()) return false;
+            if (atEnd() || (m_source.at(m_pos) != u'>')) {
+                return fatal(m_pos, "DOCTYPE improperly terminated");
+            }
+            m_pos++;
+        }
+        if (!parseMisc()) return false;
+    }
+    if (atEnd() || (m_source.at(m_pos) != u'<')) {
+        return fatal(m_pos, "Start tag expected, '<' not found");
+    }
+    if (!parseContent(false)) return false;
+    if (!parseMisc()) return false;
+    if (!atEnd() && (m_source.at(m_pos) != QChar(0))) {
+        return fatal(m_pos, "Extra content at the end of the document");
+    }
+    return true;
+}
+
+
+// comments, processing instructions and white space around the root
+bool WellFormedXMLChecker::parseMisc()
+{
+    while (true) {
+        skipBlanks();
+        if (lookingAt("<?")) {
+            if (!parsePI()) return false;
+        } else if (lookingAt("<!--")) {
+            if (!parseComment()) return false;
+        } else {
+            return true;
+        }
+    }
+}
+
+
+bool WellFormedXMLChecker::parseDocType()
+{
+    m_pos += 9;
+    skipBlanks();
+    QStringView name = parseName();
+    if (name.isEmpty()) {
+        return fatal(m_pos, "xmlParseDocTypeDecl : no DOCTYPE name !");
+    }
+    skipBlanks();
+    QStringView publicId;
+    QStringView systemId;
+    if (!parseExternalID(publicId, systemId)) return false;
+    if (!publicId.isNull() || !systemId.isNull()) {
+        m_HasExternalSubset = true;
+    }
+    skipBlanks();
+    // the internal subset is left to the caller
+    if (!atEnd() && (m_source.at(m_pos) == u'[')) {
+        return true;
+    }
+    if (atEnd() || (m_source.at(m_pos) != u'>')) {
+        return fatal(m_pos, "DOCTYPE improperly terminated");
+    }
+    m_pos++;
+    return true;
+}
+
+
+// Leaves both ids null if there is no SYSTEM or PUBLIC, a notation may
+// have a public id alone
+bool WellFormedXMLChecker::parseExternalID(QStringView &publicId, QStringView &systemId, bool strict)
+{
+    if (lookingAt("SYSTEM")) {
+        m_pos += 6;
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after 'SYSTEM'");
+        }
+        return parseLiteral(systemId, false);
+    }
+    if (lookingAt("PUBLIC")) {
+        m_pos += 6;
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after 'PUBLIC'");
+        }
+        if (!parseLiteral(publicId, true)) return false;
+        if (skipBlanks() == 0) {
+            if (!strict) return true;
+            return fatal(m_pos, "Space required after the Public Identifier");
+        }
+        if (!strict && !lookingAt("\"") && !lookingAt("'")) return true;
+        return parseLiteral(systemId, false);
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseLiteral(QStringView &literal, bool pubid)
+{
+    if (atEnd() || ((m_source.at(m_pos) != u'"') && (m_source.at(m_pos) != u'\''))) {
+        return fatal(m_pos, "SystemLiteral \" or ' expected");
+    }
+    QChar quote = m_source.at(m_pos);
+    m_pos++;
+    qsizetype start = m_pos;
+    while (!atEnd() && (m_source.at(m_pos) != quote)) {
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if (pubid ? !is_pubid_char(c) : !is_xml_char(c)) {
+            break;
+        }
+        m_pos += len;
+    }
+    if (atEnd() || (m_source.at(m_pos) != quote)) {
+        if (!pubid && outOfRange(charAt(m_pos))) return false;
+        return fatal(m_pos, "Unfinished System or Public ID \" or ' expected");
+    }
+    literal = m_source.mid(start, m_pos - start);
+    m_pos++;
+    return true;
+}
+
+
+// A declaration that makes no progress is the only error libxml2 reports
+// for anything in here it does not understand, parameter entities are
+// expanded by skipBlanks() and parsePEReference()
+bool WellFormedXMLChecker::parseInternalSubset()
+{
+    m_pos++;
+    m_InSubset = true;
+    while (!m_Inputs.isEmpty() || atEnd() || (m_source.at(m_pos) != u']')) {
+        // the same entity read twice shares its text, libxml2 then takes
+        // ending where an earlier round ended as not getting anywhere
+        const QChar *check = m_source.data() + m_pos;
+        skipBlanks();
+        if (!parseMarkupDecl()) return false;
+        if (!parsePEReference()) return false;
+        if (m_Fatal) return false;
+        if (m_source.data() + m_pos == check) {
+            return fatal(m_pos, INTERNAL_SUBSET_ERROR);
+        }
+    }
+    m_InSubset = false;
+    m_pos++;
+    skipBlanks();
+    return true;
+}
+
+
+// Element, attribute list and notation declarations are parsed for their
+// syntax only, nothing in them is used later on
+bool WellFormedXMLChecker::parseMarkupDecl()
+{
+    if (lookingAt("<!ENTITY")) {
+        return parseEntityDecl();
+    }
+    if (lookingAt("<!ELEMENT")) {
+        return parseElementDecl();
+    }
+    if (lookingAt("<!ATTLIST")) {
+        return parseAttlistDecl();
+    }
+    if (lookingAt("<!NOTATION")) {
+        return parseNotationDecl();
+    }
+    if (lookingAt("<!--")) {
+        return parseComment();
+    }
+    if (lookingAt("<?")) {
+        return parsePI();
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseElementDecl()
+{
+    int input = m_InputId;
+    m_pos += 9;
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after 'ELEMENT'");
+    }
+    QStringView name = parseName();
+    if (name.isEmpty()) {
+        return fatal(m_pos, "xmlParseElementDecl: no name for Element");
+    }
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after the element name");
+    }
+    if (lookingAt("EMPTY")) {
+        m_pos += 5;
+    } else if (lookingAt("ANY")) {
+        m_pos += 3;
+    } else if (lookingAt("(")) {
+        int group = m_InputId;
+        m_pos++;
+        skipBlanks();
+        if (lookingAt("#PCDATA")) {
+            if (!parseMixedContentDecl(group)) return false;
+        } else {
+            if (!parseChildrenContentDecl(group, 1)) return false;
+        }
+    } else if (lookingAt("%") && m_Inputs.isEmpty()) {
+        return fatal(m_pos, "PEReference: forbidden within markup decl in internal subset");
+    } else {
+        return fatal(m_pos, "xmlParseElementDecl: 'EMPTY', 'ANY' or '(' expected");
+    }
+    skipBlanks();
+    if (atEnd() || (m_source.at(m_pos) != u'>')) {
+        return fatal(m_pos, "expected '>'");
+    }
+    if (m_InputId != input) {
+        return fatal(m_pos, "Element declaration doesn't start and stop in the same entity");
+    }
+    m_pos++;
+    if (m_ElementDecls.contains(name)) {
+        error(m_pos, QString("Redefinition of element %1").arg(name.toString()));
+    } else {
+        m_ElementDecls.append(name);
+    }
+    return true;
+}
+
+
+// Everything after the #PCDATA up to and including the closing parenthesis
+bool WellFormedXMLChecker::parseMixedContentDecl(int group)
+{
+    m_pos += 7;
+    skipBlanks();
+    if (lookingAt(")")) {
+        if (m_InputId != group) {
+            return fatal(m_pos, CONTENT_BOUNDARY_ERROR);
+        }
+        m_pos++;
+        if (lookingAt("*")) m_pos++;
+        return true;
+    }
+    while (lookingAt("|")) {
+        m_pos++;
+        skipBlanks();
+        if (parseName().isEmpty()) {
+            return fatal(m_pos, "xmlParseElementMixedContentDecl : Name expected");
+        }
+        skipBlanks();
+    }
+    if (!lookingAt(")*")) {
+        return fatal(m_pos, "MixedContentDecl : '|' or ')*' expected");
+    }
+    if (m_InputId != group) {
+        return fatal(m_pos, CONTENT_BOUNDARY_ERROR);
+    }
+    m_pos += 2;
+    return true;
+}
+
+
+// A choice or sequence after its opening parenthesis, all separators in
+// one group have to be the same
+bool WellFormedXMLChecker::parseChildrenContentDecl(int group, int depth)
+{
+    if (depth > 128) {
+        return fatal(m_pos, QString("xmlParseElementChildrenContentDecl : depth %1 too deep, use XML_PARSE_HUGE")
+                            .arg(depth));
+    }
+    QChar separator;
+    bool first = true;
+    skipBlanks();
+    while (first || !lookingAt(")")) {
+        if (!first) {
+            if (atEnd() || ((m_source.at(m_pos) != u',') && (m_source.at(m_pos) != u'|'))) {
+                return fatal(m_pos, "ContentDecl : ',' '|' or ')' expected");
+            }
+            if (separator.isNull()) {
+                separator = m_source.at(m_pos);
+            } else if (m_source.at(m_pos) != separator) {
+                return fatal(m_pos, QString("xmlParseElementChildrenContentDecl : '%1' expected").arg(separator));
+            }
+            m_pos++;
+            skipBlanks();
+        }
+        first = false;
+        if (lookingAt("(")) {
+            int inner = m_InputId;
+            m_pos++;
+            skipBlanks();
+            if (!parseChildrenContentDecl(inner, depth + 1)) return false;
+        } else {
+            if (parseName().isEmpty()) {
+                return fatal(m_pos, "ContentDecl : Name or '(' expected");
+            }
+            if (lookingAt("?") || lookingAt("*") || lookingAt("+")) m_pos++;
+        }
+        skipBlanks();
+    }
+    if (m_InputId != group) {
+        return fatal(m_pos, CONTENT_BOUNDARY_ERROR);
+    }
+    m_pos++;
+    if (lookingAt("?") || lookingAt("*") || lookingAt("+")) m_pos++;
+    return true;
+}
+
+
+// Stops at the first attribute definition that is not complete, what
+// follows it is then what the internal subset fails on
+bool WellFormedXMLChecker::parseAttlistDecl()
+{
+    int input = m_InputId;
+    m_pos += 9;
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after '<!ATTLIST'");
+    }
+    QStringView element = parseName();
+    if (element.isEmpty()) {
+        return fatal(m_pos, "ATTLIST: no name for Element");
+    }
+    skipBlanks();
+    while (!lookingAt(">")) {
+        AttributeDecl decl;
+        decl.element = element;
+        decl.name = parseName();
+        if (decl.name.isEmpty()) {
+            return fatal(m_pos, "ATTLIST: no name for Attribute");
+        }
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after the attribute name");
+        }
+        if (!parseAttributeType(decl.type)) return false;
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after the attribute type");
+        }
+        QStringView value;
+        if (!parseDefaultDecl(value)) return false;
+        if (!lookingAt(">") && (skipBlanks() == 0)) {
+            return fatal(m_pos, "Space required after the attribute default value");
+        }
+        // libxml2 puts these on every start tag of the element, which can
+        // bind a prefix or need one bound
+        if (!value.isNull() && ((decl.name == u"xmlns") || decl.name.contains(u':')) &&
+            !m_NamespaceDefaults.contains(element)) {
+            m_NamespaceDefaults.append(element);
+        }
+        if (!addAttributeDecl(decl, value)) return false;
+    }
+    if (m_InputId != input) {
+        return fatal(m_pos, "Attribute list declaration doesn't start and stop in the same entity");
+    }
+    m_pos++;
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseAttributeType(AttributeType &type)
+{
+    static const struct {
+        const char *keyword;
+        AttributeType type;
+    } types[] = {
+        { "CDATA", CDataAttribute }, { "IDREFS", IdRefsAttribute }, { "IDREF", IdRefAttribute },
+        { "ID", IdAttribute }, { "ENTITY", EntityAttribute }, { "ENTITIES", EntitiesAttribute },
+        { "NMTOKENS", NmTokensAttribute }, { "NMTOKEN", NmTokenAttribute }
+    };
+    for (const auto &known : types) {
+        if (lookingAt(known.keyword)) {
+            m_pos += strlen(known.keyword);
+            type = known.type;
+            return true;
+        }
+    }
+    bool notation = lookingAt("NOTATION");
+    type = notation ? NotationAttribute : EnumerationAttribute;
+    if (notation) {
+        m_pos += 8;
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after 'NOTATION'");
+        }
+    }
+    if (!lookingAt("(")) {
+        return fatal(m_pos, notation ? "NOTATION: Name expected here" : "'(' required to start ATTLIST enumeration");
+    }
+    QList<QStringView> tokens;
+    do {
+        m_pos++;
+        skipBlanks();
+        QStringView token = notation ? parseName() : parseNmtoken();
+        if (token.isEmpty()) {
+            return fatal(m_pos, notation ? "Name expected in NOTATION declaration"
+                                         : "NmToken expected in ATTLIST enumeration");
+        }
+        if (tokens.contains(token)) {
+            error(m_pos, QString(notation ? "standalone: attribute notation value token %1 duplicated"
+                                          : "standalone: attribute enumeration value token %1 duplicated")
+                         .arg(token.toString()));
+        } else {
+            tokens.append(token);
+        }
+        skipBlanks();
+    } while (lookingAt("|"));
+    if (!lookingAt(")")) {
+        return fatal(m_pos, notation ? "'>' required to close NOTATION declaration"
+                                     : "')' required to finish ATTLIST enumeration");
+    }
+    m_pos++;
+    return true;
+}
+
+
+// value is left null for #REQUIRED and #IMPLIED
+bool WellFormedXMLChecker::parseDefaultDecl(QStringView &value)
+{
+    if (lookingAt("#REQUIRED")) {
+        m_pos += 9;
+        return true;
+    }
+    if (lookingAt("#IMPLIED")) {
+        m_pos += 8;
+        return true;
+    }
+    if (lookingAt("#FIXED")) {
+        m_pos += 6;
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after '#FIXED'");
+        }
+    }
+    if (atEnd() || ((m_source.at(m_pos) != u'"') && (m_source.at(m_pos) != u'\''))) {
+        return fatal(m_pos, "AttValue: \" or ' expected");
+    }
+    qsizetype start = m_pos + 1;
+    if (!parseAttValue()) return false;
+    value = m_source.mid(start, m_pos - 1 - start);
+    return true;
+}
+
+
+// What libxml2 checks as it adds the declaration to the dtd, all of it
+// only matters as the first error
+bool WellFormedXMLChecker::addAttributeDecl(const AttributeDecl &decl, QStringView value)
+{
+    if ((decl.name == u"xml:id") && (decl.type != IdAttribute)) {
+        error(m_pos, "xml:id : attribute type should be ID");
+    }
+    QStringView local = decl.name;
+    qsizetype colon = local.indexOf(u':');
+    if ((colon > 0) && (colon < local.size() - 1)) {
+        local = local.mid(colon + 1);
+    }
+    if (!value.isNull() && (decl.type != CDataAttribute)) {
+        QStringView normalized;
+        if (!normalizedValue(value, normalized)) return false;
+        if (!isValidDefault(decl.type, normalized)) {
+            // libxml2 has the element and attribute the wrong way round here
+            error(m_pos, QString("Attribute %1 of %2: invalid default value").arg(decl.element.toString(), local.toString()));
+        }
+    }
+    bool id = false;
+    foreach(const AttributeDecl &other, m_AttributeDecls) {
+        if (other.element != decl.element) continue;
+        if (other.name == decl.name) {
+            warning(m_pos, QString("Attribute %1 of element %2: already defined")
+                         .arg(local.toString(), decl.element.toString()));
+            return true;
+        }
+        id = id || (other.type == IdAttribute);
+    }
+    if ((decl.type == IdAttribute) && id) {
+        error(m_pos, QString("Element %1 has too may ID attributes defined : %2")
+                     .arg(decl.element.toString(), local.toString()));
+    }
+    m_AttributeDecls.append(decl);
+    return true;
+}
+
+
+// value has its spaces collapsed first as libxml2 does for every type
+// but CDATA
+bool WellFormedXMLChecker::isValidDefault(AttributeType type, QStringView value) const
+{
+    QList<QStringView> tokens = value.split(u' ', Qt::SkipEmptyParts);
+    bool single = (type == IdAttribute) || (type == IdRefAttribute) || (type == EntityAttribute) ||
+                  (type == NotationAttribute) || (type == NmTokenAttribute);
+    bool names = (type != NmTokenAttribute) && (type != NmTokensAttribute) && (type != EnumerationAttribute);
+    if (tokens.isEmpty() || (single && (tokens.size() > 1))) {
+        return false;
+    }
+    foreach(QStringView token, tokens) {
+        qsizetype i = 0;
+        while (i < token.size()) {
+            int len;
+            char32_t c = char_at(token, i, &len);
+            if ((names && (i == 0)) ? !is_name_start_char(c) : !is_name_char(c)) {
+                return false;
+            }
+            i += len;
+        }
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseNotationDecl()
+{
+    int input = m_InputId;
+    m_pos += 10;
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after '<!NOTATION'");
+    }
+    QStringView name = parseName();
+    if (name.isEmpty()) {
+        return fatal(m_pos, "NOTATION: Name expected here");
+    }
+    if (name.contains(u':')) {
+        error(m_pos, QString("colons are forbidden from notation names '%1'").arg(name.toString()));
+    }
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after the NOTATION name'");
+    }
+    QStringView publicId;
+    QStringView systemId;
+    if (!parseExternalID(publicId, systemId, false)) return false;
+    skipBlanks();
+    if (!lookingAt(">")) {
+        return fatal(m_pos, "'>' required to close NOTATION declaration");
+    }
+    if (m_InputId != input) {
+        return fatal(m_pos, "Notation declaration doesn't start and stop in the same entity");
+    }
+    m_pos++;
+    if (publicId.isNull() && systemId.isNull()) {
+        return fatal(m_pos, QString("SAX.xmlSAX2NotationDecl(%1) externalID or PublicID missing").arg(name.toString()));
+    }
+    if (m_NotationDecls.contains(name)) {
+        // reported without a position
+        errorAt(0, 0, QString("xmlAddNotationDecl: %1 already defined").arg(name.toString()), true);
+    } else {
+        m_NotationDecls.append(name);
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseEntityDecl()
+{
+    int input = m_InputId;
+    m_pos += 8;
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after '<!ENTITY'");
+    }
+    Entity entity;
+    entity.parameter = false;
+    entity.external = false;
+    entity.unparsed = false;
+    entity.checked = false;
+    entity.text = false;
+    entity.references = -1;
+    entity.length = -1;
+    entity.expansionReferences = 0;
+    entity.largestReferences = 0;
+    entity.height = 0;
+    if (!atEnd() && (m_source.at(m_pos) == u'%')) {
+        m_pos++;
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "Space required after '%%'");
+        }
+        entity.parameter = true;
+    }
+    entity.name = parseName();
+    if (entity.name.isEmpty()) {
+        return fatal(m_pos, "xmlParseEntityDecl: no name");
+    }
+    if (entity.name.contains(u':')) {
+        error(m_pos, QString("colons are forbidden from entities names '%1'").arg(entity.name.toString()));
+    }
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, "Space required after the entity name");
+    }
+    if (!atEnd() && ((m_source.at(m_pos) == u'"') || (m_source.at(m_pos) == u'\''))) {
+        if (!parseEntityValue(entity.value)) return false;
+    } else {
+        QStringView publicId;
+        if (!parseExternalID(publicId, entity.systemId)) return false;
+        if (publicId.isNull() && entity.systemId.isNull()) {
+            return fatal(m_pos, "Entity value required");
+        }
+        entity.external = true;
+        if (!entity.systemId.isNull()) {
+            if (!is_valid_uri(entity.systemId)) {
+                error(m_pos, QString("Invalid URI: %1").arg(normalized_line_ends(entity.systemId)));
+            } else if (entity.systemId.contains(u'#')) {
+                return fatal(m_pos, "Fragment not allowed");
+            }
+        }
+        if (!entity.parameter) {
+            if (!lookingAt(">") && (skipBlanks() == 0)) {
+                return fatal(m_pos, "Space required before 'NDATA'");
+            }
+            if (lookingAt("NDATA")) {
+                m_pos += 5;
+                if (skipBlanks() == 0) {
+                    return fatal(m_pos, "Space required after 'NDATA'");
+                }
+                parseName();
+                entity.unparsed = true;
+            }
+        }
+    }
+    skipBlanks();
+    if (atEnd() || (m_source.at(m_pos) != u'>')) {
+        return fatal(m_pos, QString("xmlParseEntityDecl: entity %1 not terminated").arg(entity.name.toString()));
+    }
+    if (m_InputId != input) {
+        return fatal(m_pos, "Entity declaration doesn't start and stop in the same entity");
+    }
+    m_pos++;
+    // the first declaration of an entity is the one used
+    if (findEntity(entity.name, entity.parameter) == -1) {
+        m_Entities.append(entity);
+    }
+    return true;
+}
+
+
+// The value is checked for bare & and % and has its character references
+// replaced, the references to other entities are kept as they are
+bool WellFormedXMLChecker::parseEntityValue(QStringView &value)
+{
+    QChar quote = m_source.at(m_pos);
+    m_pos++;
+    qsizetype start = m_pos;
+    while (!atEnd() && (m_source.at(m_pos) != quote)) {
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if (outOfRange(c)) return false;
+        if (!is_xml_char(c)) break;
+        m_pos += len;
+    }
+    if (atEnd() || (m_source.at(m_pos) != quote)) {
+        return fatal(m_pos, "EntityValue: \" or ' expected");
+    }
+    QStringView literal = m_source.mid(start, m_pos - start);
+    m_pos++;
+
+    for (qsizetype i = 0; i < literal.size(); i++) {
+        QChar c = literal.at(i);
+        if ((c != u'%') && ((c != u'&') || ((i + 1 < literal.size()) && (literal.at(i + 1) == u'#')))) {
+            continue;
+        }
+        qsizetype end = name_end(literal, i + 1);
+        if ((end == i + 1) || (end >= literal.size()) || (literal.at(end) != u';')) {
+            return fatal(m_pos, QString("EntityValue: '%1' forbidden except for entities references").arg(c));
+        }
+        if ((c == u'%') && m_Inputs.isEmpty()) {
+            return fatal(m_pos, "PEReferences forbidden in internal subset");
+        }
+        // libxml2 would put the text of the parameter entity in its place
+        if (c == u'%') {
+            return unsupported();
+        }
+        i = end;
+    }
+    return decodeCharRefs(literal, value);
+}
+
+
+bool WellFormedXMLChecker::parsePEReference()
+{
+    if (atEnd() || (m_source.at(m_pos) != u'%')) {
+        return true;
+    }
+    m_pos++;
+    QStringView name = parseName();
+    if (name.isEmpty()) {
+        return fatal(m_pos, "PEReference: no name");
+    }
+    if (atEnd() || (m_source.at(m_pos) != u';')) {
+        return fatal(m_pos, "PEReference: expecting ';'");
+    }
+    m_pos++;
+    m_EntityReferences++;
+    int index = findEntity(name, true);
+    if (index == -1) {
+        QString message = "PEReference: %" + name.toString() + "; not found";
+        if (!m_HasExternalSubset && !m_HasPERefs) {
+            return fatal(m_pos, message);
+        }
+        warning(m_pos, message);
+    } else if (m_Entities.at(index).external) {
+        // external entities are never loaded
+        warning(m_pos, QString("failed to load external entity \"%1\"").arg(m_Entities.at(index).systemId.toString()));
+        return true;
+    } else {
+        // libxml2 expands the general entities in there once before use
+        if (!checkExpansion(index, 0, false)) return false;
+        if (!pushInput(m_Entities.at(index).value)) return false;
+    }
+    m_HasPERefs = true;
+    return true;
+}
+
+
+// The replacement text of a parameter entity is read in place of the
+// source until skipBlanks() runs off its end, just like libxml2 does
+bool WellFormedXMLChecker::pushInput(QStringView text)
+{
+    if (m_Inputs.size() >= MAX_ENTITY_DEPTH) {
+        return fatal(m_pos, ENTITY_LOOP_ERROR);
+    }
+    Input input;
+    input.source = m_source;
+    input.pos = m_pos;
+    input.id = m_InputId;
+    m_Inputs.append(input);
+    m_source = text;
+    m_pos = 0;
+    m_InputId = ++m_LastInputId;
+    return true;
+}
+
+
+void WellFormedXMLChecker::popInput()
+{
+    Input input = m_Inputs.takeLast();
+    m_source = input.source;
+    m_pos = input.pos;
+    m_InputId = input.id;
+}
+
+
+// The root element and everything in it, or a chunk of content from an
+// entity. The open elements are kept on a stack rather than recursing and
+// a nul ends the content just as the end of the source does
+bool WellFormedXMLChecker::parseContent(bool chunk)
+{
+    if (!chunk) {
+        bool empty = false;
+        if (!parseStartTag(empty)) return false;
+        if (empty) return true;
+    }
+    while (chunk || !m_Elements.isEmpty()) {
+        if (atEnd() || (m_source.at(m_pos) == QChar(0))) {
+            if (m_Elements.isEmpty()) return true;
+            const OpenElement &open = m_Elements.last();
+            return fatal(m_pos, QString("Premature end of data in tag %1 line %2")
+                                .arg(open.local.toString()).arg(lineAt(open.pos)));
+        }
+        QChar c = m_source.at(m_pos);
+        if (c == u'<') {
+            m_HasMarkup = true;
+            if (lookingAt("</")) {
+                if (m_Elements.isEmpty()) {
+                    return fatal(m_pos, "chunk is not well balanced");
+                }
+                if (!parseEndTag()) return false;
+            } else if (lookingAt("<?")) {
+                if (!parsePI()) return false;
+            } else if (lookingAt("<!--")) {
+                if (!parseComment()) return false;
+            } else if (lookingAt("<![CDATA[")) {
+                if (!parseCDSect()) return false;
+            } else {
+                bool empty;
+                if (!parseStartTag(empty)) return false;
+            }
+        } else if (c == u'&') {
+            if (!parseReference(false)) return false;
+        } else {
+            m_HasText = true;
+            if (!parseCharData()) return false;
+        }
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseStartTag(bool &empty)
+{
+    qsizetype start = m_pos;
+    m_pos++;
+    QStringView prefix;
+    QStringView local = parseQName(prefix);
+    if (local.isEmpty()) {
+        return fatal(m_pos, "StartTag: invalid element name");
+    }
+    QStringView name = m_source.mid(start + 1, m_pos - start - 1);
+    if (m_NamespaceDefaults.contains(name)) {
+        return unsupported();
+    }
+    int nsmark = m_Namespaces.size();
+    bool default_ns = false;
+    m_Attributes.clear();
+    skipBlanks();
+    while (!atEnd()) {
+        char32_t c = charAt(m_pos);
+        if ((c == '>') || ((c == '/') && (charAt(m_pos + 1) == '>')) || !is_byte_char(c)) {
+            break;
+        }
+        Attribute attribute;
+        attribute.local = parseQName(attribute.prefix);
+        if (attribute.local.isEmpty()) {
+            return fatal(m_pos, "error parsing attribute name");
+        }
+        skipBlanks();
+        if (atEnd() || (m_source.at(m_pos) != u'=')) {
+            return fatal(m_pos, QString("Specification mandates value for attribute %1").arg(attribute.local.toString()));
+        }
+        m_pos++;
+        skipBlanks();
+        if (atEnd() || ((m_source.at(m_pos) != u'"') && (m_source.at(m_pos) != u'\''))) {
+            return fatal(m_pos, "AttValue: \" or ' expected");
+        }
+        qsizetype value_start = m_pos + 1;
+        if (!parseAttValue()) return false;
+        QStringView value = m_source.mid(value_start, m_pos - 1 - value_start);
+        bool xmlns = attribute.prefix.isEmpty() ? (attribute.local == u"xmlns") : (attribute.prefix == u"xmlns");
+        if ((xmlns || (attribute.prefix == u"xml")) && !normalizedValue(value, value)) {
+            return false;
+        }
+
+        // namespace declarations are checked as they are read
+        if (xmlns && attribute.prefix.isEmpty()) {
+            if (!value.isEmpty()) {
+                checkNamespaceDeclaration(QStringView(), value);
+            }
+            if (default_ns) {
+                return fatal(m_pos, "Attribute xmlns redefined");
+            }
+            default_ns = true;
+            Namespace ns;
+            ns.uri = value;
+            m_Namespaces.append(ns);
+        } else if (xmlns) {
+            if (attribute.local == u"xml") {
+                if (value != XML_NAMESPACE) {
+                    error(m_pos, "xml namespace prefix mapped to wrong URI");
+                }
+            } else if (value == XML_NAMESPACE) {
+                error(m_pos, "xml namespace URI mapped to wrong prefix");
+            } else if (attribute.local == u"xmlns") {
+                error(m_pos, "redefinition of the xmlns prefix is forbidden");
+            } else if (value == XMLNS_NAMESPACE) {
+                error(m_pos, "reuse of the xmlns namespace name is forbidden");
+            } else if (value.isEmpty()) {
+                error(m_pos, QString("xmlns:%1: Empty XML namespace is not allowed").arg(attribute.local.toString()));
+            } else {
+                checkNamespaceDeclaration(attribute.local, value);
+                for (int i = nsmark; i < m_Namespaces.size(); i++) {
+                    if (m_Namespaces.at(i).prefix == attribute.local) {
+                        return fatal(m_pos, QString("Attribute xmlns:%1 redefined").arg(attribute.local.toString()));
+                    }
+                }
+                Namespace ns;
+                ns.prefix = attribute.local;
+                ns.uri = value;
+                m_Namespaces.append(ns);
+            }
+        } else {
+            if ((attribute.prefix == u"xml") && (attribute.local == u"space") &&
+                (value != u"default") && (value != u"preserve")) {
+                warning(m_pos, QString("Invalid value \"%1\" for xml:space : \"default\" or \"preserve\" expected")
+                             .arg(value.toString()));
+            }
+            m_Attributes.append(attribute);
+        }
+
+        c = charAt(m_pos);
+        if ((c == '>') || ((c == '/') && (charAt(m_pos + 1) == '>'))) {
+            break;
+        }
+        if (skipBlanks() == 0) {
+            return fatal(m_pos, "attributes construct error");
+        }
+    }
+
+    // prefixes and duplicates are only looked at once all the attributes
+    // are read, each attribute in turn and then the element itself
+    for (int i = 0; i < m_Attributes.size(); i++) {
+        Attribute &attribute = m_Attributes[i];
+        if (!attribute.prefix.isEmpty() && !lookupNamespace(attribute.prefix, attribute.uri)) {
+            error(m_pos, QString("Namespace prefix %1 for %2 on %3 is not defined")
+                         .arg(attribute.prefix.toString(), attribute.local.toString(), local.toString()));
+        }
+        for (int j = 0; j < i; j++) {
+            const Attribute &other = m_Attributes.at(j);
+            if (other.local != attribute.local) continue;
+            if (other.prefix == attribute.prefix) {
+                QString attname = attribute.prefix.isEmpty() ? attribute.local.toString()
+                                  : attribute.prefix.toString() + ":" + attribute.local.toString();
+                return fatal(m_pos, QString("Attribute %1 redefined").arg(attname));
+            }
+            if (!attribute.uri.isEmpty() && (other.uri == attribute.uri)) {
+                error(m_pos, QString("Namespaced Attribute %1 in '%2' redefined")
+                             .arg(attribute.local.toString(), attribute.uri.toString()));
+                break;
+            }
+        }
+    }
+    QStringView uri;
+    if (!prefix.isEmpty() && !lookupNamespace(prefix, uri)) {
+        error(m_pos, QString("Namespace prefix %1 on %2 is not defined").arg(prefix.toString(), local.toString()));
+    }
+    // the tree libxml2 builds for an entity does not have the namespaces
+    // declared around the reference
+    if (m_InheritedNamespaces > 0) {
+        int index = namespaceIndex(prefix);
+        if ((index >= 0) && (index < m_InheritedNamespaces) && !m_Namespaces.at(index).uri.isEmpty()) {
+            warning(m_pos, prefix.isEmpty() ? QString("Namespace default prefix was not found")
+                                          : QString("Namespace prefix %1 was not found").arg(prefix.toString()));
+        }
+    }
+
+    if (lookingAt("/>")) {
+        m_pos += 2;
+        m_Namespaces.resize(nsmark);
+        empty = true;
+        return true;
+    }
+    if (!atEnd() && (m_source.at(m_pos) == u'>')) {
+        m_pos++;
+        OpenElement open;
+        open.name = name;
+        open.local = local;
+        open.prefix = prefix;
+        open.pos = start;
+        open.nsmark = nsmark;
+        m_Elements.append(open);
+        empty = false;
+        return true;
+    }
+    return fatal(m_pos, QString("Couldn't find end of Start Tag %1 line %2")
+                        .arg(local.toString()).arg(lineAt(start)));
+}
+
+
+// An end tag that matches as written is taken as is, anything else is
+// parsed the way libxml2 does to get the name it puts in the mismatch
+bool WellFormedXMLChecker::parseEndTag()
+{
+    m_pos += 2;
+    const OpenElement open = m_Elements.takeLast();
+    bool matched = false;
+    QStringView name;
+    qsizetype after = m_pos + open.name.size();
+    if (m_source.mid(m_pos).startsWith(open.name) &&
+        ((after == m_source.size()) || (m_source.at(after) == u'>') || is_blank(m_source.at(after).unicode()))) {
+        m_pos = after;
+        matched = true;
+    } else if (open.prefix.isEmpty()) {
+        name = parseName();
+        matched = !name.isEmpty() && (name == open.name);
+    } else {
+        QStringView prefix;
+        name = parseQName(prefix);
+        matched = !name.isEmpty() && (name == open.local) && (prefix == open.prefix);
+    }
+    skipBlanks();
+    if (atEnd() || (m_source.at(m_pos) != u'>')) {
+        return fatal(m_pos, "expected '>'");
+    }
+    m_pos++;
+    if (!matched) {
+        return fatal(m_pos, QString("Opening and ending tag mismatch: %1 line %2 and %3")
+                            .arg(open.local.toString())
+                            .arg(lineAt(open.pos))
+                            .arg(name.isEmpty() ? QString("unparsable") : name.toString()));
+    }
+    m_Namespaces.resize(open.nsmark);
+    return true;
+}
+
+
+// libxml2 takes a leading run of plain ascii in one go, after that the
+// length of the value with its entities expanded is checked item by item
+bool WellFormedXMLChecker::parseAttValue()
+{
+    qsizetype start = m_pos;
+    QChar quote = m_source.at(m_pos);
+    m_pos++;
+    qsizetype plain = m_pos;
+    while (plain < m_source.size()) {
+        ushort c = m_source.at(plain).unicode();
+        if ((c < 0x20) || (c > 0x7F) || (c == quote.unicode()) || (c == '&') || (c == '<')) break;
+        plain++;
+    }
+    if (plain - m_pos > MAX_TEXT_LENGTH) {
+        return fatal(start, ATTVALUE_LENGTH_ERROR);
+    }
+    m_ValueLength = plain - m_pos;
+    m_pos = plain;
+    while (true) {
+        if (atEnd()) {
+            return fatal(m_pos, "AttValue: ' expected");
+        }
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if (c == quote.unicode()) {
+            m_pos++;
+            return true;
+        }
+        if (c == '<') {
+            return fatal(m_pos, "Unescaped '<' not allowed in attributes values");
+        }
+        if (c == '&') {
+            if (!parseReference(true)) return false;
+        } else {
+            if (outOfRange(c)) {
+                return false;
+            }
+            if (!is_xml_char(c)) {
+                return fatal(m_pos, "invalid character in attribute value");
+            }
+            // a line end is one character by the time libxml2 sees it
+            if ((c == '\r') && (charAt(m_pos + 1) == '\n')) {
+                len++;
+            }
+            m_pos += len;
+            m_ValueLength += utf8_length(c);
+        }
+        if (m_ValueLength > MAX_TEXT_LENGTH) {
+            return fatal(m_pos, ATTVALUE_LENGTH_ERROR);
+        }
+    }
+}
+
+
+bool WellFormedXMLChecker::parseReference(bool in_attribute)
+{
+    if (lookingAt("&#")) {
+        char32_t value;
+        if (!parseCharRef(value)) return false;
+        m_ValueLength += utf8_length(value);
+        m_HasText = m_HasText || !in_attribute;
+        return true;
+    }
+    m_pos++;
+    QStringView name = parseName();
+    if (name.isEmpty()) {
+        return fatal(m_pos, "xmlParseEntityRef: no name");
+    }
+    if (atEnd() || (m_source.at(m_pos) != u';')) {
+        return fatal(m_pos, "EntityRef: expecting ';'");
+    }
+    m_pos++;
+    // libxml2 counts a reference in an attribute value twice, the text of
+    // a predefined entity is one byte
+    if (is_predefined_entity(name)) {
+        if (in_attribute) {
+            m_EntityReferences++;
+            m_ValueLength++;
+        }
+        m_HasText = m_HasText || !in_attribute;
+        return true;
+    }
+    m_EntityReferences += in_attribute ? 2 : 1;
+    int index = findEntity(name, false);
+    if (index == -1) {
+        return undefinedEntity(name);
+    }
+    if (in_attribute) {
+        // and once more for an entity it keeps the text of
+        if (m_Entities.at(index).text) {
+            m_EntityReferences++;
+        }
+        qint64 length;
+        if (!checkEntityUse(index, true) || !expandEntity(index, m_Depth + 1, true, length)) return false;
+        m_ValueLength += length;
+        return true;
+    }
+    const Entity &entity = m_Entities.at(index);
+    if (entity.unparsed) {
+        return fatal(m_pos, QString("Entity reference to unparsed entity %1").arg(name.toString()));
+    }
+    if (entity.external) {
+        // libxml2 gives no position for the entity it could not load
+        errorAt(0, 0, QString("failed to load external entity \"%1\"").arg(entity.systemId.toString()), false);
+        return true;
+    }
+    if (entity.checked) {
+        m_EntityReferences += entity.references;
+        m_HasText = true;
+        m_HasMarkup = m_HasMarkup || !entity.text;
+        return true;
+    }
+    // only marked once walked so that a loop runs into the depth limit,
+    // what was counted in there is what every later use counts. One that
+    // gave nothing is walked again each time
+    qint64 before = m_EntityReferences;
+    if (!checkContentEntity(index)) return false;
+    qint64 references = m_EntityReferences - before + 1;
+    if ((m_Entities.at(index).references != -1) && (m_Entities.at(index).references != references)) {
+        forgetExpansions();
+    }
+    m_Entities[index].references = references;
+    if (references * 3 >= consumedBytes() * NON_LINEAR) {
+        return fatal(m_pos, ENTITY_LOOP_ERROR);
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::undefinedEntity(QStringView name)
+{
+    QString message = QString("Entity '%1' not defined").arg(name.toString());
+    // the entity may be declared in the external dtd which is never loaded
+    if (m_HasExternalSubset || m_HasPERefs) {
+        error(m_pos, message);
+        return true;
+    }
+    return fatal(m_pos, message);
+}
+
+
+// Entities used in attribute values (or in a parameter entity) are
+// expanded as strings, everything they lead to is reported at the
+// reference that started it
+bool WellFormedXMLChecker::checkEntityUse(int index, bool in_attribute)
+{
+    const Entity &entity = m_Entities.at(index);
+    if (entity.unparsed) {
+        return fatal(m_pos, QString("Entity reference to unparsed entity %1").arg(entity.name.toString()));
+    }
+    if (entity.external && in_attribute) {
+        return fatal(m_pos, QString("Attribute references external entity '%1'").arg(entity.name.toString()));
+    }
+    if (in_attribute && entity.value.contains(u'<')) {
+        return fatal(m_pos, QString("'<' in entity '%1' is not allowed in attributes values").arg(entity.name.toString()));
+    }
+    return true;
+}
+
+
+// What libxml2 checks before it expands an entity in a string, the first
+// time it expands it just to count the references that leads to. An
+// entity may not count more than about three references for every byte
+// read so far
+bool WellFormedXMLChecker::checkExpansion(int index, int depth, bool in_attribute)
+{
+    if ((m_Entities.at(index).references == -1) && !m_Entities.at(index).external) {
+        m_FirstExpansions++;
+        m_Entities[index].references = 0;
+        qint64 before = m_EntityReferences;
+        qint64 length;
+        if (!expandText(m_Entities.at(index).value, depth + 1, in_attribute, length)) return false;
+        m_Entities[index].references = m_EntityReferences - before + 1;
+    }
+    if (!checkSubsetReferences(in_attribute)) return false;
+    qint64 references = qMax<qint64>(m_Entities.at(index).references, 0);
+    m_LargestReferences = qMax(m_LargestReferences, references);
+    if (references * 3 >= consumedBytes() * NON_LINEAR) {
+        return fatal(m_pos, ENTITY_LOOP_ERROR);
+    }
+    return true;
+}
+
+
+// What libxml2 checks each time the buffer it expands an entity into has
+// to grow, size is what is in there so far
+bool WellFormedXMLChecker::checkExpansionSize(qint64 size, bool in_attribute)
+{
+    if (!checkSubsetReferences(in_attribute)) return false;
+    if (size < BIG_ENTITY) {
+        return true;
+    }
+    m_SizeChecks++;
+    qint64 consumed = consumedBytes();
+    if ((size < consumed * NON_LINEAR) && (m_EntityReferences * 3 < consumed * NON_LINEAR)) {
+        return true;
+    }
+    return fatal(m_pos, ENTITY_LOOP_ERROR);
+}
+
+
+// Outside attribute values in the dtd every 1024th reference past 10000
+// is also checked against all of the sources read so far
+bool WellFormedXMLChecker::checkSubsetReferences(bool in_attribute)
+{
+    if (!m_InSubset || in_attribute || (m_EntityReferences <= 10000) || (m_EntityReferences % 1024 != 0)) {
+        return true;
+    }
+    qint64 consumed = consumedBytes();
+    foreach(const Input &input, m_Inputs) {
+        consumed += utf8_bytes(input.source.left(input.pos));
+    }
+    if (m_EntityReferences > consumed * NON_LINEAR) {
+        return fatal(m_pos, ENTITY_LOOP_ERROR);
+    }
+    return true;
+}
+
+
+// An expansion in an attribute value is remembered if nothing in it was
+// expanded for the first time, reported or big enough to have its size
+// checked. Using it again counts the same references and only has to
+// check the largest entity in there and how deep it goes
+bool WellFormedXMLChecker::expandEntity(int index, int depth, bool in_attribute, qint64 &length)
+{
+    const Entity &entity = m_Entities.at(index);
+    if (in_attribute && (entity.length != -1) && (depth + entity.height <= MAX_ENTITY_DEPTH) &&
+        (entity.largestReferences * 3 < consumedBytes() * NON_LINEAR)) {
+        m_EntityReferences += entity.expansionReferences;
+        m_LargestReferences = qMax(m_LargestReferences, entity.largestReferences);
+        m_DeepestExpansion = qMax(m_DeepestExpansion, depth + entity.height);
+        length = entity.length;
+        return true;
+    }
+    QStringView value = entity.value;
+    qint64 references = m_EntityReferences;
+    qint64 largest = m_LargestReferences;
+    int deepest = m_DeepestExpansion;
+    int first_expansions = m_FirstExpansions;
+    int size_checks = m_SizeChecks;
+    int reports = m_Reports;
+    m_LargestReferences = 0;
+    m_DeepestExpansion = depth;
+    if (!expandText(value, depth, in_attribute, length)) return false;
+    if (in_attribute && (m_FirstExpansions == first_expansions) && (m_SizeChecks == size_checks) &&
+        (m_Reports == reports)) {
+        Entity &remembered = m_Entities[index];
+        remembered.length = length;
+        remembered.expansionReferences = m_EntityReferences - references;
+        remembered.largestReferences = m_LargestReferences;
+        remembered.height = m_DeepestExpansion - depth;
+    }
+    m_LargestReferences = qMax(largest, m_LargestReferences);
+    m_DeepestExpansion = qMax(deepest, m_DeepestExpansion);
+    return true;
+}
+
+
+// Expands text the way libxml2 does, length is what that comes to in
+// utf-8 bytes. The buffer it uses starts small and is only checked as it
+// grows while the expansion of another entity is copied in
+bool WellFormedXMLChecker::expandText(QStringView text, int depth, bool in_attribute, qint64 &length)
+{
+    if (depth > MAX_ENTITY_DEPTH) {
+        return fatal(m_pos, ENTITY_LOOP_ERROR);
+    }
+    m_DeepestExpansion = qMax(m_DeepestExpansion, depth);
+    qint64 buffer = EXPANSION_BUFFER;
+    length = 0;
+    qsizetype i = 0;
+    while (i < text.size()) {
+        if ((text.at(i) == u'&') && (i + 1 < text.size()) && (text.at(i + 1) == u'#')) {
+            char32_t value;
+            if (!stringCharRef(text, i, value)) return false;
+            length += utf8_length(value);
+        } else if (text.at(i) == u'&') {
+            qsizetype end = name_end(text, i + 1);
+            QStringView name = text.mid(i + 1, end - i - 1);
+            i = end + 1;
+            if (is_predefined_entity(name)) {
+                length++;
+            } else {
+                m_EntityReferences++;
+                int index = findEntity(name, false);
+                if (index == -1) {
+                    if (!undefinedEntity(name)) return false;
+                    continue;
+                }
+                if (!checkEntityUse(index, in_attribute) || !checkExpansion(index, depth, in_attribute)) return false;
+                m_EntityReferences += qMax<qint64>(m_Entities.at(index).references, 0);
+                if (m_Entities.at(index).external) {
+                    // the reference itself is kept
+                    qint64 name_length = utf8_bytes(name);
+                    length++;
+                    if (length + name_length + EXPANSION_MARGIN > buffer) {
+                        buffer = buffer * 2 + name_length + EXPANSION_MARGIN;
+                    }
+                    length += name_length + 1;
+                    continue;
+                }
+                qint64 nested;
+                if (!expandEntity(index, depth + 1, in_attribute, nested)) return false;
+                while (true) {
+                    qint64 grow_at = qMax(buffer - EXPANSION_MARGIN + 1, length + 1);
+                    if (grow_at > length + nested) break;
+                    if (!checkExpansionSize(grow_at, in_attribute)) return false;
+                    nested -= grow_at - length;
+                    length = grow_at;
+                    buffer = buffer * 2 + EXPANSION_MARGIN;
+                }
+                length += nested;
+                continue;
+            }
+        } else {
+            int len;
+            length += utf8_length(char_at(text, i, &len));
+            i += len;
+        }
+        if (length + EXPANSION_MARGIN > buffer) {
+            buffer = buffer * 2 + EXPANSION_MARGIN;
+        }
+    }
+    return true;
+}
+
+
+// the counts remembered depend on what each entity in there counts
+void WellFormedXMLChecker::forgetExpansions()
+{
+    for (int i = 0; i < m_Entities.size(); i++) {
+        m_Entities[i].length = -1;
+    }
+}
+
+
+// How far libxml2 has read into the source in utf-8 bytes, counted on
+// from the last call while it is the same source
+qint64 WellFormedXMLChecker::consumedBytes()
+{
+    if ((m_ConsumedSource != m_source.data()) || (m_ConsumedPos > m_pos)) {
+        m_ConsumedSource = m_source.data();
+        m_ConsumedPos = 0;
+        m_ConsumedBytes = 0;
+    }
+    m_ConsumedBytes += utf8_bytes(m_source.mid(m_ConsumedPos, m_pos - m_ConsumedPos));
+    m_ConsumedPos = m_pos;
+    return m_ConsumedBytes;
+}
+
+
+// Entities used in content are parsed as a chunk of content the first
+// time they are used, errors in there are placed within the replacement
+// text just as libxml2 does
+bool WellFormedXMLChecker::checkContentEntity(int index)
+{
+    QStringView text = m_Entities.at(index).value;
+    if (m_Depth >= MAX_ENTITY_DEPTH) {
+        return fatal(m_pos, ENTITY_LOOP_ERROR);
+    }
+    WellFormedXMLChecker chunk(text);
+    chunk.m_Entities = m_Entities;
+    chunk.m_Namespaces = m_Namespaces;
+    chunk.m_InheritedNamespaces = m_Namespaces.size();
+    chunk.m_NamespaceDefaults = m_NamespaceDefaults;
+    // the parser libxml2 starts for this knows nothing about the dtd, any
+    // undeclared entity in here breaks well-formedness
+    chunk.m_HasExternalSubset = false;
+    chunk.m_HasPERefs = false;
+    // libxml2 goes two deeper for each chunk, one for the reference and
+    // one for the parser it starts
+    chunk.m_Depth = m_Depth + 2;
+    chunk.parseContent(true);
+    m_Entities = chunk.m_Entities;
+    m_EntityReferences += chunk.m_EntityReferences;
+    if (chunk.m_HasText || chunk.m_HasMarkup) {
+        m_Entities[index].checked = true;
+        m_Entities[index].text = !chunk.m_HasMarkup;
+        m_HasText = true;
+        m_HasMarkup = m_HasMarkup || chunk.m_HasMarkup;
+    }
+    if (chunk.m_Unsupported) {
+        return unsupported();
+    }
+    if (chunk.m_HaveError) {
+        errorAt(chunk.m_ErrorLine, chunk.m_ErrorColumn, chunk.m_ErrorMessage, chunk.m_LastWasError);
+        if (chunk.m_Fatal) {
+            m_Fatal = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// A character reference inside an entity value, i is left after it
+bool WellFormedXMLChecker::stringCharRef(QStringView text, qsizetype &i, char32_t &value)
+{
+    i += 2;
+    int base = 10;
+    if ((i < text.size()) && (text.at(i) == u'x')) {
+        base = 16;
+        i++;
+    }
+    value = 0;
+    while ((i >= text.size()) || (text.at(i) != u';')) {
+        ushort c = (i < text.size()) ? text.at(i).unicode() : 0;
+        if (!is_digit(c) && ((base == 10) || !is_hex(c))) {
+            return fatal(m_pos, (base == 16) ? "CharRef: invalid hexadecimal value" : "CharRef: invalid decimal value");
+        }
+        value = value * base + (is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+        if (value > 0x110000) value = 0x110000;
+        i++;
+    }
+    i++;
+    if (value >= 0x110000) {
+        return fatal(m_pos, "xmlParseStringCharRef: character reference out of bounds");
+    }
+    if (!is_xml_char(value)) {
+        return fatal(m_pos, QString("xmlParseStringCharRef: invalid xmlChar value %1").arg(value));
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::decodeCharRefs(QStringView literal, QStringView &value)
+{
+    if (!literal.contains(u"&#")) {
+        value = literal;
+        return true;
+    }
+    QString decoded;
+    qsizetype i = 0;
+    while (i < literal.size()) {
+        if ((literal.at(i) == u'&') && (i + 1 < literal.size()) && (literal.at(i + 1) == u'#')) {
+            char32_t c;
+            if (!stringCharRef(literal, i, c)) return false;
+            decoded.append(QChar::fromUcs4(c));
+        } else {
+            decoded.append(literal.at(i));
+            i++;
+        }
+    }
+    m_Values.append(decoded);
+    value = m_Values.last();
+    return true;
+}
+
+
+int WellFormedXMLChecker::findEntity(QStringView name, bool parameter) const
+{
+    for (int i = 0; i < m_Entities.size(); i++) {
+        if ((m_Entities.at(i).parameter == parameter) && (m_Entities.at(i).name == name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+bool WellFormedXMLChecker::parseCharRef(char32_t &value)
+{
+    m_pos += 2;
+    int base = 10;
+    if (!atEnd() && (m_source.at(m_pos) == u'x')) {
+        base = 16;
+        m_pos++;
+    }
+    const QString invalid = (base == 16) ? "CharRef: invalid hexadecimal value" : "CharRef: invalid decimal value";
+    value = 0;
+    while (true) {
+        if (atEnd()) {
+            return fatal(m_pos, invalid);
+        }
+        ushort c = m_source.at(m_pos).unicode();
+        if (c == ';') {
+            m_pos++;
+            break;
+        }
+        int digit;
+        if ((c >= '0') && (c <= '9')) {
+            digit = c - '0';
+        } else if ((base == 16) && (c >= 'a') && (c <= 'f')) {
+            digit = c - 'a' + 10;
+        } else if ((base == 16) && (c >= 'A') && (c <= 'F')) {
+            digit = c - 'A' + 10;
+        } else {
+            return fatal(m_pos, invalid);
+        }
+        value = value * base + digit;
+        if (value > 0x10FFFF) {
+            // keep it from overflowing, it is reported once the ; is reached
+            value = 0x110000;
+        }
+        m_pos++;
+    }
+    if (value > 0x10FFFF) {
+        return fatal(m_pos, "xmlParseCharRef: character reference out of bounds");
+    }
+    if (!is_xml_char(value)) {
+        return fatal(m_pos, QString("xmlParseCharRef: invalid xmlChar value %1").arg(value));
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::parseCharData()
+{
+    while (!atEnd()) {
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if ((c == '<') || (c == '&')) {
+            return true;
+        }
+        if ((c == ']') && lookingAt("]]>")) {
+            return fatal(m_pos, "Sequence ']]>' not allowed in content");
+        }
+        if (outOfRange(c)) {
+            return false;
+        }
+        if (!is_xml_char(c)) {
+            return fatal(m_pos, QString("PCDATA invalid Char value %1").arg(c));
+        }
+        m_pos += len;
+    }
+    return true;
+}
+
+
+// libxml2 reads plain ascii comments in a fast loop and only falls back
+// to looking at each character when that stops, the two report a double
+// hyphen differently
+bool WellFormedXMLChecker::parseComment()
+{
+    m_pos += 4;
+    qsizetype start = m_pos;
+    while (!atEnd()) {
+        ushort c = m_source.at(m_pos).unicode();
+        if ((c == '-') && lookingAt("--")) {
+            if (lookingAt("-->")) {
+                m_pos += 3;
+                return true;
+            }
+            if (m_pos == start) {
+                return fatal(m_pos, "Double hyphen within comment");
+            }
+            return fatal(m_pos, "Double hyphen within comment: <!--" + first_50_bytes(m_source.mid(start, m_pos - start)));
+        }
+        if ((c >= 0x80) || ((c < 0x20) && (c != 0x09) && (c != 0x0A) && (c != 0x0D)) ||
+            ((c == 0x0D) && !lookingAt("\r\n"))) {
+            break;
+        }
+        m_pos++;
+    }
+
+    int len;
+    char32_t q = charAt(m_pos, &len);
+    if (atEnd()) {
+        return fatal(m_pos, "Comment not terminated");
+    }
+    if (outOfRange(q)) {
+        return false;
+    }
+    if (!is_xml_char(q)) {
+        return fatal(m_pos, QString("xmlParseComment: invalid xmlChar value %1").arg(q));
+    }
+    qsizetype qpos = m_pos;
+    m_pos += len;
+    char32_t r = charAt(m_pos, &len);
+    if (atEnd()) {
+        return fatal(m_pos, "Comment not terminated");
+    }
+    if (outOfRange(r)) {
+        return false;
+    }
+    if (!is_xml_char(r)) {
+        // libxml2 reports the character before the invalid one here
+        return fatal(m_pos, QString("xmlParseComment: invalid xmlChar value %1").arg(q));
+    }
+    m_pos += len;
+    if (atEnd()) {
+        return fatal(m_pos, "Comment not terminated");
+    }
+    while (true) {
+        if (atEnd()) {
+            return fatal(m_pos, "Comment not terminated \n<!--" + first_50_bytes(m_source.mid(start, qpos - start)));
+        }
+        char32_t c = charAt(m_pos, &len);
+        if (outOfRange(c)) {
+            return false;
+        }
+        if (!is_xml_char(c)) {
+            return fatal(m_pos, QString("xmlParseComment: invalid xmlChar value %1").arg(c));
+        }
+        if ((q == '-') && (r == '-')) {
+            if (c == '>') {
+                m_pos += len;
+                return true;
+            }
+            return fatal(m_pos, "Comment must not contain '--' (double-hyphen)");
+        }
+        qpos += (q >= 0x10000) ? 2 : 1;
+        q = r;
+        r = c;
+        m_pos += len;
+    }
+}
+
+
+bool WellFormedXMLChecker::parsePI()
+{
+    int input = m_InputId;
+    m_pos += 2;
+    QStringView target = parseName();
+    if (target.isEmpty()) {
+        return fatal(m_pos, "xmlParsePI : no target name");
+    }
+    if (target.startsWith(u"xml", Qt::CaseInsensitive)) {
+        if (target == u"xml") {
+            return fatal(m_pos, "XML declaration allowed only at the start of the document");
+        }
+        if (target.size() == 3) {
+            return fatal(m_pos, "Invalid PI name");
+        }
+        if ((target != u"xml-stylesheet") && (target != u"xml-model")) {
+            warning(m_pos, "xmlParsePITarget: invalid name prefix 'xml'");
+        }
+    }
+    if (target.contains(u':')) {
+        error(m_pos, QString("colons are forbidden from PI names '%1'").arg(target.toString()));
+    }
+    if (lookingAt("?>")) {
+        if (m_InputId != input) {
+            return fatal(m_pos, PI_BOUNDARY_ERROR);
+        }
+        m_pos += 2;
+        return true;
+    }
+    if (skipBlanks() == 0) {
+        return fatal(m_pos, QString("ParsePI: PI %1 space expected").arg(target.toString()));
+    }
+    while (true) {
+        if (lookingAt("?>")) {
+            if (m_InputId != input) {
+                return fatal(m_pos, PI_BOUNDARY_ERROR);
+            }
+            m_pos += 2;
+            return true;
+        }
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if (outOfRange(c)) {
+            return false;
+        }
+        if (atEnd() || !is_xml_char(c)) {
+            return fatal(m_pos, QString("ParsePI: PI %1 never end ...").arg(target.toString()));
+        }
+        m_pos += len;
+    }
+}
+
+
+// libxml2 has no text for a section that ends (or goes bad) in its first
+// two characters, lxml shows that as an unregistered error
+bool WellFormedXMLChecker::parseCDSect()
+{
+    m_pos += 9;
+    qsizetype start = m_pos;
+    for (int i = 0; i < 2; i++) {
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if (outOfRange(c)) {
+            return false;
+        }
+        if (atEnd() || !is_xml_char(c)) {
+            return fatal(m_pos, "Unregistered error message");
+        }
+        m_pos += len;
+    }
+    while (true) {
+        if ((m_source.at(m_pos - 1) == u']') && (m_source.at(m_pos - 2) == u']') && lookingAt(">")) {
+            m_pos++;
+            return true;
+        }
+        int len;
+        char32_t c = charAt(m_pos, &len);
+        if (outOfRange(c)) {
+            return false;
+        }
+        if (atEnd() || !is_xml_char(c)) {
+            // what was read less the two characters held back to find the ]]>
+            qsizetype end = m_pos;
+            for (int i = 0; i < 2; i++) {
+                end--;
+                if (m_source.at(end).isLowSurrogate() && (end > start)) end--;
+            }
+            return fatal(m_pos, "CData section not finished\n" + first_50_bytes(m_source.mid(start, end - start)));
+        }
+        m_pos += len;
+    }
+}
+
+
+// Bad namespace names do not break well-formedness but are reported
+// first if something else does
+void WellFormedXMLChecker::checkNamespaceDeclaration(QStringView prefix, QStringView uri)
+{
+    QString attname = prefix.isEmpty() ? QString("xmlns") : "xmlns:" + prefix.toString();
+    if (!is_valid_uri(uri)) {
+        error(m_pos, QString("%1: '%2' is not a valid URI").arg(attname, uri.toString()));
+    } else if (prefix.isEmpty() && (scheme_length(uri) == 0)) {
+        warning(m_pos, QString("xmlns: URI %1 is not absolute").arg(uri.toString()));
+    }
+    if (prefix.isEmpty() && (uri == XML_NAMESPACE)) {
+        error(m_pos, "xml namespace URI cannot be the default namespace");
+    } else if (prefix.isEmpty() && (uri == XMLNS_NAMESPACE)) {
+        error(m_pos, "reuse of the xmlns namespace name is forbidden");
+    }
+}
+
+
+// The value libxml2 checks namespace names against, references replaced
+// and white space characters turned into spaces. Values that need it are
+// kept for the rest of the walk as namespaces may point into them, each
+// of them and all of them together only up to the length libxml2 allows
+bool WellFormedXMLChecker::normalizedValue(QStringView value, QStringView &normalized)
+{
+    bool plain = true;
+    foreach(QChar c, value) {
+        if ((c == u'&') || (c == u'\t') || (c == u'\n') || (c == u'\r')) {
+            plain = false;
+            break;
+        }
+    }
+    if (plain) {
+        normalized = value;
+        return true;
+    }
+
+    QString expanded;
+    if (!appendNormalized(value, expanded, 0) || (m_ValuesLength + expanded.size() > MAX_TEXT_LENGTH)) {
+        return fatal(m_pos, ATTVALUE_LENGTH_ERROR);
+    }
+    m_ValuesLength += expanded.size();
+    m_Values.append(expanded);
+    normalized = m_Values.last();
+    return true;
+}
+
+
+// declared entities are replaced as well, their values already have
+// their character references replaced. Stops once normalized is longer
+// than an attribute value can be
+bool WellFormedXMLChecker::appendNormalized(QStringView value, QString &normalized, int depth) const
+{
+    for (qsizetype i = 0; i < value.size(); i++) {
+        if (normalized.size() > MAX_TEXT_LENGTH) {
+            return false;
+        }
+        QChar c = value.at(i);
+        if ((c == u'\t') || (c == u'\n') || (c == u'\r')) {
+            normalized.append(QChar(' '));
+            continue;
+        }
+        qsizetype end = (c == u'&') ? value.indexOf(u';', i) : -1;
+        if (end == -1) {
+            normalized.append(c);
+            continue;
+        }
+        QStringView name = value.mid(i + 1, end - i - 1);
+        int index = -1;
+        if (name == u"lt") normalized.append(QChar('<'));
+        else if (name == u"gt") normalized.append(QChar('>'));
+        else if (name == u"amp") normalized.append(QChar('&'));
+        else if (name == u"quot") normalized.append(QChar('"'));
+        else if (name == u"apos") normalized.append(QChar('\''));
+        else if (name.startsWith(u"#x")) normalized.append(QChar::fromUcs4(name.mid(2).toUInt(nullptr, 16)));
+        else if (name.startsWith(u"#")) normalized.append(QChar::fromUcs4(name.mid(1).toUInt()));
+        else if ((depth < MAX_ENTITY_DEPTH) && ((index = findEntity(name, false)) != -1) &&
+                 !m_Entities.at(index).external) {
+            if (!appendNormalized(m_Entities.at(index).value, normalized, depth + 1)) return false;
+        }
+        else normalized.append(value.mid(i, end - i + 1));
+        i = end;
+    }
+    return normalized.size() <= MAX_TEXT_LENGTH;
+}
+
+
+bool WellFormedXMLChecker::lookupNamespace(QStringView prefix, QStringView &uri) const
+{
+    if (prefix == u"xml") {
+        uri = XML_NAMESPACE;
+        return true;
+    }
+    int index = namespaceIndex(prefix);
+    if (index == -1) return false;
+    uri = m_Namespaces.at(index).uri;
+    return true;
+}
+
+
+// innermost declaration of prefix, xml is never declared
+int WellFormedXMLChecker::namespaceIndex(QStringView prefix) const
+{
+    if (prefix == u"xml") return -1;
+    for (int i = m_Namespaces.size() - 1; i >= 0; i--) {
+        if (m_Namespaces.at(i).prefix == prefix) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+QStringView WellFormedXMLChecker::parseName()
+{
+    qsizetype start = m_pos;
+    int len;
+    if (atEnd() || !is_name_start_char(charAt(m_pos, &len))) {
+        outOfRange(charAt(m_pos));
+        return QStringView();
+    }
+    m_pos += len;
+    while (!atEnd() && is_name_char(charAt(m_pos, &len))) {
+        m_pos += len;
+    }
+    outOfRange(charAt(m_pos));
+    return m_source.mid(start, m_pos - start);
+}
+
+
+QStringView WellFormedXMLChecker::parseNCName()
+{
+    qsizetype start = m_pos;
+    int len;
+    char32_t c = charAt(m_pos, &len);
+    if (atEnd() || (c == ':') || !is_name_start_char(c)) {
+        outOfRange(c);
+        return QStringView();
+    }
+    m_pos += len;
+    while (!atEnd()) {
+        c = charAt(m_pos, &len);
+        if ((c == ':') || !is_name_char(c)) break;
+        m_pos += len;
+    }
+    outOfRange(charAt(m_pos));
+    return m_source.mid(start, m_pos - start);
+}
+
+
+QStringView WellFormedXMLChecker::parseNmtoken()
+{
+    qsizetype start = m_pos;
+    int len;
+    while (!atEnd() && is_name_char(charAt(m_pos, &len))) {
+        m_pos += len;
+    }
+    outOfRange(charAt(m_pos));
+    return m_source.mid(start, m_pos - start);
+}
+
+
+// Returns the local name, a name libxml2 can not split is returned whole
+// (or with the part it could not use) after a non fatal error
+QStringView WellFormedXMLChecker::parseQName(QStringView &prefix)
+{
+    qsizetype start = m_pos;
+    prefix = QStringView();
+    QStringView local = parseNCName();
+    if (local.isEmpty()) {
+        if (atEnd() || (m_source.at(m_pos) != u':')) {
+            return QStringView();
+        }
+        QStringView name = parseName();
+        error(m_pos, QString("Failed to parse QName '%1'").arg(name.toString()));
+        return name;
+    }
+    if (atEnd() || (m_source.at(m_pos) != u':')) {
+        return local;
+    }
+    m_pos++;
+    QStringView p = local;
+    local = parseNCName();
+    if (local.isEmpty()) {
+        error(m_pos, QString("Failed to parse QName '%1:'").arg(p.toString()));
+        parseNmtoken();
+        return m_source.mid(start, m_pos - start);
+    }
+    prefix = p;
+    if (!atEnd() && (m_source.at(m_pos) == u':')) {
+        error(m_pos, QString("Failed to parse QName '%1:%2:'").arg(p.toString(), local.toString()));
+        m_pos++;
+        parseName();
+        qsizetype lstart = start + p.size() + 1;
+        return m_source.mid(lstart, m_pos - lstart);
+    }
+    return local;
+}
+
+
+int WellFormedXMLChecker::skipBlanks()
+{
+    int n = 0;
+    // references are only followed once inside a parameter entity
+    bool expand = m_InSubset && !m_Inputs.isEmpty();
+    while (!m_Fatal) {
+        if (!atEnd() && is_blank(m_source.at(m_pos).unicode())) {
+            m_pos++;
+        } else if (m_InSubset && !atEnd() && (m_source.at(m_pos) == u'%')) {
+            if (!expand || (m_pos + 1 >= m_source.size()) || is_blank(m_source.at(m_pos + 1).unicode())) break;
+            parsePEReference();
+        } else if (m_InSubset && atEnd() && !m_Inputs.isEmpty()) {
+            popInput();
+        } else {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+
+// the code point at i, lone surrogates are what QString::toUtf8() makes of them
+char32_t WellFormedXMLChecker::charAt(qsizetype i, int *len) const
+{
+    return char_at(m_source, i, len);
+}
+
+
+// libxml2 reports nul and the two non characters as soon as it reads
+// them as a character, before the check of whatever it was parsing
+bool WellFormedXMLChecker::outOfRange(char32_t c)
+{
+    if (!atEnd() && ((c == 0) || (c == 0xFFFE) || (c == 0xFFFF))) {
+        fatal(m_pos, out_of_range(c));
+        return true;
+    }
+    return false;
+}
+
+
+bool WellFormedXMLChecker::lookingAt(const char *s) const
+{
+    qsizetype i = m_pos;
+    while (*s) {
+        if ((i >= m_source.size()) || (m_source.at(i).unicode() != (uchar) *s)) {
+            return false;
+        }
+        i++;
+        s++;
+    }
+    return true;
+}
+
+
+bool WellFormedXMLChecker::fatal(qsizetype pos, const QString &message)
+{
+    error(pos, message);
+    m_Fatal = true;
+    return false;
+}
+
+
+// stops the walk without an error of its own, see Check()
+bool WellFormedXMLChecker::unsupported()
+{
+    m_Unsupported = true;
+    m_Fatal = true;
+    return false;
+}
+
+
+void WellFormedXMLChecker::error(qsizetype pos, const QString &message)
+{
+    report(pos, message);
+    m_LastWasError = true;
+}
+
+
+void WellFormedXMLChecker::warning(qsizetype pos, const QString &message)
+{
+    report(pos, message);
+    m_LastWasError = false;
+}
+
+
+// Inside a parameter entity errors are put where the entity was used,
+// for an entity used in another entity that is within the outer one
+void WellFormedXMLChecker::report(qsizetype pos, const QString &message)
+{
+    m_Reports++;
+    if (!m_HaveError) {
+        m_HaveError = true;
+        m_ErrorMessage = message;
+        if (m_Inputs.isEmpty()) {
+            lineColumn(pos, m_ErrorLine, m_ErrorColumn);
+        } else {
+            line_column(m_Inputs.last().source, m_Inputs.last().pos, m_ErrorLine, m_ErrorColumn);
+        }
+    }
+}
+
+
+void WellFormedXMLChecker::errorAt(int line, int column, const QString &message, bool is_error)
+{
+    m_Reports++;
+    if (!m_HaveError) {
+        m_HaveError = true;
+        m_ErrorLine = line;
+        m_ErrorColumn = column;
+        m_ErrorMessage = message;
+    }
+    m_LastWasError = is_error;
+}
+
+
+// Only worked out for the one error reported, columns count code points
+// and a leading byte order mark is not counted
+void WellFormedXMLChecker::lineColumn(qsizetype pos, int &line, int &column) const
+{
+    line_column(m_source, pos, line, column);
+}
+
+
+int WellFormedXMLChecker::lineAt(qsizetype pos) const
+{
+    int line;
+    int column;
+    lineColumn(pos, line, column);
+    return line;
+}
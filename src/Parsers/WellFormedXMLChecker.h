@@ -0,0 +1,269 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks Stratford, ON, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef WELLFORMEDXMLCHECKER_H
+#define WELLFORMEDXMLCHECKER_H
+
+#include <QString>
+#include <QStringView>
+#include <QList>
+
+// Streaming well-formedness check of a whole xml document (opf, ncx, svg ...)
+// that walks the source once without building a tree. The first error is
+// reported with the same line, column and message libxml2 (and so lxml)
+// gives for it, columns count characters. The element and namespace
+// stacks only hold views of the source so it can be run on many resources
+// at the same time.
+//
+// Two things libxml2 does are not modelled: ATTLIST defaults that can
+// declare or use a namespace (libxml2 adds them to every start tag of the
+// element) and parameter entity references inside entity values (libxml2
+// replaces them as it reads the declaration). The check stops at a start
+// tag that would get such a default or at such an entity value, Check()
+// then sets unsupported and the caller has to use lxml instead.
+
+class WellFormedXMLChecker
+{
+public:
+
+    struct Error {
+        int line;
+        int column;
+        QString message;
+        bool unsupported;
+
+        Error() : line(-1), column(-1), unsupported(false) {}
+    };
+
+    // line is -1 if source is well-formed or unsupported, source should
+    // not start with an xml declaration (CleanSource removes it just as
+    // xmlprocessor does)
+    static Error Check(QStringView source);
+
+private:
+
+    WellFormedXMLChecker(QStringView source);
+
+    // name is the qualified name as written, local and prefix are how
+    // libxml2 splits it up (and so what its messages use)
+    struct OpenElement {
+        QStringView name;
+        QStringView local;
+        QStringView prefix;
+        qsizetype pos;
+        int nsmark;
+    };
+
+    struct Attribute {
+        QStringView local;
+        QStringView prefix;
+        QStringView uri;
+    };
+
+    enum AttributeType {
+        CDataAttribute,
+        IdAttribute,
+        IdRefAttribute,
+        IdRefsAttribute,
+        EntityAttribute,
+        EntitiesAttribute,
+        NmTokenAttribute,
+        NmTokensAttribute,
+        EnumerationAttribute,
+        NotationAttribute
+    };
+
+    struct AttributeDecl {
+        QStringView element;
+        QStringView name;
+        AttributeType type;
+    };
+
+    struct Input {
+        QStringView source;
+        qsizetype pos;
+        int id;
+    };
+
+    struct Namespace {
+        QStringView prefix;
+        QStringView uri;
+    };
+
+    // value has its character references already replaced, checked is set
+    // once its text has been walked as content and gave some, text if that
+    // was only text. references is what libxml2 counts for each use of the
+    // entity, -1 until it first expanded it and 0 while it does. length is
+    // -1 unless an expansion of the entity in an attribute value has been
+    // remembered, see expandEntity()
+    struct Entity {
+        QStringView name;
+        QStringView value;
+        QStringView systemId;
+        bool parameter;
+        bool external;
+        bool unparsed;
+        bool checked;
+        bool text;
+        qint64 references;
+        qint64 length;
+        qint64 expansionReferences;
+        qint64 largestReferences;
+        int height;
+    };
+
+    bool parseDocument();
+    bool parseMisc();
+    bool parseDocType();
+    bool parseInternalSubset();
+    bool parseExternalID(QStringView &publicId, QStringView &systemId, bool strict = true);
+    bool parseLiteral(QStringView &literal, bool pubid);
+    bool parseMarkupDecl();
+    bool parseElementDecl();
+    bool parseMixedContentDecl(int group);
+    bool parseChildrenContentDecl(int group, int depth);
+    bool parseAttlistDecl();
+    bool parseAttributeType(AttributeType &type);
+    bool parseDefaultDecl(QStringView &value);
+    bool addAttributeDecl(const AttributeDecl &decl, QStringView value);
+    bool isValidDefault(AttributeType type, QStringView value) const;
+    bool parseNotationDecl();
+    bool parseEntityDecl();
+    bool parseEntityValue(QStringView &value);
+    bool parsePEReference();
+    bool pushInput(QStringView text);
+    void popInput();
+    bool parseContent(bool chunk);
+    bool parseStartTag(bool &empty);
+    bool parseEndTag();
+    bool parseAttValue();
+    bool parseReference(bool in_attribute);
+    bool undefinedEntity(QStringView name);
+    bool checkEntityUse(int index, bool in_attribute);
+    bool checkExpansion(int index, int depth, bool in_attribute);
+    bool checkExpansionSize(qint64 size, bool in_attribute);
+    bool checkSubsetReferences(bool in_attribute);
+    bool expandEntity(int index, int depth, bool in_attribute, qint64 &length);
+    bool expandText(QStringView text, int depth, bool in_attribute, qint64 &length);
+    void forgetExpansions();
+    qint64 consumedBytes();
+    bool checkContentEntity(int index);
+    bool stringCharRef(QStringView text, qsizetype &i, char32_t &value);
+    bool decodeCharRefs(QStringView literal, QStringView &value);
+    int findEntity(QStringView name, bool parameter) const;
+    bool parseCharRef(char32_t &value);
+    bool parseCharData();
+    bool parseComment();
+    bool parsePI();
+    bool parseCDSect();
+    void checkNamespaceDeclaration(QStringView prefix, QStringView uri);
+    bool normalizedValue(QStringView value, QStringView &normalized);
+    bool appendNormalized(QStringView value, QString &normalized, int depth) const;
+    bool lookupNamespace(QStringView prefix, QStringView &uri) const;
+    int namespaceIndex(QStringView prefix) const;
+
+    QStringView parseName();
+    QStringView parseNCName();
+    QStringView parseNmtoken();
+    QStringView parseQName(QStringView &prefix);
+    int skipBlanks();
+    char32_t charAt(qsizetype i, int *len = nullptr) const;
+    bool outOfRange(char32_t c);
+    bool lookingAt(const char *s) const;
+    bool atEnd() const { return m_pos >= m_source.size(); }
+
+    // the first error wins, only an error that breaks well-formedness
+    // stops the walk and makes the first error the result
+    bool fatal(qsizetype pos, const QString &message);
+    bool unsupported();
+    void error(qsizetype pos, const QString &message);
+    void warning(qsizetype pos, const QString &message);
+    void report(qsizetype pos, const QString &message);
+    void errorAt(int line, int column, const QString &message, bool is_error);
+    void lineColumn(qsizetype pos, int &line, int &column) const;
+    int lineAt(qsizetype pos) const;
+
+    QStringView m_source;
+    qsizetype m_pos;
+
+    QList<OpenElement> m_Elements;
+    QList<Namespace> m_Namespaces;
+    QList<Attribute> m_Attributes;
+    QList<Entity> m_Entities;
+    QList<QStringView> m_ElementDecls;
+    QList<AttributeDecl> m_AttributeDecls;
+    QList<QStringView> m_NotationDecls;
+
+    // elements with an ATTLIST default for xmlns or a prefixed attribute,
+    // the check gives up at their first start tag
+    QList<QStringView> m_NamespaceDefaults;
+    QList<QString> m_Values;
+    qint64 m_ValuesLength;
+
+    // undeclared entities are only fatal in documents without an external dtd
+    bool m_HasExternalSubset;
+    bool m_HasPERefs;
+
+    // the sources parameter entities were used in, ids tell declarations
+    // that end in another entity than they started in
+    QList<Input> m_Inputs;
+    bool m_InSubset;
+    int m_InputId;
+    int m_LastInputId;
+
+    // nested entity content is only checked so deep
+    int m_Depth;
+    int m_InheritedNamespaces;
+
+    // libxml2 counts entity references to give up on documents whose
+    // entities expand far beyond what has been read, a chunk of entity
+    // content counts on its own. The rest tells expandEntity() whether
+    // an expansion can be remembered
+    qint64 m_EntityReferences;
+    qint64 m_LargestReferences;
+    int m_DeepestExpansion;
+    int m_FirstExpansions;
+    int m_SizeChecks;
+    int m_Reports;
+
+    // what a chunk of entity content gave
+    bool m_HasText;
+    bool m_HasMarkup;
+
+    // utf-8 length of the attribute value being read
+    qint64 m_ValueLength;
+
+    // where consumedBytes() last counted up to
+    const QChar *m_ConsumedSource;
+    qsizetype m_ConsumedPos;
+    qint64 m_ConsumedBytes;
+
+    bool m_HaveError;
+    bool m_Fatal;
+    bool m_Unsupported;
+    bool m_LastWasError;
+    int m_ErrorLine;
+    int m_ErrorColumn;
+    QString m_ErrorMessage;
+};
+
+#endif // WELLFORMEDXMLCHECKER_H
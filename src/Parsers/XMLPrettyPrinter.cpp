@@ -0,0 +1,1039 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks Stratford, ON, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <cstring>
+
+#include <QString>
+#include <QStringView>
+#include <QStringList>
+#include <QHash>
+#include <QUrl>
+
+#include "Misc/Utility.h"
+#include "Parsers/TagAtts.h"
+#include "Parsers/XMLPrettyPrinter.h"
+
+// The output has to match what the python code gave byte for byte since
+// that is what ends up in the opf, so the quirks of sigil_bs4 and of
+// opf_newparser.py are reproduced here on purpose.
+
+static const QString INDENT = "  ";
+static const QString XML_NAMESPACE = "http://www.w3.org/XML/1998/namespace";
+static const QString OPF_NAMESPACE = "http://www.idpf.org/2007/opf";
+static const QString ASCII_SPACES = " \n\t\f\r";
+static const QString OPF_WHITESPACE_CHARS = " \n\r\t";
+
+static const QStringList XML_PARENT_TAGS = QStringList() << "package" << "metadata" << "manifest"
+    << "spine" << "guide" << "ncx" << "head" << "doctitle" << "docauthor" << "navmap"
+    << "navpoint" << "navlabel" << "pagelist" << "pagetarget";
+
+static const QStringList OPF_PARENT_TAGS = QStringList() << "package" << "metadata" << "dc-metadata"
+    << "x-metadata" << "manifest" << "spine" << "tours" << "guide" << "bindings";
+
+static const QStringList DEPRECATED_METADATA_TAGS = QStringList() << "dc-metadata" << "x-metadata";
+
+// bs4's lxml tree builder rewrites the prefixes of these namespaces
+static const QHash<QString, QString> STANDARD_EPUB_PREFIXES {
+    { "http://www.idpf.org/2007/opf",                             "opf"       },
+    { "http://purl.org/dc/elements/1.1/",                         "dc"        },
+    { "http://purl.org/dc/terms/",                                "dcterms"   },
+    { "http://id.loc.gov/vocabulary/",                            "marc"      },
+    { "http://www.idpf.org/vocab/rendition/#",                    "rendition" },
+    { "http://www.editeur/org/ONIX/book/codelists/current.html#", "onix"      },
+    { "http://www.idpf.org/epub/vocab/overlays/#",                "media"     },
+    { "http://www.idpf.org/2007/ops",                             "epub"      }
+};
+
+
+static bool is_blank(QChar c)
+{
+    ushort u = c.unicode();
+    return (u == 0x20) || (u == 0x09) || (u == 0x0A) || (u == 0x0D);
+}
+
+// what python's str.isspace() takes as whitespace
+static bool is_python_space(QChar c)
+{
+    ushort u = c.unicode();
+    return ((u >= 0x09) && (u <= 0x0D)) || ((u >= 0x1C) && (u <= 0x20)) || (u == 0x85) ||
+           (u == 0xA0) || (u == 0x1680) || ((u >= 0x2000) && (u <= 0x200A)) ||
+           (u == 0x2028) || (u == 0x2029) || (u == 0x202F) || (u == 0x205F) || (u == 0x3000);
+}
+
+static bool is_hex_digit(QChar c)
+{
+    ushort u = c.unicode();
+    return ((u >= '0') && (u <= '9')) || ((u >= 'a') && (u <= 'f')) || ((u >= 'A') && (u <= 'F'));
+}
+
+static QStringView python_strip(QStringView s)
+{
+    qsizetype b = 0;
+    qsizetype e = s.size();
+    while ((b < e) && is_python_space(s.at(b))) b++;
+    while ((e > b) && is_python_space(s.at(e - 1))) e--;
+    return s.mid(b, e - b);
+}
+
+static QString rstrip(const QString &s, const QString &chars)
+{
+    qsizetype e = s.size();
+    while ((e > 0) && chars.contains(s.at(e - 1))) e--;
+    return s.left(e);
+}
+
+static char32_t code_point_at(QStringView s, qsizetype i, int &len)
+{
+    QChar c = s.at(i);
+    if (c.isHighSurrogate() && (i + 1 < s.size()) && s.at(i + 1).isLowSurrogate()) {
+        len = 2;
+        return QChar::surrogateToUcs4(c, s.at(i + 1));
+    }
+    len = 1;
+    return c.unicode();
+}
+
+// length of the match of (&#\d+;|&#x[0-9a-fA-F]+;|&\w+;) at i or 0,
+// \d and \w are the unicode classes python's re uses for them
+static qsizetype entity_length(QStringView s, qsizetype i)
+{
+    qsizetype n = s.size();
+    qsizetype p = i + 1;
+    int len;
+    if ((p < n) && (s.at(p) == '#')) {
+        qsizetype q = p + 1;
+        while ((q < n) && QChar::isDigit(code_point_at(s, q, len))) q += len;
+        if (q > p + 1) {
+            return ((q < n) && (s.at(q) == ';')) ? q + 1 - i : 0;
+        }
+        if ((q < n) && (s.at(q) == 'x')) {
+            qsizetype r = q + 1;
+            while ((r < n) && is_hex_digit(s.at(r))) r++;
+            if ((r > q + 1) && (r < n) && (s.at(r) == ';')) {
+                return r + 1 - i;
+            }
+        }
+        return 0;
+    }
+    qsizetype q = p;
+    while (q < n) {
+        char32_t c = code_point_at(s, q, len);
+        if ((c != '_') && !QChar::isLetterOrNumber(c)) break;
+        q += len;
+    }
+    return ((q > p) && (q < n) && (s.at(q) == ';')) ? q + 1 - i : 0;
+}
+
+// bs4's minimal formatter, ampersands that already look like the start
+// of an entity are left alone
+static void append_minimal(QStringView s, QString &out, bool attribute)
+{
+    for (qsizetype i = 0; i < s.size(); i++) {
+        QChar c = s.at(i);
+        switch (c.unicode()) {
+            case '<':
+                out.append("&lt;");
+                break;
+            case '>':
+                out.append("&gt;");
+                break;
+            case 0xA0:
+                out.append("&#160;");
+                break;
+            case '&':
+                out.append(entity_length(s, i) == 0 ? QString("&amp;") : QString(c));
+                break;
+            case '"':
+                out.append(attribute ? QString("&quot;") : QString(c));
+                break;
+            default:
+                out.append(c);
+        }
+    }
+}
+
+// decodexml escapes the ampersand of everything that looks like an
+// entity except the three xml ones it makes itself
+static QString escape_entities(QStringView s)
+{
+    if (s.indexOf('&') == -1) {
+        return s.toString();
+    }
+    QString out;
+    out.reserve(s.size() + 16);
+    qsizetype i = 0;
+    while (i < s.size()) {
+        if (s.at(i) == '&') {
+            qsizetype len = entity_length(s, i);
+            if (len > 0) {
+                QStringView piece = s.mid(i, len);
+                if ((piece != u"&lt;") && (piece != u"&gt;") && (piece != u"&amp;")) {
+                    out.append("&amp;");
+                    out.append(piece.mid(1));
+                } else {
+                    out.append(piece);
+                }
+                i += len;
+                continue;
+            }
+        }
+        out.append(s.at(i));
+        i++;
+    }
+    return out;
+}
+
+// libxml2 hands on \r\n and a lone \r as \n
+static void append_normalized(QStringView s, QString &out)
+{
+    qsizetype start = 0;
+    qsizetype i = s.indexOf('\r');
+    while (i != -1) {
+        out.append(s.mid(start, i - start));
+        out.append(QChar('\n'));
+        start = i + 1;
+        if ((start < s.size()) && (s.at(start) == '\n')) start++;
+        i = s.indexOf('\r', start);
+    }
+    out.append(s.mid(start));
+}
+
+// a string of nothing but ascii spaces becomes a single newline or space
+static void collapse_ascii_spaces(QString &s)
+{
+    foreach(QChar c, s) {
+        if (!ASCII_SPACES.contains(c)) return;
+    }
+    s = s.contains('\n') ? QString("\n") : QString(" ");
+}
+
+// python dict assignment, an existing key keeps its place
+static void set_pair(QList<std::pair<QString, QString> > &pairs, const QString &key, const QString &value)
+{
+    for (int i = 0; i < pairs.size(); i++) {
+        if (pairs.at(i).first == key) {
+            pairs[i].second = value;
+            return;
+        }
+    }
+    pairs.append(std::make_pair(key, value));
+}
+
+static QString xml_encode(const QString &data)
+{
+    QString newdata = data;
+    newdata.replace("&quot;", "\"").replace("&gt;", ">").replace("&lt;", "<").replace("&amp;", "&");
+    newdata.replace("&", "&amp;").replace("<", "&lt;").replace(">", "&gt;").replace("\"", "&quot;");
+    return newdata;
+}
+
+static void append_atts(QString &out, const TagAtts &atts)
+{
+    for (const auto &kv : atts.pairs()) {
+        out.append(" " + kv.first + "=\"" + xml_encode(kv.second) + "\"");
+    }
+}
+
+// hrefutils urlencodepart, unlike Utility::URLEncodePath nothing is
+// decoded or normalized first
+static QString url_encode_part(const QString &part)
+{
+    QString result;
+    foreach(uint cp, part.toUcs4()) {
+        QString s = QString::fromUcs4(reinterpret_cast<char32_t *>(&cp), 1);
+        if (Utility::NeedToPercentEncode(cp)) {
+            foreach(char b, s.toUtf8()) {
+                result.append("%" + QString::number(static_cast<uchar>(b), 16).toUpper().rightJustified(2, '0'));
+            }
+        } else {
+            result.append(s);
+        }
+    }
+    return result;
+}
+
+
+XMLPrettyPrinter::XMLPrettyPrinter(QStringView source, const QStringList &void_tags)
+    : m_source(source),
+      m_pos(0),
+      m_VoidTags(void_tags),
+      m_HaveData(false)
+{
+}
+
+
+QString XMLPrettyPrinter::PrettyPrint(QStringView source, const QStringList &void_tags)
+{
+    XMLPrettyPrinter printer(source, void_tags);
+    if (!printer.parseDocument()) {
+        return QString();
+    }
+    return "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n" + printer.m_Frames.first().out;
+}
+
+
+bool XMLPrettyPrinter::parseDocument()
+{
+    // the document itself, its contents are indented one level in
+    Frame root;
+    root.level = 0;
+    root.contentLevel = 1;
+    root.xmlparent = false;
+    root.canBeEmpty = false;
+    root.children = 0;
+    root.onlyChildBlank = false;
+    root.written = false;
+    root.pendingNewline = false;
+    m_Frames.append(root);
+    m_PrefixMaps.append(PairList() << std::make_pair(XML_NAMESPACE, QString("xml")));
+
+    if (!atEnd() && (m_source.at(0) == QChar(0xFEFF))) m_pos++;
+
+    while (!atEnd()) {
+        QChar c = m_source.at(m_pos);
+        bool ok = true;
+        if (c == '<') {
+            if (lookingAt("<!--")) {
+                ok = parseComment();
+            } else if (lookingAt("<![CDATA[")) {
+                ok = parseCDSect();
+            } else if (lookingAt("<!DOCTYPE")) {
+                ok = parseDocType();
+            } else if (lookingAt("<?")) {
+                ok = parsePI();
+            } else if (lookingAt("</")) {
+                ok = parseEndTag();
+            } else {
+                ok = parseStartTag();
+            }
+        } else if (c == '&') {
+            ok = parseReference(m_Data);
+            m_HaveData = true;
+        } else {
+            qsizetype start = m_pos;
+            while (!atEnd() && (m_source.at(m_pos) != '<') && (m_source.at(m_pos) != '&')) m_pos++;
+            // lxml does not pass on the blanks outside of the root element
+            if (m_Frames.size() > 1) {
+                append_normalized(m_source.mid(start, m_pos - start), m_Data);
+                m_HaveData = true;
+            }
+        }
+        if (!ok) return false;
+    }
+    return m_Frames.size() == 1;
+}
+
+
+bool XMLPrettyPrinter::parseStartTag()
+{
+    m_pos++;
+    QStringView qname = parseName();
+    PairList attributes;
+    QList<Declaration> declarations;
+    bool empty = false;
+    while (true) {
+        skipBlanks();
+        if (atEnd()) return false;
+        QChar c = m_source.at(m_pos);
+        if (c == '>') {
+            m_pos++;
+            break;
+        }
+        if (c == '/') {
+            m_pos += 2;
+            empty = true;
+            break;
+        }
+        QStringView name = parseName();
+        skipBlanks();
+        if (atEnd() || (m_source.at(m_pos) != '=')) return false;
+        m_pos++;
+        skipBlanks();
+        QString value;
+        if (!parseAttValue(value)) return false;
+        if (name == u"xmlns") {
+            declarations.append(Declaration{ QString(), value });
+        } else if (name.startsWith(u"xmlns:")) {
+            declarations.append(Declaration{ name.mid(6).toString(), value });
+        } else {
+            attributes.append(std::make_pair(name.toString(), value));
+        }
+    }
+    flushData();
+
+    m_DeclarationMarks.append(m_Declarations.size());
+    m_Declarations.append(declarations);
+    QString uri;
+    QString local;
+    if (!resolve(qname, false, uri, local)) return false;
+
+    // the new declarations with the epub prefixes bs4 rewrites them to,
+    // the default opf namespace is left without one
+    PairList nsmap;
+    foreach(const Declaration &decl, declarations) {
+        QString prefix = STANDARD_EPUB_PREFIXES.value(decl.uri, decl.prefix);
+        if ((prefix == "opf") && decl.prefix.isEmpty()) {
+            prefix = QString();
+        }
+        set_pair(nsmap, prefix, decl.uri);
+    }
+    if (!nsmap.isEmpty()) {
+        PairList inverted;
+        for (const auto &kv : nsmap) {
+            set_pair(inverted, kv.second, kv.first);
+        }
+        m_PrefixMaps.append(inverted);
+    } else if (m_PrefixMaps.size() > 1) {
+        m_PrefixMaps.append(PairList());
+    }
+
+    // the namespace declarations follow the other attributes
+    PairList attrs;
+    for (const auto &kv : attributes) {
+        QString auri;
+        QString alocal;
+        if (!resolve(kv.first, true, auri, alocal)) return false;
+        QString key = alocal;
+        if (!auri.isEmpty()) {
+            QString prefix = prefixForAttribute(auri);
+            if (!prefix.isEmpty()) {
+                key = prefix + ":" + alocal;
+            }
+        }
+        set_pair(attrs, key, kv.second);
+    }
+    for (const auto &kv : nsmap) {
+        set_pair(attrs, kv.first.isEmpty() ? QString("xmlns") : "xmlns:" + kv.first, kv.second);
+    }
+
+    Frame &parent = m_Frames.last();
+    beginChild(parent);
+    Frame frame;
+    QString prefix = prefixForTag(uri);
+    frame.closeName = prefix.isEmpty() ? local : prefix + ":" + local;
+    frame.start = "<" + frame.closeName;
+    for (const auto &kv : attrs) {
+        frame.start.append(" " + kv.first + "=\"");
+        append_minimal(kv.second, frame.start, true);
+        frame.start.append(QChar('"'));
+    }
+    frame.xmlparent = XML_PARENT_TAGS.contains(local.toLower());
+    frame.canBeEmpty = m_VoidTags.contains(local);
+    frame.level = parent.contentLevel;
+    frame.contentLevel = frame.xmlparent ? frame.level + 1 : frame.level;
+    frame.children = 0;
+    frame.onlyChildBlank = false;
+    frame.written = false;
+    frame.pendingNewline = false;
+    m_Frames.append(frame);
+    if (empty) {
+        closeElement();
+    }
+    return true;
+}
+
+
+bool XMLPrettyPrinter::parseEndTag()
+{
+    qsizetype end = m_source.indexOf('>', m_pos);
+    if ((end == -1) || (m_Frames.size() < 2)) return false;
+    m_pos = end + 1;
+    flushData();
+    closeElement();
+    return true;
+}
+
+
+bool XMLPrettyPrinter::parseComment()
+{
+    qsizetype end = m_source.indexOf(u"-->", m_pos + 4);
+    if (end == -1) return false;
+    flushData();
+    QString value;
+    append_normalized(m_source.mid(m_pos + 4, end - m_pos - 4), value);
+    collapse_ascii_spaces(value);
+    addString(value, CommentString);
+    m_pos = end + 3;
+    return true;
+}
+
+
+bool XMLPrettyPrinter::parsePI()
+{
+    m_pos += 2;
+    QStringView target = parseName();
+    skipBlanks();
+    qsizetype end = m_source.indexOf(u"?>", m_pos);
+    if (end == -1) return false;
+    flushData();
+    QString value = target.toString() + " ";
+    append_normalized(m_source.mid(m_pos, end - m_pos), value);
+    addString(value, PIString);
+    m_pos = end + 2;
+    return true;
+}
+
+
+bool XMLPrettyPrinter::parseCDSect()
+{
+    qsizetype start = m_pos + 9;
+    qsizetype end = m_source.indexOf(u"]]>", start);
+    if ((end == -1) || (m_Frames.size() < 2)) return false;
+    append_normalized(m_source.mid(start, end - start), m_Data);
+    m_HaveData = true;
+    m_pos = end + 3;
+    return true;
+}
+
+
+// lxml only passes on the name and the external ids, anything declared in
+// an internal subset would change the parse so that is left to python
+bool XMLPrettyPrinter::parseDocType()
+{
+    m_pos += 9;
+    skipBlanks();
+    QStringView name = parseName();
+    skipBlanks();
+    QString value = name.toString();
+    if (lookingAt("PUBLIC")) {
+        m_pos += 6;
+        skipBlanks();
+        QStringView publicId = parseLiteral();
+        skipBlanks();
+        QStringView systemId = parseLiteral();
+        value += " PUBLIC \"" + publicId.toString() + "\"\n \"" + systemId.toString() + "\"";
+    } else if (lookingAt("SYSTEM")) {
+        m_pos += 6;
+        skipBlanks();
+        value += " SYSTEM \"" + parseLiteral().toString() + "\"";
+    }
+    skipBlanks();
+    if (atEnd() || (m_source.at(m_pos) != '>')) return false;
+    m_pos++;
+    flushData();
+    addString(value, DoctypeString);
+    return true;
+}
+
+
+// character references and the predefined entities, without an internal
+// subset there is nothing else that can be well-formed
+bool XMLPrettyPrinter::parseReference(QString &out)
+{
+    qsizetype end = m_source.indexOf(';', m_pos);
+    if (end == -1) return false;
+    QStringView ref = m_source.mid(m_pos + 1, end - m_pos - 1);
+    m_pos = end + 1;
+    if (ref.startsWith('#')) {
+        bool ok;
+        uint cp = ref.startsWith(u"#x") ? ref.mid(2).toUInt(&ok, 16) : ref.mid(1).toUInt(&ok, 10);
+        if (!ok) return false;
+        out.append(QString::fromUcs4(reinterpret_cast<char32_t *>(&cp), 1));
+        return true;
+    }
+    if (ref == u"lt") {
+        out.append(QChar('<'));
+    } else if (ref == u"gt") {
+        out.append(QChar('>'));
+    } else if (ref == u"amp") {
+        out.append(QChar('&'));
+    } else if (ref == u"apos") {
+        out.append(QChar('\''));
+    } else if (ref == u"quot") {
+        out.append(QChar('"'));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// attribute values are normalized as libxml2 does for cdata attributes,
+// blanks become spaces but the ones from character references are kept
+bool XMLPrettyPrinter::parseAttValue(QString &value)
+{
+    if (atEnd()) return false;
+    QChar quote = m_source.at(m_pos++);
+    while (!atEnd()) {
+        QChar c = m_source.at(m_pos);
+        if (c == quote) {
+            m_pos++;
+            return true;
+        }
+        if (c == '&') {
+            if (!parseReference(value)) return false;
+            continue;
+        }
+        if (c == '\r') {
+            if ((m_pos + 1 < m_source.size()) && (m_source.at(m_pos + 1) == '\n')) m_pos++;
+            value.append(QChar(' '));
+        } else if ((c == '\n') || (c == '\t')) {
+            value.append(QChar(' '));
+        } else {
+            value.append(c);
+        }
+        m_pos++;
+    }
+    return false;
+}
+
+
+QStringView XMLPrettyPrinter::parseName()
+{
+    qsizetype start = m_pos;
+    while (!atEnd()) {
+        QChar c = m_source.at(m_pos);
+        if (is_blank(c) || (c == '>') || (c == '/') || (c == '=') || (c == '?') || (c == '[')) break;
+        m_pos++;
+    }
+    return m_source.mid(start, m_pos - start);
+}
+
+
+QStringView XMLPrettyPrinter::parseLiteral()
+{
+    if (atEnd()) return QStringView();
+    QChar quote = m_source.at(m_pos);
+    if ((quote != '"') && (quote != '\'')) return QStringView();
+    qsizetype end = m_source.indexOf(quote, m_pos + 1);
+    if (end == -1) {
+        m_pos = m_source.size();
+        return QStringView();
+    }
+    QStringView literal = m_source.mid(m_pos + 1, end - m_pos - 1);
+    m_pos = end + 1;
+    return literal;
+}
+
+
+void XMLPrettyPrinter::skipBlanks()
+{
+    while (!atEnd() && is_blank(m_source.at(m_pos))) m_pos++;
+}
+
+
+bool XMLPrettyPrinter::lookingAt(const char *s) const
+{
+    qsizetype n = static_cast<qsizetype>(strlen(s));
+    if (m_pos + n > m_source.size()) return false;
+    for (qsizetype i = 0; i < n; i++) {
+        if (m_source.at(m_pos + i) != QLatin1Char(s[i])) return false;
+    }
+    return true;
+}
+
+
+// the namespace uri libxml2 gives the name, empty for none
+bool XMLPrettyPrinter::resolve(QStringView qname, bool is_attribute, QString &uri, QString &local) const
+{
+    qsizetype colon = qname.indexOf(':');
+    QStringView prefix;
+    if (colon == -1) {
+        local = qname.toString();
+        if (is_attribute) {
+            uri = QString();
+            return true;
+        }
+    } else {
+        prefix = qname.left(colon);
+        local = qname.mid(colon + 1).toString();
+    }
+    if (prefix == u"xml") {
+        uri = XML_NAMESPACE;
+        return true;
+    }
+    for (int i = m_Declarations.size() - 1; i >= 0; i--) {
+        if (m_Declarations.at(i).prefix == prefix) {
+            uri = m_Declarations.at(i).uri;
+            return true;
+        }
+    }
+    uri = QString();
+    return prefix.isEmpty();
+}
+
+
+// the innermost map that knows the namespace decides
+QString XMLPrettyPrinter::prefixForAttribute(const QString &uri) const
+{
+    for (int i = m_PrefixMaps.size() - 1; i >= 0; i--) {
+        for (const auto &kv : m_PrefixMaps.at(i)) {
+            if (kv.first == uri) return kv.second;
+        }
+    }
+    return QString();
+}
+
+
+// tags get no prefix if the namespace was ever the default one in scope,
+// otherwise the most recent prefix for it
+QString XMLPrettyPrinter::prefixForTag(const QString &uri) const
+{
+    if (uri.isEmpty()) return QString();
+    QString prefix;
+    foreach(const PairList &map, m_PrefixMaps) {
+        for (const auto &kv : map) {
+            if (kv.first == uri) {
+                if (kv.second.isEmpty()) return QString();
+                prefix = kv.second;
+            }
+        }
+    }
+    return prefix;
+}
+
+
+void XMLPrettyPrinter::flushData()
+{
+    if (!m_HaveData) return;
+    m_HaveData = false;
+    QString value;
+    value.swap(m_Data);
+    collapse_ascii_spaces(value);
+    addString(value, TextString);
+}
+
+
+// a closing tag is followed by a newline if anything at all comes after
+// it in its parent, so that is only written once the next child shows up
+void XMLPrettyPrinter::beginChild(Frame &frame)
+{
+    if (frame.pendingNewline) {
+        frame.out.append(QChar('\n'));
+        frame.pendingNewline = false;
+    }
+    frame.children++;
+}
+
+
+void XMLPrettyPrinter::addString(const QString &value, StringType type)
+{
+    Frame &frame = m_Frames.last();
+    beginChild(frame);
+    if (frame.children == 1) {
+        frame.onlyChildBlank = python_strip(value).isEmpty();
+    }
+    QString text;
+    switch (type) {
+        case TextString:
+            text.reserve(value.size());
+            append_minimal(value, text, false);
+            break;
+        case CommentString:
+            text = "<!--" + value + "-->";
+            break;
+        case PIString:
+            text = "<?" + value + ">";
+            break;
+        case DoctypeString:
+            text = "<!DOCTYPE " + value + ">\n";
+            break;
+    }
+    text = escape_entities(python_strip(text));
+    if (text.isEmpty()) return;
+    if (frame.xmlparent && !frame.written) {
+        frame.out.append(INDENT.repeated(frame.contentLevel - 1));
+    }
+    frame.out.append(text);
+    frame.written = true;
+}
+
+
+// a void tag whose only string is blank is written as an empty element,
+// as with bs4 that is decided on the tree before any of its children were
+void XMLPrettyPrinter::closeElement()
+{
+    Frame frame = m_Frames.takeLast();
+    bool blank = (frame.children == 1) && frame.onlyChildBlank;
+    bool cleared = frame.canBeEmpty && blank;
+    bool empty = frame.canBeEmpty && ((frame.children == 0) || cleared);
+    QString indent = INDENT.repeated(qMax(frame.level - 1, 0));
+    const QString contents = cleared ? QString() : frame.out;
+
+    Frame &parent = m_Frames.last();
+    QString &out = parent.out;
+    out.append(indent);
+    out.append(frame.start);
+    out.append(empty ? QString("/>") : QString(">"));
+    if (frame.xmlparent) out.append(QChar('\n'));
+    out.append(contents);
+    if ((!contents.isEmpty() && !contents.endsWith('\n') && frame.xmlparent) || empty) {
+        out.append(QChar('\n'));
+    }
+    if (!empty) {
+        if (frame.xmlparent) out.append(indent);
+        out.append("</" + frame.closeName + ">");
+        parent.pendingNewline = true;
+    }
+    parent.written = true;
+    if (parent.children == 1) {
+        parent.onlyChildBlank = blank;
+    }
+
+    if (m_PrefixMaps.size() > 1) {
+        m_PrefixMaps.removeLast();
+    }
+    if (!m_DeclarationMarks.isEmpty()) {
+        m_Declarations.resize(m_DeclarationMarks.takeLast());
+    }
+}
+
+
+// A literal port of opf_newparser's Opf_Parser, including how it splits
+// up tags and which attributes it pops off, run just to rebuild the opf.
+QString XMLPrettyPrinter::RebuildOPF(const QString &opf)
+{
+    QString version;
+    QString uid;
+    TagAtts package_attr;
+    bool have_package = false;
+    TagAtts metadata_attr;
+    bool have_metadata = false;
+    TagAtts spine_attr;
+    QString metadata;
+    QString manifest;
+    QString spine;
+    QString guide;
+    QString bindings;
+    bool ns_remap = false;
+    int cnt = 0;
+
+    QStringList prefix;
+    QString tcontent;
+    TagAtts last_tattr;
+    bool have_last_tattr = false;
+    qsizetype n = opf.size();
+    qsizetype p = 0;
+    while (p < n) {
+        if (opf.at(p) != '<') {
+            qsizetype res = opf.indexOf('<', p);
+            if (res == -1) res = n;
+            tcontent = rstrip(opf.mid(p, res - p), " \r\n");
+            p = res;
+            continue;
+        }
+        qsizetype te;
+        if (QStringView(opf).mid(p).startsWith(u"<!--")) {
+            te = opf.indexOf("-->", p + 1);
+            if (te == -1) return QString();
+            te += 2;
+        } else {
+            te = opf.indexOf('>', p + 1);
+            qsizetype ntb = opf.indexOf('<', p + 1);
+            if ((ntb != -1) && (ntb < te)) {
+                tcontent = rstrip(opf.mid(p, ntb - p), " \r\n");
+                p = ntb;
+                continue;
+            }
+            // python would loop forever here
+            if (te == -1) return QString();
+        }
+        QString tag = opf.mid(p, te + 1 - p);
+        p = te + 1;
+
+        QString ttype;
+        QString tname;
+        TagAtts tattr;
+        ParseOPFTag(tag, ttype, tname, tattr);
+        if (tname.startsWith("opf:")) {
+            ns_remap = true;
+            tname = tname.mid(4);
+        }
+        bool emit = false;
+        QString content;
+        if (ttype == "begin") {
+            tcontent = QString();
+            prefix.append(tname);
+            if (OPF_PARENT_TAGS.contains(tname)) {
+                emit = true;
+            } else {
+                last_tattr = tattr;
+                have_last_tattr = true;
+            }
+        } else {
+            if (ttype == "end") {
+                if (prefix.isEmpty()) return QString();
+                prefix.removeLast();
+                tattr = have_last_tattr ? last_tattr : TagAtts();
+                have_last_tattr = false;
+            } else if (ttype == "single") {
+                tcontent = QString();
+            }
+            emit = (ttype == "single") || ((ttype == "end") && !OPF_PARENT_TAGS.contains(tname));
+            content = tcontent;
+            tcontent = QString();
+        }
+        if (!emit) continue;
+
+        QString path = prefix.join(".");
+        if (tname == "package") {
+            version = tattr.value("version", "2.0");
+            tattr.remove("version");
+            uid = tattr.value("unique-identifier", "bookid");
+            tattr.remove("unique-identifier");
+            if (ns_remap && tattr.contains("xmlns:opf")) {
+                tattr.remove("xmlns:opf");
+                tattr["xmlns"] = OPF_NAMESPACE;
+            }
+            package_attr = tattr;
+            have_package = true;
+        } else if (DEPRECATED_METADATA_TAGS.contains(tname)) {
+            continue;
+        } else if (tname == "metadata") {
+            if (ns_remap && !tattr.contains("xmlns:opf")) {
+                tattr["xmlns:opf"] = OPF_NAMESPACE;
+            }
+            metadata_attr = tattr;
+            have_metadata = true;
+        } else if (path.contains("metadata")) {
+            metadata.append("    <" + tname);
+            append_atts(metadata, tattr);
+            if (content.isEmpty()) {
+                metadata.append("/>\n");
+            } else {
+                metadata.append(">" + xml_encode(content) + "</" + tname + ">\n");
+            }
+        } else if ((tname == "item") && path.contains("manifest")) {
+            QString nid = QString("xid%1").arg(cnt, 3, 10, QChar('0'));
+            cnt++;
+            QString id = tattr.value("id", nid);
+            tattr.remove("id");
+            QString href = tattr.value("href", "");
+            tattr.remove("href");
+            if (href.indexOf(':') == -1) {
+                href = url_encode_part(QUrl::fromPercentEncoding(href.toUtf8()));
+            }
+            QString mtype = tattr.value("media-type", "");
+            tattr.remove("media-type");
+            manifest.append("    <item id=\"" + id + "\" href=\"" + href + "\" media-type=\"" + mtype + "\"");
+            append_atts(manifest, tattr);
+            manifest.append("/>\n");
+        } else if (tname == "spine") {
+            spine_attr = tattr;
+        } else if ((tname == "itemref") && path.contains("spine")) {
+            QString idref = tattr.value("idref", "");
+            tattr.remove("idref");
+            spine.append("    <itemref idref=\"" + idref + "\"");
+            append_atts(spine, tattr);
+            spine.append("/>\n");
+        } else if ((tname == "reference") && path.contains("guide")) {
+            guide.append("    <reference type=\"" + tattr.value("type", "") + "\" title=\"" +
+                         tattr.value("title", "") + "\" href=\"" + tattr.value("href", "") + "\"/>\n");
+        } else if (((tname == "mediaType") || (tname == "mediatype")) && path.contains("bindings")) {
+            bindings.append("  <mediaType media-type=\"" + tattr.value("media-type", "") +
+                            "\" handler=\"" + tattr.value("handler", "") + "\"/>\n");
+        }
+    }
+
+    // python fails on an opf without these
+    if (!have_package || !have_metadata) {
+        return QString();
+    }
+    QString res = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    res.append("<package version=\"" + version + "\" unique-identifier=\"" + uid + "\"");
+    append_atts(res, package_attr);
+    res.append(">\n");
+    res.append("  <metadata");
+    append_atts(res, metadata_attr);
+    res.append(">\n");
+    res.append(metadata);
+    res.append("  </metadata>\n");
+    res.append("  <manifest>\n");
+    res.append(manifest);
+    res.append("  </manifest>\n");
+    res.append("  <spine");
+    append_atts(res, spine_attr);
+    res.append(">\n");
+    res.append(spine);
+    res.append("  </spine>\n");
+    if (!guide.isEmpty()) {
+        res.append("  <guide>\n");
+        res.append(guide);
+        res.append("  </guide>\n");
+    }
+    if (!bindings.isEmpty() && version.startsWith("3")) {
+        res.append("  <bindings>\n");
+        res.append(bindings);
+        res.append("  </bindings>\n");
+    }
+    res.append("</package>\n");
+    return res;
+}
+
+
+// opf_newparser's _parsetag, comments come back with the type "!--"
+// and the name "comment" just as they do there
+void XMLPrettyPrinter::ParseOPFTag(const QString &s, QString &ttype, QString &tname, TagAtts &tattr)
+{
+    qsizetype n = s.size();
+    qsizetype p = 1;
+    ttype = QString();
+    while ((p < n) && (s.at(p) == ' ')) p++;
+    if ((p < n) && (s.at(p) == '/')) {
+        ttype = "end";
+        p++;
+        while ((p < n) && (s.at(p) == ' ')) p++;
+    }
+    qsizetype b = p;
+    if (QStringView(s).mid(b).startsWith(u"!--")) {
+        ttype = "!--";
+        tname = "comment";
+        return;
+    }
+    while ((p < n) && !QString(">/ \"'\r\n").contains(s.at(p))) p++;
+    tname = s.mid(b, p - b).toLower();
+    if (tname == "!doctype") {
+        tname = "!DOCTYPE";
+    }
+    if (tname == "?xml") {
+        ttype = "xmlheader";
+        return;
+    }
+    if (tname == "!DOCTYPE") {
+        ttype = "doctype";
+        return;
+    }
+    if (!ttype.isEmpty()) return;
+
+    while (s.indexOf('=', p) != -1) {
+        while ((p < n) && OPF_WHITESPACE_CHARS.contains(s.at(p))) p++;
+        b = p;
+        while ((p < n) && (s.at(p) != '=')) p++;
+        QString aname = rstrip(s.mid(b, p - b).toLower(), OPF_WHITESPACE_CHARS);
+        p++;
+        while ((p < n) && OPF_WHITESPACE_CHARS.contains(s.at(p))) p++;
+        QString val;
+        if ((p < n) && ((s.at(p) == '"') || (s.at(p) == '\''))) {
+            QChar qt = s.at(p);
+            p++;
+            b = p;
+            while ((p < n) && (s.at(p) != '>') && (s.at(p) != '<') && (s.at(p) != qt)) p++;
+            val = s.mid(b, p - b);
+            p++;
+        } else {
+            b = p;
+            while ((p < n) && (s.at(p) != '>') && (s.at(p) != '/') && (s.at(p) != ' ')) p++;
+            val = s.mid(b, p - b);
+        }
+        tattr.insert(aname, val);
+    }
+    ttype = (s.indexOf('/', p) >= 0) ? "single" : "begin";
+}
@@ -0,0 +1,130 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks Stratford, ON, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef XMLPRETTYPRINTER_H
+#define XMLPRETTYPRINTER_H
+
+#include <QString>
+#include <QStringView>
+#include <QStringList>
+#include <QList>
+#include <utility>
+
+class TagAtts;
+
+// Native version of what xmlprocessor's repairXML does to xml that is
+// already well-formed. PrettyPrint walks the source once and writes what
+// BeautifulSoup's decodexml gives for the lxml parse of it, RebuildOPF
+// is python's Opf_Parser rebuild_opfxml run on that output. Both return
+// a null QString for anything they do not reproduce so the caller can
+// hand the source to the python code instead.
+
+class XMLPrettyPrinter
+{
+public:
+
+    // source must be well-formed and not start with an xml declaration,
+    // void_tags are the tags that may be written as empty elements
+    static QString PrettyPrint(QStringView source, const QStringList &void_tags);
+
+    static QString RebuildOPF(const QString &source);
+
+private:
+
+    XMLPrettyPrinter(QStringView source, const QStringList &void_tags);
+
+    // one open element, its serialized contents are collected in out
+    // until it is closed and written into its parent
+    struct Frame {
+        QString start;
+        QString closeName;
+        QString out;
+        int level;
+        int contentLevel;
+        bool xmlparent;
+        bool canBeEmpty;
+        int children;
+        bool onlyChildBlank;
+        bool written;
+        bool pendingNewline;
+    };
+
+    // a namespace declaration as libxml2 keeps them in scope
+    struct Declaration {
+        QString prefix;
+        QString uri;
+    };
+
+    enum StringType {
+        TextString,
+        CommentString,
+        PIString,
+        DoctypeString
+    };
+
+    typedef QList<std::pair<QString, QString> > PairList;
+
+    bool parseDocument();
+    bool parseStartTag();
+    bool parseEndTag();
+    bool parseComment();
+    bool parsePI();
+    bool parseCDSect();
+    bool parseDocType();
+    bool parseReference(QString &out);
+    bool parseAttValue(QString &value);
+    QStringView parseName();
+    QStringView parseLiteral();
+    void skipBlanks();
+    bool lookingAt(const char *s) const;
+    bool atEnd() const { return m_pos >= m_source.size(); }
+
+    bool resolve(QStringView qname, bool is_attribute, QString &uri, QString &local) const;
+    QString prefixForAttribute(const QString &uri) const;
+    QString prefixForTag(const QString &uri) const;
+
+    void flushData();
+    void addString(const QString &value, StringType type);
+    void beginChild(Frame &frame);
+    void closeElement();
+
+    static void ParseOPFTag(const QString &s, QString &ttype, QString &tname, TagAtts &tattr);
+
+    QStringView m_source;
+    qsizetype m_pos;
+    const QStringList &m_VoidTags;
+
+    QList<Frame> m_Frames;
+    QList<Declaration> m_Declarations;
+    QList<int> m_DeclarationMarks;
+
+    // the prefix maps of BeautifulSoup's lxml tree builder, uri to prefix
+    // with an empty prefix for none, an empty map is a placeholder
+    QList<PairList> m_PrefixMaps;
+
+    // character data is joined up until the next markup just as it is
+    // when bs4 builds its strings
+    QString m_Data;
+    bool m_HaveData;
+};
+
+#endif // XMLPRETTYPRINTER_H
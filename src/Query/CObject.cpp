@@ -61,14 +61,10 @@ void CObject::release()
         // throw "something wrong, reference count is negative";
     }
 
-    if (mReferences == 1)
+    if (mReferences.fetch_sub(1) == 1)
     {
         delete this;
     }
-    else
-    {
-        mReferences--;
-    }
 }
 
 unsigned int CObject::references()
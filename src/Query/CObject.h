@@ -37,6 +37,8 @@
 #ifndef COBJECT_H_
 #define COBJECT_H_
 
+#include <atomic>
+
 class CObject
 {
 
@@ -56,7 +58,8 @@ class CObject
 
  private:
 
-    int mReferences;
+    // compiled selectors are shared between threads by CSelectorCache
+    std::atomic<int> mReferences;
 };
 
 #endif /* COBJECT_H_ */
@@ -40,12 +40,6 @@
 #include <string>
 #include <iostream>
 
-class QueryParserException : public std::runtime_error
-{
-public:
-    QueryParserException(const std::string &msg) : std::runtime_error(msg) {};
-};
-
 #include "Query/CParser.h"
 #include "Query/CSelector.h"
 #include "Query/CQueryUtil.h"
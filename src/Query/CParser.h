@@ -38,10 +38,17 @@
 #define CPARSER_H_
 
 #include <string>
+#include <stdexcept>
 #include "gumbo.h"
 #include "gumbo_edit.h"
 #include "Query/CSelector.h"
 
+class QueryParserException : public std::runtime_error
+{
+public:
+    QueryParserException(const std::string &msg) : std::runtime_error(msg) {};
+};
+
 class CParser
 {
 
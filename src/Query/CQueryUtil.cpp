@@ -34,6 +34,8 @@
  **
  **********************************************************************************/
 
+#include <unordered_set>
+
 #include "Query/CQueryUtil.h"
 
 std::string CQueryUtil::tolower(std::string s)
@@ -52,25 +54,29 @@ std::string CQueryUtil::tolower(std::string s)
 }
 
 std::vector<GumboNode*> CQueryUtil::unionNodes(std::vector<GumboNode*> aNodes1,
-        std::vector<GumboNode*> aNodes2)
+        const std::vector<GumboNode*>& aNodes2)
+{
+    unionNodesInto(aNodes1, aNodes2);
+    return aNodes1;
+}
+
+void CQueryUtil::unionNodesInto(std::vector<GumboNode*>& aNodes1,
+        const std::vector<GumboNode*>& aNodes2)
 {
-    for (std::vector<GumboNode*>::iterator it = aNodes2.begin(); it != aNodes2.end(); it++)
+    std::unordered_set<GumboNode*> seen(aNodes1.begin(), aNodes1.end());
+    for (std::vector<GumboNode*>::const_iterator it = aNodes2.begin(); it != aNodes2.end(); it++)
     {
         GumboNode* pNode = *it;
-        if (nodeExists(aNodes1, pNode))
+        if (seen.insert(pNode).second)
         {
-            continue;
+            aNodes1.push_back(pNode);
         }
-
-        aNodes1.push_back(pNode);
     }
-
-    return aNodes1;
 }
 
-bool CQueryUtil::nodeExists(std::vector<GumboNode*> aNodes, GumboNode* apNode)
+bool CQueryUtil::nodeExists(const std::vector<GumboNode*>& aNodes, GumboNode* apNode)
 {
-    for (std::vector<GumboNode*>::iterator it = aNodes.begin(); it != aNodes.end(); it++)
+    for (std::vector<GumboNode*>::const_iterator it = aNodes.begin(); it != aNodes.end(); it++)
     {
         GumboNode* pNode = *it;
         if (pNode == apNode)
@@ -51,9 +51,13 @@ class CQueryUtil
     static std::string tolower(std::string s);
 
     static std::vector<GumboNode*> unionNodes(std::vector<GumboNode*> aNodes1,
-                                              std::vector<GumboNode*> aNode2);
+                                              const std::vector<GumboNode*>& aNode2);
 
-    static bool nodeExists(std::vector<GumboNode*> aNodes, GumboNode* apNode);
+    // appends the nodes of aNodes2 not already in aNodes1
+    static void unionNodesInto(std::vector<GumboNode*>& aNodes1,
+                               const std::vector<GumboNode*>& aNodes2);
+
+    static bool nodeExists(const std::vector<GumboNode*>& aNodes, GumboNode* apNode);
 
     static std::string nodeText(GumboNode* apNode);
     
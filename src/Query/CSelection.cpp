@@ -40,6 +40,7 @@
 
 #include "Query/CParser.h"
 #include "Query/CQueryUtil.h"
+#include "Query/CSelectorCache.h"
 #include "Query/CNode.h"
 #include "Query/CSelection.h"
 
@@ -64,13 +65,20 @@ CSelection CSelection::find(std::string aSelector)
     // parsing the any selector can throw exceptions
     // try to fail gracefully 
     try {
-        CSelector* sel = CParser::create(aSelector);
+        CSelector* sel = CSelectorCache::get(aSelector);
         std::vector<GumboNode*> ret;
-        for (std::vector<GumboNode*>::iterator it = mNodes.begin(); it != mNodes.end(); it++)
+        if (mNodes.size() == 1)
         {
-            GumboNode* pNode = *it;
-            std::vector<GumboNode*> matched = sel->matchAll(pNode);
-            ret = CQueryUtil::unionNodes(ret, matched);
+            // the usual search from the root needs no merging
+            ret = sel->matchAll(mNodes[0]);
+        }
+        else
+        {
+            for (std::vector<GumboNode*>::iterator it = mNodes.begin(); it != mNodes.end(); it++)
+            {
+                GumboNode* pNode = *it;
+                CQueryUtil::unionNodesInto(ret, sel->matchAll(pNode));
+            }
         }
         sel->release();
         return CSelection(ret);
@@ -202,10 +202,10 @@ bool CSelector::match(GumboNode* apNode)
     }
 }
 
-std::vector<GumboNode*> CSelector::filter(std::vector<GumboNode*> nodes)
+std::vector<GumboNode*> CSelector::filter(const std::vector<GumboNode*>& nodes)
 {
     std::vector<GumboNode*> ret;
-    for (std::vector<GumboNode*>::iterator it = nodes.begin(); it != nodes.end(); it++)
+    for (std::vector<GumboNode*>::const_iterator it = nodes.begin(); it != nodes.end(); it++)
     {
         GumboNode* n = *it;
         if (match(n))
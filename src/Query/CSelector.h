@@ -114,7 +114,7 @@ class CSelector: public CObject
 
     virtual bool match(GumboNode* apNode);
 
-    std::vector<GumboNode*> filter(std::vector<GumboNode*> nodes);
+    std::vector<GumboNode*> filter(const std::vector<GumboNode*>& nodes);
 
     std::vector<GumboNode*> matchAll(GumboNode* apNode);
 
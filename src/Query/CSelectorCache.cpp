@@ -0,0 +1,114 @@
+/**********************************************************************************
+ **
+ **  SigilQuery for Gumbo
+ **
+ **  A C++ library that provides jQuery-like selectors for Google's Gumbo-Parser.
+ **  Selector engine is an implementation based on cascadia.
+ **
+ **  Based on: "gumbo-query" https://github.com/lazytiger/gumbo-query
+ **  With bug fixes, extensions and improvements
+ **
+ **  The MIT License (MIT)
+ **  Copyright (c) 2021 Kevin B. Hendricks, Stratford, Ontario Canada
+ **  Copyright (c) 2015 baimashi.com. 
+ **  Copyright (c) 2011 Andy Balholm. All rights reserved.
+ **
+ **
+ **  Permission is hereby granted, free of charge, to any person obtaining a copy
+ **  of this software and associated documentation files (the "Software"), to deal
+ **  in the Software without restriction, including without limitation the rights
+ **  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ **  copies of the Software, and to permit persons to whom the Software is
+ **  furnished to do so, subject to the following conditions:
+ **
+ **  The above copyright notice and this permission notice shall be included in
+ **  all copies or substantial portions of the Software.
+ **
+ **  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ **  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ **  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ **  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ **  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ **  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ **  THE SOFTWARE.
+ **
+ **********************************************************************************/
+
+#include "Query/CParser.h"
+#include "Query/CSelectorCache.h"
+
+// plenty for the selectors of a book's stylesheets and the searches run on it
+static const size_t MAX_ENTRIES = 2048;
+
+std::unordered_map<std::string, CSelectorCache::CEntry> CSelectorCache::mEntries;
+std::mutex CSelectorCache::mMutex;
+
+CSelector* CSelectorCache::get(const std::string& aInput)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::unordered_map<std::string, CEntry>::iterator it = mEntries.find(aInput);
+        if (it != mEntries.end())
+        {
+            if (it->second.mpSelector == NULL)
+            {
+                throw QueryParserException(it->second.mError);
+            }
+            it->second.mpSelector->retain();
+            return it->second.mpSelector;
+        }
+    }
+
+    // parse outside of the lock, the odd selector compiled twice
+    // by two threads at once does no harm
+    CEntry entry;
+    entry.mpSelector = NULL;
+    try
+    {
+        entry.mpSelector = CParser::create(aInput);
+    }
+    catch (const QueryParserException& e)
+    {
+        entry.mError = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unordered_map<std::string, CEntry>::iterator it = mEntries.find(aInput);
+    if (it == mEntries.end())
+    {
+        if (mEntries.size() >= MAX_ENTRIES)
+        {
+            clearLocked();
+        }
+        if (entry.mpSelector)
+        {
+            // one reference for the cache
+            entry.mpSelector->retain();
+        }
+        mEntries[aInput] = entry;
+    }
+    if (entry.mpSelector == NULL)
+    {
+        throw QueryParserException(entry.mError);
+    }
+    return entry.mpSelector;
+}
+
+void CSelectorCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    clearLocked();
+}
+
+void CSelectorCache::clearLocked()
+{
+    // selectors still in use are freed by their last release()
+    for (std::unordered_map<std::string, CEntry>::iterator it = mEntries.begin(); it != mEntries.end(); it++)
+    {
+        if (it->second.mpSelector)
+        {
+            it->second.mpSelector->release();
+        }
+    }
+    mEntries.clear();
+}
@@ -0,0 +1,75 @@
+/**********************************************************************************
+ **
+ **  SigilQuery for Gumbo
+ **
+ **  A C++ library that provides jQuery-like selectors for Google's Gumbo-Parser.
+ **  Selector engine is an implementation based on cascadia.
+ **
+ **  Based on: "gumbo-query" https://github.com/lazytiger/gumbo-query
+ **  With bug fixes, extensions and improvements
+ **
+ **  The MIT License (MIT)
+ **  Copyright (c) 2021 Kevin B. Hendricks, Stratford, Ontario Canada
+ **  Copyright (c) 2015 baimashi.com. 
+ **  Copyright (c) 2011 Andy Balholm. All rights reserved.
+ **
+ **
+ **  Permission is hereby granted, free of charge, to any person obtaining a copy
+ **  of this software and associated documentation files (the "Software"), to deal
+ **  in the Software without restriction, including without limitation the rights
+ **  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ **  copies of the Software, and to permit persons to whom the Software is
+ **  furnished to do so, subject to the following conditions:
+ **
+ **  The above copyright notice and this permission notice shall be included in
+ **  all copies or substantial portions of the Software.
+ **
+ **  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ **  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ **  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ **  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ **  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ **  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ **  THE SOFTWARE.
+ **
+ **********************************************************************************/
+
+#ifndef CSELECTORCACHE_H_
+#define CSELECTORCACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include "Query/CSelector.h"
+
+// Thread safe cache of compiled selectors keyed by selector text so
+// selectors used again and again are only parsed once.
+// Compiled selectors are never changed by matching so threads can share them.
+class CSelectorCache
+{
+
+ public:
+
+    // Returns the compiled selector with a reference the caller must release().
+    // Throws QueryParserException just like CParser::create does, parse
+    // errors are remembered as well.
+    static CSelector* get(const std::string& aInput);
+
+    static void clear();
+
+ private:
+
+    struct CEntry
+    {
+        CSelector* mpSelector;
+        std::string mError;
+    };
+
+    static void clearLocked();
+
+    static std::unordered_map<std::string, CEntry> mEntries;
+
+    static std::mutex mMutex;
+};
+
+#endif /* CSELECTORCACHE_H_ */
@@ -142,7 +142,7 @@ QStringList HTMLResource::GetManifestProperties() const
 {
     QStringList properties;
     QReadLocker locker(&GetLock());
-    GumboInterface gi = GumboInterface(GetText(), GetEpubVersion());
+    GumboInterface gi = GumboInterface(GetText(), GetUtf8Text(), GetEpubVersion());
     gi.parse();
     QStringList props = gi.get_all_properties();
     props.removeDuplicates();
@@ -172,7 +172,7 @@ QStringList HTMLResource::GetPathsToLinkedResources()
     // Can NOT grab Read Lock here as this is also invoked in SetText which has write lock!
     // leading to instant lockup when renaming any resource
     // QReadLocker locker(&GetLock());
-    GumboInterface gi = GumboInterface(GetText(),GetEpubVersion());
+    GumboInterface gi = GumboInterface(GetText(), GetUtf8Text(), GetEpubVersion());
     gi.parse();
     QList<GumboTag> tags;
     tags << GUMBO_TAG_IMG << GUMBO_TAG_LINK << GUMBO_TAG_AUDIO << GUMBO_TAG_VIDEO;
@@ -212,7 +212,7 @@ QStringList HTMLResource::GetPathsToLinkedResources()
 
 QString HTMLResource::GetLanguageAttribute()
 {
-    GumboInterface gi = GumboInterface(GetText(),GetEpubVersion());
+    GumboInterface gi = GumboInterface(GetText(), GetUtf8Text(), GetEpubVersion());
     gi.parse();
     QList<GumboNode*> htmltags = gi.get_all_nodes_with_tag(GUMBO_TAG_HTML);
     if (htmltags.count() != 1) return "";
@@ -36,10 +36,13 @@ TextResource::TextResource(const QString &mainfolder, const QString &fullfilepat
     Resource(mainfolder, fullfilepath, parent),
     m_CacheInUse(false),
     m_TextDocument(new TextDocument(this)),
-    m_IsLoaded(false)
+    m_IsLoaded(false),
+    m_TextRevision(0),
+    m_Utf8TextRevision(Q_UINT64_C(0xFFFFFFFFFFFFFFFF))
 {
     m_TextDocument->setDocumentLayout(new QPlainTextDocumentLayout(m_TextDocument));
     connect(m_TextDocument, SIGNAL(contentsChanged()), this, SIGNAL(Modified()));
+    connect(m_TextDocument, SIGNAL(contentsChanged()), this, SLOT(TextDocumentContentsChanged()));
 }
 
 
@@ -67,11 +70,14 @@ void TextResource::SetText(const QString &text)
     //   So we cache the text update into m_Cache and update the QTextDocument
     // when we return to the GUI thread. The single-shot timer makes sure
     // of that.
+    //   The text revision is always bumped after the new text is in place.
     if (QThread::currentThread() == QApplication::instance()->thread()) {
         SetTextInternal(text);
+        m_TextRevision.ref();
     } else {
         QMutexLocker locker(&m_CacheAccessMutex);
         m_Cache = text;
+        m_TextRevision.ref();
 
         // We want to make sure we schedule only one delayed update
         if (!m_CacheInUse) {
@@ -82,6 +88,43 @@ void TextResource::SetText(const QString &text)
 }
 
 
+quint64 TextResource::GetTextRevision() const
+{
+    return m_TextRevision.loadAcquire();
+}
+
+
+bool TextResource::HasPendingTextUpdate() const
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    return m_CacheInUse;
+}
+
+
+QByteArray TextResource::GetUtf8Text() const
+{
+    quint64 revision = GetTextRevision();
+    {
+        QMutexLocker locker(&m_Utf8TextMutex);
+        if (m_Utf8TextRevision == revision) {
+            return m_Utf8Text;
+        }
+    }
+    // Qt's UTF-8 codec already converts runs of ASCII a vector at a time
+    QByteArray utf8 = GetText().toUtf8();
+    QMutexLocker locker(&m_Utf8TextMutex);
+    m_Utf8Text = utf8;
+    m_Utf8TextRevision = revision;
+    return utf8;
+}
+
+
+void TextResource::TextDocumentContentsChanged()
+{
+    m_TextRevision.ref();
+}
+
+
 TextDocument& TextResource::GetTextDocumentForWriting()
 {
     Q_ASSERT(m_TextDocument);
@@ -163,6 +206,7 @@ bool TextResource::LoadFromDisk()
         const QString &text = Utility::ReadUnicodeTextFile(GetFullPath());
         QMutexLocker locker(&m_CacheAccessMutex);
         m_Cache = text;
+        m_TextRevision.ref();
 
         // We want to make sure we schedule only one delayed update
         if (!m_CacheInUse) {
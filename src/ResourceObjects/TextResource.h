@@ -24,6 +24,8 @@
 #ifndef TEXTRESOURCE_H
 #define TEXTRESOURCE_H
 
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QByteArray>
 #include <QtCore/QMutex>
 #include "Widgets/TextDocument.h"
 #include "ResourceObjects/Resource.h"
@@ -62,6 +64,31 @@ public:
      */
     virtual void SetText(const QString &text);
 
+    /**
+     * Returns a counter that changes every time the text changes.
+     * Caches of data derived from the text use it to know when they
+     * are stale. Read it before reading the text so a concurrent change
+     * can only make the cached data look older than it is.
+     *
+     * @return The current text revision.
+     */
+    quint64 GetTextRevision() const;
+
+    /**
+     * Returns true while text set from a worker thread has not reached
+     * the QTextDocument yet.
+     */
+    bool HasPendingTextUpdate() const;
+
+    /**
+     * Returns the text encoded as UTF-8. The encoding is kept until the
+     * text changes so the parsers working on the same text do not each
+     * transcode it again.
+     *
+     * @return The resource text as UTF-8.
+     */
+    QByteArray GetUtf8Text() const;
+
     /**
      * Returns a reference to the QTextDocument that can be read and written to
      * in consumers. If you need just read access, use GetTextDocumentForReading().
@@ -98,6 +125,11 @@ private slots:
      */
     void DelayedUpdateToTextDocument();
 
+    /**
+     * Bumps the text revision when the QTextDocument is edited directly.
+     */
+    void TextDocumentContentsChanged();
+
 private:
 
     /**
@@ -133,6 +165,18 @@ private:
     TextDocument *m_TextDocument;
 
     bool m_IsLoaded;
+
+    /**
+     * Incremented on every change to the text.
+     */
+    QAtomicInteger<quint64> m_TextRevision;
+
+    /**
+     * UTF-8 copy of the text and the text revision it was made from.
+     */
+    mutable QByteArray m_Utf8Text;
+    mutable quint64 m_Utf8TextRevision;
+    mutable QMutex m_Utf8TextMutex;
 };
 
 #endif // TEXTRESOURCE_H
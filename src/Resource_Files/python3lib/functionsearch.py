@@ -200,6 +200,22 @@ class FunctionSearch(object):
             print(e)
         return result
 
+    # offsets holds for each match its start and end in text, the number of
+    # capture groups and then each group's start and end relative to the match
+    def get_replacements_by_function(self, bookpath, text, offsets):
+        results = []
+        i = 0
+        n = len(offsets)
+        while i < n:
+            mbeg, mend, ngroups = offsets[i], offsets[i+1], offsets[i+2]
+            i += 3
+            groups = []
+            for j in range(ngroups):
+                groups.append((offsets[i], offsets[i+1]))
+                i += 2
+            results.append(self.get_single_replacement_by_function(bookpath, text[mbeg:mend], groups))
+        return results
+
 
 def getFunctionSearchEnv(metadataxml, function_name, jsonpath=None):
     repfuncs = {}
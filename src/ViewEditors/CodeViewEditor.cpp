@@ -61,10 +61,13 @@
 #include "Misc/SettingsStore.h"
 #include "Misc/SpellCheck.h"
 #include "Misc/HTMLSpellCheck.h"
+#include "Misc/SearchUtils.h"
 #include "Misc/AriaRoles.h"
 #include "Misc/Utility.h"
 #include "Parsers/HTMLStyleInfo.h"
 #include "PCRE2/PCRECache.h"
+#include "PCRE2/PCREReplaceAllBuilder.h"
+#include "ResourceObjects/TextResource.h"
 #include "ViewEditors/CodeViewEditor.h"
 #include "ViewEditors/LineNumberArea.h"
 #include "sigil_constants.h"
@@ -88,6 +91,9 @@ static const QString STARTING_INDENT_USED = "(^\\s*)[^\\s]";
 
 static const uint MAX_SPELLING_SUGGESTIONS = 10;
 
+// past this many edits between uses of the tag list just rebuild it
+static const int MAX_PENDING_TAGLIST_EDITS = 100;
+
 
 CodeViewEditor::CodeViewEditor(HighlighterType high_type, bool check_spelling, QWidget *parent)
     :
@@ -201,6 +207,9 @@ QSize CodeViewEditor::sizeHint() const
 void CodeViewEditor::CustomSetDocument(TextDocument &ndocument)
 {
     SettingsStore settings;
+    if (document()) {
+        disconnect(document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(RecordContentsChange(int, int, int)));
+    }
     setDocument(&ndocument);
     ndocument.setModified(false);
     if (m_Highlighter) {
@@ -217,6 +226,8 @@ void CodeViewEditor::CustomSetDocument(TextDocument &ndocument)
     ResetFont();
     m_isLoadFinished = true;
     m_regen_taglist = true;
+    m_TagListEdits.clear();
+    connect(&ndocument, SIGNAL(contentsChange(int, int, int)), this, SLOT(RecordContentsChange(int, int, int)));
     if (settings.uiDoubleWidthTextCursor()) setCursorWidth(2);
     emit DocumentSet();
 }
@@ -969,7 +980,7 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
                               bool marked_text,
                               int split_at)
 {
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     SPCRE::MatchInfo match_info;
     QString txt = toPlainText();
     int start_offset = 0;
@@ -1006,19 +1017,20 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
 
     int selection_offset = GetSelectionOffset(search_direction, ignore_selection_offset, marked_text);
 
-    if (search_direction == Searchable::Direction_Up) {
-        if (misspelled_words) {
+    if (misspelled_words) {
+        if (search_direction == Searchable::Direction_Up) {
             match_info = GetMisspelledWord(txt, 0, selection_offset, search_regex, search_direction);
         } else {
-            match_info = spcre->getLastMatchInfo(Utility::Substring(start, selection_offset, txt));
-        }
-    } else {
-        if (misspelled_words) {
             match_info = GetMisspelledWord(txt, selection_offset, txt.length(), search_regex, search_direction);
-        } else {
-            match_info = spcre->getFirstMatchInfo(Utility::Substring(selection_offset, end, txt));
+            start_offset = selection_offset;
         }
-        start_offset = selection_offset;
+    } else {
+        // Always search the text from the cursor, the stored match list
+        // can not tell what a search starting inside one of its matches
+        // or seeing only part of the text finds.
+        match_info = SearchUtils::FindFromPosition(*spcre, txt, selection_offset, start, end,
+                                                   search_direction == Searchable::Direction_Up);
+        start_offset = 0;
     }
 
     if (marked_text) {
@@ -1065,13 +1077,31 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
 }
 
 
+bool CodeViewEditor::GetIndexedMatches(const QString &search_regex, SearchMatchIndex::Matches &matches)
+{
+    TextResource *text_resource = qobject_cast<TextResource *>(document()->parent());
+    // While a text update from another thread is pending the document
+    // does not hold the text the revision belongs to yet
+    if (!m_isLoadFinished || !text_resource || text_resource->HasPendingTextUpdate()) {
+        return false;
+    }
+    return SearchMatchIndex::instance().Lookup(search_regex, text_resource->GetIdentifier(),
+                                               text_resource->GetTextRevision(), matches);
+}
+
+
 int CodeViewEditor::Count(const QString &search_regex, Searchable::Direction direction, bool wrap, bool marked_text)
 {
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     QString txt= toPlainText();
     int start = 0;
     int end = txt.length();
 
+    SearchMatchIndex::Matches matches;
+    if (wrap && !marked_text && GetIndexedMatches(search_regex, matches)) {
+        return matches.count();
+    }
+
     if (marked_text) {
         if (!MoveToMarkedText(direction, wrap)) {
             return 0;
@@ -1094,7 +1124,7 @@ int CodeViewEditor::Count(const QString &search_regex, Searchable::Direction dir
 
 bool CodeViewEditor::ReplaceSelected(const QString &search_regex, const QString &replacement, Searchable::Direction direction, bool replace_current)
 {
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     int selection_start = textCursor().selectionStart();
     int selection_end = textCursor().selectionEnd();
 
@@ -1186,34 +1216,25 @@ int CodeViewEditor::ReplaceAll(const QString &search_regex,
     }
     int marked_text_length = text.length();
 
-    SPCRE *spcre = PCRECache::instance().getObject(search_regex);
+    std::shared_ptr<SPCRE> spcre = PCRECache::instance().getObject(search_regex);
     QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
 
-    // Run though all match offsets making the replacement in reverse order.
-    // This way changes in text length won't change the offsets as we make
-    // our changes.
-    for (int i = match_info.count() - 1; i >= 0; i--) {
-        QString replaced_text;
-        if (!wrap) {
-            if (direction == Searchable::Direction_Up) {
-                if (match_info.at(i).offset.first > position) {
-                    break;
-                }
-            } else { 
-                if (match_info.at(i).offset.second < position) {
-                    break;
-                }
-            }
-        }
-
-        bool replacement_made = spcre->replaceText(Utility::Substring(match_info.at(i).offset.first, match_info.at(i).offset.second, text), match_info.at(i).capture_groups_offsets, replacement, replaced_text);
+    // Without wrap only the matches on the search direction side of the
+    // cursor are replaced. Searching up that is every match starting at
+    // or before the cursor, even when there are matches after it.
+    if (!wrap) {
+        match_info = PCREReplaceAllBuilder::MatchesFromPosition(match_info, position,
+                                                                direction == Searchable::Direction_Up);
+    }
 
-        if (replacement_made) {
-            // Replace the text.
-            text = text.replace(match_info.at(i).offset.first, match_info.at(i).offset.second - match_info.at(i).offset.first, replaced_text);
-            count++;
-        }
+    // Build the new text in one forward pass.
+    PCREReplaceAllBuilder builder(*spcre, text, replacement, match_info.count());
+    foreach(const SPCRE::MatchInfo &mi, match_info) {
+        builder.AppendReplacement(mi);
     }
+    count = builder.GetReplacementCount();
+    text = builder.Finish();
+
     if (marked_text) {
         // Merge the replaced marked text into the original text and adjust the marker.
         QString replaced_text = toPlainText();
@@ -2365,8 +2386,6 @@ void CodeViewEditor::EmitFilteredCursorMoved()
 
 void CodeViewEditor::TextChangedFilter()
 {
-    m_regen_taglist = true;
-
     // Clear marked text to prevent marked area not matching entered text
     // if user types text, uses Undo, etc.
     if (!m_ReplacingInMarkedText && IsMarkedText()) {
@@ -2380,6 +2399,47 @@ void CodeViewEditor::TextChangedFilter()
     }
 }
 
+void CodeViewEditor::RecordContentsChange(int position, int chars_removed, int chars_added)
+{
+    // nothing to record if the tag list gets rebuilt anyway
+    if (m_regen_taglist) {
+        return;
+    }
+    if (m_TagListEdits.size() >= MAX_PENDING_TAGLIST_EDITS) {
+        m_TagListEdits.clear();
+        m_regen_taglist = true;
+        return;
+    }
+
+    // keep the inserted text as it is now, later edits may change it again
+    int end = qMin(position + chars_added, textLength());
+    QTextCursor cursor(document());
+    cursor.setPosition(qMin(position, end));
+    cursor.setPosition(end, QTextCursor::KeepAnchor);
+    QString inserted = cursor.selectedText();
+    // the same conversions as TextDocument::toText()
+    QChar *uc = inserted.data();
+    QChar *e = uc + inserted.size();
+    for (; uc != e; ++uc) {
+        switch (uc->unicode()) {
+            case 0xfdd0: // QTextBeginningOfFrame
+            case 0xfdd1: // QTextEndOfFrame
+            case QChar::ParagraphSeparator:
+            case QChar::LineSeparator:
+                *uc = QLatin1Char('\n');
+                break;
+            default:
+            ;
+        }
+    }
+
+    TagListEdit edit;
+    edit.position = position;
+    edit.chars_removed = chars_removed;
+    edit.inserted = inserted;
+    m_TagListEdits.append(edit);
+}
+
 void CodeViewEditor::RehighlightDocument()
 {
     // need to be able to rehighlight the document
@@ -2444,9 +2504,25 @@ void CodeViewEditor::MaybeRegenerateTagList()
     // a segfault deep inside QTextDocument
     // if (!m_isLoadFinished) return;
     
+    // replay the edits since the last use so only the damaged tags are re-lexed
+    if (!m_regen_taglist && !m_TagListEdits.isEmpty()) {
+        foreach(const TagListEdit &edit, m_TagListEdits) {
+            if (!m_TagList.updateLister(edit.position, edit.chars_removed, edit.inserted)) {
+                m_regen_taglist = true;
+                break;
+            }
+        }
+        m_TagListEdits.clear();
+        // if the document reported its changes in some odd way start over
+        if (!m_regen_taglist && (m_TagList.getSource().length() != textLength())) {
+            m_regen_taglist = true;
+        }
+    }
+
     if (m_regen_taglist) {
         // qDebug() << "regenerating tag list";
         m_TagList.reloadLister(toPlainText());
+        m_TagListEdits.clear();
         m_regen_taglist = false;
     }
 }
@@ -2858,7 +2934,7 @@ QString CodeViewEditor::ConvertHierarchyToQWebPath(const QList<ElementIndex>& hi
     return pathparts.join(",");
 }
 
-std::tuple<int, int> CodeViewEditor::ConvertHierarchyToCaretMove(const QList<ElementIndex> &hierarchy) const
+int CodeViewEditor::ConvertHierarchyToCaretPosition(const QList<ElementIndex> &hierarchy) const
 {
     QString source = toPlainText();
     QString version = "any_version";
@@ -2867,20 +2943,18 @@ std::tuple<int, int> CodeViewEditor::ConvertHierarchyToCaretMove(const QList<Ele
     QString webpath = ConvertHierarchyToQWebPath(hierarchy);
     GumboNode* end_node = gi.get_node_from_qwebpath(webpath);
     if (!end_node) {
-      return std::make_tuple(0, 0);
+      return 0;
     }
-    unsigned int line = 0;
-    unsigned int col = 0;
+    size_t offset = 0;
     if ((end_node->type == GUMBO_NODE_TEXT) || (end_node->type == GUMBO_NODE_WHITESPACE) || 
         (end_node->type == GUMBO_NODE_CDATA) || (end_node->type == GUMBO_NODE_COMMENT)) {
-        line = end_node->v.text.start_pos.line + 1; // compensate for xml header removed for gumbo
-        col = end_node->v.text.start_pos.column;
+        offset = end_node->v.text.start_pos.offset;
     } else if ((end_node->type == GUMBO_NODE_ELEMENT) || (end_node->type == GUMBO_NODE_TEMPLATE)) {
-        line = end_node->v.element.start_pos.line + 1; // comprensate for xml header removed for gumbo
-        col = end_node->v.element.start_pos.column;
+        offset = end_node->v.element.start_pos.offset;
     }
-    QTextCursor cursor(document());
-    return std::make_tuple(line - cursor.blockNumber(), col);
+    // gumbo columns start at 1 so the caret used to land just past the
+    // first character of the node, keep it there
+    return gi.get_utf16_position(offset) + 1;
 }
 
 bool CodeViewEditor::ExecuteCaretUpdate(bool default_to_top)
@@ -2897,13 +2971,10 @@ bool CodeViewEditor::ExecuteCaretUpdate(bool default_to_top)
         return false;
     }
     QTextCursor cursor(document());
-    int vertical_lines_move = 0;
-    int horizontal_chars_move = 0;
     // We *have* to do the conversion on-demand since the
     // conversion uses toPlainText(), and the text needs to up-to-date.
-    std::tie(vertical_lines_move, horizontal_chars_move) = ConvertHierarchyToCaretMove(m_CaretUpdate);
-    cursor.movePosition(QTextCursor::NextBlock, QTextCursor::MoveAnchor, vertical_lines_move - 1);
-    cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::MoveAnchor, horizontal_chars_move);
+    int position = ConvertHierarchyToCaretPosition(m_CaretUpdate);
+    cursor.setPosition(qMin(position, document()->characterCount() - 1));
     m_CaretUpdate.clear();
     setTextCursor(cursor);
     m_DelayedCursorScreenCenteringRequired = true;
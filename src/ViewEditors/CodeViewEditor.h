@@ -32,6 +32,7 @@
 #include "Parsers/CSSInfo.h"
 #include "Parsers/HTMLStyleInfo.h"
 #include "Misc/PasteTarget.h"
+#include "Misc/SearchMatchIndex.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 #include "Widgets/TextDocument.h"
@@ -543,6 +544,12 @@ private slots:
      */
     void TextChangedFilter();
 
+    /**
+     * Records an edit of the document so the tag list can
+     * be updated incrementally the next time it is needed.
+     */
+    void RecordContentsChange(int position, int chars_removed, int chars_added);
+
     void PasteClipEntryFromName(const QString &name);
 
     /**
@@ -642,6 +649,14 @@ private:
      */
     int GetSelectionOffset(Searchable::Direction search_direction, bool ignore_selection_offset, bool marked_text) const;
 
+    /**
+     * Gets the matches of search_regex in the whole document from the
+     * SearchMatchIndex, so Count does not need to search the text again.
+     *
+     * @return false if the document is not indexed at its current revision.
+     */
+    bool GetIndexedMatches(const QString &search_regex, SearchMatchIndex::Matches &matches);
+
     /**
      * Scrolls the whole screen by one line.
      * Used for ScrollOneLineUp and ScrollOneLineDown shortcuts.
@@ -685,13 +700,12 @@ private:
     QString ConvertHierarchyToQWebPath(const QList<ElementIndex>& hierarchy) const;
 
     /**
-     * Converts a ViewEditor element hierarchy to a tuple describing necessary caret moves.
-     * The tuple contains the vertical lines and horizontal chars move deltas
+     * Converts a ViewEditor element hierarchy to a caret position.
      *
      * @param hierarchy The caret location as ElementIndex hierarchy.
-     * @return The info needed to move the caret to the new location.
+     * @return The position in the text to move the caret to.
      */
-    std::tuple<int, int> ConvertHierarchyToCaretMove(const QList<ElementIndex> &hierarchy) const;
+    int ConvertHierarchyToCaretPosition(const QList<ElementIndex> &hierarchy) const;
 
     /**
      * Insert HTML tags around the current selection.
@@ -869,9 +883,20 @@ private:
     bool m_pendingSpellingHighlighting;
     QString m_element_name;
 
+    struct TagListEdit {
+        int position;
+        int chars_removed;
+        QString inserted;
+    };
+
     TagLister m_TagList;
     bool m_regen_taglist;
 
+    /**
+     * Edits made since the tag list was last brought up to date.
+     */
+    QList<TagListEdit> m_TagListEdits;
+
     QString m_mediatype;
     QString m_bookpath;
 };
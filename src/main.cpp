@@ -47,6 +47,7 @@
 #include <QSharedMemory>
 
 #include "Misc/PluginDB.h"
+#include "Parsers/GumboArena.h"
 #include "Misc/UILanguage.h"
 #include "MainUI/MainApplication.h"
 #include "MainUI/MainWindow.h"
@@ -363,6 +364,8 @@ void set_env_vars_if_needed(const QString& env_path)
 // Application entry point
 int main(int argc, char *argv[])
 {
+    // before any thread can parse with gumbo
+    GumboArena::Install();
 
 #ifndef QT_DEBUG
     qInstallMessageHandler(MessageHandler);
@@ -0,0 +1,65 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// The few routines the search code uses from Utility and PythonRoutines,
+// so the search tests and benchmarks do not need the rest of Sigil.
+// Function replacements are not run, they need the embedded interpreter.
+
+#include <QString>
+#include <QStringList>
+
+#include "EmbedPython/PyObjectPtr.h"
+#include "EmbedPython/PythonRoutines.h"
+#include "Misc/Utility.h"
+
+QString Utility::Substring(int start_index, int end_index, const QStringView string)
+{
+    return string.sliced(start_index, end_index - start_index).toString();
+}
+
+QString Utility::Substring(int start_index, int end_index, const QString &string)
+{
+    return string.mid(start_index, end_index - start_index);
+}
+
+QStringView Utility::SubstringView(int start_index, int end_index, const QString &string)
+{
+    return QStringView(string).sliced(start_index, end_index - start_index);
+}
+
+PyObjectPtr PythonRoutines::SetupInitialFunctionSearchEnvInPython(const QString &function_name)
+{
+    return PyObjectPtr();
+}
+
+QString PythonRoutines::GetSingleReplacementByFunction(PyObjectPtr FSO, const QString &bookpath,
+                                                       const QString &text,
+                                                       const QList<std::pair<int,int>> capture_groups)
+{
+    return QString();
+}
+
+QStringList PythonRoutines::GetReplacementsByFunction(PyObjectPtr FSO, const QString &bookpath,
+                                                      const QString &text,
+                                                      const QList<int> &match_offsets)
+{
+    return QStringList();
+}
@@ -0,0 +1,297 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// Checks the matches SPCRE finds against what PCRE2 itself finds for
+// the same pattern, in particular for the Text Only prefix that SPCRE
+// does not hand to PCRE2, what Find Next and Find Previous land on from
+// a position and what Replace All replaces.
+//
+// search_tests
+
+#include <stdio.h>
+
+#include <utility>
+
+#include <QList>
+#include <QString>
+
+#include "Misc/SearchUtils.h"
+#include "PCRE2/PCREReplaceAllBuilder.h"
+#include "PCRE2/SPCRE.h"
+
+namespace
+{
+    const QString TEXT_ONLY = "<[^<>]*>(*SKIP)(*F)|";
+
+    int failures = 0;
+
+    QString Describe(const QList<std::pair<int, int>> &offsets)
+    {
+        QString description;
+        foreach(const auto &offset, offsets) {
+            description.append(QString("(%1,%2)").arg(offset.first).arg(offset.second));
+        }
+        return description.isEmpty() ? QString("none") : description;
+    }
+
+    void Check(const char *test, const QString &pattern, const QList<std::pair<int, int>> &expected,
+               const QList<std::pair<int, int>> &got)
+    {
+        if (got == expected) {
+            return;
+        }
+        failures++;
+        fprintf(stderr, "%s: %s\n    expected: %s\n    got:      %s\n", test,
+                pattern.toUtf8().constData(), Describe(expected).toUtf8().constData(),
+                Describe(got).toUtf8().constData());
+    }
+
+    // Every match of pattern in text the way PCRE2 finds them with the
+    // pattern exactly as given.
+    QList<std::pair<int, int>> PcreMatches(const QString &pattern, const QString &text)
+    {
+        QList<std::pair<int, int>> matches;
+        int errorno = 0;
+        PCRE2_SIZE erroroffset = 0;
+        pcre2_code *re = pcre2_compile_16(pattern.utf16(), PCRE2_ZERO_TERMINATED, PCRE2_UTF | PCRE2_MULTILINE,
+                                          &errorno, &erroroffset, NULL);
+        if (re == NULL) {
+            return matches;
+        }
+        pcre2_match_data *matchdata = pcre2_match_data_create_from_pattern_16(re, NULL);
+        PCRE2_SIZE offset = 0;
+        while (pcre2_match_16(re, text.utf16(), text.length(), offset, PCRE2_NOTEMPTY, matchdata, NULL) >= 0) {
+            PCRE2_SIZE *ovector = pcre2_get_ovector_pointer_16(matchdata);
+            matches.append(std::pair<int, int>((int) ovector[0], (int) ovector[1]));
+            offset = ovector[1];
+        }
+        pcre2_match_data_free_16(matchdata);
+        pcre2_code_free_16(re);
+        return matches;
+    }
+
+    QList<std::pair<int, int>> Offsets(const QList<SPCRE::MatchInfo> &info)
+    {
+        QList<std::pair<int, int>> offsets;
+        foreach(const SPCRE::MatchInfo &match, info) {
+            offsets.append(match.offset);
+        }
+        return offsets;
+    }
+
+    QList<std::pair<int, int>> Offsets(const SPCRE::MatchInfo &match)
+    {
+        QList<std::pair<int, int>> offsets;
+        if (match.offset.first != -1) {
+            offsets.append(match.offset);
+        }
+        return offsets;
+    }
+
+    // First, last and every match must all agree with PCRE2.
+    void CheckAgainstPcre(const char *test, const QString &pattern, const QString &text)
+    {
+        QList<std::pair<int, int>> expected = PcreMatches(pattern, text);
+        SPCRE spcre(pattern);
+        Check(test, pattern, expected, Offsets(spcre.getEveryMatchInfo(text)));
+
+        QList<std::pair<int, int>> first;
+        QList<std::pair<int, int>> last;
+        if (!expected.isEmpty()) {
+            first.append(expected.first());
+            last.append(expected.last());
+        }
+        Check(test, pattern, first, Offsets(spcre.getFirstMatchInfo(text)));
+        Check(test, pattern, last, Offsets(spcre.getLastMatchInfo(text)));
+    }
+
+    // Find Next from every position must find what PCRE2 finds first in
+    // the text after it, and Find Previous what it finds last in the text
+    // before it.
+    void CheckFindAgainstPcre(const char *test, const QString &pattern, const QString &text)
+    {
+        SPCRE spcre(pattern);
+        for (int position = 0; position <= text.length(); position++) {
+            QList<std::pair<int, int>> expected;
+            QList<std::pair<int, int>> after = PcreMatches(pattern, text.mid(position));
+            if (!after.isEmpty()) {
+                expected.append(std::pair<int, int>(after.first().first + position, after.first().second + position));
+            }
+            SPCRE::MatchInfo match = SearchUtils::FindFromPosition(spcre, text, position, 0, text.length(), false);
+            Check(test, pattern + QString(" down from %1").arg(position), expected, Offsets(match));
+
+            expected.clear();
+            QList<std::pair<int, int>> before = PcreMatches(pattern, text.left(position));
+            if (!before.isEmpty()) {
+                expected.append(before.last());
+            }
+            match = SearchUtils::FindFromPosition(spcre, text, position, 0, text.length(), true);
+            Check(test, pattern + QString(" up from %1").arg(position), expected, Offsets(match));
+        }
+    }
+
+    void CheckFind(const char *test, const QString &pattern, const QString &text, int position,
+                   bool backwards, int expected_start, int expected_end)
+    {
+        SPCRE spcre(pattern);
+        QList<std::pair<int, int>> expected;
+        if (expected_start != -1) {
+            expected.append(std::pair<int, int>(expected_start, expected_end));
+        }
+        SPCRE::MatchInfo match = SearchUtils::FindFromPosition(spcre, text, position, 0, text.length(), backwards);
+        Check(test, pattern + QString(backwards ? " up from %1" : " down from %1").arg(position),
+              expected, Offsets(match));
+    }
+
+    // Find Next from inside a match only sees the text after the cursor,
+    // so it finds the rest of that match, and a lookbehind, ^ or the
+    // Text Only prefix does not see what is in front of the cursor.
+    void FindNextFromInsideMatch()
+    {
+        CheckFind("FindNextFromInsideMatch", "\\w+", "alpha beta", 2, false, 2, 5);
+        CheckFind("FindNextFromInsideMatch", "alpha", "alpha alpha", 1, false, 6, 11);
+        CheckFind("FindNextFromInsideMatch", "(?<=a)b", "ab ab", 1, false, 4, 5);
+        CheckFind("FindNextFromInsideMatch", "^b", "ab", 1, false, 1, 2);
+        CheckFind("FindNextFromInsideMatch", TEXT_ONLY + "cat", "<a title=\"cat\">cat", 3, false, 10, 13);
+        CheckFind("FindNextFromInsideMatch", TEXT_ONLY + "cat", "<a title=\"cat\">cat", 0, false, 15, 18);
+
+        QString text = "<p class=\"a\">one two</p><p>three</p>\nfour";
+        CheckFindAgainstPcre("FindNextFromInsideMatch", "\\w+", text);
+        CheckFindAgainstPcre("FindNextFromInsideMatch", "(?<=o)\\w", text);
+        CheckFindAgainstPcre("FindNextFromInsideMatch", "^\\w+|\\w+$", text);
+        CheckFindAgainstPcre("FindNextFromInsideMatch", "two|o", text);
+        CheckFindAgainstPcre("FindNextFromInsideMatch", TEXT_ONLY + "\\w+", text);
+        CheckFindAgainstPcre("FindNextFromInsideMatch", TEXT_ONLY + "p", text);
+    }
+
+    // Find Previous only sees the text before the cursor, so from inside
+    // a match it finds the part of it in front of the cursor, and a $ or
+    // lookahead sees the cursor as the end of the text.
+    void FindPreviousFromInsideMatch()
+    {
+        CheckFind("FindPreviousFromInsideMatch", "\\w+", "alpha beta", 8, true, 6, 8);
+        CheckFind("FindPreviousFromInsideMatch", "alpha", "alpha alpha", 8, true, 0, 5);
+        CheckFind("FindPreviousFromInsideMatch", "\\w+$", "ab cd", 4, true, 3, 4);
+        CheckFind("FindPreviousFromInsideMatch", "a(?!b)", "ab ab", 4, true, 3, 4);
+        CheckFind("FindPreviousFromInsideMatch", "aa", "aaa", 3, true, 0, 2);
+        CheckFind("FindPreviousFromInsideMatch", TEXT_ONLY + "cat", "cat<a title=\"cat\">", 18, true, 0, 3);
+        CheckFind("FindPreviousFromInsideMatch", TEXT_ONLY + "cat", "<a title=\"cat\">", 13, true, 10, 13);
+
+        QString text = "<p class=\"a\">one two</p><p>three</p>\nfour";
+        CheckFindAgainstPcre("FindPreviousFromInsideMatch", "(?=o)\\w+", text);
+        CheckFindAgainstPcre("FindPreviousFromInsideMatch", "e+$", text);
+        CheckFindAgainstPcre("FindPreviousFromInsideMatch", TEXT_ONLY + "(?<![a-z])\\w", text);
+    }
+
+    void CheckText(const char *test, const QString &what, const QString &expected, const QString &got)
+    {
+        if (got == expected) {
+            return;
+        }
+        failures++;
+        fprintf(stderr, "%s: %s\n    expected: %s\n    got:      %s\n", test, what.toUtf8().constData(),
+                expected.toUtf8().constData(), got.toUtf8().constData());
+    }
+
+    // Replace All the way the code view runs it.
+    QString ReplaceAll(const QString &pattern, const QString &replacement, const QString &text,
+                       bool wrap, int position, bool backwards)
+    {
+        SPCRE spcre(pattern);
+        QList<SPCRE::MatchInfo> match_info = spcre.getEveryMatchInfo(text);
+        if (!wrap) {
+            match_info = PCREReplaceAllBuilder::MatchesFromPosition(match_info, position, backwards);
+        }
+        PCREReplaceAllBuilder builder(spcre, text, replacement, match_info.count());
+        foreach(const SPCRE::MatchInfo &mi, match_info) {
+            builder.AppendReplacement(mi);
+        }
+        return builder.Finish();
+    }
+
+    // Without wrap Replace All only replaces the matches on the search
+    // direction side of the cursor, a match around the cursor is on
+    // both sides. Searching up it replaces the matches before the cursor
+    // even when there are matches after it.
+    void ReplaceAllFromPosition()
+    {
+        QString text = "a1 a2 a3";
+        QString pattern = "a(\\d)";
+        QString replacement = "x\\1";
+        CheckText("ReplaceAllFromPosition", "wrap", "x1 x2 x3", ReplaceAll(pattern, replacement, text, true, 4, false));
+        CheckText("ReplaceAllFromPosition", "down from 4", "a1 x2 x3", ReplaceAll(pattern, replacement, text, false, 4, false));
+        CheckText("ReplaceAllFromPosition", "up from 4", "x1 x2 a3", ReplaceAll(pattern, replacement, text, false, 4, true));
+        CheckText("ReplaceAllFromPosition", "down from 2", "x1 x2 x3", ReplaceAll(pattern, replacement, text, false, 2, false));
+        CheckText("ReplaceAllFromPosition", "up from 3", "x1 x2 a3", ReplaceAll(pattern, replacement, text, false, 3, true));
+        CheckText("ReplaceAllFromPosition", "up from 0", "x1 a2 a3", ReplaceAll(pattern, replacement, text, false, 0, true));
+        CheckText("ReplaceAllFromPosition", "down from 8", "a1 a2 x3", ReplaceAll(pattern, replacement, text, false, 8, false));
+        CheckText("ReplaceAllFromPosition", "up from 8", "x1 x2 x3", ReplaceAll(pattern, replacement, text, false, 8, true));
+        CheckText("ReplaceAllFromPosition", "down from 0 literal", "b1 b2 b3", ReplaceAll("a", "b", text, false, 0, false));
+    }
+
+    void TextOnly()
+    {
+        QString text = "<p class=\"a\">a cat<br/>cat<img alt=\"cat\"/> a<b>c</b>at <cat> cat</p>"
+                       "<< cat > <cat";
+        CheckAgainstPcre("TextOnly", TEXT_ONLY + "cat", text);
+        CheckAgainstPcre("TextOnly", TEXT_ONLY + "(?i)CAT", text);
+        CheckAgainstPcre("TextOnly", "(?i)" + TEXT_ONLY + "CAT", text);
+        CheckAgainstPcre("TextOnly", TEXT_ONLY + "c\\w*", text);
+        CheckAgainstPcre("TextOnly", TEXT_ONLY + "a[^<]*", text);
+        CheckAgainstPcre("TextOnly", TEXT_ONLY + "(?<=>)\\w+", text);
+        CheckAgainstPcre("TextOnly", TEXT_ONLY + "\\bc", text);
+    }
+
+    // Many tags in front of the only match, and many after it that the
+    // pattern matches inside of. Each tag only has to be passed once,
+    // looking for the match again after every one of them takes far
+    // longer than the test is given to run.
+    void TextOnlyManyTags()
+    {
+        QString text;
+        for (int i = 0; i < 100000; i++) {
+            text.append("<span class=\"a\">x</span>");
+        }
+        text.append(" cat ");
+        for (int i = 0; i < 100000; i++) {
+            text.append("<span class=\"cat\">x</span>");
+        }
+        CheckAgainstPcre("TextOnlyManyTags", TEXT_ONLY + "cat", text);
+        CheckAgainstPcre("TextOnlyManyTags", TEXT_ONLY + "ca+t", text);
+        CheckAgainstPcre("TextOnlyManyTags", TEXT_ONLY + " c", text);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    TextOnly();
+    TextOnlyManyTags();
+    FindNextFromInsideMatch();
+    FindPreviousFromInsideMatch();
+    ReplaceAllFromPosition();
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all search checks passed\n");
+    return 0;
+}
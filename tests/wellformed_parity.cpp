@@ -0,0 +1,112 @@
+/************************************************************************
+**
+**  Copyright (C) 2026 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+// Checks every document of the well-formedness corpus with the
+// WellFormedXMLChecker and compares the line, column and message with
+// what libxml2 reported for it (wellformed/expected.txt).
+//
+// wellformed_parity <corpus directory>
+//
+// Documents whose name starts with "unsupported-" use what the checker
+// leaves to lxml, for those it has to say so instead of giving a result.
+
+#include <stdio.h>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include "Parsers/WellFormedXMLChecker.h"
+
+namespace
+{
+    QString Result(const QString &document)
+    {
+        QFile file(document);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return "cannot be read";
+        }
+        QString source = QString::fromUtf8(file.readAll());
+        WellFormedXMLChecker::Error error = WellFormedXMLChecker::Check(QStringView(source));
+        if (error.unsupported) {
+            return "unsupported";
+        }
+        if (error.line == -1) {
+            return "-1\t-1\twell-formed";
+        }
+        QString message = error.message;
+        message.replace('\n', ' ').replace('\t', ' ');
+        return QString("%1\t%2\t%3").arg(error.line).arg(error.column).arg(message);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: wellformed_parity <corpus directory>\n");
+        return 2;
+    }
+    QDir corpus(QString::fromLocal8Bit(argv[1]));
+    QFile expected_file(corpus.filePath("expected.txt"));
+    if (!expected_file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "no expected.txt in %s\n", argv[1]);
+        return 2;
+    }
+    QStringList expected_lines = QString::fromUtf8(expected_file.readAll()).split('\n', Qt::SkipEmptyParts);
+
+    int checked = 0;
+    int unsupported = 0;
+    int mismatches = 0;
+    int unlisted = 0;
+    QStringList listed;
+    foreach(const QString &line, expected_lines) {
+        if (line.startsWith('#')) continue;
+        QString name = line.section('\t', 0, 0);
+        QString expected = line.section('\t', 1);
+        listed.append(name);
+        QString result = Result(corpus.filePath(name));
+        bool should_be_unsupported = name.startsWith("unsupported-");
+        if ((result == "unsupported") && should_be_unsupported) {
+            unsupported++;
+            continue;
+        }
+        checked++;
+        if (should_be_unsupported) {
+            expected = "unsupported";
+        }
+        if (result != expected) {
+            mismatches++;
+            fprintf(stderr, "%s\n    expected: %s\n    got:      %s\n", qPrintable(name),
+                    expected.toUtf8().constData(), result.toUtf8().constData());
+        }
+    }
+    foreach(const QString &name, corpus.entryList(QStringList() << "*.xml", QDir::Files)) {
+        if (!listed.contains(name)) {
+            unlisted++;
+            fprintf(stderr, "%s is not in expected.txt\n", qPrintable(name));
+        }
+    }
+    printf("%d of %d documents match libxml2, %d left to lxml\n", checked - mismatches, checked, unsupported);
+    return (mismatches || unlisted) ? 1 : 0;
+}